@@ -0,0 +1,45 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+    mat4 modelview;
+} pc;
+
+// per tile data written by TilePool::recordDraw(), indexed by the firstInstance of each indirect draw
+struct TileInstance {
+    mat4 modelview;
+    uint layer;
+    uint flipT;
+    uint padding0;
+    uint padding1;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer TileInstances {
+    TileInstance tiles[];
+} tileInstances;
+
+layout(constant_id = 0) const uint numRows = 32;
+layout(constant_id = 1) const uint numColumns = 32;
+
+layout(location = 0) in vec3 inPosition;
+
+layout(location = 0) out vec3 fragTexCoord;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main()
+{
+    TileInstance tile = tileInstances.tiles[gl_InstanceIndex];
+
+    // gl_VertexIndex includes the tile's vertexOffset, so the position within the grid gives the texture coordinate
+    uint vi = uint(gl_VertexIndex) % (numRows * numColumns);
+    float s = float(vi % numColumns) / float(numColumns - 1);
+    float t = float(vi / numColumns) / float(numRows - 1);
+    if (tile.flipT != 0) t = 1.0 - t;
+
+    gl_Position = (pc.projection * tile.modelview) * vec4(inPosition, 1.0);
+    fragTexCoord = vec3(s, t, float(tile.layer));
+}
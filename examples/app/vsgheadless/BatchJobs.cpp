@@ -0,0 +1,96 @@
+#include "BatchJobs.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    void replaceAll(std::string& str, const std::string& key, const std::string& value)
+    {
+        for (auto pos = str.find(key); pos != std::string::npos; pos = str.find(key, pos + value.size()))
+        {
+            str.replace(pos, key.size(), value);
+        }
+    }
+} // namespace
+
+bool BatchJobs::read(const vsg::Path& filename)
+{
+    std::ifstream fin(filename.string());
+    if (!fin)
+    {
+        std::cout << "Error: unable to open job file " << filename << std::endl;
+        return false;
+    }
+
+    std::string line;
+    for (uint32_t lineNumber = 1; std::getline(fin, line); ++lineNumber)
+    {
+        std::istringstream str(line);
+        std::string keyword;
+        if (!(str >> keyword) || keyword[0] == '#') continue;
+
+        bool valid = false;
+        if (keyword == "model")
+        {
+            std::string model;
+            if ((valid = static_cast<bool>(str >> model))) models.emplace_back(model);
+        }
+        else if (keyword == "view")
+        {
+            vsg::dvec3 direction;
+            valid = static_cast<bool>(str >> direction.x >> direction.y >> direction.z) && vsg::length(direction) > 0.0;
+            if (valid) views.push_back(vsg::normalize(direction));
+        }
+        else if (keyword == "extent")
+        {
+            VkExtent2D extent;
+            valid = static_cast<bool>(str >> extent.width >> extent.height) && extent.width > 0 && extent.height > 0;
+            if (valid) extents.push_back(extent);
+        }
+        else if (keyword == "output")
+        {
+            valid = static_cast<bool>(str >> outputPattern);
+        }
+
+        if (!valid)
+        {
+            std::cout << "Error: " << filename << " line " << lineNumber << " not recognized : " << line << std::endl;
+            return false;
+        }
+    }
+
+    // a job file with just models renders them from the same view and extent as vsgheadless does by default
+    if (views.empty()) views.push_back(vsg::dvec3(0.0, -1.0, 0.0));
+    if (extents.empty()) extents.push_back(VkExtent2D{256, 256});
+
+    return !models.empty();
+}
+
+vsg::Path BatchJobs::outputFilename(const vsg::Path& model, uint32_t viewIndex, const VkExtent2D& extent) const
+{
+    std::string filename = outputPattern;
+    replaceAll(filename, "{model}", vsg::simpleFilename(model).string());
+    replaceAll(filename, "{view}", std::to_string(viewIndex));
+    replaceAll(filename, "{width}", std::to_string(extent.width));
+    replaceAll(filename, "{height}", std::to_string(extent.height));
+    return vsg::Path(filename);
+}
+
+std::vector<BatchJob> BatchJobs::jobs() const
+{
+    std::vector<BatchJob> jobs;
+    jobs.reserve(models.size() * views.size() * extents.size());
+    for (auto& model : models)
+    {
+        for (auto& extent : extents)
+        {
+            for (uint32_t viewIndex = 0; viewIndex < static_cast<uint32_t>(views.size()); ++viewIndex)
+            {
+                jobs.push_back(BatchJob{model, viewIndex, views[viewIndex], extent, outputFilename(model, viewIndex, extent)});
+            }
+        }
+    }
+    return jobs;
+}
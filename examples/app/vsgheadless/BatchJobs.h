@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// a single image to render, one of the combinations of the models, views and extents in a job file
+struct BatchJob
+{
+    vsg::Path model;
+    uint32_t viewIndex = 0;
+    vsg::dvec3 direction;
+    VkExtent2D extent{256, 256};
+    vsg::Path output;
+};
+
+// BatchJobs reads a job file for vsgheadless --batch, every model is rendered from every view at every extent:
+//
+//     # thumbnails of two models from the front and the side
+//     model models/teapot.vsgt
+//     model models/lz.vsgt
+//     view 0 -1 0.3
+//     view 1 0 0.3
+//     extent 256 256
+//     extent 1024 768
+//     output thumbnails/{model}_{view}_{width}x{height}.vsgb
+//
+// A view is the direction from the centre of the model towards the eye. In the output pattern {model} is replaced by the model's
+// filename without path or extension, {view} by the index of the view and {width} and {height} by the extent. The jobs are ordered by model then extent so that each model is loaded and compiled once and
+// consecutive jobs can share a frame.
+class BatchJobs : public vsg::Inherit<vsg::Object, BatchJobs>
+{
+public:
+    std::vector<vsg::Path> models;
+    std::vector<vsg::dvec3> views;
+    std::vector<VkExtent2D> extents;
+    std::string outputPattern = "{model}_{view}_{width}x{height}.vsgb";
+
+    // read the job file, returning false and reporting the line of the first error
+    bool read(const vsg::Path& filename);
+
+    std::vector<BatchJob> jobs() const;
+
+    vsg::Path outputFilename(const vsg::Path& model, uint32_t viewIndex, const VkExtent2D& extent) const;
+};
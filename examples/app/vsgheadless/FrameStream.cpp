@@ -0,0 +1,366 @@
+#include "FrameStream.h"
+
+#include <cstring>
+#include <thread>
+
+#if defined(_WIN32)
+#    include <fcntl.h>
+#    include <io.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define FRAMESTREAM_SSE2
+#    include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    define FRAMESTREAM_NEON
+#    include <arm_neon.h>
+#endif
+
+namespace
+{
+    // BT.601 limited range in 8 bit fixed point, the SIMD paths compute exactly the same values.
+    inline uint8_t toY(int r, int g, int b) { return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16); }
+    inline uint8_t toU(int r, int g, int b) { return static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128); }
+    inline uint8_t toV(int r, int g, int b) { return static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128); }
+
+    inline int average(int a, int b) { return (a + b + 1) >> 1; }
+
+    // average of a 2x2 block of RGBA pixels, rounding the same way as _mm_avg_epu8/vrhadd, vertically then horizontally.
+    inline void averageBlock(const uint8_t* row0, const uint8_t* row1, uint32_t x0, uint32_t x1, int& r, int& g, int& b)
+    {
+        const uint8_t* p00 = row0 + x0 * 4;
+        const uint8_t* p01 = row0 + x1 * 4;
+        const uint8_t* p10 = row1 + x0 * 4;
+        const uint8_t* p11 = row1 + x1 * 4;
+        r = average(average(p00[0], p10[0]), average(p01[0], p11[0]));
+        g = average(average(p00[1], p10[1]), average(p01[1], p11[1]));
+        b = average(average(p00[2], p10[2]), average(p01[2], p11[2]));
+    }
+
+#if defined(FRAMESTREAM_SSE2)
+    // Y of 4 RGBA pixels, one per 32 bit lane
+    inline __m128i luma4(__m128i px)
+    {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        __m128i r = _mm_and_si128(px, mask);
+        __m128i g = _mm_and_si128(_mm_srli_epi32(px, 8), mask);
+        __m128i b = _mm_and_si128(_mm_srli_epi32(px, 16), mask);
+
+        // products and sum fit in unsigned 16 bits, the upper 16 bits of each lane stay zero
+        __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi32(66)), _mm_mullo_epi16(g, _mm_set1_epi32(129)));
+        y = _mm_add_epi16(y, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi32(25)), _mm_set1_epi32(128)));
+        return _mm_add_epi16(_mm_srli_epi16(y, 8), _mm_set1_epi32(16));
+    }
+
+    // U or V of the averaged pixels in lanes 0 and 2, the coefficients are signed 16 bit values with zero upper halves
+    inline __m128i chroma4(__m128i px, int cr, int cg, int cb)
+    {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        __m128i r = _mm_and_si128(px, mask);
+        __m128i g = _mm_and_si128(_mm_srli_epi32(px, 8), mask);
+        __m128i b = _mm_and_si128(_mm_srli_epi32(px, 16), mask);
+
+        auto coefficient = [](int c) { return _mm_set1_epi32(static_cast<uint16_t>(c)); };
+        __m128i c = _mm_add_epi16(_mm_mullo_epi16(r, coefficient(cr)), _mm_mullo_epi16(g, coefficient(cg)));
+        c = _mm_add_epi16(c, _mm_add_epi16(_mm_mullo_epi16(b, coefficient(cb)), _mm_set1_epi32(128)));
+        c = _mm_srai_epi16(c, 8);
+        c = _mm_and_si128(_mm_add_epi16(c, _mm_set1_epi32(128)), _mm_set1_epi32(0xffff));
+
+        // move lanes 0 and 2 to the bottom 64 bits
+        return _mm_shuffle_epi32(c, _MM_SHUFFLE(3, 1, 2, 0));
+    }
+
+    inline __m128i averageBlocks4(const uint8_t* row0, const uint8_t* row1)
+    {
+        __m128i v = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1)));
+        return _mm_avg_epu8(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+
+    inline void store4(uint8_t* dst, __m128i lo, __m128i hi)
+    {
+        __m128i v = _mm_unpacklo_epi64(lo, hi);
+        v = _mm_packs_epi32(v, v);
+        int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+        std::memcpy(dst, &packed, 4);
+    }
+#endif
+
+    // convert 8 pixels wide runs of a pair of rows, returning the number of pixels converted
+    uint32_t convertRowPairSIMD(const uint8_t* row0, const uint8_t* row1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width)
+    {
+        uint32_t x = 0;
+#if defined(FRAMESTREAM_SSE2)
+        for (; x + 8 <= width; x += 8)
+        {
+            const uint8_t* p0 = row0 + x * 4;
+            const uint8_t* p1 = row1 + x * 4;
+
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0));
+            __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + 16));
+            __m128i ya = _mm_packs_epi32(luma4(a0), luma4(b0));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(y0 + x), _mm_packus_epi16(ya, ya));
+
+            if (y1)
+            {
+                __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1));
+                __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + 16));
+                __m128i yb = _mm_packs_epi32(luma4(a1), luma4(b1));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(y1 + x), _mm_packus_epi16(yb, yb));
+            }
+
+            __m128i blocksA = averageBlocks4(p0, p1);
+            __m128i blocksB = averageBlocks4(p0 + 16, p1 + 16);
+            store4(u + x / 2, chroma4(blocksA, -38, -74, 112), chroma4(blocksB, -38, -74, 112));
+            store4(v + x / 2, chroma4(blocksA, 112, -94, -18), chroma4(blocksB, 112, -94, -18));
+        }
+#elif defined(FRAMESTREAM_NEON)
+        for (; x + 16 <= width; x += 16)
+        {
+            uint8x16x4_t p0 = vld4q_u8(row0 + x * 4);
+            uint8x16x4_t p1 = vld4q_u8(row1 + x * 4);
+
+            auto luma = [](const uint8x16x4_t& p, uint8_t* dst) {
+                uint16x8_t lo = vmull_u8(vget_low_u8(p.val[0]), vdup_n_u8(66));
+                lo = vmlal_u8(lo, vget_low_u8(p.val[1]), vdup_n_u8(129));
+                lo = vmlal_u8(lo, vget_low_u8(p.val[2]), vdup_n_u8(25));
+                uint16x8_t hi = vmull_u8(vget_high_u8(p.val[0]), vdup_n_u8(66));
+                hi = vmlal_u8(hi, vget_high_u8(p.val[1]), vdup_n_u8(129));
+                hi = vmlal_u8(hi, vget_high_u8(p.val[2]), vdup_n_u8(25));
+                lo = vaddq_u16(lo, vdupq_n_u16(128));
+                hi = vaddq_u16(hi, vdupq_n_u16(128));
+                vst1q_u8(dst, vaddq_u8(vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)), vdupq_n_u8(16)));
+            };
+
+            luma(p0, y0 + x);
+            if (y1) luma(p1, y1 + x);
+
+            // average vertically then horizontally, vrshr by 1 of the pairwise sum rounds the same as vrhadd
+            int16x8_t r = vreinterpretq_s16_u16(vrshrq_n_u16(vpaddlq_u8(vrhaddq_u8(p0.val[0], p1.val[0])), 1));
+            int16x8_t g = vreinterpretq_s16_u16(vrshrq_n_u16(vpaddlq_u8(vrhaddq_u8(p0.val[1], p1.val[1])), 1));
+            int16x8_t b = vreinterpretq_s16_u16(vrshrq_n_u16(vpaddlq_u8(vrhaddq_u8(p0.val[2], p1.val[2])), 1));
+
+            auto chroma = [&](int16_t cr, int16_t cg, int16_t cb, uint8_t* dst) {
+                int16x8_t c = vmulq_n_s16(r, cr);
+                c = vmlaq_n_s16(c, g, cg);
+                c = vmlaq_n_s16(c, b, cb);
+                c = vshrq_n_s16(vaddq_s16(c, vdupq_n_s16(128)), 8);
+                vst1_u8(dst, vqmovun_s16(vaddq_s16(c, vdupq_n_s16(128))));
+            };
+
+            chroma(-38, -74, 112, u + x / 2);
+            chroma(112, -94, -18, v + x / 2);
+        }
+#else
+        (void)row0;
+        (void)row1;
+        (void)y0;
+        (void)y1;
+        (void)u;
+        (void)v;
+        (void)width;
+#endif
+        return x;
+    }
+} // namespace
+
+void convertRGBAtoBGRA(const uint8_t* src, size_t srcRowPitch, uint8_t* dst, uint32_t width, uint32_t height)
+{
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* s = src + y * srcRowPitch;
+        uint8_t* d = dst + size_t(y) * width * 4;
+        uint32_t x = 0;
+#if defined(FRAMESTREAM_SSE2)
+        const __m128i agMask = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+        const __m128i rbMask = _mm_set1_epi32(0x00ff00ff);
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x * 4));
+            __m128i rb = _mm_and_si128(px, rbMask);
+            __m128i swapped = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x * 4), _mm_or_si128(_mm_and_si128(px, agMask), swapped));
+        }
+#elif defined(FRAMESTREAM_NEON)
+        for (; x + 16 <= width; x += 16)
+        {
+            uint8x16x4_t px = vld4q_u8(s + x * 4);
+            uint8x16_t r = px.val[0];
+            px.val[0] = px.val[2];
+            px.val[2] = r;
+            vst4q_u8(d + x * 4, px);
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            d[x * 4 + 0] = s[x * 4 + 2];
+            d[x * 4 + 1] = s[x * 4 + 1];
+            d[x * 4 + 2] = s[x * 4 + 0];
+            d[x * 4 + 3] = s[x * 4 + 3];
+        }
+    }
+}
+
+void convertRGBAtoYUV420(const uint8_t* src, size_t srcRowPitch, uint8_t* dst, uint32_t width, uint32_t height)
+{
+    uint32_t chromaWidth = (width + 1) / 2;
+    uint32_t chromaHeight = (height + 1) / 2;
+    uint8_t* yPlane = dst;
+    uint8_t* uPlane = yPlane + size_t(width) * height;
+    uint8_t* vPlane = uPlane + size_t(chromaWidth) * chromaHeight;
+
+    for (uint32_t y = 0; y < height; y += 2)
+    {
+        // an odd last row is paired with itself
+        bool secondRow = (y + 1) < height;
+        const uint8_t* row0 = src + y * srcRowPitch;
+        const uint8_t* row1 = secondRow ? row0 + srcRowPitch : row0;
+        uint8_t* y0 = yPlane + size_t(y) * width;
+        uint8_t* y1 = secondRow ? y0 + width : nullptr;
+        uint8_t* u = uPlane + size_t(y / 2) * chromaWidth;
+        uint8_t* v = vPlane + size_t(y / 2) * chromaWidth;
+
+        uint32_t x = convertRowPairSIMD(row0, row1, y0, y1, u, v, width);
+
+        for (; x < width; ++x)
+        {
+            const uint8_t* p0 = row0 + x * 4;
+            y0[x] = toY(p0[0], p0[1], p0[2]);
+            if (y1)
+            {
+                const uint8_t* p1 = row1 + x * 4;
+                y1[x] = toY(p1[0], p1[1], p1[2]);
+            }
+
+            if ((x & 1) == 0)
+            {
+                // an odd last column is paired with itself
+                int r, g, b;
+                averageBlock(row0, row1, x, std::min(x + 1, width - 1), r, g, b);
+                u[x / 2] = toU(r, g, b);
+                v[x / 2] = toV(r, g, b);
+            }
+        }
+    }
+}
+
+FrameStream::FrameStream(const vsg::Path& filename, Format in_format, double in_framesPerSecond) :
+    format(in_format),
+    framesPerSecond(in_framesPerSecond)
+{
+    if (filename.string() == "-")
+    {
+        _file = stdout;
+#if defined(_WIN32)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+    else
+    {
+        // a named pipe is opened like a file, blocking until the reader opens the other end
+        _file = std::fopen(filename.string().c_str(), "wb");
+        if (!_file) throw vsg::Exception{vsg::make_string("Error: FrameStream unable to open ", filename)};
+        _closeFile = true;
+    }
+}
+
+FrameStream::~FrameStream()
+{
+    if (_closeFile)
+        std::fclose(_file);
+    else
+        std::fflush(_file);
+}
+
+FrameStream::Format FrameStream::formatFromString(const std::string& str)
+{
+    if (str == "bgra") return BGRA;
+    if (str == "yuv420") return YUV420;
+    return RGBA;
+}
+
+size_t FrameStream::frameSize(uint32_t width, uint32_t height) const
+{
+    if (format == YUV420) return size_t(width) * height + 2 * size_t((width + 1) / 2) * ((height + 1) / 2);
+    return size_t(width) * height * 4;
+}
+
+vsg::clock::time_point FrameStream::pace()
+{
+    if (numFrames == 0) _start = vsg::clock::now();
+
+    if (framesPerSecond > 0.0)
+    {
+        std::this_thread::sleep_until(_start + std::chrono::duration_cast<vsg::clock::duration>(std::chrono::duration<double>(double(numFrames) / framesPerSecond)));
+    }
+
+    return vsg::clock::now();
+}
+
+bool FrameStream::finish(bool result, size_t size, vsg::clock::time_point startOfWrite)
+{
+    writeTime += std::chrono::duration<double>(vsg::clock::now() - startOfWrite).count();
+
+    if (result)
+    {
+        ++numFrames;
+        numBytes += size;
+    }
+    return result;
+}
+
+bool FrameStream::write(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch)
+{
+    auto startOfWrite = pace();
+
+    size_t size = frameSize(width, height);
+    bool result = true;
+    if (format == RGBA)
+    {
+        size_t rowSize = size_t(width) * 4;
+        if (rowPitch == rowSize)
+        {
+            result = std::fwrite(rgba, 1, size, _file) == size;
+        }
+        else
+        {
+            for (uint32_t y = 0; y < height && result; ++y) result = std::fwrite(rgba + y * rowPitch, 1, rowSize, _file) == rowSize;
+        }
+    }
+    else
+    {
+        _buffer.resize(size);
+        if (format == BGRA)
+            convertRGBAtoBGRA(rgba, rowPitch, _buffer.data(), width, height);
+        else
+            convertRGBAtoYUV420(rgba, rowPitch, _buffer.data(), width, height);
+
+        result = std::fwrite(_buffer.data(), 1, size, _file) == size;
+    }
+
+    return finish(result, size, startOfWrite);
+}
+
+bool FrameStream::writeYUV420(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t width, uint32_t height)
+{
+    if (format != YUV420) return false;
+
+    auto startOfWrite = pace();
+
+    size_t lumaSize = size_t(width) * height;
+    size_t chromaSize = size_t((width + 1) / 2) * ((height + 1) / 2);
+
+    // the planes are usually contiguous so can be written in one go
+    bool result;
+    if (u == y + lumaSize && v == u + chromaSize)
+    {
+        result = std::fwrite(y, 1, lumaSize + 2 * chromaSize, _file) == lumaSize + 2 * chromaSize;
+    }
+    else
+    {
+        result = std::fwrite(y, 1, lumaSize, _file) == lumaSize &&
+                 std::fwrite(u, 1, chromaSize, _file) == chromaSize &&
+                 std::fwrite(v, 1, chromaSize, _file) == chromaSize;
+    }
+
+    return finish(result, lumaSize + 2 * chromaSize, startOfWrite);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <cstdio>
+
+// FrameStream writes rendered frames as raw video to stdout or a named pipe, for piping into an encoder such as
+//     vsgheadless model.vsgt --stream - --stream-format yuv420 | ffmpeg -f rawvideo -pix_fmt yuv420p -s 1920x1080 -i - out.mp4
+//
+// RGBA frames are written straight from the mapped capture memory a row at a time, BGRA and YUV420 (I420, BT.601 limited range)
+// are converted with SSE2 or NEON into a single output buffer that is then written, so there are no other copies of the frame.
+// Optionally the frames are paced to a fixed frame rate rather than written as fast as they are rendered.
+class FrameStream : public vsg::Inherit<vsg::Object, FrameStream>
+{
+public:
+    enum Format
+    {
+        RGBA,
+        BGRA,
+        YUV420
+    };
+
+    // filename of "-" writes to stdout
+    FrameStream(const vsg::Path& filename, Format in_format, double in_framesPerSecond = 0.0);
+
+    const Format format;
+    const double framesPerSecond;
+
+    // parse "rgba", "bgra" or "yuv420", defaulting to RGBA
+    static Format formatFromString(const std::string& str);
+
+    // write a frame of RGBA8 pixels whose rows are rowPitch bytes apart
+    bool write(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch);
+
+    // write a frame that has already been converted to I420 planes, e.g. on the GPU, the stream format must be YUV420
+    bool writeYUV420(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t width, uint32_t height);
+
+    size_t frameSize(uint32_t width, uint32_t height) const;
+
+    // stats
+    uint64_t numFrames = 0;
+    uint64_t numBytes = 0;
+    double writeTime = 0.0; // seconds spent converting and writing
+
+protected:
+    virtual ~FrameStream();
+
+    // wait until the next frame is due, returning the time writing started
+    vsg::clock::time_point pace();
+    bool finish(bool result, size_t size, vsg::clock::time_point startOfWrite);
+
+    std::FILE* _file = nullptr;
+    bool _closeFile = false;
+    std::vector<uint8_t> _buffer;
+    vsg::clock::time_point _start;
+};
+
+// convert RGBA8 rows to BGRA8 and to I420 planes, exposed so they can be benchmarked separately from the output.
+void convertRGBAtoBGRA(const uint8_t* src, size_t srcRowPitch, uint8_t* dst, uint32_t width, uint32_t height);
+void convertRGBAtoYUV420(const uint8_t* src, size_t srcRowPitch, uint8_t* dst, uint32_t width, uint32_t height);
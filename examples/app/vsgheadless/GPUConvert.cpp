@@ -0,0 +1,197 @@
+#include "GPUConvert.h"
+
+#include <algorithm>
+
+namespace
+{
+    const uint32_t workgroupSize = 64;   // local_size_x in shaders/headless_convert.comp
+    const uint32_t maxWorkgroupsX = 4096; // spread large dispatches over y to stay well within maxComputeWorkGroupCount
+} // namespace
+
+GPUConvert::GPUConvert(Mode in_mode, vsg::ref_ptr<vsg::ShaderStage> computeShader, const VkExtent2D& in_extent, vsg::ref_ptr<vsg::vec2Value> in_depthProjection) :
+    mode(in_mode),
+    extent(in_extent),
+    depthProjection(in_depthProjection)
+{
+    if (!depthProjection) depthProjection = vsg::vec2Value::create(vsg::vec2(0.0f, 1.0f));
+
+    // share the shader module but give each extent its own specialization constants
+    auto computeStage = vsg::ShaderStage::create(VK_SHADER_STAGE_COMPUTE_BIT, "main", computeShader->module);
+    computeStage->specializationConstants = vsg::ShaderStage::SpecializationConstants{
+        {0, vsg::intValue::create(static_cast<int>(extent.width))},
+        {1, vsg::intValue::create(static_cast<int>(extent.height))},
+        {2, vsg::intValue::create(static_cast<int>(mode))}};
+
+    vsg::DescriptorSetLayoutBindings descriptorBindings{
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}};
+    _descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+
+    vsg::PushConstantRanges pushConstantRanges{{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vsg::vec2)}};
+    _pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{_descriptorSetLayout}, pushConstantRanges);
+    _bindPipeline = vsg::BindComputePipeline::create(vsg::ComputePipeline::create(_pipelineLayout, computeStage));
+
+    // the shader uses texelFetch so filtering doesn't matter, but depth formats aren't required to support linear filtering
+    _sampler = vsg::Sampler::create();
+    _sampler->magFilter = VK_FILTER_NEAREST;
+    _sampler->minFilter = VK_FILTER_NEAREST;
+    _sampler->mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    _sampler->anisotropyEnable = VK_FALSE;
+}
+
+bool GPUConvert::modeFromString(const std::string& str, Mode& mode)
+{
+    if (str == "rgb")
+        mode = RGB;
+    else if (str == "yuv420")
+        mode = YUV420;
+    else if (str == "linear")
+        mode = LINEAR_DEPTH;
+    else if (str == "linear8")
+        mode = LINEAR_DEPTH8;
+    else
+        return false;
+    return true;
+}
+
+void GPUConvert::setDepthProjection(vsg::vec2Value& value, const vsg::dmat4& projectionMatrix)
+{
+    value.value() = vsg::vec2(static_cast<float>(projectionMatrix[2][2]), static_cast<float>(projectionMatrix[3][2]));
+}
+
+uint32_t GPUConvert::numUnits() const
+{
+    // each invocation writes one 32 bit word, or 3 for packed RGB
+    uint32_t numPixels = extent.width * extent.height;
+    uint32_t numQuads = (numPixels + 3) / 4;
+    switch (mode)
+    {
+    case RGB: return numQuads;
+    case YUV420: {
+        uint32_t numChroma = ((extent.width + 1) / 2) * ((extent.height + 1) / 2);
+        return numQuads + 2 * ((numChroma + 3) / 4);
+    }
+    case LINEAR_DEPTH: return numPixels;
+    default: return numQuads;
+    }
+}
+
+VkDeviceSize GPUConvert::bufferSize() const
+{
+    switch (mode)
+    {
+    case RGB: return VkDeviceSize(numUnits()) * 12;
+    case YUV420: {
+        // round up to whole rows so the planes can be mapped as a single ubyteArray2D
+        VkDeviceSize rows = (VkDeviceSize(numUnits()) * 4 + extent.width - 1) / extent.width;
+        return rows * extent.width;
+    }
+    default: return VkDeviceSize(numUnits()) * 4;
+    }
+}
+
+std::array<VkDeviceSize, 3> GPUConvert::planeOffsets() const
+{
+    VkDeviceSize lumaSize = VkDeviceSize((extent.width * extent.height + 3) / 4) * 4;
+    VkDeviceSize chromaSize = VkDeviceSize((((extent.width + 1) / 2) * ((extent.height + 1) / 2) + 3) / 4) * 4;
+    return {0, lumaSize, lumaSize + chromaSize};
+}
+
+std::pair<vsg::ref_ptr<vsg::Commands>, vsg::ref_ptr<vsg::Buffer>> GPUConvert::createCapture(vsg::ref_ptr<vsg::Device> device, vsg::ref_ptr<vsg::Image> sourceImage, VkImageLayout sourceLayout)
+{
+    // 1. create host visible buffer for the compute shader to write to
+    VkDeviceSize size = bufferSize();
+    auto destinationBuffer = vsg::createBufferAndMemory(device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+    // 2. descriptors for sampling the source image, sampling a depth image requires a view of just the depth aspect
+    VkImageAspectFlags aspectFlags = depthMode() ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    auto imageInfo = vsg::ImageInfo::create(_sampler, vsg::ImageView::create(sourceImage, aspectFlags), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    vsg::Descriptors descriptors{
+        vsg::DescriptorImage::create(imageInfo, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+        vsg::DescriptorBuffer::create(vsg::BufferInfoList{vsg::BufferInfo::create(destinationBuffer, 0, size)}, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)};
+    auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, vsg::DescriptorSet::create(_descriptorSetLayout, descriptors));
+
+    VkAccessFlags attachmentAccess = depthMode() ? (VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT) : (VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    VkPipelineStageFlags attachmentStages = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+    auto commands = vsg::Commands::create();
+
+    // 3.a) transition source image for sampling once rendering has finished
+    auto transitionSourceImageToShaderReadBarrier = vsg::ImageMemoryBarrier::create(
+        attachmentAccess,                                // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT,                       // dstAccessMask
+        sourceLayout,                                    // oldLayout
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,        // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                         // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                         // dstQueueFamilyIndex
+        sourceImage,                                     // image
+        VkImageSubresourceRange{aspectFlags, 0, 1, 0, 1} // subresourceRange
+    );
+
+    commands->addChild(vsg::PipelineBarrier::create(
+        attachmentStages,                        // srcStageMask
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,    // dstStageMask
+        0,                                       // dependencyFlags
+        transitionSourceImageToShaderReadBarrier // barrier
+        ));
+
+    // 3.b) convert
+    uint32_t numWorkgroups = (numUnits() + workgroupSize - 1) / workgroupSize;
+    uint32_t workgroupsX = std::min(numWorkgroups, maxWorkgroupsX);
+    uint32_t workgroupsY = (numWorkgroups + workgroupsX - 1) / workgroupsX;
+
+    commands->addChild(_bindPipeline);
+    commands->addChild(bindDescriptorSet);
+    commands->addChild(vsg::PushConstants::create(VK_SHADER_STAGE_COMPUTE_BIT, 0, depthProjection));
+    commands->addChild(vsg::Dispatch::create(workgroupsX, workgroupsY, 1));
+
+    // 3.c) transition source image back for rendering and make the converted data visible to the host
+    auto transitionSourceImageBackBarrier = vsg::ImageMemoryBarrier::create(
+        VK_ACCESS_SHADER_READ_BIT,                       // srcAccessMask
+        attachmentAccess,                                // dstAccessMask
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,        // oldLayout
+        sourceLayout,                                    // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                         // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                         // dstQueueFamilyIndex
+        sourceImage,                                     // image
+        VkImageSubresourceRange{aspectFlags, 0, 1, 0, 1} // subresourceRange
+    );
+
+    auto transitionDestinationBufferToHostReadBarrier = vsg::BufferMemoryBarrier::create(
+        VK_ACCESS_SHADER_WRITE_BIT, // srcAccessMask
+        VK_ACCESS_HOST_READ_BIT,    // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,    // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,    // dstQueueFamilyIndex
+        destinationBuffer,          // buffer
+        0,                          // offset
+        size                        // size
+    );
+
+    commands->addChild(vsg::PipelineBarrier::create(
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,          // srcStageMask
+        attachmentStages | VK_PIPELINE_STAGE_HOST_BIT, // dstStageMask
+        0,                                             // dependencyFlags
+        transitionSourceImageBackBarrier,              // barrier
+        transitionDestinationBufferToHostReadBarrier   // barrier
+        ));
+
+    return {commands, destinationBuffer};
+}
+
+vsg::ref_ptr<vsg::Data> GPUConvert::map(vsg::ref_ptr<vsg::Device> device, vsg::ref_ptr<vsg::Buffer> buffer) const
+{
+    // Map the buffer memory and assign as an Array2D that will automatically unmap itself on destruction.
+    auto deviceMemory = buffer->getDeviceMemory(device->deviceID);
+    switch (mode)
+    {
+    case RGB:
+        return vsg::MappedData<vsg::ubvec3Array2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{VK_FORMAT_R8G8B8_UNORM}, extent.width, extent.height);
+    case YUV420:
+        return vsg::MappedData<vsg::ubyteArray2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{VK_FORMAT_R8_UNORM}, extent.width, static_cast<uint32_t>(bufferSize() / extent.width));
+    case LINEAR_DEPTH:
+        return vsg::MappedData<vsg::floatArray2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{VK_FORMAT_R32_SFLOAT}, extent.width, extent.height);
+    default:
+        return vsg::MappedData<vsg::ubyteArray2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{VK_FORMAT_R8_UNORM}, extent.width, extent.height);
+    }
+}
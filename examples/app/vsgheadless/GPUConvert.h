@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <array>
+
+// GPUConvert converts the rendered color or depth image into a compact format with a compute shader, writing straight into a host visible
+// buffer so that only the converted pixels are read back across the bus and the CPU doesn't have to convert them after readback:
+//   RGB            packed 24 bit RGB, 3/4 of the bytes of RGBA
+//   YUV420         I420 planes, BT.601 limited range, 3/8 of the bytes of RGBA
+//   LINEAR_DEPTH   distance from the eye as float rather than the non linear depth buffer value
+//   LINEAR_DEPTH8  distance between the near and far planes as unorm8, 1/4 of the bytes of float depth
+//
+// Requires shaders/headless_convert.comp, the source image must be created with VK_IMAGE_USAGE_SAMPLED_BIT.
+class GPUConvert : public vsg::Inherit<vsg::Object, GPUConvert>
+{
+public:
+    // matches MODE in shaders/headless_convert.comp
+    enum Mode
+    {
+        RGB = 0,
+        YUV420 = 1,
+        LINEAR_DEPTH = 2,
+        LINEAR_DEPTH8 = 3
+    };
+
+    GPUConvert(Mode in_mode, vsg::ref_ptr<vsg::ShaderStage> computeShader, const VkExtent2D& in_extent, vsg::ref_ptr<vsg::vec2Value> in_depthProjection = {});
+
+    const Mode mode;
+    const VkExtent2D extent;
+
+    // projection matrix [2][2] and [3][2] used by the depth modes, update before each frame is recorded
+    vsg::ref_ptr<vsg::vec2Value> depthProjection;
+
+    // parse "rgb", "yuv420", "linear" or "linear8", returning false for anything else
+    static bool modeFromString(const std::string& str, Mode& mode);
+
+    static void setDepthProjection(vsg::vec2Value& value, const vsg::dmat4& projectionMatrix);
+
+    bool depthMode() const { return mode == LINEAR_DEPTH || mode == LINEAR_DEPTH8; }
+
+    // size in bytes of the converted image, including padding the planes to a multiple of 4 bytes
+    VkDeviceSize bufferSize() const;
+
+    // offsets of the Y, U and V planes in the YUV420 buffer, the planes are tightly packed when width and height are even and
+    // the chroma plane size is a multiple of 4, as in 1920x1080
+    std::array<VkDeviceSize, 3> planeOffsets() const;
+
+    // create the commands that convert sourceImage, which must be in sourceLayout, into a new host visible buffer
+    std::pair<vsg::ref_ptr<vsg::Commands>, vsg::ref_ptr<vsg::Buffer>> createCapture(vsg::ref_ptr<vsg::Device> device, vsg::ref_ptr<vsg::Image> sourceImage, VkImageLayout sourceLayout);
+
+    // map a buffer returned by createCapture as an Array2D of the converted format, YUV420 is a ubyteArray2D of the planes one after another
+    vsg::ref_ptr<vsg::Data> map(vsg::ref_ptr<vsg::Device> device, vsg::ref_ptr<vsg::Buffer> buffer) const;
+
+protected:
+    uint32_t numUnits() const;
+
+    vsg::ref_ptr<vsg::DescriptorSetLayout> _descriptorSetLayout;
+    vsg::ref_ptr<vsg::PipelineLayout> _pipelineLayout;
+    vsg::ref_ptr<vsg::BindComputePipeline> _bindPipeline;
+    vsg::ref_ptr<vsg::Sampler> _sampler;
+};
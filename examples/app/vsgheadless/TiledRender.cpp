@@ -0,0 +1,158 @@
+#include "TiledRender.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+TileProjection::TileProjection(vsg::ref_ptr<vsg::ProjectionMatrix> in_projection, uint32_t in_fullWidth, uint32_t in_fullHeight) :
+    projection(in_projection),
+    fullWidth(in_fullWidth),
+    fullHeight(in_fullHeight)
+{
+    setTile(0, 0, fullWidth, fullHeight);
+}
+
+void TileProjection::setTile(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    // clip space range of the tile in the full view
+    double left = 2.0 * double(x) / double(fullWidth) - 1.0;
+    double right = 2.0 * double(x + width) / double(fullWidth) - 1.0;
+    double top = 2.0 * double(y) / double(fullHeight) - 1.0;
+    double bottom = 2.0 * double(y + height) / double(fullHeight) - 1.0;
+
+    // scale and translate that range to -1 to 1, the translation is multiplied by w so it applies after the perspective divide
+    double sx = 2.0 / (right - left);
+    double sy = 2.0 / (bottom - top);
+    tileMatrix = vsg::dmat4(sx, 0.0, 0.0, 0.0,
+                            0.0, sy, 0.0, 0.0,
+                            0.0, 0.0, 1.0, 0.0,
+                            -sx * (left + right) * 0.5, -sy * (top + bottom) * 0.5, 0.0, 1.0);
+}
+
+PosterImage::PosterImage(const vsg::Path& in_filename, uint32_t in_width, uint32_t in_height, vsg::ref_ptr<const vsg::Options> in_options) :
+    filename(in_filename),
+    width(in_width),
+    height(in_height),
+    options(in_options),
+    _size(size_t(in_width) * in_height * 4)
+{
+    if (vsg::lowerCaseFileExtension(filename) != ".raw")
+    {
+        _image = vsg::ubvec4Array2D::create(width, height, vsg::Data::Properties{VK_FORMAT_R8G8B8A8_UNORM});
+        _pixels = reinterpret_cast<uint8_t*>(_image->dataPointer());
+        return;
+    }
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(filename.string().c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) throw vsg::Exception{vsg::make_string("Error: PosterImage unable to create ", filename)};
+    _file = file;
+
+    ULARGE_INTEGER size;
+    size.QuadPart = _size;
+    _mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, size.HighPart, size.LowPart, nullptr);
+    if (_mapping) _pixels = static_cast<uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, _size));
+#else
+    _file = open(filename.string().c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_file < 0) throw vsg::Exception{vsg::make_string("Error: PosterImage unable to create ", filename)};
+
+    if (ftruncate(_file, static_cast<off_t>(_size)) == 0)
+    {
+        void* pixels = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _file, 0);
+        if (pixels != MAP_FAILED) _pixels = static_cast<uint8_t*>(pixels);
+    }
+#endif
+
+    if (!_pixels)
+    {
+        unmap();
+        throw vsg::Exception{vsg::make_string("Error: PosterImage unable to map ", _size, " bytes of ", filename)};
+    }
+}
+
+PosterImage::~PosterImage()
+{
+    unmap();
+}
+
+void PosterImage::unmap()
+{
+    if (_image) return;
+
+#if defined(_WIN32)
+    if (_pixels) UnmapViewOfFile(_pixels);
+    if (_mapping) CloseHandle(_mapping);
+    if (_file) CloseHandle(_file);
+    _mapping = nullptr;
+    _file = nullptr;
+#else
+    if (_pixels) munmap(_pixels, _size);
+    if (_file >= 0) close(_file);
+    _file = -1;
+#endif
+    _pixels = nullptr;
+}
+
+void PosterImage::stitch(const uint8_t* tile, size_t rowPitch, uint32_t tileWidth, uint32_t tileHeight, uint32_t x, uint32_t y, uint32_t supersample)
+{
+    if (!_pixels || x >= width || y >= height) return;
+
+    auto start = vsg::clock::now();
+
+    uint32_t columns = std::min(tileWidth / supersample, width - x);
+    uint32_t rows = std::min(tileHeight / supersample, height - y);
+
+    for (uint32_t r = 0; r < rows; ++r)
+    {
+        uint8_t* dst = _pixels + (size_t(y + r) * width + x) * 4;
+        if (supersample == 1)
+        {
+            std::memcpy(dst, tile + r * rowPitch, size_t(columns) * 4);
+            continue;
+        }
+
+        // box filter each block of supersample x supersample pixels
+        uint32_t numSamples = supersample * supersample;
+        for (uint32_t c = 0; c < columns; ++c)
+        {
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for (uint32_t sy = 0; sy < supersample; ++sy)
+            {
+                const uint8_t* src = tile + (size_t(r) * supersample + sy) * rowPitch + size_t(c) * supersample * 4;
+                for (uint32_t sx = 0; sx < supersample; ++sx, src += 4)
+                {
+                    sum[0] += src[0];
+                    sum[1] += src[1];
+                    sum[2] += src[2];
+                    sum[3] += src[3];
+                }
+            }
+            for (int i = 0; i < 4; ++i) dst[c * 4 + i] = static_cast<uint8_t>((sum[i] + numSamples / 2) / numSamples);
+        }
+    }
+
+    stitchTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+}
+
+bool PosterImage::finish()
+{
+    if (_image) return vsg::write(_image, filename, options);
+
+    if (!_pixels) return false;
+
+#if defined(_WIN32)
+    bool result = FlushViewOfFile(_pixels, 0) != 0;
+#else
+    bool result = msync(_pixels, _size, MS_SYNC) == 0;
+#endif
+    unmap();
+    return result;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// TileProjection renders one tile of a larger image by scaling and offsetting the clip space of the projection it wraps, so the tile's
+// sub-frustum of the full view fills the viewport. It works for any ProjectionMatrix, the wrapped projection should have the aspect
+// ratio of the full image.
+class TileProjection : public vsg::Inherit<vsg::ProjectionMatrix, TileProjection>
+{
+public:
+    TileProjection(vsg::ref_ptr<vsg::ProjectionMatrix> in_projection, uint32_t in_fullWidth, uint32_t in_fullHeight);
+
+    vsg::ref_ptr<vsg::ProjectionMatrix> projection;
+    uint32_t fullWidth;
+    uint32_t fullHeight;
+    vsg::dmat4 tileMatrix;
+
+    // select the tile covering pixels x to x+width and y to y+height of the full image
+    void setTile(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+    vsg::dmat4 transform() const override { return tileMatrix * projection->transform(); }
+};
+
+// PosterImage is the RGBA8 image the tiles are stitched into. A .raw filename is memory mapped so images larger than memory are
+// written straight to the file, e.g. view with
+//     magick -size 16384x16384 -depth 8 rgba:poster.raw poster.png
+// any other extension is assembled in memory and written with vsg::write() by finish().
+class PosterImage : public vsg::Inherit<vsg::Object, PosterImage>
+{
+public:
+    PosterImage(const vsg::Path& in_filename, uint32_t in_width, uint32_t in_height, vsg::ref_ptr<const vsg::Options> in_options = {});
+
+    const vsg::Path filename;
+    const uint32_t width;
+    const uint32_t height;
+    vsg::ref_ptr<const vsg::Options> options;
+
+    // copy a rendered RGBA8 tile into the image with its top left corner at x, y, averaging each block of supersample x supersample
+    // tile pixels into one image pixel, the parts of the tile beyond the edges of the image are ignored.
+    void stitch(const uint8_t* tile, size_t rowPitch, uint32_t tileWidth, uint32_t tileHeight, uint32_t x, uint32_t y, uint32_t supersample);
+
+    // flush the mapped file or write the in memory image
+    bool finish();
+
+    // stats
+    double stitchTime = 0.0; // milliseconds
+
+protected:
+    virtual ~PosterImage();
+
+    void unmap();
+
+    uint8_t* _pixels = nullptr;
+    size_t _size = 0;
+    vsg::ref_ptr<vsg::ubvec4Array2D> _image;
+
+#if defined(_WIN32)
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#else
+    int _file = -1;
+#endif
+};
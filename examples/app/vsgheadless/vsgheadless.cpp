@@ -19,11 +19,22 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #    include <vsgXchange/all.h>
 #endif
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <set>
 #include <thread>
 
-vsg::ref_ptr<vsg::ImageView> createColorImageView(vsg::ref_ptr<vsg::Device> device, const VkExtent2D& extent, VkFormat imageFormat, VkSampleCountFlagBits samples)
+#include "BatchJobs.h"
+#include "CaptureSink.h"
+#include "FrameStream.h"
+#include "GPUConvert.h"
+#include "TiledRender.h"
+
+vsg::ref_ptr<vsg::ImageView> createColorImageView(vsg::ref_ptr<vsg::Device> device, const VkExtent2D& extent, VkFormat imageFormat, VkSampleCountFlagBits samples, VkImageUsageFlags additionalUsage = 0)
 {
     auto colorImage = vsg::Image::create();
     colorImage->imageType = VK_IMAGE_TYPE_2D;
@@ -33,7 +44,7 @@ vsg::ref_ptr<vsg::ImageView> createColorImageView(vsg::ref_ptr<vsg::Device> devi
     colorImage->arrayLayers = 1;
     colorImage->samples = samples;
     colorImage->tiling = VK_IMAGE_TILING_OPTIMAL;
-    colorImage->usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    colorImage->usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | additionalUsage;
     colorImage->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     colorImage->flags = 0;
     colorImage->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -41,7 +52,7 @@ vsg::ref_ptr<vsg::ImageView> createColorImageView(vsg::ref_ptr<vsg::Device> devi
     return vsg::createImageView(device, colorImage, VK_IMAGE_ASPECT_COLOR_BIT);
 }
 
-vsg::ref_ptr<vsg::ImageView> createDepthImageView(vsg::ref_ptr<vsg::Device> device, const VkExtent2D& extent, VkFormat depthFormat, VkSampleCountFlagBits samples)
+vsg::ref_ptr<vsg::ImageView> createDepthImageView(vsg::ref_ptr<vsg::Device> device, const VkExtent2D& extent, VkFormat depthFormat, VkSampleCountFlagBits samples, VkImageUsageFlags additionalUsage = 0)
 {
     auto depthImage = vsg::Image::create();
     depthImage->imageType = VK_IMAGE_TYPE_2D;
@@ -51,7 +62,7 @@ vsg::ref_ptr<vsg::ImageView> createDepthImageView(vsg::ref_ptr<vsg::Device> devi
     depthImage->samples = samples;
     depthImage->format = depthFormat;
     depthImage->tiling = VK_IMAGE_TILING_OPTIMAL;
-    depthImage->usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    depthImage->usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | additionalUsage;
     depthImage->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     depthImage->flags = 0;
     depthImage->sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -333,8 +344,253 @@ std::pair<vsg::ref_ptr<vsg::Commands>, vsg::ref_ptr<vsg::Buffer>> createDepthCap
     return {commands, destinationBuffer};
 }
 
+// the RecordAndSubmitTask has a fence for each frame it can have in flight, each slot of the ring needs its own frame's fence.
+void assignRingFences(vsg::Viewer& viewer, vsg::ref_ptr<vsg::Device> device, uint32_t ringDepth)
+{
+    auto& recordAndSubmitTask = viewer.recordAndSubmitTasks.front();
+    if (!recordAndSubmitTask->fence(ringDepth - 1))
+    {
+        auto ringTask = vsg::RecordAndSubmitTask::create(device, ringDepth);
+        ringTask->commandGraphs = recordAndSubmitTask->commandGraphs;
+        ringTask->queue = recordAndSubmitTask->queue;
+        ringTask->databasePager = recordAndSubmitTask->databasePager;
+        recordAndSubmitTask = ringTask;
+    }
+}
+
+// render all the jobs in a job file with the one device, loading and compiling each model once and sharing state between models.
+// Up to jobsPerFrame jobs of the same model and extent are recorded into each frame, each into its own framebuffer, with ringDepth
+// frames in flight while the images of earlier frames are handed to the sink to be written on its writer threads.
+int renderBatch(const BatchJobs& batch, vsg::ref_ptr<vsg::Device> device, int queueFamily, vsg::ref_ptr<vsg::Options> options, uint32_t ringDepth, uint32_t jobsPerFrame,
+                vsg::ref_ptr<CaptureSink> sink, double setupTime)
+{
+    VkFormat imageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+    jobsPerFrame = std::max(1u, jobsPerFrame);
+
+    auto jobs = batch.jobs();
+
+    // share pipelines, textures and other state between the models
+    options->sharedObjects = vsg::SharedObjects::create();
+
+    std::set<std::string> outputDirectories;
+    for (auto& job : jobs)
+    {
+        auto directory = vsg::filePath(job.output);
+        if (directory && outputDirectories.insert(directory.string()).second) vsg::makeDirectory(directory);
+    }
+
+    // a render target for each job that can be in flight for each extent, they all share one render pass so models are compiled against compatible passes
+    struct Target
+    {
+        vsg::ref_ptr<vsg::RenderGraph> renderGraph;
+        vsg::ref_ptr<vsg::View> view;
+        vsg::ref_ptr<vsg::LookAt> lookAt;
+        vsg::ref_ptr<vsg::Perspective> perspective;
+        vsg::ref_ptr<vsg::Commands> colorBufferCapture;
+        vsg::ref_ptr<vsg::Image> copiedColorBuffer;
+        const BatchJob* job = nullptr;
+    };
+
+    auto renderPass = vsg::createRenderPass(device, imageFormat, depthFormat, true);
+    auto commandGraph = vsg::CommandGraph::create(device, queueFamily);
+
+    std::map<std::pair<uint32_t, uint32_t>, std::vector<Target>> targets;
+    for (auto& extent : batch.extents)
+    {
+        auto& extentTargets = targets[{extent.width, extent.height}];
+        if (!extentTargets.empty()) continue;
+
+        extentTargets.resize(ringDepth * jobsPerFrame);
+        for (auto& target : extentTargets)
+        {
+            auto colorImageView = createColorImageView(device, extent, imageFormat, VK_SAMPLE_COUNT_1_BIT);
+            auto depthImageView = createDepthImageView(device, extent, depthFormat, VK_SAMPLE_COUNT_1_BIT);
+
+            target.lookAt = vsg::LookAt::create();
+            target.perspective = vsg::Perspective::create(30.0, static_cast<double>(extent.width) / static_cast<double>(extent.height), 0.1, 10.0);
+            target.view = vsg::View::create(vsg::Camera::create(target.perspective, target.lookAt, vsg::ViewportState::create(extent)));
+
+            target.renderGraph = vsg::RenderGraph::create();
+            target.renderGraph->framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{colorImageView, depthImageView}, extent.width, extent.height, 1);
+            target.renderGraph->renderArea.offset = {0, 0};
+            target.renderGraph->renderArea.extent = extent;
+            target.renderGraph->setClearValues({{0.2f, 0.2f, 0.4f, 1.0f}});
+            target.renderGraph->addChild(target.view);
+
+            std::tie(target.colorBufferCapture, target.copiedColorBuffer) = createColorCapture(device, extent, colorImageView->image, imageFormat);
+
+            // all the render graphs are in the command graph when the viewer is compiled so that there is a compile context for every view
+            commandGraph->addChild(target.renderGraph);
+        }
+    }
+
+    auto viewer = vsg::Viewer::create();
+    viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
+    assignRingFences(*viewer, device, ringDepth);
+    viewer->compile();
+
+    struct Frame
+    {
+        std::vector<Target*> targets;
+        uint64_t frameCount = 0;
+        bool pending = false;
+    };
+    std::vector<Frame> frames(ringDepth);
+
+    uint64_t numJobsDone = 0;
+    uint64_t numJobsFailed = 0;
+    std::vector<uint8_t> consumedData;
+
+    auto consume = [&](Frame& frame) {
+        frame.pending = false;
+        for (auto target : frame.targets)
+        {
+            auto& copiedColorBuffer = target->copiedColorBuffer;
+
+            VkImageSubresource subResource{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+            VkSubresourceLayout subResourceLayout;
+            vkGetImageSubresourceLayout(*device, copiedColorBuffer->vk(device->deviceID), &subResource, &subResourceLayout);
+
+            auto& extent = target->job->extent;
+            auto imageData = vsg::MappedData<vsg::ubvec4Array2D>::create(copiedColorBuffer->getDeviceMemory(device->deviceID), subResourceLayout.offset, 0, vsg::Data::Properties{imageFormat}, extent.width, extent.height);
+
+            if (!sink)
+            {
+                consumedData.resize(imageData->dataSize());
+                std::memcpy(consumedData.data(), imageData->dataPointer(), imageData->dataSize());
+            }
+            else if (!sink->write(*imageData, target->job->output))
+            {
+                ++numJobsFailed;
+            }
+
+            ++numJobsDone;
+            target->job = nullptr;
+        }
+        frame.targets.clear();
+    };
+
+    uint64_t waitTimeout = 1999999999; // 1second in nanoseconds.
+    double loadAndCompileTime = 0.0;
+    size_t numModelsLoaded = 0;
+
+    vsg::Path modelFilename;
+    vsg::ref_ptr<vsg::Node> model;
+    vsg::dvec3 centre;
+    double radius = 1.0;
+
+    auto startOfJobs = vsg::clock::now();
+
+    // frames that only skip jobs aren't submitted, so the ring is indexed by the submissions rather than the frame count
+    uint64_t numSubmitted = 0;
+    size_t next = 0;
+    while (next < jobs.size() && viewer->advanceToNextFrame())
+    {
+        if (jobs[next].model != modelFilename)
+        {
+            // load and compile the next model, the frames in flight keep the previous one referenced until they have been consumed
+            auto startOfLoad = vsg::clock::now();
+
+            modelFilename = jobs[next].model;
+            model = vsg::read_cast<vsg::Node>(modelFilename, options);
+            if (!model)
+            {
+                std::cout << "Warning: unable to load " << modelFilename << ", skipping its jobs." << std::endl;
+                for (; next < jobs.size() && jobs[next].model == modelFilename; ++next) ++numJobsFailed;
+                continue;
+            }
+
+            vsg::ComputeBounds computeBounds;
+            model->accept(computeBounds);
+            centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
+            radius = vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.6;
+
+            viewer->compileManager->compile(model);
+
+            loadAndCompileTime += std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startOfLoad).count();
+            ++numModelsLoaded;
+        }
+
+        viewer->update();
+
+        // fill this frame with consecutive jobs of the same model and extent
+        auto frameIndex = numSubmitted % ringDepth;
+        auto& frame = frames[frameIndex];
+        const VkExtent2D extent = jobs[next].extent;
+        auto frameTargets = targets[{extent.width, extent.height}].begin() + frameIndex * jobsPerFrame;
+
+        commandGraph->children.clear();
+        for (uint32_t i = 0; i < jobsPerFrame && next < jobs.size(); ++i, ++next)
+        {
+            auto& job = jobs[next];
+            if (job.model != modelFilename || job.extent.width != extent.width || job.extent.height != extent.height) break;
+
+            auto& target = frameTargets[i];
+            target.job = &job;
+            target.view->children = {model};
+            target.lookAt->eye = centre + job.direction * (radius * 1.5);
+            target.lookAt->center = centre;
+            target.lookAt->up = (std::abs(job.direction.z) > 0.99) ? vsg::dvec3(0.0, 1.0, 0.0) : vsg::dvec3(0.0, 0.0, 1.0);
+            target.perspective->nearDistance = radius * 0.001;
+            target.perspective->farDistance = radius * 4.5;
+
+            commandGraph->addChild(target.renderGraph);
+            commandGraph->addChild(target.colorBufferCapture);
+            frame.targets.push_back(&target);
+        }
+
+        viewer->recordAndSubmit();
+
+        frame.frameCount = numSubmitted++;
+        frame.pending = true;
+
+        // consume the oldest frame in flight, waiting on its fence
+        auto& oldestFrame = frames[numSubmitted % ringDepth];
+        if (oldestFrame.pending && oldestFrame.frameCount + ringDepth == numSubmitted)
+        {
+            viewer->waitForFences(ringDepth - 1, waitTimeout);
+            consume(oldestFrame);
+        }
+    }
+
+    // consume the frames still in flight, oldest first
+    viewer->deviceWaitIdle();
+    std::sort(frames.begin(), frames.end(), [](const Frame& lhs, const Frame& rhs) { return lhs.frameCount < rhs.frameCount; });
+    for (auto& frame : frames)
+    {
+        if (frame.pending) consume(frame);
+    }
+    if (sink)
+    {
+        // frames that were queued but then failed to encode or write on the sink's writer threads
+        sink->flush();
+        numJobsFailed += sink->numFramesFailed;
+    }
+
+    auto duration = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startOfJobs).count();
+
+    std::cout << "Batch of " << jobs.size() << " jobs, " << batch.models.size() << " models x " << batch.views.size() << " views x " << batch.extents.size() << " extents, rendered in "
+              << duration << "s, " << double(numJobsDone) / duration << " jobs/sec, " << jobsPerFrame << " jobs per frame with ring depth " << ringDepth
+              << (numJobsFailed > 0 ? vsg::make_string(", failed ", numJobsFailed) : std::string()) << std::endl;
+
+    // one process per job pays for creating the instance and device and for loading and compiling its model every time
+    if (numModelsLoaded > 0 && numJobsDone > 0)
+    {
+        double perModel = loadAndCompileTime / double(numModelsLoaded);
+        double perJob = (duration - loadAndCompileTime) / double(numJobsDone);
+        double estimate = double(numJobsDone) * (setupTime + perModel + perJob);
+        std::cout << "Setup " << setupTime << "s, load and compile " << perModel << "s/model, render and write " << perJob * 1000.0 << "ms/job, one process per job would take at least "
+                  << estimate << "s, " << double(numJobsDone) / estimate << " jobs/sec" << std::endl;
+    }
+
+    return numJobsFailed > 0 ? 1 : 0;
+}
+
 int main(int argc, char** argv)
 {
+    auto startTime = vsg::clock::now();
+
     // set up defaults and read command line arguments to override them
     VkExtent2D extent{2048, 1024};
     VkFormat imageFormat = VK_FORMAT_R8G8B8A8_UNORM;
@@ -351,11 +607,58 @@ int main(int argc, char** argv)
     auto depthFilename = arguments.value<vsg::Path>("depth.vsgb", {"--depth-file", "--df"});
     auto resizeCadence = arguments.value(0, "--resize");
     auto useExecuteCommands = arguments.read("--use-ec");
+    auto ringDepth = arguments.value<uint32_t>(0, "--ring");
+    auto noWrite = arguments.read("--no-write");
+    auto writeSequence = arguments.read("--sequence");
+    auto writerThreads = arguments.value<uint32_t>(2, "--writer-threads");
+    auto writerBuffers = arguments.value<uint32_t>(8, "--writer-buffers");
+    auto streamFilename = arguments.value<vsg::Path>("", "--stream");
+    auto streamFormat = FrameStream::formatFromString(arguments.value<std::string>("rgba", "--stream-format"));
+    auto streamFPS = arguments.value(0.0, "--stream-fps");
+    auto gpuColor = arguments.value<std::string>("", "--gpu-color");
+    auto gpuDepth = arguments.value<std::string>("", "--gpu-depth");
+    VkExtent2D posterExtent{0, 0};
+    arguments.read("--poster", posterExtent.width, posterExtent.height);
+    auto tileSize = arguments.value<uint32_t>(2048, "--tile");
+    auto supersample = std::max(1u, arguments.value<uint32_t>(1, "--supersample"));
+    auto posterFilename = arguments.value<vsg::Path>("poster.raw", "--poster-file");
+    auto tileMemory = arguments.value<uint32_t>(512, "--tile-memory");
+    auto batchFilename = arguments.value<vsg::Path>("", "--batch");
+    auto batchJobsPerFrame = arguments.value<uint32_t>(4, "--batch-frame");
     if (arguments.read("--st")) extent = VkExtent2D{192, 108};
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
-    if (argc <= 1)
+    // with --gpu-color and --gpu-depth the color and depth images are converted with a compute shader before they are read back
+    GPUConvert::Mode colorConvertMode = GPUConvert::RGB;
+    GPUConvert::Mode depthConvertMode = GPUConvert::LINEAR_DEPTH;
+    if (!gpuColor.empty() && (!GPUConvert::modeFromString(gpuColor, colorConvertMode) || (colorConvertMode != GPUConvert::RGB && colorConvertMode != GPUConvert::YUV420)))
+    {
+        std::cerr << "Error: --gpu-color must be rgb or yuv420." << std::endl;
+        return 1;
+    }
+    if (!gpuDepth.empty() && (!GPUConvert::modeFromString(gpuDepth, depthConvertMode) || (depthConvertMode != GPUConvert::LINEAR_DEPTH && depthConvertMode != GPUConvert::LINEAR_DEPTH8)))
+    {
+        std::cerr << "Error: --gpu-depth must be linear or linear8." << std::endl;
+        return 1;
+    }
+    // with --poster render an image larger than the device supports as a grid of tiles that are stitched together, the framebuffer is one tile
+    bool tiled = posterExtent.width > 0 && posterExtent.height > 0;
+    if (tiled && (streamFilename || !gpuColor.empty()))
+    {
+        std::cerr << "Error: --poster can't be combined with --stream or --gpu-color." << std::endl;
+        return 1;
+    }
+    if (streamFilename && !gpuColor.empty() && (colorConvertMode != GPUConvert::YUV420 || streamFormat != FrameStream::YUV420))
+    {
+        std::cerr << "Error: --stream only supports --gpu-color yuv420 with --stream-format yuv420." << std::endl;
+        return 1;
+    }
+
+    // when streaming frames to stdout send all the console output to stderr so it doesn't get mixed into the stream
+    if (streamFilename.string() == "-") std::cout.rdbuf(std::cerr.rdbuf());
+
+    if (argc <= 1 && !batchFilename)
     {
         std::cout << "Please specify model to load on command line" << std::endl;
         return 1;
@@ -376,8 +679,21 @@ int main(int argc, char** argv)
     options->add(vsgXchange::all::create());
 #endif
 
-    auto vsg_scene = vsg::read_cast<vsg::Node>(argv[1], options);
-    if (!vsg_scene)
+    vsg::ref_ptr<vsg::ShaderStage> convertShader;
+    if (!gpuColor.empty() || !gpuDepth.empty())
+    {
+        convertShader = vsg::read_cast<vsg::ShaderStage>("shaders/headless_convert.comp", options);
+        if (!convertShader)
+        {
+            std::cout << "Could not create shaders." << std::endl;
+            return 1;
+        }
+    }
+
+    // in batch mode the models are listed in the job file
+    vsg::ref_ptr<vsg::Node> vsg_scene;
+    if (!batchFilename) vsg_scene = vsg::read_cast<vsg::Node>(argv[1], options);
+    if (!vsg_scene && !batchFilename)
     {
         std::cout << "No command graph created." << std::endl;
         return 1;
@@ -412,6 +728,44 @@ int main(int argc, char** argv)
 
     auto device = vsg::Device::create(physicalDevice, queueSettings, validatedNames, deviceExtensions, deviceFeatures);
 
+    // with --batch render all the jobs in the job file with this one device rather than loading a model from the command line
+    if (batchFilename)
+    {
+        auto batch = BatchJobs::create();
+        if (!batch->read(batchFilename)) return 1;
+
+        vsg::ref_ptr<CaptureSink> batchSink;
+        if (!noWrite) batchSink = CaptureSink::create(vsg::Path(batch->outputPattern), writerThreads, writerBuffers, options);
+
+        auto setupTime = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startTime).count();
+        return renderBatch(*batch, device, queueFamily, options, std::max(1u, ringDepth == 0 ? 2u : ringDepth), batchJobsPerFrame, batchSink, setupTime);
+    }
+
+    VkExtent2D renderExtent = extent;
+    uint32_t tilesX = 1, tilesY = 1;
+    if (tiled)
+    {
+        // the tiles are rendered at supersample times the poster resolution, so the tile size must be a multiple of it as well as within the device limits
+        const auto& limits = physicalDevice->getProperties().limits;
+        tileSize = std::min({tileSize, limits.maxFramebufferWidth, limits.maxFramebufferHeight, limits.maxImageDimension2D});
+        tileSize = std::max(supersample, tileSize - tileSize % supersample);
+
+        renderExtent = VkExtent2D{posterExtent.width * supersample, posterExtent.height * supersample};
+        extent = VkExtent2D{std::min(tileSize, renderExtent.width), std::min(tileSize, renderExtent.height)};
+        tilesX = (renderExtent.width + extent.width - 1) / extent.width;
+        tilesY = (renderExtent.height + extent.height - 1) / extent.height;
+        numFrames = static_cast<int>(tilesX * tilesY);
+        resizeCadence = 0;
+
+        // keep as many tiles in flight as the readback memory budget allows, each needs its own linear copy of the tile
+        if (ringDepth == 0)
+        {
+            uint64_t tileBytes = uint64_t(extent.width) * extent.height * 4;
+            ringDepth = static_cast<uint32_t>(std::clamp<uint64_t>((uint64_t(tileMemory) * 1024 * 1024) / tileBytes, 1, 4));
+        }
+    }
+    ringDepth = std::max(1u, ringDepth);
+
     // compute the bounds of the scene graph to help position camera
     vsg::ComputeBounds computeBounds;
     vsg_scene->accept(computeBounds);
@@ -422,21 +776,30 @@ int main(int argc, char** argv)
     // set up the camera
     auto lookAt = vsg::LookAt::create(centre + vsg::dvec3(0.0, -radius * 1.5, 0.0), centre, vsg::dvec3(0.0, 0.0, 1.0));
 
+    double aspectRatio = static_cast<double>(renderExtent.width) / static_cast<double>(renderExtent.height);
     vsg::ref_ptr<vsg::ProjectionMatrix> perspective;
     if (vsg::ref_ptr<vsg::EllipsoidModel> ellipsoidModel(vsg_scene->getObject<vsg::EllipsoidModel>("EllipsoidModel")); ellipsoidModel)
     {
-        perspective = vsg::EllipsoidPerspective::create(lookAt, ellipsoidModel, 30.0, static_cast<double>(extent.width) / static_cast<double>(extent.height), nearFarRatio, 0.0);
+        perspective = vsg::EllipsoidPerspective::create(lookAt, ellipsoidModel, 30.0, aspectRatio, nearFarRatio, 0.0);
     }
     else
     {
-        perspective = vsg::Perspective::create(30.0, static_cast<double>(extent.width) / static_cast<double>(extent.height), nearFarRatio * radius, radius * 4.5);
+        perspective = vsg::Perspective::create(30.0, aspectRatio, nearFarRatio * radius, radius * 4.5);
     }
 
-    auto camera = vsg::Camera::create(perspective, lookAt, vsg::ViewportState::create(extent));
+    // each tile renders its own sub-frustum of the full view
+    vsg::ref_ptr<TileProjection> tileProjection;
+    if (tiled) tileProjection = TileProjection::create(perspective, renderExtent.width, renderExtent.height);
+
+    auto camera = vsg::Camera::create(tileProjection ? vsg::ref_ptr<vsg::ProjectionMatrix>(tileProjection) : perspective, lookAt, vsg::ViewportState::create(extent));
 
     // set up the Rendergraph to manage the rendering
-    auto colorImageView = createColorImageView(device, extent, imageFormat, VK_SAMPLE_COUNT_1_BIT);
-    auto depthImageView = createDepthImageView(device, extent, depthFormat, VK_SAMPLE_COUNT_1_BIT);
+    // the compute conversion samples the single sampled color and depth images
+    VkImageUsageFlags colorUsage = gpuColor.empty() ? 0 : VK_IMAGE_USAGE_SAMPLED_BIT;
+    VkImageUsageFlags depthUsage = gpuDepth.empty() ? 0 : VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    auto colorImageView = createColorImageView(device, extent, imageFormat, VK_SAMPLE_COUNT_1_BIT, colorUsage);
+    auto depthImageView = createDepthImageView(device, extent, depthFormat, VK_SAMPLE_COUNT_1_BIT, depthUsage);
     vsg::ref_ptr<vsg::Framebuffer> framebuffer;
     if (samples == VK_SAMPLE_COUNT_1_BIT)
     {
@@ -452,9 +815,48 @@ int main(int argc, char** argv)
         framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{msaa_colorImageView, colorImageView, msaa_depthImageView, depthImageView} , extent.width, extent.height, 1);
     }
 
-    // create support for copying the color buffer
-    auto [colorBufferCapture, copiedColorBuffer] = createColorCapture(device, extent, colorImageView->image, imageFormat);
-    auto [depthBufferCapture, copiedDepthBuffer] = createDepthCapture(device, extent, depthImageView->image, depthFormat);
+    // create a ring of captures of the color and depth buffers, so that the readback of one frame can be consumed while the following frames are rendered
+    struct CaptureSlot
+    {
+        vsg::ref_ptr<vsg::Commands> colorBufferCapture;
+        vsg::ref_ptr<vsg::Image> copiedColorBuffer;
+        vsg::ref_ptr<vsg::Commands> depthBufferCapture;
+        vsg::ref_ptr<vsg::Buffer> copiedDepthBuffer;
+        vsg::ref_ptr<vsg::Buffer> convertedColorBuffer;
+        vsg::ref_ptr<vsg::Buffer> convertedDepthBuffer;
+        uint64_t frameCount = 0;
+        uint32_t tile = 0;
+        bool pending = false;
+    };
+
+    // the projection used to linearize depth is updated each frame as the EllipsoidPerspective adjusts its near and far planes
+    auto depthProjection = vsg::vec2Value::create();
+    vsg::ref_ptr<GPUConvert> colorConvert, depthConvert;
+
+    std::vector<CaptureSlot> captureSlots(ringDepth);
+    auto createCaptureSlots = [&]() {
+        if (!gpuColor.empty()) colorConvert = GPUConvert::create(colorConvertMode, convertShader, extent);
+        if (!gpuDepth.empty()) depthConvert = GPUConvert::create(depthConvertMode, convertShader, extent, depthProjection);
+
+        for (auto& slot : captureSlots)
+        {
+            if (colorConvert)
+                std::tie(slot.colorBufferCapture, slot.convertedColorBuffer) = colorConvert->createCapture(device, colorImageView->image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+            else
+                std::tie(slot.colorBufferCapture, slot.copiedColorBuffer) = createColorCapture(device, extent, colorImageView->image, imageFormat);
+
+            if (!streamFilename && !tiled)
+            {
+                if (depthConvert)
+                    std::tie(slot.depthBufferCapture, slot.convertedDepthBuffer) = depthConvert->createCapture(device, depthImageView->image, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+                else
+                    std::tie(slot.depthBufferCapture, slot.copiedDepthBuffer) = createDepthCapture(device, extent, depthImageView->image, depthFormat);
+            }
+
+            slot.pending = false;
+        }
+    };
+    createCaptureSlots();
 
     auto renderGraph = vsg::RenderGraph::create();
 
@@ -482,11 +884,10 @@ int main(int argc, char** argv)
     else
         renderGraph->addChild(view);
 
+    // the capture commands of the current slot are assigned to the commandGraph each frame
     auto commandGraph = vsg::CommandGraph::create(device, queueFamily);
     commandGraph->addChild(renderGraph);
     commandGraphs.push_back(commandGraph);
-    if (colorBufferCapture) commandGraph->addChild(colorBufferCapture);
-    if (depthBufferCapture) commandGraph->addChild(depthBufferCapture);
 
     // create the viewer
     auto viewer = vsg::Viewer::create();
@@ -504,17 +905,198 @@ int main(int argc, char** argv)
 
     viewer->assignRecordAndSubmitTaskAndPresentation(commandGraphs);
 
+    assignRingFences(*viewer, device, ringDepth);
+
     viewer->compile();
 
+    // the capture commands aren't in the command graph when it's compiled, so compile the compute pipelines and descriptors of the conversions separately
+    auto compileCaptureSlots = [&]() {
+        if (!colorConvert && !depthConvert) return;
+        for (auto& slot : captureSlots)
+        {
+            viewer->compileManager->compile(slot.colorBufferCapture);
+            if (slot.depthBufferCapture) viewer->compileManager->compile(slot.depthBufferCapture);
+        }
+    };
+    compileCaptureSlots();
+
     uint64_t waitTimeout = 1999999999; // 1second in nanoseconds.
 
+    std::vector<uint8_t> consumedData;
+
+    // with --sequence write numbered frames on writer threads rather than overwriting the same files on the render thread
+    vsg::ref_ptr<CaptureSink> colorSink, depthSink;
+    if (writeSequence && !noWrite)
+    {
+        colorSink = CaptureSink::create(colorFilename, writerThreads, writerBuffers, options);
+        depthSink = CaptureSink::create(depthFilename, writerThreads, writerBuffers, options);
+    }
+
+    // with --stream write the color buffer of each frame as raw video rather than writing image files, the depth buffer isn't captured
+    vsg::ref_ptr<FrameStream> frameStream;
+    if (streamFilename) frameStream = FrameStream::create(streamFilename, streamFormat, streamFPS);
+
+    // with --poster the tiles are stitched into a memory mapped .raw file, or an in memory image for other formats
+    vsg::ref_ptr<PosterImage> posterImage;
+    if (tiled)
+    {
+        try
+        {
+            posterImage = PosterImage::create(posterFilename, posterExtent.width, posterExtent.height, options);
+        }
+        catch (const vsg::Exception& exception)
+        {
+            std::cout << exception.message << std::endl;
+            return 1;
+        }
+    }
+
+    // bytes read back from the device and CPU time spent consuming them, to compare the --gpu-color/--gpu-depth conversions against the plain copies
+    uint64_t numFramesConsumed = 0;
+    uint64_t readbackBytes = 0;
+    double consumeTime = 0.0;
+
+    // with --no-write just copy the data out of the mapped memory, otherwise queue it to be written or write it straight away
+    auto deliver = [&](vsg::ref_ptr<vsg::Data> imageData, vsg::ref_ptr<CaptureSink> sink, const vsg::Path& filename, uint64_t frameCount) {
+        if (noWrite)
+        {
+            consumedData.resize(imageData->dataSize());
+            std::memcpy(consumedData.data(), imageData->dataPointer(), imageData->dataSize());
+        }
+        else if (sink)
+        {
+            sink->write(*imageData, frameCount);
+        }
+        else
+        {
+            vsg::write(imageData, filename);
+        }
+    };
+
+    // map the copied color and depth buffers of a completed frame and write them out
+    auto consume = [&](CaptureSlot& slot) {
+        slot.pending = false;
+
+        auto startOfConsume = vsg::clock::now();
+        ++numFramesConsumed;
+
+        if (auto& copiedColorBuffer = slot.copiedColorBuffer)
+        {
+            VkImageSubresource subResource{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+            VkSubresourceLayout subResourceLayout;
+            vkGetImageSubresourceLayout(*device, copiedColorBuffer->vk(device->deviceID), &subResource, &subResourceLayout);
+
+            auto deviceMemory = copiedColorBuffer->getDeviceMemory(device->deviceID);
+            readbackBytes += subResourceLayout.size;
+
+            if (posterImage)
+            {
+                // stitch the tile directly from the mapped memory, downsampling when supersampling
+                void* mappedData = nullptr;
+                if (deviceMemory->map(subResourceLayout.offset, subResourceLayout.size, 0, &mappedData) == VK_SUCCESS)
+                {
+                    uint32_t x = (slot.tile % tilesX) * extent.width;
+                    uint32_t y = (slot.tile / tilesX) * extent.height;
+                    posterImage->stitch(static_cast<const uint8_t*>(mappedData), subResourceLayout.rowPitch, extent.width, extent.height, x / supersample, y / supersample, supersample);
+                    deviceMemory->unmap();
+                }
+            }
+            else if (frameStream)
+            {
+                // write directly from the mapped memory, respecting the row pitch of the linear image
+                void* mappedData = nullptr;
+                if (deviceMemory->map(subResourceLayout.offset, subResourceLayout.size, 0, &mappedData) == VK_SUCCESS)
+                {
+                    if (!frameStream->write(static_cast<const uint8_t*>(mappedData), extent.width, extent.height, subResourceLayout.rowPitch))
+                    {
+                        std::cout << "Error: failed to write frame to stream " << streamFilename << std::endl;
+                    }
+                    deviceMemory->unmap();
+                }
+            }
+            else
+            {
+                // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
+                auto imageData = vsg::MappedData<vsg::ubvec4Array2D>::create(deviceMemory, subResourceLayout.offset, 0, vsg::Data::Properties{imageFormat}, extent.width, extent.height); // deviceMemory, offset, flags and dimensions
+                deliver(imageData, colorSink, colorFilename, slot.frameCount);
+            }
+        }
+
+        if (auto& convertedColorBuffer = slot.convertedColorBuffer)
+        {
+            auto imageData = colorConvert->map(device, convertedColorBuffer);
+            readbackBytes += colorConvert->bufferSize();
+
+            if (frameStream)
+            {
+                // the planes are already converted so are written straight from the mapped memory
+                auto planes = colorConvert->planeOffsets();
+                auto data = static_cast<const uint8_t*>(imageData->dataPointer());
+                if (!frameStream->writeYUV420(data + planes[0], data + planes[1], data + planes[2], extent.width, extent.height))
+                {
+                    std::cout << "Error: failed to write frame to stream " << streamFilename << std::endl;
+                }
+            }
+            else
+            {
+                deliver(imageData, colorSink, colorFilename, slot.frameCount);
+            }
+        }
+
+        if (auto& copiedDepthBuffer = slot.copiedDepthBuffer)
+        {
+            // 3. map buffer and copy data.
+            auto deviceMemory = copiedDepthBuffer->getDeviceMemory(device->deviceID);
+            readbackBytes += copiedDepthBuffer->size;
+
+            // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
+            vsg::ref_ptr<vsg::Data> imageData;
+            if (depthFormat == VK_FORMAT_D32_SFLOAT || depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT)
+            {
+                imageData = vsg::MappedData<vsg::floatArray2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{depthFormat}, extent.width, extent.height); // deviceMemory, offset, flags and dimensions
+            }
+            else
+            {
+                imageData = vsg::MappedData<vsg::uintArray2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{depthFormat}, extent.width, extent.height); // deviceMemory, offset, flags and dimensions
+            }
+
+            deliver(imageData, depthSink, depthFilename, slot.frameCount);
+        }
+
+        if (auto& convertedDepthBuffer = slot.convertedDepthBuffer)
+        {
+            readbackBytes += depthConvert->bufferSize();
+            deliver(depthConvert->map(device, convertedDepthBuffer), depthSink, depthFilename, slot.frameCount);
+        }
+
+        consumeTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startOfConsume).count();
+    };
+
+    // wait for and consume any frames still in flight, oldest first
+    auto consumePending = [&]() {
+        viewer->deviceWaitIdle();
+
+        std::vector<CaptureSlot*> pendingSlots;
+        for (auto& slot : captureSlots)
+        {
+            if (slot.pending) pendingSlots.push_back(&slot);
+        }
+        std::sort(pendingSlots.begin(), pendingSlots.end(), [](const CaptureSlot* lhs, const CaptureSlot* rhs) { return lhs->frameCount < rhs->frameCount; });
+
+        for (auto slot : pendingSlots) consume(*slot);
+    };
+
+    auto startOfFrames = vsg::clock::now();
+    uint64_t numFramesRendered = 0;
+
     // rendering main loop
     while (viewer->advanceToNextFrame() && (numFrames--) > 0)
     {
         std::cout << "Frame " << viewer->getFrameStamp()->frameCount << std::endl;
         if (resizeCadence && (viewer->getFrameStamp()->frameCount>0) && ((viewer->getFrameStamp()->frameCount) % resizeCadence == 0))
         {
-            viewer->deviceWaitIdle();
+            // consume the frames in flight before their capture buffers are replaced
+            consumePending();
 
             extent.width /= 2;
             extent.height /= 2;
@@ -524,11 +1106,8 @@ int main(int argc, char** argv)
 
             std::cout << "Resized to " << extent.width << ", " << extent.height << std::endl;
 
-            auto previous_colorBufferCapture = colorBufferCapture;
-            auto previous_depthBufferCapture = depthBufferCapture;
-
-            colorImageView = createColorImageView(device, extent, imageFormat, VK_SAMPLE_COUNT_1_BIT);
-            depthImageView = createDepthImageView(device, extent, depthFormat, VK_SAMPLE_COUNT_1_BIT);
+            colorImageView = createColorImageView(device, extent, imageFormat, VK_SAMPLE_COUNT_1_BIT, colorUsage);
+            depthImageView = createDepthImageView(device, extent, depthFormat, VK_SAMPLE_COUNT_1_BIT, depthUsage);
             if (samples == VK_SAMPLE_COUNT_1_BIT)
             {
                 auto renderPass = vsg::createRenderPass(device, imageFormat, depthFormat, true);
@@ -546,18 +1125,8 @@ int main(int argc, char** argv)
             renderGraph->framebuffer = framebuffer;
 
             // create new copy subgraphs
-            std::tie(colorBufferCapture, copiedColorBuffer) = createColorCapture(device, extent, colorImageView->image, imageFormat);
-            std::tie(depthBufferCapture, copiedDepthBuffer) = createDepthCapture(device, extent, depthImageView->image, depthFormat);
-
-            auto replace_child = [](vsg::Group* group, vsg::ref_ptr<vsg::Node> previous, vsg::ref_ptr<vsg::Node> replacement) {
-                for (auto& child : group->children)
-                {
-                    if (child == previous) child = replacement;
-                }
-            };
-
-            replace_child(commandGraph, previous_colorBufferCapture, colorBufferCapture);
-            replace_child(commandGraph, previous_depthBufferCapture, depthBufferCapture);
+            createCaptureSlots();
+            compileCaptureSlots();
         }
 
         // pass any events into EventHandlers assigned to the Viewer, this includes Frame events generated by the viewer each frame
@@ -565,48 +1134,71 @@ int main(int argc, char** argv)
 
         viewer->update();
 
-        viewer->recordAndSubmit();
+        // assign this frame's capture slot, the slot was consumed after it was last submitted so its buffers are free to reuse
+        auto frameCount = viewer->getFrameStamp()->frameCount;
+        auto& slot = captureSlots[frameCount % ringDepth];
+        commandGraph->children = {renderGraph, slot.colorBufferCapture};
+        if (slot.depthBufferCapture) commandGraph->children.push_back(slot.depthBufferCapture);
 
-        if (copiedColorBuffer || copiedDepthBuffer)
+        if (depthConvert) GPUConvert::setDepthProjection(*depthProjection, perspective->transform());
+
+        if (tileProjection)
         {
-            // wait for completion.
-            viewer->waitForFences(0, waitTimeout);
+            slot.tile = static_cast<uint32_t>(numFramesRendered);
+            tileProjection->setTile((slot.tile % tilesX) * extent.width, (slot.tile / tilesX) * extent.height, extent.width, extent.height);
+        }
 
-            if (copiedColorBuffer)
-            {
-                VkImageSubresource subResource{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
-                VkSubresourceLayout subResourceLayout;
-                vkGetImageSubresourceLayout(*device, copiedColorBuffer->vk(device->deviceID), &subResource, &subResourceLayout);
+        viewer->recordAndSubmit();
 
-                auto deviceMemory = copiedColorBuffer->getDeviceMemory(device->deviceID);
+        slot.frameCount = frameCount;
+        slot.pending = true;
+        ++numFramesRendered;
 
-                // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
-                auto imageData = vsg::MappedData<vsg::ubvec4Array2D>::create(deviceMemory, subResourceLayout.offset, 0, vsg::Data::Properties{imageFormat}, extent.width, extent.height); // deviceMemory, offset, flags and dimensions
+        // consume the oldest frame in flight, waiting on its fence, the frames after it continue rendering in the meantime.
+        auto& oldestSlot = captureSlots[(frameCount + 1) % ringDepth];
+        if (oldestSlot.pending && oldestSlot.frameCount + ringDepth - 1 == frameCount)
+        {
+            viewer->waitForFences(ringDepth - 1, waitTimeout);
+            consume(oldestSlot);
+        }
+    }
 
-                vsg::write(imageData, colorFilename);
-            }
+    consumePending();
 
-            if (copiedDepthBuffer)
-            {
-                // 3. map buffer and copy data.
-                auto deviceMemory = copiedDepthBuffer->getDeviceMemory(device->deviceID);
+    for (auto& sink : {colorSink, depthSink})
+    {
+        if (!sink) continue;
+        sink->flush();
+        std::cout << "Written " << sink->numFramesWritten << " frames, " << double(sink->bytesWritten) / (1024.0 * 1024.0) << "MB, to " << sink->frameFilename(0)
+                  << (sink->numFramesFailed > 0 ? vsg::make_string(", failed ", sink->numFramesFailed) : std::string()) << ", render thread blocked for " << sink->blockedTime << "ms" << std::endl;
+    }
 
-                // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
-                if (depthFormat == VK_FORMAT_D32_SFLOAT || depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT)
-                {
-                    auto imageData = vsg::MappedData<vsg::floatArray2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{depthFormat}, extent.width, extent.height); // deviceMemory, offset, flags and dimensions
+    if (posterImage && !posterImage->finish()) std::cout << "Error: failed to write " << posterFilename << std::endl;
 
-                    vsg::write(imageData, depthFilename);
-                }
-                else
-                {
-                    auto imageData = vsg::MappedData<vsg::uintArray2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{depthFormat}, extent.width, extent.height); // deviceMemory, offset, flags and dimensions
+    auto duration = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startOfFrames).count();
 
-                    vsg::write(imageData, depthFilename);
-                }
-            }
-        }
+    if (posterImage)
+    {
+        std::cout << "Poster " << posterExtent.width << "x" << posterExtent.height << (supersample > 1 ? vsg::make_string(" supersampled x", supersample) : std::string())
+                  << " rendered as " << tilesX * tilesY << " tiles of " << extent.width << "x" << extent.height << " in " << duration << "s, "
+                  << duration * 1000.0 / double(tilesX * tilesY) << "ms/tile, stitching " << posterImage->stitchTime << "ms, written to " << posterFilename << std::endl;
+    }
+
+    if (frameStream)
+    {
+        double megabytes = double(frameStream->numBytes) / (1024.0 * 1024.0);
+        std::cout << "Streamed " << frameStream->numFrames << " frames, " << megabytes << "MB, sustained " << megabytes / duration << " MB/s, " << double(frameStream->numFrames) / duration
+                  << " frames/sec, conversion and write time " << frameStream->writeTime * 1000.0 << "ms" << std::endl;
+    }
+    if (numFramesConsumed > 0)
+    {
+        std::cout << "Read back " << double(readbackBytes) / (1024.0 * 1024.0 * double(numFramesConsumed)) << "MB/frame"
+                  << (gpuColor.empty() ? std::string() : vsg::make_string(", color converted on GPU to ", gpuColor))
+                  << (gpuDepth.empty() ? std::string() : vsg::make_string(", depth converted on GPU to ", gpuDepth))
+                  << ", consume CPU time " << consumeTime / double(numFramesConsumed) << "ms/frame" << std::endl;
     }
+    std::cout << "Rendered " << numFramesRendered << " frames at " << extent.width << "x" << extent.height << " with ring depth " << ringDepth << " in " << duration << "s, "
+              << double(numFramesRendered) / duration << " frames/sec" << std::endl;
 
     // clean up done automatically thanks to ref_ptr<>
     return 0;
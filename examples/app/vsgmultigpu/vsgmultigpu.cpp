@@ -8,6 +8,8 @@
 #include <iostream>
 #include <thread>
 
+#include "ThreadPlacement.h"
+
 vsg::ref_ptr<vsg::Node> createScene(const vsg::Path& filename, vsg::ref_ptr<vsg::Options> options)
 {
     if (filename)
@@ -217,6 +219,9 @@ int main(int argc, char** argv)
         affinity.cpus.insert(cpu);
     }
 
+    // alternatively place the main and record threads using a policy, one of none, compact or scatter
+    auto placement = ThreadPlacement::create(ThreadPlacement::policyFromString(arguments.value(std::string("none"), "--placement")));
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     vsg::Path filename;
@@ -320,11 +325,27 @@ int main(int argc, char** argv)
                 }
             }
         }
+        else if (placement->policy != ThreadPlacement::NONE)
+        {
+            placement->placeCurrentThread(ThreadPlacement::MAIN, 0);
+
+            uint32_t index = 0;
+            for (auto& thread : viewer->threads)
+            {
+                if (thread.joinable()) placement->place(thread, ThreadPlacement::RECORD, index++);
+            }
+        }
     }
     else if (affinity)
     {
         vsg::setAffinity(affinity);
     }
+    else
+    {
+        placement->placeCurrentThread(ThreadPlacement::MAIN, 0);
+    }
+
+    if (placement->policy != ThreadPlacement::NONE) placement->report(std::cout);
 
 
     // add close handler to respond the close window button and pressing escape
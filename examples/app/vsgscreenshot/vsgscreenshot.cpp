@@ -7,24 +7,32 @@
 #include <algorithm>
 #include <chrono>
 #include <iostream>
-#include <thread>
+
+#include "CaptureSink.h"
 
 class ScreenshotHandler : public vsg::Inherit<vsg::Visitor, ScreenshotHandler>
 {
 public:
     bool do_image_capture = false;
     bool do_depth_capture = false;
-    vsg::ref_ptr<vsg::Event> event;
-    bool eventDebugTest = false;
+    bool continuous = false;
     vsg::Path colorFilename;
     vsg::Path depthFilename;
     vsg::ref_ptr<vsg::Options> options;
 
-    ScreenshotHandler(vsg::ref_ptr<vsg::Event> in_event, const vsg::Path& in_colorFilename, const vsg::Path& in_depthFilename, vsg::ref_ptr<vsg::Options> in_options = {}):
-        event(in_event),
+    // the sinks write the captures on background threads, as a numbered sequence when numbered or in continuous mode, otherwise to colorFilename and depthFilename
+    vsg::ref_ptr<CaptureSink> colorSink;
+    vsg::ref_ptr<CaptureSink> depthSink;
+    bool numbered = false;
+    uint64_t numColorCaptures = 0;
+    uint64_t numDepthCaptures = 0;
+    uint64_t numDropped = 0;
+
+    ScreenshotHandler(const vsg::Path& in_colorFilename, const vsg::Path& in_depthFilename, vsg::ref_ptr<vsg::Options> in_options = {}, uint32_t numSlots = 3) :
         colorFilename(in_colorFilename),
         depthFilename(in_depthFilename),
-        options(in_options)
+        options(in_options),
+        _slots(std::max(1u, numSlots))
     {
     }
 
@@ -38,6 +46,11 @@ public:
         {
             do_depth_capture = true;
         }
+        if (keyPress.keyBase == 'c')
+        {
+            continuous = !continuous;
+            std::cout << "Continuous capture " << (continuous ? "on" : "off") << std::endl;
+        }
     }
 
     void printInfo(vsg::ref_ptr<vsg::Window> window)
@@ -68,91 +81,189 @@ public:
         std::cout << "    depthFormat() = " << window->depthFormat() << std::endl;
     }
 
-    void screenshot_image(vsg::ref_ptr<vsg::Window> window)
+    bool capturing() const
     {
-        // printInfo(window);
+        if (continuous) return true;
+        for (auto& slot : _slots)
+        {
+            if (slot.pending) return true;
+        }
+        return false;
+    }
 
-        do_image_capture = false;
+    // add the commands for any requested captures to the end of the frame's command graph, call after advanceToNextFrame() and before recordAndSubmit().
+    // The capture resources of each slot are created once and only recreated when the window is resized.
+    void assignCaptures(vsg::ref_ptr<vsg::Window> window, vsg::CommandGraph& commandGraph, size_t numRenderCommands)
+    {
+        commandGraph.children.resize(numRenderCommands);
+
+        if (continuous) do_image_capture = true;
+        if (!do_image_capture && !do_depth_capture) return;
 
-        if (eventDebugTest && event && event->status() == VK_EVENT_RESET)
+        if (window->extent2D().width != _extent.width || window->extent2D().height != _extent.height || window->getSwapchain() != _swapchain)
         {
-            std::cout << "event->status() == VK_EVENT_RESET" << std::endl;
-            // manually wait for the event to be signaled
-            while (event->status() == VK_EVENT_RESET)
+            createSlots(window);
+        }
+
+        auto itr = std::find_if(_slots.begin(), _slots.end(), [](const Slot& slot) { return !slot.pending; });
+        if (itr == _slots.end())
+        {
+            // all the slots are waiting to be read back, drop the continuous capture of this frame rather than waiting
+            if (continuous)
             {
-                std::cout << "w";
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                ++numDropped;
+                do_image_capture = false;
             }
-            std::cout << std::endl;
+            return;
         }
 
-        auto width = window->extent2D().width;
-        auto height = window->extent2D().height;
+        auto& slot = *itr;
+        slot.color = do_image_capture;
+        slot.depth = do_depth_capture;
+        slot.numbered = numbered || continuous;
+        do_image_capture = false;
+        do_depth_capture = false;
 
-        auto device = window->getDevice();
-        auto physicalDevice = window->getPhysicalDevice();
-        auto swapchain = window->getSwapchain();
+        if (slot.color)
+        {
+            // the swapchain image rendered to this frame, it's been acquired by advanceToNextFrame()
+            auto imageIndex = window->imageIndex();
+            if (imageIndex >= slot.colorCaptures.size()) slot.colorCaptures.resize(imageIndex + 1);
+            if (!slot.colorCaptures[imageIndex]) slot.colorCaptures[imageIndex] = createColorCapture(window, slot, window->imageView(imageIndex)->image);
+            commandGraph.addChild(slot.colorCaptures[imageIndex]);
+        }
+        if (slot.depth)
+        {
+            if (!slot.depthCapture) slot.depthCapture = createDepthCapture(window, slot);
+            commandGraph.addChild(slot.depthCapture);
+        }
 
-        // get the colour buffer image of the previous rendered frame as the current frame hasn't been rendered yet.  The 1 in window->imageIndex(1) means image from 1 frame ago.
-        auto sourceImage = window->imageView(window->imageIndex(1))->image;
+        // signal the slot's event once the copies are complete so poll() can check for completion without blocking
+        commandGraph.addChild(slot.setEvent);
+        slot.pending = true;
+    }
 
-        VkFormat sourceImageFormat = swapchain->getImageFormat();
-        VkFormat targetImageFormat = sourceImageFormat;
+    // read back any captures the GPU has completed, without waiting for the ones still in flight.
+    void poll(vsg::ref_ptr<vsg::Window> window)
+    {
+        for (auto& slot : _slots)
+        {
+            if (slot.pending && slot.event->status() == VK_EVENT_SET) consume(window, slot);
+        }
+    }
+
+    // wait for all the captures in flight and read them back, used before the capture resources are replaced and on exit.
+    void flush(vsg::ref_ptr<vsg::Window> window)
+    {
+        if (!capturing()) return;
+
+        window->getDevice()->deviceWaitIdle();
+        for (auto& slot : _slots)
+        {
+            if (slot.pending) consume(window, slot);
+        }
+    }
+
+protected:
+    struct Slot
+    {
+        vsg::ref_ptr<vsg::Image> colorImage;
+        VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+        vsg::ref_ptr<vsg::Buffer> depthBuffer;
+        vsg::ref_ptr<vsg::Event> event;
+        vsg::ref_ptr<vsg::SetEvent> setEvent;
+        std::vector<vsg::ref_ptr<vsg::Commands>> colorCaptures; // one per swapchain image, created on first use
+        vsg::ref_ptr<vsg::Commands> depthCapture;
+        bool color = false;
+        bool depth = false;
+        bool numbered = false;
+        bool pending = false;
+    };
+
+    std::vector<Slot> _slots;
+    VkExtent2D _extent{0, 0};
+    bool _supportsBlit = false;
+    const vsg::Swapchain* _swapchain = nullptr;
+
+    void createSlots(vsg::ref_ptr<vsg::Window> window)
+    {
+        flush(window);
+
+        auto device = window->getDevice();
+        auto physicalDevice = window->getPhysicalDevice();
+        _extent = window->extent2D();
+        _swapchain = window->getSwapchain();
 
         //
         // 1) Check to see of Blit is supported.
         //
+        VkFormat sourceImageFormat = window->getSwapchain()->getImageFormat();
+
         VkFormatProperties srcFormatProperties;
         vkGetPhysicalDeviceFormatProperties(*(physicalDevice), sourceImageFormat, &srcFormatProperties);
 
         VkFormatProperties destFormatProperties;
         vkGetPhysicalDeviceFormatProperties(*(physicalDevice), VK_FORMAT_R8G8B8A8_UNORM, &destFormatProperties);
 
-        bool supportsBlit = ((srcFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) != 0) &&
-                            ((destFormatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT) != 0);
+        _supportsBlit = ((srcFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) != 0) &&
+                        ((destFormatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT) != 0);
 
-        if (supportsBlit)
-        {
-            // we can automatically convert the image format when blit, so take advantage of it to ensure RGBA
-            targetImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
-        }
+        // we can automatically convert the image format when blit, so take advantage of it to ensure RGBA
+        VkFormat targetImageFormat = _supportsBlit ? VK_FORMAT_R8G8B8A8_UNORM : sourceImageFormat;
 
-        vsg::info("supportsBlit = ", supportsBlit);
+        vsg::info("supportsBlit = ", _supportsBlit);
 
-        //
-        // 2) create image to write to
-        //
-        auto destinationImage = vsg::Image::create();
-        destinationImage->imageType = VK_IMAGE_TYPE_2D;
-        destinationImage->format = targetImageFormat;
-        destinationImage->extent.width = width;
-        destinationImage->extent.height = height;
-        destinationImage->extent.depth = 1;
-        destinationImage->arrayLayers = 1;
-        destinationImage->mipLevels = 1;
-        destinationImage->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        destinationImage->samples = VK_SAMPLE_COUNT_1_BIT;
-        destinationImage->tiling = VK_IMAGE_TILING_LINEAR;
-        destinationImage->usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        auto depthMemoryRequirements = window->getDepthImage()->getMemoryRequirements(device->deviceID);
 
-        destinationImage->compile(device);
+        for (auto& slot : _slots)
+        {
+            //
+            // 2) create image to write to
+            //
+            auto destinationImage = vsg::Image::create();
+            destinationImage->imageType = VK_IMAGE_TYPE_2D;
+            destinationImage->format = targetImageFormat;
+            destinationImage->extent.width = _extent.width;
+            destinationImage->extent.height = _extent.height;
+            destinationImage->extent.depth = 1;
+            destinationImage->arrayLayers = 1;
+            destinationImage->mipLevels = 1;
+            destinationImage->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            destinationImage->samples = VK_SAMPLE_COUNT_1_BIT;
+            destinationImage->tiling = VK_IMAGE_TILING_LINEAR;
+            destinationImage->usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+            destinationImage->compile(device);
+
+            auto deviceMemory = vsg::DeviceMemory::create(device, destinationImage->getMemoryRequirements(device->deviceID), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+            destinationImage->bind(deviceMemory, 0);
+
+            slot.colorImage = destinationImage;
+            slot.colorFormat = targetImageFormat;
+            slot.depthBuffer = vsg::createBufferAndMemory(device, depthMemoryRequirements.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+            // Vulkan creates vkEvent in an unsignalled state
+            if (!slot.event)
+            {
+                slot.event = vsg::Event::create(device);
+                slot.setEvent = vsg::SetEvent::create(slot.event, VK_PIPELINE_STAGE_TRANSFER_BIT);
+            }
 
-        auto deviceMemory = vsg::DeviceMemory::create(device, destinationImage->getMemoryRequirements(device->deviceID), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            slot.colorCaptures.clear();
+            slot.depthCapture = {};
+            slot.pending = false;
+        }
+    }
 
-        destinationImage->bind(deviceMemory, 0);
+    vsg::ref_ptr<vsg::Commands> createColorCapture(vsg::ref_ptr<vsg::Window> window, Slot& slot, vsg::ref_ptr<vsg::Image> sourceImage)
+    {
+        auto width = _extent.width;
+        auto height = _extent.height;
+        auto destinationImage = slot.colorImage;
 
-        //
-        // 3) create command buffer and submit to graphics queue
-        //
         auto commands = vsg::Commands::create();
 
-        if (event)
-        {
-            vsg::info("Using vsg::Event/vkEvent");
-            commands->addChild(vsg::WaitEvents::create(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, event));
-            commands->addChild(vsg::ResetEvent::create(event, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT));
-        }
-
         // 3.a) transition destinationImage to transfer destination initialLayout
         auto transitionDestinationImageToDestinationLayoutBarrier = vsg::ImageMemoryBarrier::create(
             0,                                                             // srcAccessMask
@@ -165,9 +276,9 @@ public:
             VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1} // subresourceRange
         );
 
-        // 3.b) transition swapChainImage from present to transfer source initialLayout
+        // 3.b) transition swapChainImage from present to transfer source initialLayout, once this frame's rendering to it has completed
         auto transitionSourceImageToTransferSourceLayoutBarrier = vsg::ImageMemoryBarrier::create(
-            VK_ACCESS_MEMORY_READ_BIT,                                     // srcAccessMask
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,                          // srcAccessMask
             VK_ACCESS_TRANSFER_READ_BIT,                                   // dstAccessMask
             VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,                               // oldLayout
             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,                          // newLayout
@@ -178,7 +289,7 @@ public:
         );
 
         auto cmd_transitionForTransferBarrier = vsg::PipelineBarrier::create(
-            VK_PIPELINE_STAGE_TRANSFER_BIT,                       // srcStageMask
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,        // srcStageMask
             VK_PIPELINE_STAGE_TRANSFER_BIT,                       // dstStageMask
             0,                                                    // dependencyFlags
             transitionDestinationImageToDestinationLayoutBarrier, // barrier
@@ -187,7 +298,7 @@ public:
 
         commands->addChild(cmd_transitionForTransferBarrier);
 
-        if (supportsBlit)
+        if (_supportsBlit)
         {
             // 3.c.1) if blit using VkCmdBliImage
             VkImageBlit region{};
@@ -236,7 +347,7 @@ public:
         // 3.d) transition destinate image from transfer destination layout to general layout to enable mapping to image DeviceMemory
         auto transitionDestinationImageToMemoryReadBarrier = vsg::ImageMemoryBarrier::create(
             VK_ACCESS_TRANSFER_WRITE_BIT,                                  // srcAccessMask
-            VK_ACCESS_MEMORY_READ_BIT,                                     // dstAccessMask
+            VK_ACCESS_HOST_READ_BIT,                                       // dstAccessMask
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,                          // oldLayout
             VK_IMAGE_LAYOUT_GENERAL,                                       // newLayout
             VK_QUEUE_FAMILY_IGNORED,                                       // srcQueueFamilyIndex
@@ -258,90 +369,32 @@ public:
         );
 
         auto cmd_transitionFromTransferBarrier = vsg::PipelineBarrier::create(
-            VK_PIPELINE_STAGE_TRANSFER_BIT,                // srcStageMask
-            VK_PIPELINE_STAGE_TRANSFER_BIT,                // dstStageMask
-            0,                                             // dependencyFlags
-            transitionDestinationImageToMemoryReadBarrier, // barrier
-            transitionSourceImageBackToPresentBarrier      // barrier
+            VK_PIPELINE_STAGE_TRANSFER_BIT,                                   // srcStageMask
+            VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, // dstStageMask
+            0,                                                                // dependencyFlags
+            transitionDestinationImageToMemoryReadBarrier,                    // barrier
+            transitionSourceImageBackToPresentBarrier                         // barrier
         );
 
         commands->addChild(cmd_transitionFromTransferBarrier);
 
-        auto fence = vsg::Fence::create(device);
-        auto queueFamilyIndex = physicalDevice->getQueueFamily(VK_QUEUE_GRAPHICS_BIT);
-        auto commandPool = vsg::CommandPool::create(device, queueFamilyIndex);
-        auto queue = device->getQueue(queueFamilyIndex);
-
-        vsg::submitCommandsToQueue(commandPool, fence, 100000000000, queue, [&](vsg::CommandBuffer& commandBuffer) {
-            commands->record(commandBuffer);
-        });
-
-        //
-        // 4) map image and copy
-        //
-        VkImageSubresource subResource{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
-        VkSubresourceLayout subResourceLayout;
-        vkGetImageSubresourceLayout(*device, destinationImage->vk(device->deviceID), &subResource, &subResourceLayout);
-
-        // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
-        auto imageData = vsg::MappedData<vsg::ubvec4Array2D>::create(deviceMemory, subResourceLayout.offset, 0, vsg::Data::Properties{targetImageFormat}, width, height); // deviceMemory, offset, flags and dimensions
-
-        if (vsg::write(imageData, colorFilename, options))
-        {
-            std::cout<<"Written color buffer to "<<colorFilename<<std::endl;
-        }
-        else
-        {
-            std::cout<<"Failed to written color buffer to "<<colorFilename<<std::endl;
-        }
+        return commands;
     }
 
-    void screenshot_depth(vsg::ref_ptr<vsg::Window> window)
+    vsg::ref_ptr<vsg::Commands> createDepthCapture(vsg::ref_ptr<vsg::Window> window, Slot& slot)
     {
-        do_depth_capture = false;
-
-        //printInfo(window);
-        if (eventDebugTest && event && event->status() == VK_EVENT_RESET)
-        {
-            std::cout << "event->status() == VK_EVENT_RESET" << std::endl;
-            // manually wait for the event to be signaled
-            while (event->status() == VK_EVENT_RESET)
-            {
-                std::cout << "w";
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            }
-            std::cout << std::endl;
-        }
-
-        auto width = window->extent2D().width;
-        auto height = window->extent2D().height;
-
-        auto device = window->getDevice();
-        auto physicalDevice = window->getPhysicalDevice();
+        auto width = _extent.width;
+        auto height = _extent.height;
 
         vsg::ref_ptr<vsg::Image> sourceImage(window->getDepthImage());
-
-        VkFormat sourceImageFormat = window->depthFormat();
-        VkFormat targetImageFormat = sourceImageFormat;
-
-        auto memoryRequirements = sourceImage->getMemoryRequirements(device->deviceID);
-
-        // 1. create buffer to copy to.
-        VkDeviceSize bufferSize = memoryRequirements.size;
-        auto destinationBuffer = vsg::createBufferAndMemory(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
-        auto destinationMemory = destinationBuffer->getDeviceMemory(device->deviceID);
+        auto destinationBuffer = slot.depthBuffer;
+        VkDeviceSize bufferSize = destinationBuffer->size;
 
         VkImageAspectFlags imageAspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT; // | VK_IMAGE_ASPECT_STENCIL_BIT; // need to match imageAspectFlags setting to WindowTraits::depthFormat.
 
         // 2.a) transition depth image for reading
         auto commands = vsg::Commands::create();
 
-        if (event)
-        {
-            commands->addChild(vsg::WaitEvents::create(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, event));
-            commands->addChild(vsg::ResetEvent::create(event, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT));
-        }
-
         auto transitionSourceImageToTransferSourceLayoutBarrier = vsg::ImageMemoryBarrier::create(
             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, // srcAccessMask
             VK_ACCESS_TRANSFER_READ_BIT,                                                                // dstAccessMask
@@ -406,7 +459,7 @@ public:
 
         auto transitionDestinationBufferToMemoryReadBarrier = vsg::BufferMemoryBarrier::create(
             VK_ACCESS_TRANSFER_WRITE_BIT, // srcAccessMask
-            VK_ACCESS_MEMORY_READ_BIT,    // dstAccessMask
+            VK_ACCESS_HOST_READ_BIT,      // dstAccessMask
             VK_QUEUE_FAMILY_IGNORED,      // srcQueueFamilyIndex
             VK_QUEUE_FAMILY_IGNORED,      // dstQueueFamilyIndex
             destinationBuffer,            // buffer
@@ -415,58 +468,98 @@ public:
         );
 
         auto cmd_transitionSourceImageBackToPresentBarrier = vsg::PipelineBarrier::create(
-            VK_PIPELINE_STAGE_TRANSFER_BIT,                                                            // srcStageMask
-            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // dstStageMask
-            0,                                                                                         // dependencyFlags
-            transitionSourceImageBackToPresentBarrier,                                                 // barrier
-            transitionDestinationBufferToMemoryReadBarrier                                             // barrier
+            VK_PIPELINE_STAGE_TRANSFER_BIT,                                                                                       // srcStageMask
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT, // dstStageMask
+            0,                                                                                                                    // dependencyFlags
+            transitionSourceImageBackToPresentBarrier,                                                                            // barrier
+            transitionDestinationBufferToMemoryReadBarrier                                                                        // barrier
         );
 
         commands->addChild(cmd_transitionSourceImageBackToPresentBarrier);
 
-        auto fence = vsg::Fence::create(device);
-        auto queueFamilyIndex = physicalDevice->getQueueFamily(VK_QUEUE_GRAPHICS_BIT);
-        auto commandPool = vsg::CommandPool::create(device, queueFamilyIndex);
-        auto queue = device->getQueue(queueFamilyIndex);
-
-        vsg::submitCommandsToQueue(commandPool, fence, 100000000000, queue, [&](vsg::CommandBuffer& commandBuffer) {
-            commands->record(commandBuffer);
-        });
+        return commands;
+    }
 
-        // 3. map buffer and copy data.
+    void consume(vsg::ref_ptr<vsg::Window> window, Slot& slot)
+    {
+        auto device = window->getDevice();
 
-        // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
-        if (targetImageFormat == VK_FORMAT_D32_SFLOAT || targetImageFormat == VK_FORMAT_D32_SFLOAT_S8_UINT)
+        if (slot.color)
         {
-            auto imageData = vsg::MappedData<vsg::floatArray2D>::create(destinationMemory, 0, 0, vsg::Data::Properties{targetImageFormat}, width, height); // deviceMemory, offset, flags and dimensions
+            //
+            // 4) map image and copy
+            //
+            VkImageSubresource subResource{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+            VkSubresourceLayout subResourceLayout;
+            vkGetImageSubresourceLayout(*device, slot.colorImage->vk(device->deviceID), &subResource, &subResourceLayout);
+
+            // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
+            auto imageData = vsg::MappedData<vsg::ubvec4Array2D>::create(slot.colorImage->getDeviceMemory(device->deviceID), subResourceLayout.offset, 0, vsg::Data::Properties{slot.colorFormat}, _extent.width, _extent.height); // deviceMemory, offset, flags and dimensions
 
-            size_t num_set_depth = 0;
-            size_t num_unset_depth = 0;
-            for (auto& value : *imageData)
+            if (slot.numbered)
             {
-                if (value == 0.0f)
-                    ++num_unset_depth;
-                else
-                    ++num_set_depth;
+                auto frameNumber = numColorCaptures++;
+                if (colorSink->write(*imageData, frameNumber) && !continuous) std::cout<<"Queued color buffer to be written to "<<colorSink->frameFilename(frameNumber)<<std::endl;
             }
-
-            std::cout << "num_unset_depth = " << num_unset_depth << std::endl;
-            std::cout << "num_set_depth = " << num_set_depth << std::endl;
-
-            if (vsg::write(imageData, depthFilename, options))
+            else if (colorSink->write(*imageData, colorFilename))
+            {
+                ++numColorCaptures;
+                std::cout<<"Queued color buffer to be written to "<<colorFilename<<std::endl;
+            }
+            else
             {
-                std::cout<<"Written depth buffer to "<<depthFilename<<std::endl;
+                std::cout<<"Failed to written color buffer to "<<colorFilename<<std::endl;
             }
         }
-        else
+
+        if (slot.depth)
         {
-            auto imageData = vsg::MappedData<vsg::uintArray2D>::create(destinationMemory, 0, 0, vsg::Data::Properties{targetImageFormat}, width, height); // deviceMemory, offset, flags and dimensions
+            // 3. map buffer and copy data.
+            auto destinationMemory = slot.depthBuffer->getDeviceMemory(device->deviceID);
+            VkFormat targetImageFormat = window->depthFormat();
+
+            // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
+            vsg::ref_ptr<vsg::Data> imageData;
+            if (targetImageFormat == VK_FORMAT_D32_SFLOAT || targetImageFormat == VK_FORMAT_D32_SFLOAT_S8_UINT)
+            {
+                auto floatData = vsg::MappedData<vsg::floatArray2D>::create(destinationMemory, 0, 0, vsg::Data::Properties{targetImageFormat}, _extent.width, _extent.height); // deviceMemory, offset, flags and dimensions
+
+                if (!continuous)
+                {
+                    size_t num_set_depth = 0;
+                    size_t num_unset_depth = 0;
+                    for (auto& value : *floatData)
+                    {
+                        if (value == 0.0f)
+                            ++num_unset_depth;
+                        else
+                            ++num_set_depth;
+                    }
+
+                    std::cout << "num_unset_depth = " << num_unset_depth << std::endl;
+                    std::cout << "num_set_depth = " << num_set_depth << std::endl;
+                }
+                imageData = floatData;
+            }
+            else
+            {
+                imageData = vsg::MappedData<vsg::uintArray2D>::create(destinationMemory, 0, 0, vsg::Data::Properties{targetImageFormat}, _extent.width, _extent.height); // deviceMemory, offset, flags and dimensions
+            }
 
-            if (vsg::write(imageData, depthFilename))
+            if (slot.numbered)
+            {
+                auto frameNumber = numDepthCaptures++;
+                if (depthSink->write(*imageData, frameNumber)) std::cout<<"Queued depth buffer to be written to "<<depthSink->frameFilename(frameNumber)<<std::endl;
+            }
+            else if (depthSink->write(*imageData, depthFilename))
             {
-                std::cout<<"Written depth buffer to "<<depthFilename<<std::endl;
+                ++numDepthCaptures;
+                std::cout<<"Queued depth buffer to be written to "<<depthFilename<<std::endl;
             }
         }
+
+        slot.event->reset();
+        slot.pending = false;
     }
 };
 
@@ -501,7 +594,9 @@ int main(int argc, char** argv)
     arguments.read("--samples", windowTraits->samples);
     auto colorFilename = arguments.value<vsg::Path>("screenshot.vsgt", {"--color-file", "--cf"});
     auto depthFilename = arguments.value<vsg::Path>("depth.vsgt", {"--depth-file", "--df"});
-    auto use_vkEvent = arguments.read("--use-vkEvent");
+    auto writeSequence = arguments.read("--sequence");
+    auto continuous = arguments.read("--continuous");
+    auto numCaptureSlots = arguments.value<uint32_t>(3, "--capture-slots");
     if (arguments.read("--msaa")) windowTraits->samples = VK_SAMPLE_COUNT_8_BIT;
     if (arguments.read("--IMMEDIATE")) windowTraits->swapchainPreferences.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
     if (arguments.read("--FIFO")) windowTraits->swapchainPreferences.presentMode = VK_PRESENT_MODE_FIFO_KHR;
@@ -595,19 +690,31 @@ int main(int argc, char** argv)
 
     viewer->addEventHandler(vsg::Trackball::create(camera));
 
-    auto event = vsg::Event::create_if(use_vkEvent, window->getOrCreateDevice()); // Vulkan creates vkEvent in an unsignalled state
-
     // Add ScreenshotHandler to respond to keyboard and mouse events.
-    auto screenshotHandler = ScreenshotHandler::create(event, colorFilename, depthFilename, options);
+    auto screenshotHandler = ScreenshotHandler::create(colorFilename, depthFilename, options, numCaptureSlots);
+    screenshotHandler->numbered = writeSequence;
+    screenshotHandler->continuous = continuous;
+    screenshotHandler->colorSink = CaptureSink::create(colorFilename, 1, 4, options);
+    screenshotHandler->depthSink = CaptureSink::create(depthFilename, 1, 4, options);
     viewer->addEventHandler(screenshotHandler);
 
     auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
-    if (event) commandGraph->addChild(vsg::SetEvent::create(event, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT));
+    auto numRenderCommands = commandGraph->children.size();
 
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     viewer->compile();
 
+    // frame time stats, split by whether a capture was in flight so the cost of capturing can be compared with normal frames
+    struct FrameStats
+    {
+        uint64_t count = 0;
+        double total = 0.0;
+        double max = 0.0;
+    };
+    FrameStats capturingFrames, normalFrames;
+    auto previousFrameTime = vsg::clock::now();
+
     // rendering main loop
     while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
     {
@@ -616,14 +723,34 @@ int main(int argc, char** argv)
 
         viewer->update();
 
-        viewer->recordAndSubmit();
+        // record the capture commands into this frame's command graph, the GPU signals an event when they have completed
+        screenshotHandler->assignCaptures(window, *commandGraph, numRenderCommands);
 
-        if (screenshotHandler->do_image_capture) screenshotHandler->screenshot_image(window);
-        if (screenshotHandler->do_depth_capture) screenshotHandler->screenshot_depth(window);
+        viewer->recordAndSubmit();
 
         viewer->present();
+
+        // read back captures from earlier frames that have completed, never waiting on the GPU
+        screenshotHandler->poll(window);
+
+        auto frameTime = vsg::clock::now();
+        double frameDuration = std::chrono::duration<double, std::chrono::milliseconds::period>(frameTime - previousFrameTime).count();
+        previousFrameTime = frameTime;
+
+        auto& stats = screenshotHandler->capturing() ? capturingFrames : normalFrames;
+        ++stats.count;
+        stats.total += frameDuration;
+        stats.max = std::max(stats.max, frameDuration);
     }
 
+    screenshotHandler->flush(window);
+    screenshotHandler->colorSink->flush();
+    screenshotHandler->depthSink->flush();
+
+    if (normalFrames.count > 0) std::cout << "Frame time without capture : average " << normalFrames.total / double(normalFrames.count) << "ms, max " << normalFrames.max << "ms over " << normalFrames.count << " frames" << std::endl;
+    if (capturingFrames.count > 0) std::cout << "Frame time with capture : average " << capturingFrames.total / double(capturingFrames.count) << "ms, max " << capturingFrames.max << "ms over " << capturingFrames.count << " frames" << std::endl;
+    if (screenshotHandler->numColorCaptures > 0 || screenshotHandler->numDropped > 0) std::cout << "Captured " << screenshotHandler->numColorCaptures << " color frames, dropped " << screenshotHandler->numDropped << ", write blocked " << screenshotHandler->colorSink->blockedTime << "ms" << std::endl;
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
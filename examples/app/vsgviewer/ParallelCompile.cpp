@@ -0,0 +1,334 @@
+#include "ParallelCompile.h"
+#include "SharedPipelines.h"
+
+#include <algorithm>
+#include <exception>
+#include <set>
+#include <thread>
+
+namespace
+{
+    struct CountNodes : public vsg::ConstVisitor
+    {
+        size_t numNodes = 0;
+
+        void apply(const vsg::Node& node) override
+        {
+            ++numNodes;
+            node.traverse(*this);
+        }
+    };
+
+    size_t countNodes(const vsg::Node& node)
+    {
+        CountNodes count;
+        node.accept(count);
+        return count.numNodes;
+    }
+
+    // CollectCompileUnits collects the Commands and StateCommands of each partition along with the objects their compile() will
+    // create or modify, so that objects reachable from more than one partition can be found and their users compiled serially.
+    struct CollectCompileUnits : public vsg::Visitor
+    {
+        struct Unit
+        {
+            vsg::ref_ptr<vsg::Command> command;
+            std::vector<const vsg::Object*> resources;
+        };
+
+        std::vector<Unit> units;
+        std::map<const vsg::Object*, size_t> owners;
+        std::set<const vsg::Object*> shared;
+        size_t partitionIndex = 0;
+
+        void use(const vsg::Object* object, Unit& unit)
+        {
+            if (!object) return;
+
+            unit.resources.push_back(object);
+
+            auto [itr, inserted] = owners.emplace(object, partitionIndex);
+            if (!inserted && itr->second != partitionIndex) shared.insert(object);
+        }
+
+        void use(const vsg::BufferInfo* bufferInfo, Unit& unit)
+        {
+            if (!bufferInfo) return;
+            use(static_cast<const vsg::Object*>(bufferInfo), unit);
+            use(bufferInfo->data.get(), unit);
+            use(bufferInfo->buffer.get(), unit);
+        }
+
+        void use(const vsg::PipelineLayout* layout, Unit& unit)
+        {
+            if (!layout) return;
+            use(static_cast<const vsg::Object*>(layout), unit);
+            for (auto& setLayout : layout->setLayouts) use(setLayout.get(), unit);
+        }
+
+        void use(const vsg::DescriptorSet* descriptorSet, Unit& unit)
+        {
+            if (!descriptorSet) return;
+            use(static_cast<const vsg::Object*>(descriptorSet), unit);
+            use(descriptorSet->setLayout.get(), unit);
+            for (auto& descriptor : descriptorSet->descriptors)
+            {
+                use(descriptor.get(), unit);
+                if (auto descriptorImage = descriptor.cast<vsg::DescriptorImage>())
+                {
+                    for (auto& imageInfo : descriptorImage->imageInfoList)
+                    {
+                        use(imageInfo.get(), unit);
+                        use(imageInfo->sampler.get(), unit);
+                        if (auto& imageView = imageInfo->imageView)
+                        {
+                            use(imageView.get(), unit);
+                            if (imageView->image) use(imageView->image->data.get(), unit);
+                            use(imageView->image.get(), unit);
+                        }
+                    }
+                }
+                else if (auto descriptorBuffer = descriptor.cast<vsg::DescriptorBuffer>())
+                {
+                    for (auto& bufferInfo : descriptorBuffer->bufferInfoList) use(bufferInfo.get(), unit);
+                }
+            }
+        }
+
+        template<class P>
+        void usePipeline(const P* pipeline, Unit& unit)
+        {
+            if (!pipeline) return;
+            use(static_cast<const vsg::Object*>(pipeline), unit);
+            use(pipeline->layout.get(), unit);
+        }
+
+        void use(const vsg::GraphicsPipeline* pipeline, Unit& unit)
+        {
+            usePipeline(pipeline, unit);
+            if (pipeline)
+            {
+                for (auto& stage : pipeline->stages)
+                {
+                    use(stage.get(), unit);
+                    use(stage->module.get(), unit);
+                }
+            }
+        }
+
+        void add(vsg::Command& command)
+        {
+            Unit unit{vsg::ref_ptr<vsg::Command>(&command), {}};
+            use(static_cast<const vsg::Object*>(&command), unit);
+
+            if (auto bindPipeline = command.cast<vsg::BindGraphicsPipeline>())
+            {
+                use(bindPipeline->pipeline.get(), unit);
+            }
+            else if (auto bindSharedPipeline = command.cast<BindSharedGraphicsPipeline>())
+            {
+                use(bindSharedPipeline->pipeline.get(), unit);
+            }
+            else if (auto bindComputePipeline = command.cast<vsg::BindComputePipeline>())
+            {
+                usePipeline(bindComputePipeline->pipeline.get(), unit);
+                if (bindComputePipeline->pipeline)
+                {
+                    auto& stage = bindComputePipeline->pipeline->stage;
+                    use(stage.get(), unit);
+                    if (stage) use(stage->module.get(), unit);
+                }
+            }
+            else if (auto bindDescriptorSets = command.cast<vsg::BindDescriptorSets>())
+            {
+                use(bindDescriptorSets->layout.get(), unit);
+                for (auto& descriptorSet : bindDescriptorSets->descriptorSets) use(descriptorSet.get(), unit);
+            }
+            else if (auto bindDescriptorSet = command.cast<vsg::BindDescriptorSet>())
+            {
+                use(bindDescriptorSet->layout.get(), unit);
+                use(bindDescriptorSet->descriptorSet.get(), unit);
+            }
+            else if (auto bindVertexBuffers = command.cast<vsg::BindVertexBuffers>())
+            {
+                for (auto& array : bindVertexBuffers->arrays) use(array.get(), unit);
+            }
+            else if (auto bindIndexBuffer = command.cast<vsg::BindIndexBuffer>())
+            {
+                use(bindIndexBuffer->indices.get(), unit);
+            }
+            else if (auto vid = command.cast<vsg::VertexIndexDraw>())
+            {
+                for (auto& array : vid->arrays) use(array.get(), unit);
+                use(vid->indices.get(), unit);
+            }
+            else if (auto geometry = command.cast<vsg::Geometry>())
+            {
+                for (auto& array : geometry->arrays) use(array.get(), unit);
+                use(geometry->indices.get(), unit);
+                for (auto& child : geometry->commands) use(child.get(), unit);
+            }
+
+            units.push_back(std::move(unit));
+        }
+
+        void apply(vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(vsg::StateGroup& stateGroup) override
+        {
+            for (auto& stateCommand : stateGroup.stateCommands) add(*stateCommand);
+            stateGroup.traverse(*this);
+        }
+
+        void apply(vsg::Command& command) override
+        {
+            add(command);
+        }
+    };
+
+    double milliseconds(vsg::clock::time_point start)
+    {
+        return std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+    }
+} // namespace
+
+std::vector<ParallelCompile::Partition> ParallelCompile::partition(vsg::ref_ptr<vsg::Node> scene, std::vector<vsg::ref_ptr<vsg::Object>>& expanded) const
+{
+    std::vector<Partition> partitions{Partition{scene, countNodes(*scene)}};
+
+    size_t target = std::max(numThreads, 1u) * partitionsPerThread;
+    while (partitions.size() < target)
+    {
+        // expand the largest group into its children, leaving the rest of the nodes as single partitions
+        auto largest = partitions.end();
+        for (auto itr = partitions.begin(); itr != partitions.end(); ++itr)
+        {
+            auto group = itr->node->cast<vsg::Group>();
+            if (group && !group->children.empty() && (largest == partitions.end() || itr->numNodes > largest->numNodes)) largest = itr;
+        }
+        if (largest == partitions.end()) break;
+
+        auto group = largest->node.cast<vsg::Group>();
+        partitions.erase(largest);
+
+        // the state of an expanded StateGroup applies to all its children so has to be compiled ahead of them
+        if (auto stateGroup = group.cast<vsg::StateGroup>())
+        {
+            for (auto& stateCommand : stateGroup->stateCommands) expanded.push_back(stateCommand);
+        }
+
+        for (auto& child : group->children) partitions.push_back(Partition{child, countNodes(*child)});
+    }
+
+    return partitions;
+}
+
+void ParallelCompile::compile(vsg::Viewer& viewer, vsg::ref_ptr<vsg::Node> scene)
+{
+    std::vector<vsg::ref_ptr<vsg::Object>> expanded;
+    auto partitions = partition(scene, expanded);
+    numPartitions = partitions.size();
+
+    // assign the largest partitions first, each to the thread with the fewest nodes so far
+    std::sort(partitions.begin(), partitions.end(), [](const Partition& lhs, const Partition& rhs) { return lhs.numNodes > rhs.numNodes; });
+
+    uint32_t threadCount = std::max(1u, std::min(numThreads, static_cast<uint32_t>(partitions.size())));
+    std::vector<std::vector<vsg::ref_ptr<vsg::Node>>> assigned(threadCount);
+    std::vector<size_t> assignedNodes(threadCount, 0);
+    for (auto& p : partitions)
+    {
+        auto t = std::distance(assignedNodes.begin(), std::min_element(assignedNodes.begin(), assignedNodes.end()));
+        assigned[t].push_back(p.node);
+        assignedNodes[t] += p.numNodes;
+    }
+
+    // each thread has its own CompileTraversal, with descriptor pools sized for the partitions assigned to it
+    std::vector<vsg::ref_ptr<vsg::CompileTraversal>> compileTraversals;
+    for (auto& nodes : assigned)
+    {
+        vsg::CollectResourceRequirements collectRequirements;
+        for (auto& node : nodes) node->accept(collectRequirements);
+        if (compileTraversals.empty())
+        {
+            for (auto& object : expanded) object->accept(collectRequirements);
+        }
+
+        compileTraversals.push_back(vsg::CompileTraversal::create(viewer, collectRequirements.createResourceHints()));
+    }
+
+    // compile the objects reachable from more than one partition on this thread, the partitions then only compile objects of their own
+    auto startShared = vsg::clock::now();
+
+    CollectCompileUnits collectUnits;
+    for (size_t i = 0; i < partitions.size(); ++i)
+    {
+        collectUnits.partitionIndex = i;
+        partitions[i].node->accept(collectUnits);
+    }
+
+    auto& sharedTraversal = compileTraversals.front();
+    for (auto& object : expanded) object->accept(*sharedTraversal);
+
+    numShared = expanded.size();
+    for (auto& unit : collectUnits.units)
+    {
+        bool isShared = std::any_of(unit.resources.begin(), unit.resources.end(), [&](const vsg::Object* object) { return collectUnits.shared.count(object) > 0; });
+        if (isShared)
+        {
+            unit.command->accept(*sharedTraversal);
+            ++numShared;
+        }
+    }
+
+    sharedTime = milliseconds(startShared);
+
+    // compile the partitions
+    auto startParallel = vsg::clock::now();
+
+    std::vector<std::exception_ptr> exceptions(threadCount);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            try
+            {
+                for (auto& node : assigned[t]) node->accept(*compileTraversals[t]);
+            }
+            catch (...)
+            {
+                exceptions[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    for (auto& exception : exceptions)
+    {
+        if (exception) std::rethrow_exception(exception);
+    }
+
+    parallelTime = milliseconds(startParallel);
+
+    // merge the transfer commands of all the threads into the first thread's Contexts so each Context makes a single submission.
+    // All the CompileTraversals were created from the same viewer so have their Contexts in the same order.
+    auto startTransfer = vsg::clock::now();
+
+    for (size_t t = 1; t < compileTraversals.size(); ++t)
+    {
+        auto destination = sharedTraversal->contexts.begin();
+        for (auto& context : compileTraversals[t]->contexts)
+        {
+            auto& commands = (*destination++)->commands;
+            commands.insert(commands.end(), context->commands.begin(), context->commands.end());
+            context->commands.clear();
+        }
+    }
+
+    for (auto& context : sharedTraversal->contexts) context->record();
+    for (auto& context : sharedTraversal->contexts) context->waitForCompletion();
+
+    transferTime = milliseconds(startTransfer);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// ParallelCompile compiles the Vulkan objects of a scene graph on several threads before viewer->compile() is called.
+//
+// The scene is partitioned into independent subgraphs by expanding the largest groups until there are several partitions per
+// thread, then the partitions are assigned to threads, each with its own CompileTraversal and so its own Contexts, staging
+// buffers and descriptor pools. Objects that are reachable from more than one partition, such as state shared via
+// vsg::SharedObjects, are compiled up front on the calling thread as vsg's compile() methods aren't safe to call concurrently on
+// the same object. Once all threads have finished their transfer commands are merged into a single submission per Context.
+//
+// viewer->compile() must still be called afterwards to set up the rest of the viewer, it skips the objects already compiled.
+class ParallelCompile : public vsg::Inherit<vsg::Object, ParallelCompile>
+{
+public:
+    explicit ParallelCompile(uint32_t in_numThreads) :
+        numThreads(in_numThreads) {}
+
+    uint32_t numThreads = 1;
+    uint32_t partitionsPerThread = 4;
+
+    void compile(vsg::Viewer& viewer, vsg::ref_ptr<vsg::Node> scene);
+
+    // stats from the last compile()
+    size_t numPartitions = 0;
+    size_t numShared = 0;
+    double sharedTime = 0.0;   // milliseconds compiling the shared objects
+    double parallelTime = 0.0; // milliseconds compiling the partitions
+    double transferTime = 0.0; // milliseconds recording, submitting and waiting for the transfers
+
+protected:
+    struct Partition
+    {
+        vsg::ref_ptr<vsg::Node> node;
+        size_t numNodes = 0;
+    };
+
+    std::vector<Partition> partition(vsg::ref_ptr<vsg::Node> scene, std::vector<vsg::ref_ptr<vsg::Object>>& expanded) const;
+};
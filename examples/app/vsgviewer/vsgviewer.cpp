@@ -9,6 +9,11 @@
 #include <iostream>
 #include <thread>
 
+#include "ImageConvert.h"
+#include "ParallelCompile.h"
+#include "PipelineCache.h"
+#include "SharedPipelines.h"
+
 vsg::ref_ptr<vsg::Node> createTextureQuad(vsg::ref_ptr<vsg::Data> sourceData, uint32_t mipmapLevelsHints)
 {
     struct ConvertToRGBA : public vsg::Visitor
@@ -23,27 +28,12 @@ vsg::ref_ptr<vsg::Node> createTextureQuad(vsg::ref_ptr<vsg::Data> sourceData, ui
         void apply(vsg::uintArray2D& fa) override
         {
             // treat as a 24bit depth buffer
-            float div = 1.0f / static_cast<float>(1 << 24);
-
-            auto rgba = vsg::vec4Array2D::create(fa.width(), fa.height(), vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT});
-            auto dest_itr = rgba->begin();
-            for (auto& v : fa)
-            {
-                float m = static_cast<float>(v) * div;
-                (*dest_itr++).set(m, m, m, 1.0);
-            }
-            textureData = rgba;
+            textureData = convertDepthToRGBA(fa);
         }
 
         void apply(vsg::floatArray2D& fa) override
         {
-            auto rgba = vsg::vec4Array2D::create(fa.width(), fa.height(), vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT});
-            auto dest_itr = rgba->begin();
-            for (auto& v : fa)
-            {
-                (*dest_itr++).set(v, v, v, 1.0);
-            }
-            textureData = rgba;
+            textureData = convertGrayToRGBA(fa);
         }
 
         vsg::ref_ptr<vsg::Data> convert(vsg::ref_ptr<vsg::Data> data)
@@ -225,6 +215,8 @@ int main(int argc, char** argv)
         if (arguments.read("--rgb")) options->mapRGBtoRGBAHint = false;
 
         if (int log_level = 0; arguments.read("--log-level", log_level)) vsg::Logger::instance()->level = vsg::Logger::Level(log_level);
+        auto pipelineCacheFilename = arguments.value(vsg::Path(), "--pipeline-cache");
+        auto compileThreads = arguments.value<uint32_t>(0, "--compile-threads");
 
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -288,6 +280,17 @@ int main(int argc, char** argv)
 
         viewer->addWindow(window);
 
+        // optionally create the pipelines with a VkPipelineCache that is loaded from file and saved on exit, so subsequent runs can skip recompiling them
+        vsg::ref_ptr<PipelineCache> pipelineCache;
+        vsg::ref_ptr<SharedPipelines> sharedPipelines;
+        if (pipelineCacheFilename)
+        {
+            auto device = window->getOrCreateDevice();
+            pipelineCache = PipelineCache::create(device, pipelineCacheFilename);
+            sharedPipelines = SharedPipelines::create(device, pipelineCache, vsg::ref_ptr<vsg::OperationThreads>());
+            sharedPipelines->prepare(*vsg_scene);
+        }
+
         // compute the bounds of the scene graph to help position camera
         vsg::ComputeBounds computeBounds;
         vsg_scene->accept(computeBounds);
@@ -348,8 +351,33 @@ int main(int argc, char** argv)
         auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
         viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
+        auto startCompile = vsg::clock::now();
+
+        // optionally compile independent subgraphs of the scene on several threads, viewer->compile() then only sets up the viewer
+        if (compileThreads > 0)
+        {
+            auto parallelCompile = ParallelCompile::create(compileThreads);
+            parallelCompile->compile(*viewer, vsg_scene);
+
+            std::cout << "ParallelCompile with " << compileThreads << " threads, partitions = " << parallelCompile->numPartitions << ", shared objects = " << parallelCompile->numShared
+                      << ", shared time = " << parallelCompile->sharedTime << "ms, parallel time = " << parallelCompile->parallelTime << "ms, transfer time = " << parallelCompile->transferTime << "ms" << std::endl;
+        }
+
         viewer->compile();
 
+        if (compileThreads > 0)
+        {
+            auto compileTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startCompile).count();
+            std::cout << "Total compile time = " << compileTime << "ms with " << compileThreads << " threads" << std::endl;
+        }
+
+        if (pipelineCache)
+        {
+            auto compileTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startCompile).count();
+            std::cout << "viewer->compile() time = " << compileTime << "ms with " << (pipelineCache->loaded() ? "warm" : "cold") << " pipeline cache, pipelines created = " << sharedPipelines->numCreated
+                      << ", vkCreateGraphicsPipelines time = " << sharedPipelines->createTime << "ms" << std::endl;
+        }
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
@@ -362,6 +390,12 @@ int main(int argc, char** argv)
 
             viewer->present();
         }
+
+        if (pipelineCache)
+        {
+            viewer->deviceWaitIdle();
+            if (!pipelineCache->save()) std::cout << "Failed to write pipeline cache to " << pipelineCacheFilename << std::endl;
+        }
     }
     catch (const vsg::Exception& ve)
     {
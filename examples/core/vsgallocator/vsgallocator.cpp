@@ -5,10 +5,14 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <filesystem>
 #include <iostream>
 #include <thread>
 
+#include "ThreadPlacement.h"
+
 class CustomAllocator : public vsg::Allocator
 {
 public:
@@ -169,10 +173,16 @@ int main(int argc, char** argv)
             affinity.cpus.insert(cpu);
         }
 
+        // thread placement policy, one of none, compact or scatter, and the number of threads to use to benchmark loading the files
+        auto placement = ThreadPlacement::create(ThreadPlacement::policyFromString(arguments.value(std::string("none"), "--placement")));
+        auto loadThreads = arguments.value<uint32_t>(0, "--load-threads");
+        auto loadRepeat = arguments.value<uint32_t>(4, "--load-repeat");
+
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
         // if required set the affinity of the main thread.
         if (affinity) vsg::setAffinity(affinity);
+        else placement->placeCurrentThread(ThreadPlacement::MAIN, 0);
 
         if (argc <= 1)
         {
@@ -180,6 +190,49 @@ int main(int argc, char** argv)
             return 1;
         }
 
+        if (loadThreads > 0)
+        {
+            // benchmark the load throughput, each thread loading all the files loadRepeat times
+            std::vector<vsg::Path> filenames;
+            size_t bytesPerPass = 0;
+            for (int i = 1; i < argc; ++i)
+            {
+                if (auto filename = vsg::findFile(arguments[i], options))
+                {
+                    filenames.push_back(filename);
+                    bytesPerPass += std::filesystem::file_size(filename.string());
+                }
+            }
+
+            std::atomic_uint numLoaded = 0;
+            auto startOfBenchmark = vsg::clock::now();
+
+            std::vector<std::thread> threads;
+            for (uint32_t t = 0; t < loadThreads; ++t)
+            {
+                // pin the thread before it reads anything, the memory it allocates is then local to its node
+                threads.emplace_back([&, threadAffinity = placement->affinity(ThreadPlacement::LOAD, t)]() {
+                    if (threadAffinity) vsg::setAffinity(threadAffinity);
+
+                    for (uint32_t r = 0; r < loadRepeat; ++r)
+                    {
+                        for (auto& filename : filenames)
+                        {
+                            if (vsg::read(filename, options)) ++numLoaded;
+                        }
+                    }
+                });
+            }
+            for (auto& thread : threads) thread.join();
+
+            auto benchmarkDuration = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startOfBenchmark).count();
+            double megabytes = double(bytesPerPass) * loadThreads * loadRepeat / (1024.0 * 1024.0);
+
+            placement->report(std::cout);
+            std::cout << "Load benchmark: " << loadThreads << " threads loaded " << numLoaded << " files in " << benchmarkDuration * 1000.0 << "ms, "
+                      << double(numLoaded) / benchmarkDuration << " loads/s, " << megabytes / benchmarkDuration << " MB/s" << std::endl;
+        }
+
         // record time point just before loading the scene graph
         auto startOfLoad = vsg::clock::now();
 
@@ -0,0 +1,243 @@
+#include "AsyncLogger.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    std::atomic_uint64_t s_nextLoggerID{1};
+
+    // cache the calling thread's ring for the most recently used AsyncLogger, keyed by ID rather than address so that
+    // a new logger allocated at the address of a deleted one doesn't pick up a stale ring
+    struct ThreadRing
+    {
+        uint64_t loggerID = 0;
+        void* ring = nullptr;
+    };
+    thread_local ThreadRing s_threadRing;
+
+    size_t powerOfTwo(size_t size)
+    {
+        size_t capacity = 2;
+        while (capacity < size) capacity *= 2;
+        return capacity;
+    }
+} // namespace
+
+AsyncLogger::Ring::Ring(size_t capacity, uint32_t in_threadIndex) :
+    records(capacity),
+    mask(capacity - 1),
+    threadIndex(in_threadIndex)
+{
+}
+
+AsyncLogger::AsyncLogger(size_t in_ringSize) :
+    ringSize(powerOfTwo(in_ringSize)),
+    _id(s_nextLoggerID.fetch_add(1))
+{
+    _thread = std::thread([this]() { run(); });
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    {
+        std::scoped_lock<std::mutex> lock(_wakeMutex);
+        _done = true;
+    }
+    _wake.notify_all();
+    _thread.join();
+
+    // write anything logged after the background thread's last pass
+    drain();
+}
+
+uint64_t AsyncLogger::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(vsg::clock::now().time_since_epoch()).count();
+}
+
+AsyncLogger::Ring* AsyncLogger::ring()
+{
+    if (s_threadRing.loggerID == _id) return static_cast<Ring*>(s_threadRing.ring);
+
+    // the thread_local only caches the last logger used, so threads that alternate between loggers find their existing ring here
+    std::scoped_lock<std::mutex> lock(_ringsMutex);
+    auto& threadRing = _threadRings[std::this_thread::get_id()];
+    if (!threadRing)
+    {
+        _rings.emplace_back(new Ring(ringSize, static_cast<uint32_t>(_rings.size())));
+        threadRing = _rings.back().get();
+    }
+
+    s_threadRing.loggerID = _id;
+    s_threadRing.ring = threadRing;
+    return threadRing;
+}
+
+void AsyncLogger::push(Record& record)
+{
+    auto& r = *ring();
+
+    size_t head = r.head.load(std::memory_order_relaxed);
+    if (head - r.tail.load(std::memory_order_acquire) >= r.records.size())
+    {
+        ++r.numDropped;
+        delete record.text;
+        return;
+    }
+
+    r.records[head & r.mask] = record;
+    r.head.store(head + 1, std::memory_order_release);
+}
+
+void AsyncLogger::pushText(Level msg_level, const std::string_view& message)
+{
+    Record record;
+    record.timestamp = now();
+    record.level = msg_level;
+    record.text = new std::string(message);
+    push(record);
+}
+
+void AsyncLogger::debug_implementation(const std::string_view& message)
+{
+    pushText(LOGGER_DEBUG, message);
+}
+
+void AsyncLogger::info_implementation(const std::string_view& message)
+{
+    pushText(LOGGER_INFO, message);
+}
+
+void AsyncLogger::warn_implementation(const std::string_view& message)
+{
+    pushText(LOGGER_WARN, message);
+}
+
+void AsyncLogger::error_implementation(const std::string_view& message)
+{
+    pushText(LOGGER_ERROR, message);
+}
+
+void AsyncLogger::fatal_implementation(const std::string_view& message)
+{
+    pushText(LOGGER_FATAL, message);
+    flush();
+    throw vsg::Exception{std::string(message)};
+}
+
+void AsyncLogger::flush()
+{
+    // the rings only ever grow so take a snapshot of how far each has been written to
+    std::vector<std::pair<Ring*, size_t>> targets;
+    {
+        std::scoped_lock<std::mutex> lock(_ringsMutex);
+        for (auto& r : _rings) targets.emplace_back(r.get(), r->head.load(std::memory_order_acquire));
+    }
+
+    _wake.notify_all();
+
+    for (auto& [r, head] : targets)
+    {
+        while (r->tail.load(std::memory_order_acquire) < head)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+}
+
+uint64_t AsyncLogger::numDropped() const
+{
+    std::scoped_lock<std::mutex> lock(_ringsMutex);
+
+    uint64_t count = 0;
+    for (auto& r : _rings) count += r->numDropped.load();
+    return count;
+}
+
+void AsyncLogger::run()
+{
+    while (!_done)
+    {
+        if (drain()) continue;
+
+        std::unique_lock<std::mutex> lock(_wakeMutex);
+        _wake.wait_for(lock, std::chrono::milliseconds(1), [&]() { return _done.load(); });
+    }
+}
+
+bool AsyncLogger::drain()
+{
+    std::vector<std::pair<Ring*, size_t>> consumed;
+    {
+        std::scoped_lock<std::mutex> lock(_ringsMutex);
+        for (auto& r : _rings)
+        {
+            size_t tail = r->tail.load(std::memory_order_relaxed);
+            size_t head = r->head.load(std::memory_order_acquire);
+            for (size_t i = tail; i < head; ++i) _batch.push_back(r->records[i & r->mask]);
+            if (head != tail) consumed.emplace_back(r.get(), head);
+        }
+    }
+
+    uint64_t dropped = numDropped();
+    if (_batch.empty() && dropped == _numDroppedReported) return false;
+
+    // interleave the records from the different threads in the order they were logged
+    std::stable_sort(_batch.begin(), _batch.end(), [](const Record& lhs, const Record& rhs) { return lhs.timestamp < rhs.timestamp; });
+
+    std::ostringstream out, err;
+    for (auto& record : _batch)
+    {
+        write(record.level >= LOGGER_WARN ? err : out, record);
+        delete record.text;
+    }
+    _batch.clear();
+
+    if (dropped != _numDroppedReported)
+    {
+        err << "Warning: AsyncLogger dropped " << (dropped - _numDroppedReported) << " messages\n";
+        _numDroppedReported = dropped;
+    }
+
+    if (auto str = out.str(); !str.empty()) std::cout << str << std::flush;
+    if (auto str = err.str(); !str.empty()) std::cerr << str << std::flush;
+
+    // only release the ring entries once written so that flush() can wait on them
+    for (auto& [r, head] : consumed) r->tail.store(head, std::memory_order_release);
+
+    return true;
+}
+
+void AsyncLogger::write(std::ostream& out, const Record& record) const
+{
+    switch (record.level)
+    {
+    case (LOGGER_DEBUG): out << "debug: "; break;
+    case (LOGGER_INFO): out << "info: "; break;
+    case (LOGGER_WARN): out << "Warning: "; break;
+    case (LOGGER_ERROR): out << "ERROR: "; break;
+    case (LOGGER_FATAL): out << "FATAL: "; break;
+    default: break;
+    }
+
+    if (record.text)
+    {
+        out << *record.text << "\n";
+        return;
+    }
+
+    out << record.format;
+    for (uint8_t i = 0; i < record.numArgs; ++i)
+    {
+        auto& value = record.values[i];
+        switch (record.types[i])
+        {
+        case (ARG_INT): out << value.i; break;
+        case (ARG_UINT): out << value.u; break;
+        case (ARG_DOUBLE): out << value.d; break;
+        case (ARG_CHAR): out << static_cast<char>(value.i); break;
+        }
+    }
+    out << "\n";
+}
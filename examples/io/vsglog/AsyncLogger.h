@@ -0,0 +1,165 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+// AsyncLogger moves formatting and output off the calling threads. Each thread that logs gets its own single producer/single
+// consumer ring of fixed size records, so logging never takes a lock once the thread's ring has been created. A background
+// thread drains the rings, orders the records by timestamp, formats them and writes them to std::cout/std::cerr.
+// When a ring is full the record is dropped and counted rather than blocking the caller.
+//
+// Messages passed through the usual vsg::info(..) etc. are formatted by vsg::Logger on the calling thread and only the output
+// is deferred. The logBinary(level, "literal", args...) front end avoids the formatting too: it stores a pointer to the string literal,
+// which identifies the message, along with up to maxArgs arithmetic arguments in binary form. Only the format is kept by pointer so it
+// must be a string literal, other strings and char arrays may not outlive the call so the message is formatted on the calling thread.
+class AsyncLogger : public vsg::Inherit<vsg::Logger, AsyncLogger>
+{
+public:
+    explicit AsyncLogger(size_t in_ringSize = 8192);
+
+    static constexpr size_t maxArgs = 6;
+
+    enum ArgType : uint8_t
+    {
+        ARG_INT,
+        ARG_UINT,
+        ARG_DOUBLE,
+        ARG_CHAR
+    };
+
+    union ArgValue
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+    };
+
+    struct Record
+    {
+        uint64_t timestamp = 0;       // nanoseconds
+        const char* format = nullptr; // string literal passed to logBinary()
+        std::string* text = nullptr;  // message already formatted by vsg::Logger, owned by the record
+        Level level = LOGGER_INFO;
+        uint8_t numArgs = 0;
+        ArgType types[maxArgs];
+        ArgValue values[maxArgs];
+    };
+
+    // binary front end, arguments that can't be stored in binary form fall back to formatting on the calling thread
+    template<size_t N, typename... Args>
+    void logBinary(Level msg_level, const char (&format)[N], const Args&... args)
+    {
+        if (msg_level < level) return;
+
+        Record record;
+        record.timestamp = now();
+        record.level = msg_level;
+
+        if constexpr (sizeof...(Args) <= maxArgs && (is_binary_arg<Args>::value && ...))
+        {
+            record.format = format;
+            record.numArgs = static_cast<uint8_t>(sizeof...(Args));
+            size_t i = 0;
+            (encode(record, i++, args), ...);
+        }
+        else
+        {
+            std::ostringstream stream;
+            stream << format;
+            (stream << ... << args);
+            record.text = new std::string(stream.str());
+        }
+
+        push(record);
+    }
+
+    // wait until everything logged before the call has been written
+    void flush();
+
+    // number of records dropped because a thread's ring was full
+    uint64_t numDropped() const;
+
+    const size_t ringSize;
+
+protected:
+    virtual ~AsyncLogger();
+
+    template<typename T>
+    struct is_binary_arg
+    {
+        static constexpr bool value = std::is_arithmetic_v<T>;
+    };
+
+    template<typename T>
+    static void encode(Record& record, size_t i, const T& value)
+    {
+        if constexpr (std::is_same_v<T, char>)
+        {
+            record.types[i] = ARG_CHAR;
+            record.values[i].i = value;
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            record.types[i] = ARG_DOUBLE;
+            record.values[i].d = value;
+        }
+        else if constexpr (std::is_signed_v<T>)
+        {
+            record.types[i] = ARG_INT;
+            record.values[i].i = value;
+        }
+        else
+        {
+            record.types[i] = ARG_UINT;
+            record.values[i].u = value;
+        }
+    }
+
+    struct Ring
+    {
+        Ring(size_t capacity, uint32_t in_threadIndex);
+
+        std::vector<Record> records;
+        const size_t mask;
+        const uint32_t threadIndex;
+
+        alignas(64) std::atomic_size_t head{0}; // next record to write, only modified by the producer
+        alignas(64) std::atomic_size_t tail{0}; // next record to read, only modified by the consumer once the record has been written
+        std::atomic_uint64_t numDropped{0};
+    };
+
+    static uint64_t now();
+
+    Ring* ring();
+    void push(Record& record);
+    void run();
+    bool drain();
+    void write(std::ostream& out, const Record& record) const;
+
+    void debug_implementation(const std::string_view& message) override;
+    void info_implementation(const std::string_view& message) override;
+    void warn_implementation(const std::string_view& message) override;
+    void error_implementation(const std::string_view& message) override;
+    void fatal_implementation(const std::string_view& message) override;
+
+    void pushText(Level msg_level, const std::string_view& message);
+
+    const uint64_t _id;
+
+    mutable std::mutex _ringsMutex;
+    std::vector<std::unique_ptr<Ring>> _rings;
+    std::map<std::thread::id, Ring*> _threadRings;
+
+    std::mutex _wakeMutex;
+    std::condition_variable _wake;
+    std::atomic_bool _done{false};
+    uint64_t _numDroppedReported = 0;
+    std::vector<Record> _batch;
+    std::thread _thread;
+};
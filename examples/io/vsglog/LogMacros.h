@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vsg/io/Logger.h>
+
+// Front end to vsg::Logger that filters messages before any of their arguments are evaluated.
+//
+// VSGLOG_MIN_LEVEL is the lowest vsg::Logger::Level compiled in, calls below it are discarded by the compiler. It defaults to
+// LOGGER_WARN in release (NDEBUG) builds so debug and info messages cost nothing, and LOGGER_ALL otherwise. Define it on the
+// command line to override, i.e. -DVSGLOG_MIN_LEVEL=2 to keep info messages in a release build.
+//
+// Calls that are compiled in check the logger's runtime level inline, so when filtered out the arguments aren't evaluated or
+// formatted and no virtual function is called.
+//
+//     VSGLOG_INFO("loaded ", filename, " in ", time, "ms");
+
+#ifndef VSGLOG_MIN_LEVEL
+#    ifdef NDEBUG
+#        define VSGLOG_MIN_LEVEL 3
+#    else
+#        define VSGLOG_MIN_LEVEL 0
+#    endif
+#endif
+
+#define VSGLOG_AT(min_level, msg_level, ...)                                                                        \
+    do                                                                                                              \
+    {                                                                                                               \
+        if constexpr (static_cast<int>(msg_level) >= static_cast<int>(min_level))                                   \
+        {                                                                                                           \
+            auto& vsglog_logger = vsg::Logger::instance();                                                          \
+            if (vsglog_logger && vsglog_logger->level <= (msg_level)) vsglog_logger->log((msg_level), __VA_ARGS__); \
+        }                                                                                                           \
+    } while (false)
+
+#define VSGLOG(msg_level, ...) VSGLOG_AT(VSGLOG_MIN_LEVEL, msg_level, __VA_ARGS__)
+
+#define VSGLOG_DEBUG(...) VSGLOG(vsg::Logger::LOGGER_DEBUG, __VA_ARGS__)
+#define VSGLOG_INFO(...) VSGLOG(vsg::Logger::LOGGER_INFO, __VA_ARGS__)
+#define VSGLOG_WARN(...) VSGLOG(vsg::Logger::LOGGER_WARN, __VA_ARGS__)
+#define VSGLOG_ERROR(...) VSGLOG(vsg::Logger::LOGGER_ERROR, __VA_ARGS__)
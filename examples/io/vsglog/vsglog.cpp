@@ -1,6 +1,10 @@
 #include <vsg/all.h>
 
 #include <iostream>
+#include <thread>
+
+#include "AsyncLogger.h"
+#include "LogMacros.h"
 
 class CustomLogger : public vsg::Inherit<vsg::Logger, CustomLogger>
 {
@@ -41,6 +45,8 @@ int main(int argc, char** argv)
     vsg::CommandLine arguments(&argc, argv);
 
     auto count = arguments.value<size_t>(0, "-n");
+    auto numThreads = arguments.value<size_t>(16, "-t");
+    auto ringSize = arguments.value<size_t>(8192, "--ring-size");
     auto level = vsg::Logger::Level(arguments.value(0, "-l"));
 
     // you can override the message verbosity by setting the minimum level that will be printed.
@@ -55,6 +61,10 @@ int main(int argc, char** argv)
     // you can call the logger directly.
     vsg::Logger::instance()->info("info2 cstring");
 
+    // the VSGLOG_* macros from LogMacros.h check the level before their arguments are evaluated, and are compiled out entirely below VSGLOG_MIN_LEVEL
+    VSGLOG_DEBUG("macro debug ", vsg::vec3(1.0f, 2.0f, 3.0f));
+    VSGLOG_INFO("macro info ", vsg::vec3(1.0f, 2.0f, 3.0f));
+
     // you can pass multiple fields to the info, these will be converted, in a thread safe way, to a string form by using Logger's internal ostringstream
     vsg::info("time ", 10, "ms, vector = (", vsg::vec3(10.0f, 20.0f, 30.0f), ")");
 
@@ -115,6 +125,83 @@ int main(int argc, char** argv)
         }
         auto tick6 = vsg::clock::now();
 
+        // filtered out messages, with an argument that is costly to evaluate. vsg::info(..) evaluates its arguments before
+        // the Logger checks the level, VSGLOG_INFO(..) checks the level first and VSGLOG_AT(..) removes the call at compile time.
+        vsg::Logger::instance() = vsg::StdLogger::create();
+        vsg::Logger::instance()->level = vsg::Logger::LOGGER_WARN;
+
+        auto filterTick1 = vsg::clock::now();
+        for(size_t i=0; i<count; ++i)
+        {
+            vsg::info("line number ", std::to_string(i));
+        }
+        auto filterTick2 = vsg::clock::now();
+        for(size_t i=0; i<count; ++i)
+        {
+            VSGLOG_INFO("line number ", std::to_string(i));
+        }
+        auto filterTick3 = vsg::clock::now();
+        for(size_t i=0; i<count; ++i)
+        {
+            VSGLOG_AT(vsg::Logger::LOGGER_WARN, vsg::Logger::LOGGER_INFO, "line number ", std::to_string(i));
+        }
+        auto filterTick4 = vsg::clock::now();
+
+        // compare the synchronous StdLogger with the AsyncLogger, first from the main thread and then with numThreads threads
+        // logging at the same time as in vsglog_mt.
+        auto logFromThreads = [&](auto logFunction) {
+            auto start = vsg::clock::now();
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < numThreads; ++t)
+            {
+                threads.emplace_back([&, t]() {
+                    for (size_t i = t; i < count; i += numThreads) logFunction(i);
+                });
+            }
+            for (auto& thread : threads) thread.join();
+            return std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+        };
+
+        auto asyncLogger = AsyncLogger::create(ringSize);
+        asyncLogger->level = level;
+        vsg::Logger::instance() = asyncLogger;
+
+        auto tick7 = vsg::clock::now();
+        for(size_t i=0; i<count; ++i)
+        {
+            vsg::info("line number ", i);
+        }
+        auto tick8 = vsg::clock::now();
+        asyncLogger->flush();
+        auto tick9 = vsg::clock::now();
+        for(size_t i=0; i<count; ++i)
+        {
+            asyncLogger->logBinary(vsg::Logger::LOGGER_INFO, "line number ", i);
+        }
+        auto tick10 = vsg::clock::now();
+        asyncLogger->flush();
+        auto tick11 = vsg::clock::now();
+        auto singleThreadDropped = asyncLogger->numDropped();
+
+        vsg::Logger::instance() = vsg::StdLogger::create();
+        vsg::Logger::instance()->level = level;
+        auto mtSyncTime = logFromThreads([](size_t i) { vsg::info("line number ", i); });
+
+        asyncLogger = AsyncLogger::create(ringSize);
+        asyncLogger->level = level;
+        vsg::Logger::instance() = asyncLogger;
+
+        auto mtAsyncTime = logFromThreads([](size_t i) { vsg::info("line number ", i); });
+        auto tick12 = vsg::clock::now();
+        asyncLogger->flush();
+        auto tick13 = vsg::clock::now();
+
+        auto mtBinaryTime = logFromThreads([&](size_t i) { asyncLogger->logBinary(vsg::Logger::LOGGER_INFO, "line number ", i); });
+        auto tick14 = vsg::clock::now();
+        asyncLogger->flush();
+        auto tick15 = vsg::clock::now();
+        auto multiThreadDropped = asyncLogger->numDropped();
+
         auto time1 = std::chrono::duration<double, std::chrono::milliseconds::period>(tick2 - tick1).count();
         auto time2 = std::chrono::duration<double, std::chrono::milliseconds::period>(tick3 - tick2).count();
         auto time3 = std::chrono::duration<double, std::chrono::milliseconds::period>(tick5 - tick4).count();
@@ -128,6 +215,19 @@ int main(int argc, char** argv)
         vsg::info("vsg::info(\"line number i\" time = ",time2,"ms");
         vsg::info("null vsg::info(\"simple\") time = ",time3,"ms");
         vsg::info("null vsg::info(\"line number i\" time = ",time4,"ms");
+
+        auto ms = [](const vsg::time_point& start, const vsg::time_point& end) { return std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count(); };
+
+        vsg::info("filtered vsg::info(\"line number \", std::to_string(i)) time = ", ms(filterTick1, filterTick2), "ms");
+        vsg::info("filtered VSGLOG_INFO(\"line number \", std::to_string(i)) time = ", ms(filterTick2, filterTick3), "ms");
+        vsg::info("compile time filtered VSGLOG_AT(LOGGER_WARN, LOGGER_INFO, \"line number \", std::to_string(i)) time = ", ms(filterTick3, filterTick4), "ms");
+        vsg::info("VSGLOG_MIN_LEVEL = ", VSGLOG_MIN_LEVEL);
+
+        vsg::info("async vsg::info(\"line number i\") time = ", ms(tick7, tick8), "ms, flush time = ", ms(tick8, tick9), "ms");
+        vsg::info("async logBinary(\"line number \", i) time = ", ms(tick9, tick10), "ms, flush time = ", ms(tick10, tick11), "ms, dropped = ", singleThreadDropped);
+        vsg::info(numThreads, " threads sync vsg::info(\"line number i\") time = ", mtSyncTime, "ms");
+        vsg::info(numThreads, " threads async vsg::info(\"line number i\") time = ", mtAsyncTime, "ms, flush time = ", ms(tick12, tick13), "ms");
+        vsg::info(numThreads, " threads async logBinary(\"line number \", i) time = ", mtBinaryTime, "ms, flush time = ", ms(tick14, tick15), "ms, dropped = ", multiThreadDropped);
     }
 
     return 0;
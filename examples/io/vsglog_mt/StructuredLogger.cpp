@@ -0,0 +1,126 @@
+#include "StructuredLogger.h"
+
+StructuredLogger::StructuredLogger(const vsg::Path& filename) :
+    _fout(filename.string(), std::ios::out | std::ios::binary),
+    _startTime(vsg::clock::now())
+{
+    _fout.write("VSGSLOG\0", 8);
+    write(version);
+}
+
+StructuredLogger::~StructuredLogger()
+{
+}
+
+uint32_t StructuredLogger::stringID(std::string_view str)
+{
+    if (auto itr = _strings.find(str); itr != _strings.end()) return itr->second;
+
+    uint32_t id = static_cast<uint32_t>(_strings.size());
+    _strings.emplace(std::string(str), id);
+
+    write('S');
+    write(id);
+    writeString(str);
+    return id;
+}
+
+void StructuredLogger::writeString(std::string_view str)
+{
+    write(static_cast<uint32_t>(str.size()));
+    _fout.write(str.data(), str.size());
+}
+
+uint32_t StructuredLogger::threadIndex(std::thread::id id)
+{
+    if (auto itr = _threads.find(id); itr != _threads.end()) return itr->second;
+
+    uint32_t index = static_cast<uint32_t>(_threads.size());
+    _threads[id] = index;
+    return index;
+}
+
+void StructuredLogger::setThreadName(std::thread::id id, std::string_view name)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    uint32_t index = threadIndex(id);
+    uint32_t nameID = stringID(name);
+
+    write('T');
+    write(index);
+    write(nameID);
+}
+
+void StructuredLogger::event(Level msg_level, std::string_view message, std::initializer_list<Field> fields)
+{
+    writeEvent(msg_level, message, true, fields);
+}
+
+void StructuredLogger::writeEvent(Level msg_level, std::string_view message, bool internMessage, std::initializer_list<Field> fields)
+{
+    if (msg_level < level) return;
+
+    uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(vsg::clock::now() - _startTime).count();
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    // strings must be in the table before the event that refers to them
+    uint32_t thread = threadIndex(std::this_thread::get_id());
+    uint32_t messageID = internMessage ? stringID(message) : inlineString;
+
+    std::vector<uint32_t> keyIDs;
+    for (auto& field : fields) keyIDs.push_back(stringID(field.key));
+
+    write('E');
+    write(timestamp);
+    write(thread);
+    write(static_cast<uint8_t>(msg_level));
+    write(messageID);
+    if (messageID == inlineString) writeString(message);
+    write(static_cast<uint8_t>(fields.size()));
+
+    size_t i = 0;
+    for (auto& field : fields)
+    {
+        write(keyIDs[i++]);
+        write(field.type);
+        switch (field.type)
+        {
+        case (FIELD_INT): write(field.i); break;
+        case (FIELD_UINT): write(field.u); break;
+        case (FIELD_DOUBLE): write(field.d); break;
+        case (FIELD_STRING): writeString(field.s); break;
+        }
+    }
+}
+
+void StructuredLogger::debug_implementation(const std::string_view& message)
+{
+    writeEvent(LOGGER_DEBUG, message, false, {});
+}
+
+void StructuredLogger::info_implementation(const std::string_view& message)
+{
+    writeEvent(LOGGER_INFO, message, false, {});
+}
+
+void StructuredLogger::warn_implementation(const std::string_view& message)
+{
+    writeEvent(LOGGER_WARN, message, false, {});
+}
+
+void StructuredLogger::error_implementation(const std::string_view& message)
+{
+    writeEvent(LOGGER_ERROR, message, false, {});
+}
+
+void StructuredLogger::fatal_implementation(const std::string_view& message)
+{
+    writeEvent(LOGGER_FATAL, message, false, {});
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _fout.flush();
+    }
+    throw vsg::Exception{std::string(message)};
+}
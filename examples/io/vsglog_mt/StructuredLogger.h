@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <fstream>
+#include <map>
+#include <thread>
+
+// StructuredLogger writes log messages to a compact binary file as events made up of a message name and typed key/value fields,
+// so that they can be filtered and aggregated offline with vsglogview rather than parsed from free form text.
+// Messages passed through the usual vsg::info(..) etc. are recorded as events with no fields.
+//
+// File format, all values little endian:
+//     header   "VSGSLOG\0" followed by uint32 version
+//     records  uint8 tag followed by the record
+//         'S'  string table entry  : uint32 id, uint32 length, chars
+//         'T'  thread name         : uint32 thread, uint32 name string id
+//         'E'  event               : uint64 timestamp in nanoseconds since the logger was created, uint32 thread, uint8 level,
+//                                    uint32 message string id, uint8 number of fields, then for each field
+//                                    uint32 key string id, uint8 type, value (8 byte int64, uint64 or double, or uint32 length and chars)
+//                                    a message string id of inlineString is followed by uint32 length and chars
+// Event names and field keys are written to the string table the first time they are used so each is only stored once,
+// while the free form text from vsg::info(..) etc. and string field values are written inline so the table stays bounded.
+class StructuredLogger : public vsg::Inherit<vsg::Logger, StructuredLogger>
+{
+public:
+    explicit StructuredLogger(const vsg::Path& filename);
+
+    static constexpr uint32_t version = 2;
+    static constexpr uint32_t inlineString = 0xffffffff;
+
+    enum FieldType : uint8_t
+    {
+        FIELD_INT = 0,
+        FIELD_UINT = 1,
+        FIELD_DOUBLE = 2,
+        FIELD_STRING = 3
+    };
+
+    struct Field
+    {
+        Field(std::string_view in_key, int32_t value) :
+            key(in_key), type(FIELD_INT), i(value) {}
+        Field(std::string_view in_key, int64_t value) :
+            key(in_key), type(FIELD_INT), i(value) {}
+        Field(std::string_view in_key, uint32_t value) :
+            key(in_key), type(FIELD_UINT), u(value) {}
+        Field(std::string_view in_key, uint64_t value) :
+            key(in_key), type(FIELD_UINT), u(value) {}
+        Field(std::string_view in_key, double value) :
+            key(in_key), type(FIELD_DOUBLE), d(value) {}
+        Field(std::string_view in_key, std::string_view value) :
+            key(in_key), type(FIELD_STRING), s(value) {}
+        Field(std::string_view in_key, const char* value) :
+            key(in_key), type(FIELD_STRING), s(value) {}
+
+        std::string_view key;
+        FieldType type;
+        int64_t i = 0;
+        uint64_t u = 0;
+        double d = 0.0;
+        std::string_view s;
+    };
+
+    // record an event, i.e. logger->event(vsg::Logger::LOGGER_INFO, "frame", {{"frame", frameCount}, {"cpu_ms", time}})
+    void event(Level msg_level, std::string_view message, std::initializer_list<Field> fields = {});
+
+    // name the thread in the log, equivalent to ThreadLogger::setThreadPrefix()
+    void setThreadName(std::thread::id id, std::string_view name);
+
+    bool valid() const { return _fout.good(); }
+
+protected:
+    virtual ~StructuredLogger();
+
+    void debug_implementation(const std::string_view& message) override;
+    void info_implementation(const std::string_view& message) override;
+    void warn_implementation(const std::string_view& message) override;
+    void error_implementation(const std::string_view& message) override;
+    void fatal_implementation(const std::string_view& message) override;
+
+    void writeEvent(Level msg_level, std::string_view message, bool internMessage, std::initializer_list<Field> fields);
+
+    // the following must be called with _mutex held
+    uint32_t stringID(std::string_view str);
+    void writeString(std::string_view str);
+    uint32_t threadIndex(std::thread::id id);
+
+    template<typename T>
+    void write(T value)
+    {
+        _fout.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    std::mutex _mutex;
+    std::ofstream _fout;
+    vsg::time_point _startTime;
+    std::map<std::string, uint32_t, std::less<>> _strings;
+    std::map<std::thread::id, uint32_t> _threads;
+};
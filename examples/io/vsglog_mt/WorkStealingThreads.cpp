@@ -0,0 +1,159 @@
+#include "WorkStealingThreads.h"
+
+namespace
+{
+    // identifies the pool and worker that the current thread belongs to so add() and take() can use the worker's own deque
+    thread_local const WorkStealingThreads* s_pool = nullptr;
+    thread_local uint32_t s_workerIndex = 0;
+} // namespace
+
+WorkStealingThreads::WorkStealingThreads(uint32_t numThreads, vsg::ref_ptr<vsg::ActivityStatus> in_status) :
+    status(in_status ? in_status : vsg::ActivityStatus::create())
+{
+    numThreads = std::max(numThreads, 1u);
+
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        _workers.emplace_back(new Worker);
+    }
+
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        threads.emplace_back([this, i]() { run(i); });
+    }
+}
+
+WorkStealingThreads::~WorkStealingThreads()
+{
+    stop();
+}
+
+void WorkStealingThreads::add(vsg::ref_ptr<vsg::Operation> operation)
+{
+    if (!operation) return;
+
+    uint32_t workerIndex = (s_pool == this) ? s_workerIndex : (_nextWorker.fetch_add(1) % static_cast<uint32_t>(_workers.size()));
+
+    auto& worker = *_workers[workerIndex];
+    {
+        std::scoped_lock<std::mutex> lock(worker.mutex);
+        worker.operations.push_back(operation);
+    }
+
+    // a sleeping worker increments _numSleeping before checking _numPending, so it either sees this operation or we see it sleeping
+    _numPending.fetch_add(1);
+    if (_numSleeping.load() > 0)
+    {
+        std::scoped_lock<std::mutex> lock(_sleepMutex);
+        _operationAvailable.notify_one();
+    }
+}
+
+vsg::ref_ptr<vsg::Operation> WorkStealingThreads::pop(uint32_t workerIndex)
+{
+    auto& worker = *_workers[workerIndex];
+    std::scoped_lock<std::mutex> lock(worker.mutex);
+    if (worker.operations.empty()) return {};
+
+    auto operation = std::move(worker.operations.back());
+    worker.operations.pop_back();
+    _numPending.fetch_sub(1);
+    return operation;
+}
+
+vsg::ref_ptr<vsg::Operation> WorkStealingThreads::steal(uint32_t startIndex)
+{
+    uint32_t numWorkers = static_cast<uint32_t>(_workers.size());
+    for (uint32_t i = 0; i < numWorkers; ++i)
+    {
+        auto& worker = *_workers[(startIndex + i) % numWorkers];
+
+        // don't wait on a worker that is busy with its own deque, move on to the next one
+        std::unique_lock<std::mutex> lock(worker.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || worker.operations.empty()) continue;
+
+        auto operation = std::move(worker.operations.front());
+        worker.operations.pop_front();
+        _numPending.fetch_sub(1);
+        ++numStolen;
+        return operation;
+    }
+    return {};
+}
+
+vsg::ref_ptr<vsg::Operation> WorkStealingThreads::take()
+{
+    if (s_pool == this)
+    {
+        if (auto operation = pop(s_workerIndex)) return operation;
+        return steal(s_workerIndex + 1);
+    }
+
+    // try_lock in steal() can miss operations on a contended deque, so keep trying while any are pending
+    while (_numPending.load() > 0)
+    {
+        if (auto operation = steal(_nextWorker.load())) return operation;
+        std::this_thread::yield();
+    }
+    return {};
+}
+
+vsg::ref_ptr<vsg::Operation> WorkStealingThreads::take_when_available()
+{
+    while (status->active())
+    {
+        if (auto operation = take()) return operation;
+
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        ++_numSleeping;
+        _operationAvailable.wait(lock, [&]() { return _numPending.load() > 0 || !status->active(); });
+        --_numSleeping;
+    }
+    return {};
+}
+
+void WorkStealingThreads::setAffinity(const vsg::Affinity& affinity)
+{
+    if (affinity.cpus.empty()) return;
+
+    std::vector<uint32_t> cpus(affinity.cpus.begin(), affinity.cpus.end());
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        vsg::Affinity workerAffinity;
+        workerAffinity.cpus.insert(cpus[i % cpus.size()]);
+        vsg::setAffinity(threads[i], workerAffinity);
+    }
+}
+
+void WorkStealingThreads::stop()
+{
+    {
+        std::scoped_lock<std::mutex> lock(_sleepMutex);
+        status->set(false);
+    }
+    _operationAvailable.notify_all();
+
+    for (auto& thread : threads)
+    {
+        if (thread.joinable()) thread.join();
+    }
+    threads.clear();
+
+    for (auto& worker : _workers)
+    {
+        std::scoped_lock<std::mutex> lock(worker->mutex);
+        _numPending.fetch_sub(worker->operations.size());
+        worker->operations.clear();
+    }
+}
+
+void WorkStealingThreads::run(uint32_t workerIndex)
+{
+    s_pool = this;
+    s_workerIndex = workerIndex;
+
+    while (status->active())
+    {
+        if (auto operation = take_when_available()) operation->run();
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+// WorkStealingThreads is an alternative to vsg::OperationThreads where each worker thread has its own deque of operations
+// rather than all threads contending on a single OperationQueue mutex. Workers run operations from the back of their own deque
+// and when it's empty steal from the front of the other workers' deques. Operations added from a worker thread go onto that
+// worker's deque, operations added from other threads are distributed round robin across the workers.
+//
+// add(), take() and take_when_available() match the OperationQueue methods so the main thread can help process operations.
+class WorkStealingThreads : public vsg::Inherit<vsg::Object, WorkStealingThreads>
+{
+public:
+    WorkStealingThreads(uint32_t numThreads, vsg::ref_ptr<vsg::ActivityStatus> in_status = {});
+
+    std::vector<std::thread> threads;
+    vsg::ref_ptr<vsg::ActivityStatus> status;
+
+    // add an operation. Thread safe.
+    void add(vsg::ref_ptr<vsg::Operation> operation);
+
+    // take an operation if one is available, returns a null ref_ptr otherwise. Thread safe.
+    vsg::ref_ptr<vsg::Operation> take();
+
+    // wait until an operation is available or the threads are stopped. Thread safe.
+    vsg::ref_ptr<vsg::Operation> take_when_available();
+
+    // hint which CPUs to run on, worker i is pinned to the i'th CPU in affinity.cpus, wrapping round if there are more workers than CPUs.
+    void setAffinity(const vsg::Affinity& affinity);
+
+    // stop and join the worker threads, operations still queued are discarded
+    void stop();
+
+    size_t size() const { return _numPending.load(); }
+
+    // number of operations taken from another worker's deque or by a non worker thread
+    std::atomic_uint64_t numStolen{0};
+
+protected:
+    virtual ~WorkStealingThreads();
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<vsg::ref_ptr<vsg::Operation>> operations;
+    };
+
+    vsg::ref_ptr<vsg::Operation> pop(uint32_t workerIndex);
+    vsg::ref_ptr<vsg::Operation> steal(uint32_t startIndex);
+    void run(uint32_t workerIndex);
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic_size_t _numPending{0};
+    std::atomic_uint32_t _nextWorker{0};
+
+    std::mutex _sleepMutex;
+    std::condition_variable _operationAvailable;
+    std::atomic_uint32_t _numSleeping{0};
+};
@@ -1,7 +1,12 @@
 #include <vsg/all.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 
+#include "StructuredLogger.h"
+#include "WorkStealingThreads.h"
+
 struct MyOperation : public vsg::Inherit<vsg::Operation, MyOperation>
 {
     uint32_t value = 0;
@@ -9,12 +14,120 @@ struct MyOperation : public vsg::Inherit<vsg::Operation, MyOperation>
 
     void run() override
     {
+        auto start = vsg::clock::now();
+
         auto level = vsg::Logger::Level(1 + value % 4);
         vsg::info("info() operation ",value);
         vsg::log(level, "log() operation ",value);
+
+        // when using the StructuredLogger also record an event with typed fields that vsglogview can filter and aggregate
+        if (auto structuredLogger = vsg::Logger::instance().cast<StructuredLogger>())
+        {
+            double duration = std::chrono::duration<double, std::chrono::microseconds::period>(vsg::clock::now() - start).count();
+            structuredLogger->event(vsg::Logger::LOGGER_INFO, "operation", {{"value", value}, {"level", static_cast<uint32_t>(level)}, {"duration_us", duration}});
+        }
+    }
+};
+
+// trivial operation used to measure the overhead of the operation queues, records the time from add() to run()
+struct TimedOperation : public vsg::Inherit<vsg::Operation, TimedOperation>
+{
+    vsg::time_point added;
+    double* latency;
+    std::atomic_size_t& numCompleted;
+
+    TimedOperation(double* in_latency, std::atomic_size_t& in_numCompleted) :
+        added(vsg::clock::now()), latency(in_latency), numCompleted(in_numCompleted) {}
+
+    void run() override
+    {
+        *latency = std::chrono::duration<double, std::chrono::microseconds::period>(vsg::clock::now() - added).count();
+        ++numCompleted;
     }
 };
 
+struct BenchmarkResult
+{
+    double time = 0.0; // milliseconds
+    double p50 = 0.0;  // microseconds
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+// add count operations then have the main thread help process them, in the same way as the main processing loop below
+template<class Threads, typename Add, typename Take>
+BenchmarkResult benchmark(vsg::ref_ptr<Threads> threads, size_t count, Add add, Take take)
+{
+    std::vector<double> latencies(count, 0.0);
+    std::atomic_size_t numCompleted{0};
+
+    auto start = vsg::clock::now();
+    for (size_t i = 0; i < count; ++i)
+    {
+        add(threads, TimedOperation::create(&latencies[i], numCompleted));
+    }
+
+    while (auto op = take(threads))
+    {
+        op->run();
+    }
+
+    while (numCompleted.load() < count)
+    {
+        std::this_thread::yield();
+    }
+
+    BenchmarkResult result;
+    result.time = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    if (!latencies.empty())
+    {
+        result.p50 = latencies[latencies.size() / 2];
+        result.p99 = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+        result.max = latencies.back();
+    }
+    return result;
+}
+
+int runBenchmark(size_t count, uint32_t maxThreads, const vsg::Affinity& affinity)
+{
+    vsg::Logger::instance()->level = vsg::Logger::LOGGER_INFO;
+    vsg::info("Benchmarking ", count, " operations, times in ms, latencies from add() to run() in us.");
+    vsg::info("threads, OperationThreads time, ops/s, p50, p99, max, WorkStealingThreads time, ops/s, p50, p99, max, stolen");
+
+    auto ops_per_second = [&](double time) { return time > 0.0 ? double(count) * 1000.0 / time : 0.0; };
+
+    for (uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    {
+        auto operationThreads = vsg::OperationThreads::create(numThreads);
+        if (affinity) operationThreads->setAffinity(affinity);
+
+        auto shared = benchmark(
+            operationThreads, count,
+            [](auto& threads, vsg::ref_ptr<vsg::Operation> op) { threads->add(op); },
+            [](auto& threads) { return threads->queue->take(); });
+
+        operationThreads = {};
+
+        auto workStealingThreads = WorkStealingThreads::create(numThreads);
+        if (affinity) workStealingThreads->setAffinity(affinity);
+
+        auto stealing = benchmark(
+            workStealingThreads, count,
+            [](auto& threads, vsg::ref_ptr<vsg::Operation> op) { threads->add(op); },
+            [](auto& threads) { return threads->take(); });
+
+        auto numStolen = workStealingThreads->numStolen.load();
+        workStealingThreads = {};
+
+        vsg::info(numThreads, ", ", shared.time, ", ", ops_per_second(shared.time), ", ", shared.p50, ", ", shared.p99, ", ", shared.max, ", ",
+                  stealing.time, ", ", ops_per_second(stealing.time), ", ", stealing.p50, ", ", stealing.p99, ", ", stealing.max, ", ", numStolen);
+    }
+
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     // assign our custom ThreadLogger
@@ -25,23 +138,65 @@ int main(int argc, char** argv)
     mt_logger->setThreadPrefix(std::this_thread::get_id(), "main | ");
 
     vsg::CommandLine arguments(&argc, argv);
+    auto benchmarkQueues = arguments.read("--benchmark");
     auto numThreads = arguments.value<size_t>(16, "-t");
-    auto count = arguments.value<size_t>(100, "-n");
+    auto count = arguments.value<size_t>(benchmarkQueues ? 1000000 : 100, "-n");
     auto level = vsg::Logger::Level(arguments.value(0, "-l"));
     auto defaultThreadPrefix = arguments.read({"-d", "--default"});
+    auto workStealing = arguments.read({"-w", "--work-stealing"});
+    auto maxThreads = arguments.value<uint32_t>(64, "--max-threads");
+
+    // optionally replace the ThreadLogger with a StructuredLogger that writes a binary log for viewing with vsglogview
+    vsg::ref_ptr<StructuredLogger> structuredLogger;
+    if (vsg::Path structuredFilename; arguments.read("--structured", structuredFilename))
+    {
+        structuredLogger = StructuredLogger::create(structuredFilename);
+        if (!structuredLogger->valid())
+        {
+            std::cout << "Unable to open " << structuredFilename << " for writing." << std::endl;
+            return 1;
+        }
+
+        structuredLogger->setThreadName(std::this_thread::get_id(), "main");
+        vsg::Logger::instance() = structuredLogger;
+    }
+
+    // optionally pin the threads to the first numCPUs cores, work stealing threads are pinned one per core
+    vsg::Affinity affinity;
+    if (uint32_t numCPUs = 0; arguments.read("--affinity", numCPUs))
+    {
+        for (uint32_t cpu = 0; cpu < numCPUs; ++cpu) affinity.cpus.insert(cpu);
+    }
+
+    if (benchmarkQueues) return runBenchmark(count, maxThreads, affinity);
 
     // default to logger level 0 to print all messages, but allow command line to override.
     vsg::Logger::instance()->level = level;
 
-    auto operationThreads = vsg::OperationThreads::create(numThreads);
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+    vsg::ref_ptr<WorkStealingThreads> workStealingThreads;
+    if (workStealing)
+    {
+        workStealingThreads = WorkStealingThreads::create(static_cast<uint32_t>(numThreads));
+        if (affinity) workStealingThreads->setAffinity(affinity);
+    }
+    else
+    {
+        operationThreads = vsg::OperationThreads::create(numThreads);
+        if (affinity) operationThreads->setAffinity(affinity);
+    }
+
+    auto& threads = workStealingThreads ? workStealingThreads->threads : operationThreads->threads;
 
     if (!defaultThreadPrefix)
     {
         uint32_t threadNum = 0;
-        for(auto& thread : operationThreads->threads)
+        for(auto& thread : threads)
         {
-            auto prefix = vsg::make_string("thread ", threadNum++, " | ");
+            auto name = vsg::make_string("thread ", threadNum++);
+            auto prefix = name + " | ";
             mt_logger->setThreadPrefix(thread.get_id(), prefix);
+            if (structuredLogger) structuredLogger->setThreadName(thread.get_id(), name);
             vsg::info("set thread prefix for thread::id = ", thread.get_id(), " to ", prefix);
         }
     }
@@ -53,13 +208,14 @@ int main(int argc, char** argv)
     // so by the end this loop many will already have been processed.
     for(size_t i=0; i<count; ++i)
     {
-        operationThreads->add(MyOperation::create(i));
+        if (workStealingThreads) workStealingThreads->add(MyOperation::create(i));
+        else operationThreads->add(MyOperation::create(i));
     }
 
     // have the main thread get and run operations from the OperationThreads queue of operations
 
     vsg::info("Starting to process operations.");
-    while(auto op = operationThreads->queue->take())
+    while(auto op = workStealingThreads ? workStealingThreads->take() : operationThreads->queue->take())
     {
         op->run();
     }
@@ -67,6 +223,7 @@ int main(int argc, char** argv)
 
     // destroy the threads, some operations may still be running so these will complete before destruction is allowed to complete
     operationThreads = {};
+    workStealingThreads = {};
 
     vsg::info("OperationThreads destroyed.");
 
@@ -0,0 +1,371 @@
+#include <vsg/all.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+
+// reader for the binary structured log written by the StructuredLogger in vsglog_mt, see StructuredLogger.h for the file format.
+
+enum FieldType : uint8_t
+{
+    FIELD_INT = 0,
+    FIELD_UINT = 1,
+    FIELD_DOUBLE = 2,
+    FIELD_STRING = 3
+};
+
+struct Field
+{
+    uint32_t key = 0;
+    FieldType type = FIELD_INT;
+    union
+    {
+        int64_t i;
+        uint64_t u = 0;
+        double d;
+    };
+
+    bool numeric() const { return type != FIELD_STRING; }
+
+    double asDouble() const
+    {
+        switch (type)
+        {
+        case (FIELD_INT): return static_cast<double>(i);
+        case (FIELD_UINT): return static_cast<double>(u);
+        case (FIELD_DOUBLE): return d;
+        default: return 0.0;
+        }
+    }
+};
+
+struct Event
+{
+    uint64_t timestamp = 0;
+    uint32_t thread = 0;
+    uint8_t level = 0;
+    uint32_t message = 0;
+    std::vector<Field> fields;
+
+    double time() const { return static_cast<double>(timestamp) * 1e-6; } // milliseconds
+};
+
+// string ids with the top bit set index the messages and string values written inline rather than the string table
+static constexpr uint32_t inlineString = 0xffffffff;
+static constexpr uint32_t inlineBit = 0x80000000;
+
+struct StructuredLog
+{
+    std::vector<std::string> strings;
+    std::vector<std::string> inlineStrings;
+    std::map<uint32_t, uint32_t> threadNames;
+    std::vector<Event> events;
+
+    const std::string& string(uint32_t id) const
+    {
+        static const std::string empty;
+        if (id & inlineBit) return (id & ~inlineBit) < inlineStrings.size() ? inlineStrings[id & ~inlineBit] : empty;
+        return id < strings.size() ? strings[id] : empty;
+    }
+
+    std::string threadName(uint32_t thread) const
+    {
+        if (auto itr = threadNames.find(thread); itr != threadNames.end()) return string(itr->second);
+        return vsg::make_string("thread ", thread);
+    }
+
+    std::string value(const Field& field) const
+    {
+        switch (field.type)
+        {
+        case (FIELD_INT): return std::to_string(field.i);
+        case (FIELD_UINT): return std::to_string(field.u);
+        case (FIELD_DOUBLE): return vsg::make_string(field.d);
+        case (FIELD_STRING): return string(static_cast<uint32_t>(field.u));
+        }
+        return {};
+    }
+
+    bool read(const vsg::Path& filename)
+    {
+        std::ifstream fin(filename.string(), std::ios::in | std::ios::binary);
+        if (!fin) return false;
+
+        char signature[8];
+        uint32_t version = 0;
+        fin.read(signature, 8);
+        fin.read(reinterpret_cast<char*>(&version), sizeof(version));
+        if (!fin || std::string(signature, 7) != "VSGSLOG" || version != 2)
+        {
+            std::cout << filename << " is not a supported structured log file." << std::endl;
+            return false;
+        }
+
+        auto read = [&fin](auto& value) { return static_cast<bool>(fin.read(reinterpret_cast<char*>(&value), sizeof(value))); };
+        auto readInline = [&](uint32_t& id) {
+            uint32_t length = 0;
+            if (!read(length)) return false;
+            std::string str(length, '\0');
+            if (!fin.read(str.data(), length)) return false;
+            id = inlineBit | static_cast<uint32_t>(inlineStrings.size());
+            inlineStrings.push_back(std::move(str));
+            return true;
+        };
+
+        char tag = 0;
+        while (read(tag))
+        {
+            bool complete = false;
+            if (tag == 'S')
+            {
+                uint32_t id = 0, length = 0;
+                if (read(id) && read(length))
+                {
+                    std::string str(length, '\0');
+                    if (fin.read(str.data(), length))
+                    {
+                        if (id >= strings.size()) strings.resize(id + 1);
+                        strings[id] = std::move(str);
+                        complete = true;
+                    }
+                }
+            }
+            else if (tag == 'T')
+            {
+                uint32_t thread = 0, name = 0;
+                if (read(thread) && read(name))
+                {
+                    threadNames[thread] = name;
+                    complete = true;
+                }
+            }
+            else if (tag == 'E')
+            {
+                Event event;
+                uint8_t numFields = 0;
+                if (read(event.timestamp) && read(event.thread) && read(event.level) && read(event.message) &&
+                    (event.message != inlineString || readInline(event.message)) && read(numFields))
+                {
+                    complete = true;
+                    for (uint8_t f = 0; f < numFields && complete; ++f)
+                    {
+                        Field field;
+                        complete = read(field.key) && read(field.type);
+                        if (complete && field.type == FIELD_STRING)
+                        {
+                            uint32_t id = 0;
+                            complete = readInline(id);
+                            field.u = id;
+                        }
+                        else if (complete)
+                        {
+                            complete = read(field.u);
+                        }
+                        event.fields.push_back(field);
+                    }
+                    if (complete) events.push_back(std::move(event));
+                }
+            }
+            else
+            {
+                std::cout << "Unknown record type '" << tag << "' in " << filename << ", stopping." << std::endl;
+                break;
+            }
+
+            // a log from an application that didn't exit cleanly may end part way through a record
+            if (!complete)
+            {
+                std::cout << "Warning: " << filename << " is truncated." << std::endl;
+                break;
+            }
+        }
+
+        // order events from different threads by time
+        std::stable_sort(events.begin(), events.end(), [](const Event& lhs, const Event& rhs) { return lhs.timestamp < rhs.timestamp; });
+        return true;
+    }
+};
+
+std::string escapeJSON(const std::string& str)
+{
+    std::string result;
+    for (auto c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            result.push_back('\\');
+            result.push_back(c);
+        }
+        else if (c == '\n')
+            result += "\\n";
+        else if (static_cast<unsigned char>(c) < 0x20)
+            result.push_back(' ');
+        else
+            result.push_back(c);
+    }
+    return result;
+}
+
+std::string escapeCSV(const std::string& str)
+{
+    if (str.find_first_of(",\"\n") == std::string::npos) return str;
+
+    std::string result = "\"";
+    for (auto c : str)
+    {
+        if (c == '"') result.push_back('"');
+        result.push_back(c);
+    }
+    result.push_back('"');
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    vsg::CommandLine arguments(&argc, argv);
+
+    if (arguments.read({"--help", "-h"}) || argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " file.vsglog [options]\n"
+                  << "    --message name       only include events with this message\n"
+                  << "    --thread name        only include events from this thread\n"
+                  << "    --level n            only include events at or above this vsg::Logger::Level\n"
+                  << "    --from ms --to ms    only include events in this time range\n"
+                  << "    --csv file.csv       write the events with a column per field\n"
+                  << "    --json file.json     write the events as an array of objects\n"
+                  << "    --aggregate key      print count, min, mean, p50, p99, max and sum of a numeric field per message\n"
+                  << "    --summary            print the number of events per message and thread\n";
+        return argc < 2 ? 1 : 0;
+    }
+
+    auto messageFilter = arguments.value(std::string(), "--message");
+    auto threadFilter = arguments.value(std::string(), "--thread");
+    auto minLevel = arguments.value<uint32_t>(0, "--level");
+    auto fromTime = arguments.value(0.0, "--from");
+    auto toTime = arguments.value(std::numeric_limits<double>::max(), "--to");
+    auto csvFilename = arguments.value(vsg::Path(), "--csv");
+    auto jsonFilename = arguments.value(vsg::Path(), "--json");
+    auto aggregateKey = arguments.value(std::string(), "--aggregate");
+    auto summary = arguments.read("--summary");
+
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+    StructuredLog log;
+    if (!log.read(argv[1])) return 1;
+
+    std::vector<const Event*> events;
+    for (auto& event : log.events)
+    {
+        if (!messageFilter.empty() && log.string(event.message) != messageFilter) continue;
+        if (!threadFilter.empty() && log.threadName(event.thread) != threadFilter) continue;
+        if (event.level < minLevel || event.time() < fromTime || event.time() > toTime) continue;
+        events.push_back(&event);
+    }
+
+    std::cout << "Read " << log.events.size() << " events from " << argv[1] << ", " << events.size() << " match the filters." << std::endl;
+
+    // field keys in the order they first appear
+    std::vector<uint32_t> keys;
+    for (auto event : events)
+    {
+        for (auto& field : event->fields)
+        {
+            if (std::find(keys.begin(), keys.end(), field.key) == keys.end()) keys.push_back(field.key);
+        }
+    }
+
+    if (csvFilename)
+    {
+        std::ofstream fout(csvFilename.string());
+        fout << "time_ms,thread,level,message";
+        for (auto key : keys) fout << "," << escapeCSV(log.string(key));
+        fout << "\n";
+
+        for (auto event : events)
+        {
+            fout << event->time() << "," << escapeCSV(log.threadName(event->thread)) << "," << uint32_t(event->level) << "," << escapeCSV(log.string(event->message));
+            for (auto key : keys)
+            {
+                fout << ",";
+                for (auto& field : event->fields)
+                {
+                    if (field.key == key) fout << escapeCSV(log.value(field));
+                }
+            }
+            fout << "\n";
+        }
+        std::cout << "Written " << csvFilename << std::endl;
+    }
+
+    if (jsonFilename)
+    {
+        std::ofstream fout(jsonFilename.string());
+        fout << "[\n";
+        for (size_t i = 0; i < events.size(); ++i)
+        {
+            auto event = events[i];
+            fout << "  {\"time_ms\": " << event->time() << ", \"thread\": \"" << escapeJSON(log.threadName(event->thread)) << "\", \"level\": " << uint32_t(event->level)
+                 << ", \"message\": \"" << escapeJSON(log.string(event->message)) << "\"";
+            for (auto& field : event->fields)
+            {
+                fout << ", \"" << escapeJSON(log.string(field.key)) << "\": ";
+                if (field.type == FIELD_DOUBLE && !std::isfinite(field.d))
+                    fout << "null"; // NaN and inf have no JSON representation
+                else if (field.numeric())
+                    fout << log.value(field);
+                else
+                    fout << "\"" << escapeJSON(log.value(field)) << "\"";
+            }
+            fout << ((i + 1 < events.size()) ? "},\n" : "}\n");
+        }
+        fout << "]\n";
+        std::cout << "Written " << jsonFilename << std::endl;
+    }
+
+    if (!aggregateKey.empty())
+    {
+        std::map<std::string, std::vector<double>> values;
+        for (auto event : events)
+        {
+            for (auto& field : event->fields)
+            {
+                if (field.numeric() && log.string(field.key) == aggregateKey) values[log.string(event->message)].push_back(field.asDouble());
+            }
+        }
+
+        std::cout << "message, count, min, mean, p50, p99, max, sum of " << aggregateKey << std::endl;
+        for (auto& [message, samples] : values)
+        {
+            std::sort(samples.begin(), samples.end());
+            double sum = 0.0;
+            for (auto value : samples) sum += value;
+            std::cout << message << ", " << samples.size() << ", " << samples.front() << ", " << sum / double(samples.size()) << ", " << samples[samples.size() / 2] << ", "
+                      << samples[std::min(samples.size() - 1, samples.size() * 99 / 100)] << ", " << samples.back() << ", " << sum << std::endl;
+        }
+    }
+
+    if (summary)
+    {
+        std::map<std::pair<std::string, std::string>, size_t> counts;
+        for (auto event : events) ++counts[{log.string(event->message), log.threadName(event->thread)}];
+
+        std::cout << "message, thread, count" << std::endl;
+        for (auto& [key, count] : counts) std::cout << key.first << ", " << key.second << ", " << count << std::endl;
+    }
+
+    // with no other output requested print the events
+    if (!csvFilename && !jsonFilename && aggregateKey.empty() && !summary)
+    {
+        for (auto event : events)
+        {
+            std::cout << event->time() << "ms " << log.threadName(event->thread) << " | " << log.string(event->message);
+            for (auto& field : event->fields) std::cout << " " << log.string(field.key) << "=" << log.value(field);
+            std::cout << "\n";
+        }
+    }
+
+    return 0;
+}
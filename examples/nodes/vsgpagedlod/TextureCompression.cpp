@@ -0,0 +1,414 @@
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    bool isSRGB(VkFormat format)
+    {
+        return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8_SRGB;
+    }
+
+    uint32_t numComponents(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB: return 4;
+        case VK_FORMAT_R8G8B8_UNORM:
+        case VK_FORMAT_R8G8B8_SRGB: return 3;
+        default: return 0;
+        }
+    }
+
+    bool isSRGBBlockFormat(VkFormat format)
+    {
+        return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK;
+    }
+
+    // convert the RGB channels between the sRGB and linear encodings, alpha is always linear
+    void convertColorSpace(vsg::ubvec4* texels, size_t count, bool toSRGB)
+    {
+        static const auto tables = []() {
+            std::array<std::array<uint8_t, 256>, 2> t;
+            for (int i = 0; i < 256; ++i)
+            {
+                float v = static_cast<float>(i) / 255.0f;
+                float linear = (v <= 0.04045f) ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+                float srgb = (v <= 0.0031308f) ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+                t[0][i] = static_cast<uint8_t>(std::lround(linear * 255.0f));
+                t[1][i] = static_cast<uint8_t>(std::lround(srgb * 255.0f));
+            }
+            return t;
+        }();
+
+        auto& table = tables[toSRGB ? 1 : 0];
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (int c = 0; c < 3; ++c) texels[i][c] = table[texels[i][c]];
+        }
+    }
+
+    uint32_t numMipmapLevels(uint32_t width, uint32_t height, uint32_t maxNumMipmaps)
+    {
+        uint32_t numLevels = 1;
+        while (numLevels < maxNumMipmaps && (width >> numLevels) >= 4 && (height >> numLevels) >= 4 && ((width >> numLevels) % 4) == 0 && ((height >> numLevels) % 4) == 0) ++numLevels;
+        return numLevels;
+    }
+
+    using Block = std::array<vsg::ubvec4, 16>;
+
+    // read 4x4 texels starting at x,y from a tightly packed RGBA level
+    void readBlock(const vsg::ubvec4* level, uint32_t width, uint32_t x, uint32_t y, Block& block)
+    {
+        for (uint32_t r = 0; r < 4; ++r)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                block[r * 4 + c] = level[(y + r) * width + (x + c)];
+            }
+        }
+    }
+
+    int colorDistance(const vsg::ubvec4& lhs, const int* rhs)
+    {
+        int dr = int(lhs.r) - rhs[0];
+        int dg = int(lhs.g) - rhs[1];
+        int db = int(lhs.b) - rhs[2];
+        return dr * dr + dg * dg + db * db;
+    }
+
+    //
+    // BC1, using the bounding box endpoint selection with inset described by J.M.P. van Waveren in "Real-Time DXT Compression"
+    //
+    uint16_t packRGB565(int r, int g, int b)
+    {
+        return static_cast<uint16_t>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+    }
+
+    void unpackRGB565(uint16_t c, int* rgb)
+    {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    void encodeBC1(const Block& block, uint8_t* dest)
+    {
+        int minColor[3] = {255, 255, 255};
+        int maxColor[3] = {0, 0, 0};
+        for (auto& texel : block)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                minColor[i] = std::min(minColor[i], int(texel[i]));
+                maxColor[i] = std::max(maxColor[i], int(texel[i]));
+            }
+        }
+
+        // inset the bounding box by 1/16th of its size to reduce the error on the endpoints
+        for (int i = 0; i < 3; ++i)
+        {
+            int inset = (maxColor[i] - minColor[i]) >> 4;
+            minColor[i] = std::min(minColor[i] + inset, 255);
+            maxColor[i] = std::max(maxColor[i] - inset, 0);
+        }
+
+        uint16_t c0 = packRGB565(maxColor[0], maxColor[1], maxColor[2]);
+        uint16_t c1 = packRGB565(minColor[0], minColor[1], minColor[2]);
+
+        uint32_t indices = 0;
+        if (c0 != c1)
+        {
+            // c0 > c1 selects the four color mode
+            if (c0 < c1) std::swap(c0, c1);
+
+            int palette[4][3];
+            unpackRGB565(c0, palette[0]);
+            unpackRGB565(c1, palette[1]);
+            for (int i = 0; i < 3; ++i)
+            {
+                palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+                palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+            }
+
+            for (uint32_t t = 0; t < 16; ++t)
+            {
+                uint32_t bestIndex = 0;
+                int bestDistance = colorDistance(block[t], palette[0]);
+                for (uint32_t p = 1; p < 4; ++p)
+                {
+                    int distance = colorDistance(block[t], palette[p]);
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        bestIndex = p;
+                    }
+                }
+                indices |= bestIndex << (t * 2);
+            }
+        }
+
+        dest[0] = static_cast<uint8_t>(c0 & 0xff);
+        dest[1] = static_cast<uint8_t>(c0 >> 8);
+        dest[2] = static_cast<uint8_t>(c1 & 0xff);
+        dest[3] = static_cast<uint8_t>(c1 >> 8);
+        for (int i = 0; i < 4; ++i) dest[4 + i] = static_cast<uint8_t>((indices >> (i * 8)) & 0xff);
+    }
+
+    //
+    // ETC2 RGB, encoded using the ETC1 compatible individual mode which all ETC2 decoders support.
+    //
+    const int etcModifierTable[8][2] = {{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+    struct SubBlockResult
+    {
+        int base[3];
+        uint32_t table = 0;
+        uint32_t selectors[8];
+        int error = 0;
+    };
+
+    // texels are passed in as the 8 indices into the 4x4 block that make up the sub block
+    SubBlockResult encodeETCSubBlock(const Block& block, const uint32_t* texels)
+    {
+        SubBlockResult result;
+
+        int sum[3] = {0, 0, 0};
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            for (int c = 0; c < 3; ++c) sum[c] += block[texels[i]][c];
+        }
+
+        // quantize the average to 4 bits per component, then expand back to 8 bits the same way the decoder will
+        int expanded[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            result.base[c] = std::min(15, (sum[c] * 15 + 8 * 255 / 2) / (8 * 255));
+            expanded[c] = (result.base[c] << 4) | result.base[c];
+        }
+
+        result.error = std::numeric_limits<int>::max();
+        for (uint32_t table = 0; table < 8; ++table)
+        {
+            const int modifiers[4] = {etcModifierTable[table][0], etcModifierTable[table][1], -etcModifierTable[table][0], -etcModifierTable[table][1]};
+
+            int tableError = 0;
+            uint32_t tableSelectors[8];
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                int bestDistance = std::numeric_limits<int>::max();
+                for (uint32_t s = 0; s < 4; ++s)
+                {
+                    int candidate[3];
+                    for (int c = 0; c < 3; ++c) candidate[c] = std::clamp(expanded[c] + modifiers[s], 0, 255);
+                    int distance = colorDistance(block[texels[i]], candidate);
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        tableSelectors[i] = s;
+                    }
+                }
+                tableError += bestDistance;
+            }
+
+            if (tableError < result.error)
+            {
+                result.error = tableError;
+                result.table = table;
+                std::copy(tableSelectors, tableSelectors + 8, result.selectors);
+            }
+        }
+        return result;
+    }
+
+    void encodeETC2(const Block& block, uint8_t* dest)
+    {
+        // texel indices of the two sub blocks, flip = 0 gives 2x4 side by side, flip = 1 gives 4x2 stacked
+        const uint32_t subBlocks[2][2][8] = {
+            {{0, 1, 4, 5, 8, 9, 12, 13}, {2, 3, 6, 7, 10, 11, 14, 15}},
+            {{0, 1, 2, 3, 4, 5, 6, 7}, {8, 9, 10, 11, 12, 13, 14, 15}}};
+
+        SubBlockResult best[2];
+        uint32_t bestFlip = 0;
+        int bestError = std::numeric_limits<int>::max();
+        for (uint32_t flip = 0; flip < 2; ++flip)
+        {
+            auto first = encodeETCSubBlock(block, subBlocks[flip][0]);
+            auto second = encodeETCSubBlock(block, subBlocks[flip][1]);
+            if (first.error + second.error < bestError)
+            {
+                bestError = first.error + second.error;
+                best[0] = first;
+                best[1] = second;
+                bestFlip = flip;
+            }
+        }
+
+        uint64_t bits = 0;
+        bits |= uint64_t(best[0].base[0]) << 60;
+        bits |= uint64_t(best[1].base[0]) << 56;
+        bits |= uint64_t(best[0].base[1]) << 52;
+        bits |= uint64_t(best[1].base[1]) << 48;
+        bits |= uint64_t(best[0].base[2]) << 44;
+        bits |= uint64_t(best[1].base[2]) << 40;
+        bits |= uint64_t(best[0].table) << 37;
+        bits |= uint64_t(best[1].table) << 34;
+        // diff bit 33 left as 0 for individual mode
+        bits |= uint64_t(bestFlip) << 32;
+
+        // selectors are stored column major, with the most significant bits in the upper 16 bits
+        for (uint32_t s = 0; s < 2; ++s)
+        {
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                uint32_t texel = subBlocks[bestFlip][s][i];
+                uint32_t x = texel % 4, y = texel / 4;
+                uint32_t bitPosition = x * 4 + y;
+                uint32_t selector = best[s].selectors[i];
+                bits |= uint64_t(selector >> 1) << (16 + bitPosition);
+                bits |= uint64_t(selector & 1) << bitPosition;
+            }
+        }
+
+        for (int i = 0; i < 8; ++i) dest[i] = static_cast<uint8_t>((bits >> (56 - i * 8)) & 0xff);
+    }
+} // namespace
+
+VkFormat selectCompressedImageFormat(vsg::PhysicalDevice* physicalDevice, vsg::DeviceFeatures* requestedFeatures)
+{
+    auto& availableFeatures = physicalDevice->getFeatures();
+
+    auto supportsSampling = [&](VkFormat format) {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(*physicalDevice, format, &formatProperties);
+        return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+    };
+
+    if (availableFeatures.textureCompressionBC && supportsSampling(VK_FORMAT_BC1_RGB_UNORM_BLOCK))
+    {
+        if (requestedFeatures) requestedFeatures->get().textureCompressionBC = VK_TRUE;
+        return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    }
+
+    if (availableFeatures.textureCompressionETC2 && supportsSampling(VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK))
+    {
+        if (requestedFeatures) requestedFeatures->get().textureCompressionETC2 = VK_TRUE;
+        return VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+vsg::ref_ptr<vsg::ubvec4Array2D> createMipmappedRGBA(const vsg::Data* image, uint32_t maxNumMipmaps)
+{
+    uint32_t components = numComponents(image->properties.format);
+    if (components == 0 || image->properties.maxNumMipmaps > 1) return {};
+
+    uint32_t width = image->width();
+    uint32_t height = image->height();
+    uint32_t numLevels = numMipmapLevels(width, height, maxNumMipmaps);
+
+    vsg::Data::Properties properties = image->properties;
+    properties.format = isSRGB(image->properties.format) ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    properties.stride = 0;
+    properties.maxNumMipmaps = static_cast<uint8_t>(numLevels);
+
+    auto rgba = vsg::ubvec4Array2D::create(width, height, properties);
+
+    // copy across the base level, expanding RGB to RGBA where required
+    auto src = static_cast<const uint8_t*>(image->dataPointer());
+    auto dest = static_cast<vsg::ubvec4*>(rgba->dataPointer());
+    uint32_t srcStride = image->stride();
+    for (uint32_t i = 0; i < width * height; ++i, src += srcStride)
+    {
+        dest[i].set(src[0], src[1], src[2], components == 4 ? src[3] : 255);
+    }
+
+    // box filter each level down from the one above it
+    auto previous = dest;
+    auto level = dest + width * height;
+    for (uint32_t l = 1; l < numLevels; ++l)
+    {
+        uint32_t levelWidth = width >> l;
+        uint32_t levelHeight = height >> l;
+        uint32_t previousWidth = width >> (l - 1);
+        for (uint32_t r = 0; r < levelHeight; ++r)
+        {
+            for (uint32_t c = 0; c < levelWidth; ++c)
+            {
+                auto& t00 = previous[(r * 2) * previousWidth + c * 2];
+                auto& t01 = previous[(r * 2) * previousWidth + c * 2 + 1];
+                auto& t10 = previous[(r * 2 + 1) * previousWidth + c * 2];
+                auto& t11 = previous[(r * 2 + 1) * previousWidth + c * 2 + 1];
+
+                auto& texel = level[r * levelWidth + c];
+                for (int i = 0; i < 4; ++i) texel[i] = static_cast<uint8_t>((int(t00[i]) + int(t01[i]) + int(t10[i]) + int(t11[i]) + 2) / 4);
+            }
+        }
+        previous = level;
+        level += levelWidth * levelHeight;
+    }
+
+    return rgba;
+}
+
+vsg::ref_ptr<vsg::Data> compressImage(const vsg::Data* image, VkFormat format, uint32_t maxNumMipmaps)
+{
+    if (!image) return {};
+
+    bool bc1 = (format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK);
+    bool etc2 = (format == VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK || format == VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK);
+    if (!bc1 && !etc2) return {};
+
+    uint32_t width = image->width();
+    uint32_t height = image->height();
+    if (width < 4 || height < 4 || (width % 4) != 0 || (height % 4) != 0) return {};
+
+    auto rgba = createMipmappedRGBA(image, maxNumMipmaps);
+    if (!rgba) return {};
+
+    uint32_t numLevels = rgba->properties.maxNumMipmaps;
+
+    // the output is always in the requested format so it matches the format the device was checked for and the
+    // TilePool image, re-encode the texels when the source colour space differs from the requested one.
+    bool sRGB = isSRGBBlockFormat(format);
+    if (isSRGB(rgba->properties.format) != sRGB) convertColorSpace(static_cast<vsg::ubvec4*>(rgba->dataPointer()), rgba->dataSize() / sizeof(vsg::ubvec4), sRGB);
+
+    vsg::Data::Properties properties = image->properties;
+    properties.format = format;
+    properties.stride = 0;
+    properties.blockWidth = 4;
+    properties.blockHeight = 4;
+    properties.maxNumMipmaps = static_cast<uint8_t>(numLevels);
+
+    auto compressed = vsg::block64Array2D::create(width / 4, height / 4, properties);
+
+    Block block;
+    auto level = static_cast<const vsg::ubvec4*>(rgba->dataPointer());
+    auto dest = static_cast<uint8_t*>(compressed->dataPointer());
+    for (uint32_t l = 0; l < numLevels; ++l)
+    {
+        uint32_t levelWidth = width >> l;
+        uint32_t levelHeight = height >> l;
+        for (uint32_t y = 0; y < levelHeight; y += 4)
+        {
+            for (uint32_t x = 0; x < levelWidth; x += 4)
+            {
+                readBlock(level, levelWidth, x, y, block);
+                if (bc1)
+                    encodeBC1(block, dest);
+                else
+                    encodeETC2(block, dest);
+                dest += 8;
+            }
+        }
+        level += levelWidth * levelHeight;
+    }
+
+    return compressed;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// return the first block compressed format that the physical device can sample from, BC1 is preferred over ETC2,
+// if requestedFeatures is provided the device feature required for the selected format is enabled on it.
+// The UNORM variant is returned and checked, compressImage converts sRGB sources to it so the colour space of the tiles
+// always matches the format. Returns VK_FORMAT_UNDEFINED when no suitable format is supported.
+VkFormat selectCompressedImageFormat(vsg::PhysicalDevice* physicalDevice, vsg::DeviceFeatures* requestedFeatures = nullptr);
+
+// create a RGBA copy of a 8bit RGB or RGBA image with up to maxNumMipmaps box filtered mipmap levels,
+// levels smaller than 4x4 are not generated so that all levels can be block compressed.
+vsg::ref_ptr<vsg::ubvec4Array2D> createMipmappedRGBA(const vsg::Data* image, uint32_t maxNumMipmaps);
+
+// transcode a 8bit RGB or RGBA image, along with generated mipmaps, to VK_FORMAT_BC1_RGB_*_BLOCK or VK_FORMAT_ETC2_R8G8B8_*_BLOCK.
+// The result is always in the requested format, sRGB source texels are converted to linear for the UNORM formats and vice versa.
+// Returns null if the source image or format isn't supported, image dimensions must be a multiple of 4.
+vsg::ref_ptr<vsg::Data> compressImage(const vsg::Data* image, VkFormat format, uint32_t maxNumMipmaps);
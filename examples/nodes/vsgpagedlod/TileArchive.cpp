@@ -0,0 +1,209 @@
+#include "TileArchive.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace
+{
+    // read only std::streambuf over a memory mapped tile so that vsg::read() can deserialize it without an intermediate copy
+    struct MemoryStreamBuffer : public std::streambuf
+    {
+        MemoryStreamBuffer(const uint8_t* data, size_t size)
+        {
+            auto begin = reinterpret_cast<char*>(const_cast<uint8_t*>(data));
+            setg(begin, begin, begin + size);
+        }
+    };
+} // namespace
+
+TileArchive::TileArchive()
+{
+}
+
+TileArchive::~TileArchive()
+{
+    close();
+}
+
+bool TileArchive::open(const vsg::Path& filename)
+{
+    close();
+
+#if defined(_WIN32)
+    HANDLE fileHandle = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+
+    HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle)
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    _fileHandle = fileHandle;
+    _mappingHandle = mappingHandle;
+    _data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    _size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    _fileDescriptor = ::open(filename.c_str(), O_RDONLY);
+    if (_fileDescriptor < 0) return false;
+
+    struct stat fileStat;
+    if (fstat(_fileDescriptor, &fileStat) != 0)
+    {
+        close();
+        return false;
+    }
+
+    _size = static_cast<size_t>(fileStat.st_size);
+    void* ptr = (_size > 0) ? mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fileDescriptor, 0) : MAP_FAILED;
+    _data = (ptr != MAP_FAILED) ? static_cast<const uint8_t*>(ptr) : nullptr;
+#endif
+
+    if (!_data || _size < sizeof(Header))
+    {
+        close();
+        return false;
+    }
+
+    auto header = reinterpret_cast<const Header*>(_data);
+    if (std::memcmp(header->magic, Header().magic, sizeof(header->magic)) != 0 || header->version != Header().version ||
+        header->indexOffset + header->numTiles * sizeof(Entry) > _size)
+    {
+        vsg::warn("TileArchive::open(", filename, ") not a valid tile archive.");
+        close();
+        return false;
+    }
+
+    _header = header;
+    _entries = reinterpret_cast<const Entry*>(_data + header->indexOffset);
+
+    return true;
+}
+
+void TileArchive::close()
+{
+#if defined(_WIN32)
+    if (_data) UnmapViewOfFile(_data);
+    if (_mappingHandle) CloseHandle(_mappingHandle);
+    if (_fileHandle) CloseHandle(_fileHandle);
+    _mappingHandle = nullptr;
+    _fileHandle = nullptr;
+#else
+    if (_data) munmap(const_cast<uint8_t*>(_data), _size);
+    if (_fileDescriptor >= 0) ::close(_fileDescriptor);
+    _fileDescriptor = -1;
+#endif
+
+    _data = nullptr;
+    _size = 0;
+    _header = nullptr;
+    _entries = nullptr;
+}
+
+const TileArchive::Entry* TileArchive::findEntry(uint32_t x, uint32_t y, uint32_t level) const
+{
+    if (!_header) return nullptr;
+
+    Entry key;
+    key.level = level;
+    key.x = x;
+    key.y = y;
+
+    auto end = _entries + _header->numTiles;
+    auto itr = std::lower_bound(_entries, end, key);
+    if (itr == end || itr->level != level || itr->x != x || itr->y != y) return nullptr;
+    if (itr->offset + itr->size > _size) return nullptr;
+    return itr;
+}
+
+vsg::ref_ptr<vsg::Data> TileArchive::readTile(uint32_t x, uint32_t y, uint32_t level, vsg::ref_ptr<const vsg::Options> options) const
+{
+    auto entry = findEntry(x, y, level);
+    if (!entry) return {};
+
+    auto local_options = options ? vsg::Options::create(*options) : vsg::Options::create();
+    local_options->extensionHint = ".vsgb";
+
+    MemoryStreamBuffer buffer(_data + entry->offset, static_cast<size_t>(entry->size));
+    std::istream stream(&buffer);
+    return vsg::read_cast<vsg::Data>(stream, local_options);
+}
+
+bool TileArchive::write(const vsg::Path& filename, const Header& header, const std::vector<SourceTile>& tiles)
+{
+    // write to a temporary file so that an interrupted build never leaves a partially written archive behind
+    auto tempFilename = vsg::Path(filename.string() + ".tmp");
+
+    std::ofstream fout(tempFilename.string(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!fout) return false;
+
+    Header archiveHeader = header;
+    archiveHeader.numTiles = 0;
+    archiveHeader.indexOffset = 0;
+    fout.write(reinterpret_cast<const char*>(&archiveHeader), sizeof(Header));
+
+    std::vector<Entry> entries;
+    entries.reserve(tiles.size());
+
+    std::vector<char> buffer;
+    uint64_t offset = sizeof(Header);
+    for (auto& tile : tiles)
+    {
+        std::ifstream fin(tile.filename.string(), std::ios::in | std::ios::binary | std::ios::ate);
+        if (!fin) continue;
+
+        auto size = static_cast<size_t>(fin.tellg());
+        fin.seekg(0);
+        buffer.resize(size);
+        fin.read(buffer.data(), size);
+
+        Entry entry;
+        entry.level = tile.level;
+        entry.x = tile.x;
+        entry.y = tile.y;
+        entry.offset = offset;
+        entry.size = size;
+        entries.push_back(entry);
+
+        fout.write(buffer.data(), size);
+        offset += size;
+
+        // keep payloads and the index 8 byte aligned so the index can be accessed directly from the mapped memory
+        static const char padding[8] = {};
+        size_t paddingSize = static_cast<size_t>((8 - (offset % 8)) % 8);
+        fout.write(padding, paddingSize);
+        offset += paddingSize;
+    }
+
+    std::sort(entries.begin(), entries.end());
+
+    archiveHeader.numTiles = static_cast<uint32_t>(entries.size());
+    archiveHeader.indexOffset = offset;
+    fout.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+
+    fout.seekp(0);
+    fout.write(reinterpret_cast<const char*>(&archiveHeader), sizeof(Header));
+    fout.close();
+    if (!fout) return false;
+
+    std::remove(filename.string().c_str());
+    return std::rename(tempFilename.string().c_str(), filename.string().c_str()) == 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// TileArchive provides read access to a single file containing a pyramid of tiles, each tile stored as a native .vsgb serialized vsg::Data.
+// The file is memory mapped so that tiles can be read concurrently from the loading threads without any per tile file or network requests.
+//
+// File layout, all values are stored in native (little endian) byte order:
+//     Header
+//     tile payloads
+//     Entry[Header::numTiles] sorted by level, y, x
+class TileArchive : public vsg::Inherit<vsg::Object, TileArchive>
+{
+public:
+    struct Header
+    {
+        char magic[8] = {'v', 's', 'g', 't', 'i', 'l', 'e', 's'};
+        uint32_t version = 1;
+        uint32_t numTiles = 0;
+        uint64_t indexOffset = 0;
+
+        // extents and layout of the level 0 tiles, matching the settings of TileReader
+        double extents[4] = {-180.0, -90.0, 180.0, 90.0}; // min x, min y, max x, max y
+        uint32_t noX = 2;
+        uint32_t noY = 1;
+        uint32_t maxLevel = 0;
+        uint32_t originTopLeft = 0;
+        uint32_t sphericalMercator = 0;
+        uint32_t reserved[3] = {0, 0, 0};
+    };
+
+    struct Entry
+    {
+        uint32_t level = 0;
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t reserved = 0;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+
+        bool operator<(const Entry& rhs) const
+        {
+            if (level != rhs.level) return level < rhs.level;
+            if (y != rhs.y) return y < rhs.y;
+            return x < rhs.x;
+        }
+    };
+
+    struct SourceTile
+    {
+        uint32_t level;
+        uint32_t x;
+        uint32_t y;
+        vsg::Path filename;
+    };
+
+    TileArchive();
+
+    bool open(const vsg::Path& filename);
+    void close();
+
+    bool valid() const { return _header != nullptr; }
+    const Header& header() const { return *_header; }
+
+    // return the tile data, or null if the tile isn't in the archive. Thread safe.
+    vsg::ref_ptr<vsg::Data> readTile(uint32_t x, uint32_t y, uint32_t level, vsg::ref_ptr<const vsg::Options> options = {}) const;
+
+    // pack the contents of the source files into a new archive, the archive is written to a temporary file and renamed on completion.
+    static bool write(const vsg::Path& filename, const Header& header, const std::vector<SourceTile>& tiles);
+
+protected:
+    virtual ~TileArchive();
+
+    const Entry* findEntry(uint32_t x, uint32_t y, uint32_t level) const;
+
+    const uint8_t* _data = nullptr;
+    size_t _size = 0;
+    const Header* _header = nullptr;
+    const Entry* _entries = nullptr;
+
+#if defined(_WIN32)
+    void* _fileHandle = nullptr;
+    void* _mappingHandle = nullptr;
+#else
+    int _fileDescriptor = -1;
+#endif
+};
@@ -0,0 +1,393 @@
+#include "TilePool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    bool isBlockCompressed(VkFormat format)
+    {
+        return format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK || format == VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK;
+    }
+} // namespace
+
+TilePool::TilePool(vsg::ref_ptr<vsg::Device> in_device, uint32_t in_numFrames, uint32_t in_maxNumTiles, uint32_t in_tileImageSize, VkFormat in_imageFormat, bool in_multiDrawIndirect) :
+    device(in_device),
+    numFrames(std::max(in_numFrames, 1u)),
+    maxNumTiles(in_maxNumTiles),
+    tileImageSize(in_tileImageSize),
+    imageFormat(in_imageFormat),
+    multiDrawIndirect(in_multiDrawIndirect)
+{
+    auto deviceID = device->deviceID;
+
+    // both supported block compressed formats use 8 bytes per 4x4 block, only the first mipmap level is used
+    _imageSize = isBlockCompressed(imageFormat) ? VkDeviceSize((tileImageSize + 3) / 4) * ((tileImageSize + 3) / 4) * 8 : VkDeviceSize(tileImageSize) * tileImageSize * 4;
+
+    VkDeviceSize vertexSize = numVertices * sizeof(vsg::vec3);
+    VkDeviceSize indexSize = numIndices * sizeof(uint16_t);
+    _stagingSize = indexSize + maxUploadsPerFrame * (vertexSize + _imageSize);
+
+    VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    _vertexBuffer = vsg::createBufferAndMemory(device, vertexSize * maxNumTiles, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    _indexBuffer = vsg::createBufferAndMemory(device, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // per frame buffers written by the CPU
+    _stagingBuffer = vsg::createBufferAndMemory(device, _stagingSize * numFrames, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, hostMemory);
+    _indirectBuffer = vsg::createBufferAndMemory(device, sizeof(VkDrawIndexedIndirectCommand) * maxNumTiles * numFrames, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, hostMemory);
+    _instanceBuffer = vsg::createBufferAndMemory(device, sizeof(TileInstance) * maxNumTiles * numFrames, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, hostMemory);
+
+    _stagingData = static_cast<uint8_t*>(map(_stagingBuffer, _stagingSize * numFrames));
+    _indirectCommands = static_cast<VkDrawIndexedIndirectCommand*>(map(_indirectBuffer, sizeof(VkDrawIndexedIndirectCommand) * maxNumTiles * numFrames));
+    _instances = static_cast<TileInstance*>(map(_instanceBuffer, sizeof(TileInstance) * maxNumTiles * numFrames));
+
+    // texture array with one layer per tile
+    _image = vsg::Image::create();
+    _image->imageType = VK_IMAGE_TYPE_2D;
+    _image->format = imageFormat;
+    _image->extent = VkExtent3D{tileImageSize, tileImageSize, 1};
+    _image->mipLevels = 1;
+    _image->arrayLayers = maxNumTiles;
+    _image->samples = VK_SAMPLE_COUNT_1_BIT;
+    _image->tiling = VK_IMAGE_TILING_OPTIMAL;
+    _image->usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    _image->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    _image->compile(device);
+
+    auto imageMemory = vsg::DeviceMemory::create(device, _image->getMemoryRequirements(deviceID), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    _image->bind(imageMemory, 0);
+
+    _imageView = vsg::ImageView::create(_image, VK_IMAGE_ASPECT_COLOR_BIT);
+    _imageView->viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    _imageView->subresourceRange = VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, maxNumTiles};
+    _imageView->compile(device);
+
+    // hand out the lowest slots first
+    _freeSlots.resize(maxNumTiles);
+    for (uint32_t i = 0; i < maxNumTiles; ++i) _freeSlots[i] = maxNumTiles - 1 - i;
+
+    _slotReady.resize(maxNumTiles, 0);
+    _slotFlipT.resize(maxNumTiles, 0);
+    _visibleTiles.reserve(maxNumTiles);
+}
+
+TilePool::~TilePool()
+{
+    for (auto& buffer : {_stagingBuffer, _indirectBuffer, _instanceBuffer})
+    {
+        if (buffer) buffer->getDeviceMemory(device->deviceID)->unmap();
+    }
+}
+
+void* TilePool::map(vsg::Buffer* buffer, VkDeviceSize size)
+{
+    auto deviceID = device->deviceID;
+    void* data = nullptr;
+    if (buffer->getDeviceMemory(deviceID)->map(buffer->getMemoryOffset(deviceID), size, 0, &data) != VK_SUCCESS)
+    {
+        throw vsg::Exception{"Error: TilePool failed to map buffer memory."};
+    }
+    return data;
+}
+
+bool TilePool::enableDeviceFeatures(vsg::PhysicalDevice* physicalDevice, vsg::DeviceFeatures* deviceFeatures)
+{
+    auto supported = physicalDevice->getFeatures();
+    if (!supported.multiDrawIndirect || !supported.drawIndirectFirstInstance) return false;
+
+    auto& features = deviceFeatures->get();
+    features.multiDrawIndirect = VK_TRUE;
+    features.drawIndirectFirstInstance = VK_TRUE;
+    return true;
+}
+
+bool TilePool::compatible(const vsg::Data* image) const
+{
+    if (!image || image->properties.format != imageFormat) return false;
+
+    uint32_t width = image->width() * std::max(uint32_t(image->properties.blockWidth), 1u);
+    uint32_t height = image->height() * std::max(uint32_t(image->properties.blockHeight), 1u);
+    return width == tileImageSize && height == tileImageSize && image->dataSize() >= _imageSize;
+}
+
+uint32_t TilePool::numSlotsUsed() const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return maxNumTiles - static_cast<uint32_t>(_freeSlots.size());
+}
+
+uint32_t TilePool::allocate(vsg::ref_ptr<vsg::vec3Array> vertices, vsg::ref_ptr<vsg::Data> image)
+{
+    if (!vertices || vertices->size() != numVertices || !compatible(image)) return invalidSlot;
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    if (_freeSlots.empty()) return invalidSlot;
+
+    uint32_t slot = _freeSlots.back();
+    _freeSlots.pop_back();
+
+    _slotReady[slot] = 0;
+    _slotFlipT[slot] = (image->properties.origin == vsg::TOP_LEFT) ? 1 : 0;
+    _pendingUploads.push_back(PendingUpload{slot, vertices, image});
+
+    return slot;
+}
+
+void TilePool::release(uint32_t slot)
+{
+    if (slot >= maxNumTiles) return;
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    _pendingUploads.erase(std::remove_if(_pendingUploads.begin(), _pendingUploads.end(), [&](const PendingUpload& upload) { return upload.slot == slot; }), _pendingUploads.end());
+    _slotReady[slot] = 0;
+    _releasedSlots.push_back(ReleasedSlot{slot, _frameCount});
+}
+
+void TilePool::addVisible(uint32_t slot, const vsg::dmat4& localToWorld)
+{
+    _visibleTiles.push_back(VisibleTile{slot, localToWorld});
+}
+
+void TilePool::recordUploads(vsg::CommandBuffer& commandBuffer, uint64_t frameCount)
+{
+    auto deviceID = device->deviceID;
+    auto vk_commandBuffer = commandBuffer.vk();
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    _frameCount = std::max(_frameCount, frameCount);
+    auto frameIndex = static_cast<uint32_t>(frameCount % numFrames);
+
+    // slots released numFrames ago can no longer be referenced by frames in flight so can be reused
+    while (!_releasedSlots.empty() && _releasedSlots.front().frameCount + numFrames <= _frameCount)
+    {
+        _freeSlots.push_back(_releasedSlots.front().slot);
+        _releasedSlots.pop_front();
+    }
+
+    VkDeviceSize stagingBase = VkDeviceSize(frameIndex) * _stagingSize;
+    VkDeviceSize stagingOffset = 0;
+    VkBuffer vk_stagingBuffer = _stagingBuffer->vk(deviceID);
+    VkImage vk_image = _image->vk(deviceID);
+
+    std::vector<VkImageMemoryBarrier> preCopyBarriers;
+    std::vector<VkImageMemoryBarrier> postCopyBarriers;
+    std::vector<VkBufferCopy> vertexCopies;
+    std::vector<VkBufferImageCopy> imageCopies;
+    bool copyIndices = false;
+
+    auto imageBarrier = [&](uint32_t baseLayer, uint32_t layerCount, VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout) {
+        return VkImageMemoryBarrier{
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr,
+            srcAccess, dstAccess,
+            oldLayout, newLayout,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+            vk_image,
+            VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, baseLayer, layerCount}};
+    };
+
+    if (!_initialized)
+    {
+        // every tile uses the same grid so they all share one set of indices
+        auto indices = reinterpret_cast<uint16_t*>(_stagingData + stagingBase);
+        for (uint32_t r = 0; r < numRows - 1; ++r)
+        {
+            for (uint32_t c = 0; c < numColumns - 1; ++c)
+            {
+                uint16_t vi = static_cast<uint16_t>(c + r * numColumns);
+                (*indices++) = vi;
+                (*indices++) = vi + 1;
+                (*indices++) = vi + numColumns;
+                (*indices++) = vi + numColumns;
+                (*indices++) = vi + 1;
+                (*indices++) = vi + numColumns + 1;
+            }
+        }
+        stagingOffset += numIndices * sizeof(uint16_t);
+        copyIndices = true;
+
+        // move all the layers into a valid layout for the descriptor, including those that haven't been assigned a tile yet
+        auto initialBarrier = imageBarrier(0, maxNumTiles, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        vkCmdPipelineBarrier(vk_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &initialBarrier);
+        _initialized = true;
+    }
+
+    numTilesUploaded = 0;
+    while (!_pendingUploads.empty() && numTilesUploaded < maxUploadsPerFrame)
+    {
+        auto upload = _pendingUploads.front();
+        _pendingUploads.pop_front();
+
+        VkDeviceSize vertexSize = numVertices * sizeof(vsg::vec3);
+        std::memcpy(_stagingData + stagingBase + stagingOffset, upload.vertices->dataPointer(), vertexSize);
+        vertexCopies.push_back(VkBufferCopy{stagingBase + stagingOffset, VkDeviceSize(upload.slot) * vertexSize, vertexSize});
+        stagingOffset += vertexSize;
+
+        std::memcpy(_stagingData + stagingBase + stagingOffset, upload.image->dataPointer(), _imageSize);
+        imageCopies.push_back(VkBufferImageCopy{
+            stagingBase + stagingOffset, 0, 0,
+            VkImageSubresourceLayers{VK_IMAGE_ASPECT_COLOR_BIT, 0, upload.slot, 1},
+            VkOffset3D{0, 0, 0},
+            VkExtent3D{tileImageSize, tileImageSize, 1}});
+        stagingOffset += _imageSize;
+
+        // previous contents of the layer are discarded
+        preCopyBarriers.push_back(imageBarrier(upload.slot, 1, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+        postCopyBarriers.push_back(imageBarrier(upload.slot, 1, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+
+        _slotReady[upload.slot] = 1;
+        ++numTilesUploaded;
+    }
+
+    if (!copyIndices && vertexCopies.empty()) return;
+
+    if (!preCopyBarriers.empty())
+    {
+        vkCmdPipelineBarrier(vk_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(preCopyBarriers.size()), preCopyBarriers.data());
+    }
+
+    if (copyIndices)
+    {
+        VkBufferCopy indexCopy{stagingBase, 0, numIndices * sizeof(uint16_t)};
+        vkCmdCopyBuffer(vk_commandBuffer, vk_stagingBuffer, _indexBuffer->vk(deviceID), 1, &indexCopy);
+    }
+
+    if (!vertexCopies.empty())
+    {
+        vkCmdCopyBuffer(vk_commandBuffer, vk_stagingBuffer, _vertexBuffer->vk(deviceID), static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+        vkCmdCopyBufferToImage(vk_commandBuffer, vk_stagingBuffer, vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(imageCopies.size()), imageCopies.data());
+    }
+
+    // make the copied vertices, indices and texels visible to the draws in the following CommandGraph
+    VkMemoryBarrier memoryBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT};
+    vkCmdPipelineBarrier(vk_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, static_cast<uint32_t>(postCopyBarriers.size()), postCopyBarriers.data());
+}
+
+void TilePool::recordDraw(vsg::CommandBuffer& commandBuffer, uint64_t frameCount, const vsg::dmat4& view)
+{
+    auto deviceID = device->deviceID;
+    auto vk_commandBuffer = commandBuffer.vk();
+
+    auto frameIndex = static_cast<uint32_t>(frameCount % numFrames);
+    uint32_t count = 0;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+
+        auto commands = _indirectCommands + frameIndex * maxNumTiles;
+        auto instances = _instances + frameIndex * maxNumTiles;
+        for (auto& visibleTile : _visibleTiles)
+        {
+            if (!_slotReady[visibleTile.slot] || count >= maxNumTiles) continue;
+
+            // compute the modelview in double precision so that ECEF tiles don't jitter
+            instances[count] = TileInstance{vsg::mat4(view * visibleTile.localToWorld), visibleTile.slot, _slotFlipT[visibleTile.slot], {0, 0}};
+            commands[count] = VkDrawIndexedIndirectCommand{numIndices, 1, 0, static_cast<int32_t>(visibleTile.slot * numVertices), frameIndex * maxNumTiles + count};
+            ++count;
+        }
+    }
+    _visibleTiles.clear();
+
+    numTilesDrawn = count;
+    numDrawCalls = 0;
+    if (count == 0) return;
+
+    VkBuffer vertexBuffers[] = {_vertexBuffer->vk(deviceID)};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(vk_commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(vk_commandBuffer, _indexBuffer->vk(deviceID), 0, VK_INDEX_TYPE_UINT16);
+
+    if (multiDrawIndirect)
+    {
+        VkDeviceSize indirectOffset = sizeof(VkDrawIndexedIndirectCommand) * frameIndex * maxNumTiles;
+        vkCmdDrawIndexedIndirect(vk_commandBuffer, _indirectBuffer->vk(deviceID), indirectOffset, count, sizeof(VkDrawIndexedIndirectCommand));
+        numDrawCalls = 1;
+    }
+    else
+    {
+        // without multiDrawIndirect fall back to a direct draw per tile, still without any per tile state changes
+        auto commands = _indirectCommands + frameIndex * maxNumTiles;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            vkCmdDrawIndexed(vk_commandBuffer, commands[i].indexCount, 1, 0, commands[i].vertexOffset, commands[i].firstInstance);
+        }
+        numDrawCalls = count;
+    }
+}
+
+vsg::ref_ptr<vsg::Node> TilePool::createDrawGraph(vsg::ref_ptr<vsg::ViewMatrix> viewMatrix, vsg::ref_ptr<const vsg::Options> options)
+{
+    auto vertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/batchedtile.vert", options);
+    auto fragmentShader = vsg::read_cast<vsg::ShaderStage>("shaders/batchedtile.frag", options);
+    if (!vertexShader || !fragmentShader)
+    {
+        vsg::warn("Could not create batched tile shaders.");
+        return {};
+    }
+
+    vsg::DescriptorSetLayoutBindings descriptorBindings{
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}, // texture array
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr}            // per tile matrices
+    };
+
+    auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+
+    vsg::PushConstantRanges pushConstantRanges{
+        {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection view, and model matrices, actual push constant calls automatically provided by the VSG's RecordTraversal
+    };
+
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, pushConstantRanges);
+
+    vsg::VertexInputState::Bindings vertexBindingsDescriptions{
+        VkVertexInputBindingDescription{0, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_VERTEX} // vertex data
+    };
+
+    vsg::VertexInputState::Attributes vertexAttributeDescriptions{
+        VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0} // vertex data
+    };
+
+    vsg::GraphicsPipelineStates pipelineStates{
+        vsg::VertexInputState::create(vertexBindingsDescriptions, vertexAttributeDescriptions),
+        vsg::InputAssemblyState::create(),
+        vsg::RasterizationState::create(),
+        vsg::MultisampleState::create(),
+        vsg::ColorBlendState::create(),
+        vsg::DepthStencilState::create()};
+
+    auto graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
+
+    auto sampler = vsg::Sampler::create();
+    sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    auto texture = vsg::DescriptorImage::create(vsg::ImageInfo::create(sampler, _imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    auto instances = vsg::DescriptorBuffer::create(vsg::BufferInfoList{vsg::BufferInfo::create(_instanceBuffer, 0, sizeof(TileInstance) * maxNumTiles * numFrames)}, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture, instances});
+
+    auto stateGroup = vsg::StateGroup::create();
+    stateGroup->add(vsg::BindGraphicsPipeline::create(graphicsPipeline));
+    stateGroup->add(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, descriptorSet));
+    stateGroup->addChild(BatchedTileDraw::create(vsg::ref_ptr<TilePool>(this), viewMatrix));
+
+    return stateGroup;
+}
+
+BatchedTile::BatchedTile(vsg::ref_ptr<TilePool> in_pool, uint32_t in_slot, const vsg::dmat4& in_localToWorld, const vsg::dsphere& in_bound) :
+    pool(in_pool),
+    slot(in_slot),
+    localToWorld(in_localToWorld),
+    bound(in_bound)
+{
+}
+
+BatchedTile::~BatchedTile()
+{
+    pool->release(slot);
+}
+
+void BatchedTile::record(vsg::CommandBuffer&) const
+{
+    pool->addVisible(slot, localToWorld);
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <deque>
+
+// TilePool suballocates the geometry and imagery of terrain tiles from shared buffers so that all the visible tiles can be
+// drawn with a single vkCmdDrawIndexedIndirect. Each tile occupies a fixed slot made up of numVertices vertices in the
+// shared vertex buffer and one layer of the shared texture array, as all tiles use the same grid they share one index buffer.
+//
+// Tile data is copied into the pool by the TilePoolUpload node, which must be recorded in a CommandGraph ahead of the one
+// containing the tiles. During the record traversal each visible BatchedTile adds itself to the pool, then the BatchedTileDraw
+// node placed after the tiles writes the per frame indirect commands and per tile matrices and issues the draw. Both take the
+// frame from the RecordTraversal's FrameStamp so the two CommandGraphs may be recorded on separate threads.
+class TilePool : public vsg::Inherit<vsg::Object, TilePool>
+{
+public:
+    static constexpr uint32_t numRows = 32;
+    static constexpr uint32_t numColumns = 32;
+    static constexpr uint32_t numVertices = numRows * numColumns;
+    static constexpr uint32_t numIndices = (numRows - 1) * (numColumns - 1) * 6;
+
+    static constexpr uint32_t maxUploadsPerFrame = 32;
+
+    static constexpr uint32_t invalidSlot = ~0u;
+
+    // per tile data read by the vertex shader from the storage buffer, matches TileInstance in shaders/batchedtile.vert
+    struct TileInstance
+    {
+        vsg::mat4 modelview;
+        uint32_t layer;
+        uint32_t flipT;
+        uint32_t padding[2];
+    };
+
+    // in_numFrames is the number of frames that may be in flight, usually window->numFrames(), it sizes the per frame staging, indirect and matrix buffers
+    TilePool(vsg::ref_ptr<vsg::Device> in_device, uint32_t in_numFrames, uint32_t in_maxNumTiles, uint32_t in_tileImageSize, VkFormat in_imageFormat, bool in_multiDrawIndirect);
+
+    const vsg::ref_ptr<vsg::Device> device;
+    const uint32_t numFrames;
+    const uint32_t maxNumTiles;
+    const uint32_t tileImageSize;
+    const VkFormat imageFormat;
+    const bool multiDrawIndirect;
+
+    // enable the features needed to draw all tiles with a single indirect call, must be called before the Device is created. Returns false if unsupported.
+    static bool enableDeviceFeatures(vsg::PhysicalDevice* physicalDevice, vsg::DeviceFeatures* deviceFeatures);
+
+    // return true if the image can be placed in the texture array
+    bool compatible(const vsg::Data* image) const;
+
+    // assign a slot to a tile and queue its data for upload, returns invalidSlot if the pool is full. Thread safe.
+    uint32_t allocate(vsg::ref_ptr<vsg::vec3Array> vertices, vsg::ref_ptr<vsg::Data> image);
+
+    // return a slot to the pool once the frames that may reference it have completed. Thread safe.
+    void release(uint32_t slot);
+
+    // called during the record traversal, frameCount is the FrameStamp::frameCount of the frame being recorded
+    void addVisible(uint32_t slot, const vsg::dmat4& localToWorld);
+    void recordUploads(vsg::CommandBuffer& commandBuffer, uint64_t frameCount);
+    void recordDraw(vsg::CommandBuffer& commandBuffer, uint64_t frameCount, const vsg::dmat4& view);
+
+    // create the subgraph that binds the batched pipeline and draws the visible tiles, this must be placed after the tiles in the scene graph.
+    vsg::ref_ptr<vsg::Node> createDrawGraph(vsg::ref_ptr<vsg::ViewMatrix> viewMatrix, vsg::ref_ptr<const vsg::Options> options);
+
+    // stats for the last frame recorded
+    uint32_t numTilesDrawn = 0;
+    uint32_t numDrawCalls = 0;
+    uint32_t numTilesUploaded = 0;
+
+    uint32_t numSlotsUsed() const;
+
+protected:
+    virtual ~TilePool();
+
+    struct PendingUpload
+    {
+        uint32_t slot;
+        vsg::ref_ptr<vsg::vec3Array> vertices;
+        vsg::ref_ptr<vsg::Data> image;
+    };
+
+    struct ReleasedSlot
+    {
+        uint32_t slot;
+        uint64_t frameCount;
+    };
+
+    struct VisibleTile
+    {
+        uint32_t slot;
+        vsg::dmat4 localToWorld;
+    };
+
+    void* map(vsg::Buffer* buffer, VkDeviceSize size);
+
+    VkDeviceSize _imageSize = 0;
+    VkDeviceSize _stagingSize = 0;
+
+    vsg::ref_ptr<vsg::Buffer> _vertexBuffer;
+    vsg::ref_ptr<vsg::Buffer> _indexBuffer;
+    vsg::ref_ptr<vsg::Buffer> _stagingBuffer;
+    vsg::ref_ptr<vsg::Buffer> _indirectBuffer;
+    vsg::ref_ptr<vsg::Buffer> _instanceBuffer;
+    vsg::ref_ptr<vsg::Image> _image;
+    vsg::ref_ptr<vsg::ImageView> _imageView;
+
+    uint8_t* _stagingData = nullptr;
+    VkDrawIndexedIndirectCommand* _indirectCommands = nullptr;
+    TileInstance* _instances = nullptr;
+
+    mutable std::mutex _mutex;
+    std::vector<uint32_t> _freeSlots;
+    std::deque<ReleasedSlot> _releasedSlots;
+    std::deque<PendingUpload> _pendingUploads;
+    std::vector<uint8_t> _slotReady;
+    std::vector<uint8_t> _slotFlipT;
+    uint64_t _frameCount = 0;
+    bool _initialized = false;
+
+    // only accessed from the record traversal
+    std::vector<VisibleTile> _visibleTiles;
+};
+
+// BatchedTile stands in for a tile's StateGroup/MatrixTransform/draw subgraph, when recorded it adds its slot to the pool's visible list.
+class BatchedTile : public vsg::Inherit<vsg::Command, BatchedTile>
+{
+public:
+    BatchedTile(vsg::ref_ptr<TilePool> in_pool, uint32_t in_slot, const vsg::dmat4& in_localToWorld, const vsg::dsphere& in_bound);
+
+    vsg::ref_ptr<TilePool> pool;
+    uint32_t slot;
+    vsg::dmat4 localToWorld;
+    vsg::dsphere bound;
+
+    void record(vsg::CommandBuffer& commandBuffer) const override;
+
+protected:
+    virtual ~BatchedTile();
+};
+
+// TilePoolUpload copies newly loaded tiles into the pool, must be recorded outside of a render pass.
+class TilePoolUpload : public vsg::Inherit<vsg::Node, TilePoolUpload>
+{
+public:
+    explicit TilePoolUpload(vsg::ref_ptr<TilePool> in_pool) :
+        pool(in_pool) {}
+
+    vsg::ref_ptr<TilePool> pool;
+
+    void accept(vsg::RecordTraversal& rt) const override { pool->recordUploads(*rt.getCommandBuffer(), rt.getFrameStamp()->frameCount); }
+};
+
+// BatchedTileDraw draws all the BatchedTile recorded since the previous draw.
+class BatchedTileDraw : public vsg::Inherit<vsg::Node, BatchedTileDraw>
+{
+public:
+    BatchedTileDraw(vsg::ref_ptr<TilePool> in_pool, vsg::ref_ptr<vsg::ViewMatrix> in_viewMatrix) :
+        pool(in_pool),
+        viewMatrix(in_viewMatrix) {}
+
+    vsg::ref_ptr<TilePool> pool;
+    vsg::ref_ptr<vsg::ViewMatrix> viewMatrix;
+
+    void accept(vsg::RecordTraversal& rt) const override
+    {
+        // as a Node rather than a Command the pipeline, descriptor set and matrices inherited from the StateGroup have to be recorded explicitly
+        rt.getState()->record();
+        pool->recordDraw(*rt.getCommandBuffer(), rt.getFrameStamp()->frameCount, viewMatrix->transform());
+    }
+};
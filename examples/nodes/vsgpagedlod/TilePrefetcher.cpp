@@ -0,0 +1,355 @@
+#include "TilePrefetcher.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    // set on the prefetch threads so that their own reads through TileReader::read() don't wait on themselves in take()
+    thread_local bool s_prefetchThread = false;
+
+    // approximate memory footprint of a loaded tile subgraph
+    struct ComputeDataSize : public vsg::Inherit<vsg::ConstVisitor, ComputeDataSize>
+    {
+        size_t size = 0;
+
+        void apply(const vsg::Object& object) override
+        {
+            object.traverse(*this);
+        }
+
+        void apply(const vsg::Data& data) override
+        {
+            size += data.dataSize();
+        }
+
+        void apply(const vsg::StateGroup& stateGroup) override
+        {
+            for (auto& stateCommand : stateGroup.stateCommands) stateCommand->accept(*this);
+            stateGroup.traverse(*this);
+        }
+
+        void apply(const vsg::BindDescriptorSets& bds) override
+        {
+            for (auto& descriptorSet : bds.descriptorSets)
+            {
+                for (auto& descriptor : descriptorSet->descriptors)
+                {
+                    if (auto descriptorImage = descriptor.cast<vsg::DescriptorImage>())
+                    {
+                        for (auto& imageInfo : descriptorImage->imageInfoList)
+                        {
+                            if (imageInfo->imageView && imageInfo->imageView->image && imageInfo->imageView->image->data) size += imageInfo->imageView->image->data->dataSize();
+                        }
+                    }
+                }
+            }
+        }
+
+        void apply(const vsg::BindVertexBuffers& bvb) override
+        {
+            for (auto& array : bvb.arrays)
+            {
+                if (array->data) size += array->data->dataSize();
+            }
+        }
+
+        void apply(const vsg::BindIndexBuffer& bib) override
+        {
+            if (bib.indices && bib.indices->data) size += bib.indices->data->dataSize();
+        }
+    };
+} // namespace
+
+LowResolutionTiles::LowResolutionTiles(const vsg::dmat4& in_projection, const vsg::dmat4& in_view) :
+    projection(in_projection),
+    view(in_view)
+{
+}
+
+bool LowResolutionTiles::inView(const vsg::dsphere& bound, double& screenHeightRatio) const
+{
+    auto center = view * bound.center;
+    double distance = -center.z;
+    if (distance + bound.radius < 0.0) return false;
+
+    // bound intersects the eye so will always be treated as high resolution
+    if (distance <= bound.radius)
+    {
+        screenHeightRatio = std::numeric_limits<double>::max();
+        return true;
+    }
+
+    double rx = bound.radius * projection[0][0] / distance;
+    double ry = bound.radius * projection[1][1] / distance;
+    double x = projection[0][0] * center.x / distance;
+    double y = projection[1][1] * center.y / distance;
+    if (std::abs(x) > 1.0 + rx || std::abs(y) > 1.0 + ry) return false;
+
+    screenHeightRatio = ry;
+    return true;
+}
+
+void LowResolutionTiles::apply(const vsg::Node& node)
+{
+    node.traverse(*this);
+}
+
+void LowResolutionTiles::apply(const vsg::PagedLOD& plod)
+{
+    double screenHeightRatio = 0.0;
+    if (!inView(plod.bound, screenHeightRatio)) return;
+
+    auto& highResolution = plod.children[0];
+    if (screenHeightRatio > highResolution.minimumScreenHeightRatio)
+    {
+        if (highResolution.node)
+        {
+            highResolution.node->accept(*this);
+            return;
+        }
+
+        ++numLowResolutionTiles;
+        requests.push_back(TilePrefetcher::Request{plod.filename, plod.options, predictionTime, screenHeightRatio});
+    }
+
+    if (auto& lowResolution = plod.children[1].node) lowResolution->accept(*this);
+}
+
+TilePrefetcher::TilePrefetcher(uint32_t numThreads)
+{
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        _threads.emplace_back([this]() { run(); });
+    }
+}
+
+TilePrefetcher::~TilePrefetcher()
+{
+    stop();
+}
+
+void TilePrefetcher::stop()
+{
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _done = true;
+        _queue.clear();
+        _cache.clear();
+        _cacheSize = 0;
+    }
+
+    _requestAvailable.notify_all();
+    _requestCompleted.notify_all();
+
+    for (auto& thread : _threads) thread.join();
+    _threads.clear();
+}
+
+std::vector<vsg::dmat4> TilePrefetcher::predictViewMatrices(const vsg::Camera& camera, const vsg::FrameStamp& frameStamp)
+{
+    std::vector<vsg::dmat4> viewMatrices;
+
+    if (animationPath)
+    {
+        // read ahead along the animation path using the same time reference as the AnimationPathHandler
+        double time = std::chrono::duration<double, std::chrono::seconds::period>(frameStamp.time - animationStartPoint).count();
+        for (uint32_t i = 1; i <= numPredictionSteps; ++i)
+        {
+            double t = time + lookAheadTime * double(i) / double(numPredictionSteps);
+            viewMatrices.push_back(vsg::inverse(animationPath->computeMatrix(t)));
+        }
+        return viewMatrices;
+    }
+
+    // extrapolate the eye position using a smoothed velocity, keeping the current orientation
+    auto view = camera.viewMatrix->transform();
+    auto eye = vsg::inverse(view) * vsg::dvec3(0.0, 0.0, 0.0);
+    double time = std::chrono::duration<double, std::chrono::seconds::period>(frameStamp.time.time_since_epoch()).count();
+
+    if (_hasPreviousEye && time > _previousTime)
+    {
+        auto currentVelocity = (eye - _previousEye) / (time - _previousTime);
+        _velocity = _velocity * 0.7 + currentVelocity * 0.3;
+    }
+    _hasPreviousEye = true;
+    _previousEye = eye;
+    _previousTime = time;
+
+    if (vsg::length(_velocity) == 0.0) return viewMatrices;
+
+    for (uint32_t i = 1; i <= numPredictionSteps; ++i)
+    {
+        auto offset = _velocity * (lookAheadTime * double(i) / double(numPredictionSteps));
+        viewMatrices.push_back(view * vsg::translate(-offset));
+    }
+    return viewMatrices;
+}
+
+void TilePrefetcher::update(const vsg::Camera& camera, const vsg::Node& scene, const vsg::FrameStamp& frameStamp)
+{
+    ++_frameCount;
+
+    double time = std::chrono::duration<double, std::chrono::seconds::period>(frameStamp.time.time_since_epoch()).count();
+    double previousUpdateTime = _previousUpdateTime;
+    _previousUpdateTime = time;
+
+    auto projection = camera.projectionMatrix->transform();
+    auto viewMatrices = predictViewMatrices(camera, frameStamp);
+
+    // collect the tiles that will be required, keeping the earliest time and highest priority for each
+    std::map<vsg::Path, Request> required;
+    for (size_t i = 0; i < viewMatrices.size(); ++i)
+    {
+        LowResolutionTiles predict(projection, viewMatrices[i]);
+        predict.predictionTime = lookAheadTime * double(i + 1) / double(viewMatrices.size());
+        scene.accept(predict);
+
+        for (auto& request : predict.requests)
+        {
+            auto itr = required.find(request.filename);
+            if (itr == required.end())
+                required[request.filename] = request;
+            else
+                itr->second.priority = std::max(itr->second.priority, request.priority);
+        }
+    }
+
+    std::vector<Request> candidates;
+    for (auto& [filename, request] : required) candidates.push_back(request);
+    std::sort(candidates.begin(), candidates.end(), [](const Request& lhs, const Request& rhs) {
+        if (lhs.time != rhs.time) return lhs.time < rhs.time;
+        return lhs.priority > rhs.priority;
+    });
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    // tiles the DatabasePager has already asked for don't need prefetching, forget them once they are no longer predicted
+    for (auto itr = _requestedByPager.begin(); itr != _requestedByPager.end();)
+    {
+        if (required.count(*itr) == 0)
+            itr = _requestedByPager.erase(itr);
+        else
+            ++itr;
+    }
+
+    // cancel queued requests that are no longer predicted
+    for (auto itr = _queue.begin(); itr != _queue.end();)
+    {
+        if (required.count(itr->filename) == 0)
+        {
+            itr = _queue.erase(itr);
+            ++numCancelled;
+        }
+        else
+            ++itr;
+    }
+
+    // refresh cached tiles that are still predicted so that eviction removes mispredicted tiles first
+    for (auto& [filename, cachedTile] : _cache)
+    {
+        if (required.count(filename) != 0) cachedTile.lastPredictedFrame = _frameCount;
+    }
+
+    // issue new requests within the bandwidth and memory budgets
+    if (previousUpdateTime > 0.0) _tokens = std::min(_tokens + (time - previousUpdateTime) * maxTilesPerSecond, double(maxNumInFlight));
+
+    for (auto& candidate : candidates)
+    {
+        if (_tokens < 1.0 || _cacheSize >= maxCacheSize || (_inFlight.size() + _queue.size()) >= maxNumInFlight) break;
+
+        if (_cache.count(candidate.filename) != 0 || _inFlight.count(candidate.filename) != 0 || _requestedByPager.count(candidate.filename) != 0) continue;
+        if (std::any_of(_queue.begin(), _queue.end(), [&](const Request& request) { return request.filename == candidate.filename; })) continue;
+
+        _queue.push_back(candidate);
+        _tokens -= 1.0;
+        ++numRequested;
+    }
+
+    _requestAvailable.notify_all();
+}
+
+vsg::ref_ptr<vsg::Object> TilePrefetcher::take(const vsg::Path& filename)
+{
+    if (s_prefetchThread) return {};
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // the DatabasePager now needs this tile so drop it from the prefetch queue, and wait if it's already being loaded
+    for (auto itr = _queue.begin(); itr != _queue.end(); ++itr)
+    {
+        if (itr->filename == filename)
+        {
+            _queue.erase(itr);
+            break;
+        }
+    }
+
+    _requestedByPager.insert(filename);
+
+    _requestCompleted.wait(lock, [&]() { return _done || _inFlight.count(filename) == 0; });
+
+    auto itr = _cache.find(filename);
+    if (itr == _cache.end()) return {};
+
+    auto object = itr->second.object;
+    _cacheSize -= itr->second.size;
+    _cache.erase(itr);
+    ++numHits;
+    return object;
+}
+
+void TilePrefetcher::evict()
+{
+    // remove the tiles that have gone the longest without being predicted
+    while (_cacheSize > maxCacheSize && !_cache.empty())
+    {
+        auto oldest = _cache.begin();
+        for (auto itr = _cache.begin(); itr != _cache.end(); ++itr)
+        {
+            if (itr->second.lastPredictedFrame < oldest->second.lastPredictedFrame) oldest = itr;
+        }
+
+        _cacheSize -= oldest->second.size;
+        _cache.erase(oldest);
+        ++numEvicted;
+    }
+}
+
+void TilePrefetcher::run()
+{
+    s_prefetchThread = true;
+
+    while (true)
+    {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _requestAvailable.wait(lock, [&]() { return _done || !_queue.empty(); });
+            if (_done) return;
+
+            request = _queue.front();
+            _queue.pop_front();
+            _inFlight.insert(request.filename);
+        }
+
+        auto object = vsg::read(request.filename, request.options);
+
+        ComputeDataSize computeDataSize;
+        if (object) object->accept(computeDataSize);
+
+        {
+            std::scoped_lock<std::mutex> lock(_mutex);
+            _inFlight.erase(request.filename);
+            if (object)
+            {
+                _cache[request.filename] = CachedTile{object, computeDataSize.size, _frameCount};
+                _cacheSize += computeDataSize.size;
+                ++numLoaded;
+                evict();
+            }
+        }
+
+        _requestCompleted.notify_all();
+    }
+}
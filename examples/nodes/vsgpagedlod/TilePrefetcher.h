@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <condition_variable>
+#include <deque>
+#include <set>
+#include <thread>
+
+// TilePrefetcher predicts where the camera will be over the next lookAheadTime seconds, either by extrapolating the camera's
+// velocity or by reading ahead along an AnimationPath, and loads the PagedLOD tiles that will be required at those positions.
+// Loaded tiles are held in a cache that TileReader::read() checks before loading a tile itself.
+class TilePrefetcher : public vsg::Inherit<vsg::Object, TilePrefetcher>
+{
+public:
+    TilePrefetcher(uint32_t numThreads = 2);
+
+    // prediction settings
+    double lookAheadTime = 2.0;
+    uint32_t numPredictionSteps = 4;
+    vsg::ref_ptr<vsg::AnimationPath> animationPath;
+    vsg::time_point animationStartPoint;
+
+    // bandwidth and memory budgets
+    uint32_t maxNumInFlight = 2;
+    double maxTilesPerSecond = 20.0;
+    size_t maxCacheSize = 256 * 1024 * 1024;
+
+    // predict the tiles required and schedule loads, called once per frame from the main thread after viewer->update().
+    void update(const vsg::Camera& camera, const vsg::Node& scene, const vsg::FrameStamp& frameStamp);
+
+    // return the prefetched tile and remove it from the cache, waiting for it to complete if it's currently being loaded. Thread safe.
+    vsg::ref_ptr<vsg::Object> take(const vsg::Path& filename);
+
+    // stop the prefetch threads and release any cached tiles
+    void stop();
+
+    // stats
+    uint64_t numRequested = 0;
+    uint64_t numLoaded = 0;
+    uint64_t numHits = 0;
+    uint64_t numCancelled = 0;
+    uint64_t numEvicted = 0;
+
+    struct Request
+    {
+        vsg::Path filename;
+        vsg::ref_ptr<const vsg::Options> options;
+        double time = 0.0;     // predicted time until the tile is required
+        double priority = 0.0; // screen height ratio of the tile at the predicted position
+    };
+
+protected:
+    virtual ~TilePrefetcher();
+
+    struct CachedTile
+    {
+        vsg::ref_ptr<vsg::Object> object;
+        size_t size = 0;
+        uint64_t lastPredictedFrame = 0;
+    };
+
+    void run();
+    void evict();
+
+    std::vector<vsg::dmat4> predictViewMatrices(const vsg::Camera& camera, const vsg::FrameStamp& frameStamp);
+
+    std::mutex _mutex;
+    std::condition_variable _requestAvailable;
+    std::condition_variable _requestCompleted;
+    std::deque<Request> _queue;
+    std::set<vsg::Path> _inFlight;
+    std::set<vsg::Path> _requestedByPager;
+    std::map<vsg::Path, CachedTile> _cache;
+    size_t _cacheSize = 0;
+    bool _done = false;
+
+    std::vector<std::thread> _threads;
+
+    // velocity prediction
+    bool _hasPreviousEye = false;
+    vsg::dvec3 _previousEye;
+    vsg::dvec3 _velocity;
+    double _previousTime = 0.0;
+    double _previousUpdateTime = 0.0;
+    double _tokens = 0.0;
+    uint64_t _frameCount = 0;
+};
+
+// LowResolutionTiles counts the PagedLODs in the view frustum that require their high resolution child but don't have it loaded yet.
+class LowResolutionTiles : public vsg::Inherit<vsg::ConstVisitor, LowResolutionTiles>
+{
+public:
+    LowResolutionTiles(const vsg::dmat4& in_projection, const vsg::dmat4& in_view);
+
+    vsg::dmat4 projection;
+    vsg::dmat4 view;
+
+    uint32_t numLowResolutionTiles = 0;
+    std::vector<TilePrefetcher::Request> requests;
+    double predictionTime = 0.0;
+
+    void apply(const vsg::Node& node) override;
+    void apply(const vsg::PagedLOD& plod) override;
+
+protected:
+    bool inView(const vsg::dsphere& bound, double& screenHeightRatio) const;
+};
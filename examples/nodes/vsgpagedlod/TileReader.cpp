@@ -1,4 +1,5 @@
 #include "TileReader.h"
+#include "TextureCompression.h"
 
 vsg::dvec3 TileReader::computeLatitudeLongitudeAltitude(const vsg::dvec3& src) const
 {
@@ -71,10 +72,64 @@ vsg::ref_ptr<vsg::Object> TileReader::read(const vsg::Path& filename, vsg::ref_p
 
         // std::cout<<"read("<<filename<<") -> tile_info = "<<tile_info<<", x = "<<x<<", y = "<<y<<", z = "<<lod<<std::endl;
 
+        if (prefetcher)
+        {
+            if (auto object = prefetcher->take(filename)) return object;
+        }
+
         return read_subtile(x, y, lod, options);
     }
 }
 
+vsg::Path TileReader::getTranscodedCachePath(const vsg::Path& tilePath, vsg::ref_ptr<const vsg::Options> options) const
+{
+    if (!tilePath || !options || !options->fileCache) return {};
+
+    // strip any server scheme so remote tiles map to a relative path within the file cache
+    auto path = tilePath.string();
+    if (auto pos = path.find("://"); pos != std::string::npos) path.erase(0, pos + 3);
+
+    const char* formatSuffix = (compressedImageFormat == VK_FORMAT_BC1_RGB_UNORM_BLOCK) ? ".bc1.vsgb" : ".etc2.vsgb";
+    return options->fileCache / vsg::Path(vsg::removeExtension(vsg::Path(path)).string() + formatSuffix);
+}
+
+vsg::ref_ptr<vsg::Data> TileReader::prepareImageTile(const vsg::Path& tilePath, vsg::ref_ptr<vsg::Data> imageTile, vsg::ref_ptr<const vsg::Options> options) const
+{
+    if (!imageTile) return {};
+
+    size_t bytesRead = imageTile->dataSize();
+    if (compressedImageFormat != VK_FORMAT_UNDEFINED)
+    {
+        // reuse a previously transcoded tile if one is available in the file cache
+        auto cachePath = getTranscodedCachePath(tilePath, options);
+        vsg::ref_ptr<vsg::Data> compressed;
+        if (cachePath && vsg::fileExists(cachePath))
+        {
+            compressed = vsg::read_cast<vsg::Data>(cachePath, options);
+        }
+
+        if (!compressed)
+        {
+            compressed = compressImage(imageTile, compressedImageFormat, mipmapLevelsHint);
+            if (compressed && cachePath)
+            {
+                vsg::makeDirectory(vsg::filePath(cachePath));
+                vsg::write(compressed, cachePath, options);
+            }
+        }
+
+        if (compressed) imageTile = compressed;
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock(statsMutex);
+        numImageBytesRead += bytesRead;
+        numImageBytesUploaded += imageTile->dataSize();
+    }
+
+    return imageTile;
+}
+
 vsg::ref_ptr<vsg::Object> TileReader::read_root(vsg::ref_ptr<const vsg::Options> options) const
 {
     auto group = createRoot();
@@ -84,10 +139,18 @@ vsg::ref_ptr<vsg::Object> TileReader::read_root(vsg::ref_ptr<const vsg::Options>
     {
         for (uint32_t x = 0; x < noX; ++x)
         {
-            auto imagePath = getTilePath(imageLayer, x, y, lod);
-            //auto terrainPath = getTilePath(terrainLayer, x, y, lod);
+            vsg::ref_ptr<vsg::Data> imageTile;
+            if (archive)
+            {
+                imageTile = prepareImageTile({}, archive->readTile(x, y, lod, options), options);
+            }
+            else
+            {
+                auto imagePath = getTilePath(imageLayer, x, y, lod);
+                //auto terrainPath = getTilePath(terrainLayer, x, y, lod);
 
-            auto imageTile = vsg::read_cast<vsg::Data>(imagePath, options);
+                imageTile = prepareImageTile(imagePath, vsg::read_cast<vsg::Data>(imagePath, options), options);
+            }
             //auto terrainTile = vsg::read(terrainPath, options);
 
             if (imageTile)
@@ -96,10 +159,7 @@ vsg::ref_ptr<vsg::Object> TileReader::read_root(vsg::ref_ptr<const vsg::Options>
                 auto tile = createTile(tile_extents, imageTile);
                 if (tile)
                 {
-                    vsg::ComputeBounds computeBound;
-                    tile->accept(computeBound);
-                    auto& bb = computeBound.bounds;
-                    vsg::dsphere bound((bb.min.x + bb.max.x) * 0.5, (bb.min.y + bb.max.y) * 0.5, (bb.min.z + bb.max.z) * 0.5, vsg::length(bb.max - bb.min) * 0.5);
+                    auto bound = computeTileBound(*tile);
 
                     auto plod = vsg::PagedLOD::create();
                     plod->bound = bound;
@@ -152,6 +212,7 @@ vsg::ref_ptr<vsg::Object> TileReader::read_subtile(uint32_t x, uint32_t y, uint3
         uint32_t local_y;
     };
 
+    std::vector<TileID> tileIDs;
     vsg::Paths tiles;
     std::map<vsg::Path, TileID> pathToTileID;
 
@@ -164,53 +225,101 @@ vsg::ref_ptr<vsg::Object> TileReader::read_subtile(uint32_t x, uint32_t y, uint3
         {
             uint32_t local_x = subtile_x + dx;
             uint32_t local_y = subtile_y + dy;
-            auto tilePath = getTilePath(imageLayer, local_x, local_y, local_lod);
-            tiles.push_back(tilePath);
-            pathToTileID[tilePath] = TileID{local_x, local_y};
+            tileIDs.push_back(TileID{local_x, local_y});
+            if (!archive)
+            {
+                auto tilePath = getTilePath(imageLayer, local_x, local_y, local_lod);
+                tiles.push_back(tilePath);
+                pathToTileID[tilePath] = TileID{local_x, local_y};
+            }
         }
     }
 
-    auto pathObjects = vsg::read(tiles, options);
+    auto elapsed = [](vsg::time_point start, vsg::time_point end) {
+        return std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+    };
+
+    struct ImageTile
+    {
+        TileID tileID;
+        vsg::Path tilePath;
+        vsg::ref_ptr<vsg::Data> image;
+    };
 
-    if (pathObjects.size() == 4)
+    std::vector<ImageTile> imageTiles;
+    if (archive)
     {
-        for (auto& [tilePath, object] : pathObjects)
+        // tiles are read directly from the memory mapped archive so no need for vsg::read()'s multi-threaded file requests
+        for (auto& tileID : tileIDs)
         {
-            auto& tileID = pathToTileID[tilePath];
-            auto imageTile = object.cast<vsg::Data>();
-            if (imageTile)
+            imageTiles.push_back(ImageTile{tileID, {}, archive->readTile(tileID.local_x, tileID.local_y, local_lod, options)});
+        }
+    }
+    else
+    {
+        auto pathObjects = vsg::read(tiles, options);
+        if (pathObjects.size() == 4)
+        {
+            for (auto& [tilePath, object] : pathObjects)
             {
-                auto tile_extents = computeTileExtents(tileID.local_x, tileID.local_y, local_lod);
-                auto tile = createTile(tile_extents, imageTile);
-                if (tile)
+                imageTiles.push_back(ImageTile{pathToTileID[tilePath], tilePath, object.cast<vsg::Data>()});
+            }
+        }
+    }
+
+    vsg::time_point end_fetch = vsg::clock::now();
+
+    uint64_t numBytes = 0;
+    for (auto& imageTile : imageTiles)
+    {
+        if (imageTile.image) numBytes += imageTile.image->dataSize();
+        imageTile.image = prepareImageTile(imageTile.tilePath, imageTile.image, options);
+    }
+
+    vsg::time_point end_decode = vsg::clock::now();
+
+    double meshBuildTime = 0.0;
+    double scenegraphBuildTime = 0.0;
+
+    for (auto& [tileID, tilePath, imageTile] : imageTiles)
+    {
+        if (imageTile)
+        {
+            vsg::time_point start_mesh = vsg::clock::now();
+
+            auto tile_extents = computeTileExtents(tileID.local_x, tileID.local_y, local_lod);
+            auto tile = createTile(tile_extents, imageTile);
+
+            vsg::time_point end_mesh = vsg::clock::now();
+            meshBuildTime += elapsed(start_mesh, end_mesh);
+
+            if (tile)
+            {
+                auto bound = computeTileBound(*tile);
+
+                if (local_lod < maxLevel)
+                {
+                    auto plod = vsg::PagedLOD::create();
+                    plod->bound = bound;
+                    plod->children[0] = vsg::PagedLOD::Child{lodTransitionScreenHeightRatio, {}}; // external child visible when it's bound occupies more than 1/4 of the height of the window
+                    plod->children[1] = vsg::PagedLOD::Child{0.0, tile};                          // visible always
+                    plod->filename = vsg::make_string(tileID.local_x, " ", tileID.local_y, " ", local_lod, ".tile");
+                    plod->options = options;
+
+                    //std::cout<<"plod->filename "<<plod->filename<<std::endl;
+
+                    group->addChild(plod);
+                }
+                else
                 {
-                    vsg::ComputeBounds computeBound;
-                    tile->accept(computeBound);
-                    auto& bb = computeBound.bounds;
-                    vsg::dsphere bound((bb.min.x + bb.max.x) * 0.5, (bb.min.y + bb.max.y) * 0.5, (bb.min.z + bb.max.z) * 0.5, vsg::length(bb.max - bb.min) * 0.5);
-
-                    if (local_lod < maxLevel)
-                    {
-                        auto plod = vsg::PagedLOD::create();
-                        plod->bound = bound;
-                        plod->children[0] = vsg::PagedLOD::Child{lodTransitionScreenHeightRatio, {}}; // external child visible when it's bound occupies more than 1/4 of the height of the window
-                        plod->children[1] = vsg::PagedLOD::Child{0.0, tile};                          // visible always
-                        plod->filename = vsg::make_string(tileID.local_x, " ", tileID.local_y, " ", local_lod, ".tile");
-                        plod->options = options;
-
-                        //std::cout<<"plod->filename "<<plod->filename<<std::endl;
-
-                        group->addChild(plod);
-                    }
-                    else
-                    {
-                        auto cullGroup = vsg::CullGroup::create();
-                        cullGroup->bound = bound;
-                        cullGroup->addChild(tile);
-
-                        group->addChild(cullGroup);
-                    }
+                    auto cullGroup = vsg::CullGroup::create();
+                    cullGroup->bound = bound;
+                    cullGroup->addChild(tile);
+
+                    group->addChild(cullGroup);
                 }
+
+                scenegraphBuildTime += elapsed(end_mesh, vsg::clock::now());
             }
         }
     }
@@ -225,6 +334,13 @@ vsg::ref_ptr<vsg::Object> TileReader::read_subtile(uint32_t x, uint32_t y, uint3
         totalTimeReadingTiles += time_to_read_tile;
     }
 
+    stats->record(local_lod, TileReaderStats::FETCH, elapsed(start_read, end_fetch));
+    stats->record(local_lod, TileReaderStats::DECODE, elapsed(end_fetch, end_decode));
+    stats->record(local_lod, TileReaderStats::MESH_BUILD, meshBuildTime);
+    stats->record(local_lod, TileReaderStats::SCENEGRAPH_BUILD, scenegraphBuildTime);
+    stats->record(local_lod, TileReaderStats::TOTAL, elapsed(start_read, end_read));
+    stats->recordTiles(local_lod, group->children.size(), numBytes);
+
     if (group->children.size() != 4)
     {
         vsg::warn("Warning: could not load all 4 subtiles, loaded only ", group->children.size());
@@ -237,6 +353,32 @@ vsg::ref_ptr<vsg::Object> TileReader::read_subtile(uint32_t x, uint32_t y, uint3
 
 void TileReader::init()
 {
+    // open the local tile archive and adopt its layout
+    const std::string archiveScheme("archive:");
+    auto imageLayerString = imageLayer.string();
+    if (imageLayerString.compare(0, archiveScheme.length(), archiveScheme) == 0)
+    {
+        vsg::Path archiveFilename(imageLayerString.substr(archiveScheme.length()));
+
+        archive = TileArchive::create();
+        if (archive->open(archiveFilename))
+        {
+            auto& header = archive->header();
+            extents.min.set(header.extents[0], header.extents[1], 0.0);
+            extents.max.set(header.extents[2], header.extents[3], 1.0);
+            noX = header.noX;
+            noY = header.noY;
+            maxLevel = std::min(maxLevel, header.maxLevel);
+            originTopLeft = header.originTopLeft != 0;
+            if (header.sphericalMercator) projection = "EPSG:3857";
+        }
+        else
+        {
+            vsg::warn("TileReader::init() could not open tile archive ", archiveFilename);
+            archive = {};
+        }
+    }
+
     // set up graphics pipeline
     vsg::DescriptorSetLayoutBindings descriptorBindings{
         {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr} // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
@@ -302,8 +444,25 @@ vsg::ref_ptr<vsg::StateGroup> TileReader::createRoot() const
     return root;
 }
 
+vsg::dsphere TileReader::computeTileBound(const vsg::Node& tile) const
+{
+    // batched tiles have no geometry of their own so carry their bound
+    if (auto batchedTile = tile.cast<BatchedTile>()) return batchedTile->bound;
+
+    vsg::ComputeBounds computeBound;
+    tile.accept(computeBound);
+    auto& bb = computeBound.bounds;
+    return vsg::dsphere((bb.min.x + bb.max.x) * 0.5, (bb.min.y + bb.max.y) * 0.5, (bb.min.z + bb.max.z) * 0.5, vsg::length(bb.max - bb.min) * 0.5);
+}
+
 vsg::ref_ptr<vsg::Node> TileReader::createTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const
 {
+    // fall back to a standalone tile if the image doesn't match the pool or the pool is full
+    if (tilePool && tilePool->compatible(sourceData))
+    {
+        if (auto tile = createBatchedTile(tile_extents, sourceData)) return tile;
+    }
+
 #if 1
     return createECEFTile(tile_extents, sourceData);
 #else
@@ -475,3 +634,40 @@ vsg::ref_ptr<vsg::Node> TileReader::createTextureQuad(const vsg::dbox& tile_exte
 
     return scenegraph;
 }
+
+vsg::ref_ptr<vsg::Node> TileReader::createBatchedTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> textureData) const
+{
+    vsg::dvec3 center = computeLatitudeLongitudeAltitude((tile_extents.min + tile_extents.max) * 0.5);
+
+    auto localToWorld = ellipsoidModel->computeLocalToWorldTransform(center);
+    auto worldToLocal = vsg::inverse(localToWorld);
+
+    const uint32_t numRows = TilePool::numRows;
+    const uint32_t numCols = TilePool::numColumns;
+
+    double longitudeOrigin = tile_extents.min.x;
+    double longitudeScale = (tile_extents.max.x - tile_extents.min.x) / double(numCols - 1);
+    double latitudeOrigin = tile_extents.min.y;
+    double latitudeScale = (tile_extents.max.y - tile_extents.min.y) / double(numRows - 1);
+
+    // only positions are stored in the pool, texture coordinates are computed by the vertex shader from the vertex index
+    auto vertices = vsg::vec3Array::create(numRows * numCols);
+    vsg::dbox bb;
+    for (uint32_t r = 0; r < numRows; ++r)
+    {
+        for (uint32_t c = 0; c < numCols; ++c)
+        {
+            vsg::dvec3 location(longitudeOrigin + double(c) * longitudeScale, latitudeOrigin + double(r) * latitudeScale, 0.0);
+            auto ecef = ellipsoidModel->convertLatLongAltitudeToECEF(computeLatitudeLongitudeAltitude(location));
+
+            vertices->set(c + r * numCols, vsg::vec3(worldToLocal * ecef));
+            bb.add(ecef);
+        }
+    }
+
+    auto slot = tilePool->allocate(vertices, textureData);
+    if (slot == TilePool::invalidSlot) return {};
+
+    vsg::dsphere bound((bb.min.x + bb.max.x) * 0.5, (bb.min.y + bb.max.y) * 0.5, (bb.min.z + bb.max.z) * 0.5, vsg::length(bb.max - bb.min) * 0.5);
+    return BatchedTile::create(tilePool, slot, localToWorld, bound);
+}
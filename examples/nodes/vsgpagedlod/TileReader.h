@@ -2,6 +2,11 @@
 
 #include <vsg/all.h>
 
+#include "TileArchive.h"
+#include "TilePool.h"
+#include "TilePrefetcher.h"
+#include "TileReaderStats.h"
+
 class TileReader : public vsg::Inherit<vsg::ReaderWriter, TileReader>
 {
 public:
@@ -16,10 +21,20 @@ public:
     std::string projection;
     vsg::ref_ptr<vsg::EllipsoidModel> ellipsoidModel = vsg::EllipsoidModel::create();
 
+    // image layer either a {z}/{x}/{y} path template, or a local tile archive in the form archive:filename
     vsg::Path imageLayer;
     vsg::Path terrainLayer;
     uint32_t mipmapLevelsHint = 16;
 
+    // block compressed format that image tiles are transcoded to on the loading threads, VK_FORMAT_UNDEFINED disables transcoding
+    VkFormat compressedImageFormat = VK_FORMAT_UNDEFINED;
+
+    // tile archive opened by init() when the imageLayer uses the archive: scheme
+    vsg::ref_ptr<TileArchive> archive;
+
+    // when assigned, tiles are suballocated from the pool's shared buffers and texture array rather than having their own state and geometry
+    vsg::ref_ptr<TilePool> tilePool;
+
     void init();
 
     vsg::ref_ptr<vsg::Object> read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) const override;
@@ -28,6 +43,14 @@ public:
     mutable std::mutex statsMutex;
     mutable uint64_t numTilesRead{0};
     mutable double totalTimeReadingTiles{0.0};
+    mutable uint64_t numImageBytesRead{0};
+    mutable uint64_t numImageBytesUploaded{0};
+
+    // optional prefetcher whose cache is checked before loading subtiles
+    vsg::ref_ptr<TilePrefetcher> prefetcher;
+
+    // per level, per phase timing histograms of read_subtile()
+    vsg::ref_ptr<TileReaderStats> stats = TileReaderStats::create();
 
 protected:
     vsg::dvec3 computeLatitudeLongitudeAltitude(const vsg::dvec3& src) const;
@@ -37,9 +60,15 @@ protected:
     vsg::ref_ptr<vsg::Object> read_root(vsg::ref_ptr<const vsg::Options> options = {}) const;
     vsg::ref_ptr<vsg::Object> read_subtile(uint32_t x, uint32_t y, uint32_t lod, vsg::ref_ptr<const vsg::Options> options = {}) const;
 
+    vsg::Path getTranscodedCachePath(const vsg::Path& tilePath, vsg::ref_ptr<const vsg::Options> options) const;
+    vsg::ref_ptr<vsg::Data> prepareImageTile(const vsg::Path& tilePath, vsg::ref_ptr<vsg::Data> imageTile, vsg::ref_ptr<const vsg::Options> options) const;
+
     vsg::ref_ptr<vsg::Node> createTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const;
     vsg::ref_ptr<vsg::Node> createECEFTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const;
     vsg::ref_ptr<vsg::Node> createTextureQuad(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const;
+    vsg::ref_ptr<vsg::Node> createBatchedTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const;
+
+    vsg::dsphere computeTileBound(const vsg::Node& tile) const;
 
     vsg::ref_ptr<vsg::StateGroup> createRoot() const;
 
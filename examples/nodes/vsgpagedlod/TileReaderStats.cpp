@@ -0,0 +1,214 @@
+#include "TileReaderStats.h"
+
+#include <cmath>
+#include <fstream>
+
+namespace
+{
+    void increment(std::atomic_uint64_t& counter, uint64_t value)
+    {
+        // single writer so avoid the cost of an atomic read-modify-write
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    uint32_t bucketForMicroseconds(double microseconds)
+    {
+        if (microseconds < 1.0) return 0;
+        auto bucket = static_cast<uint32_t>(4.0 * std::log2(microseconds)) + 1;
+        return std::min(bucket, TileReaderStats::numBuckets - 1);
+    }
+
+    double bucketLowerBound(uint32_t bucket)
+    {
+        return (bucket == 0) ? 0.0 : std::pow(2.0, double(bucket - 1) * 0.25);
+    }
+
+    // percentile in milliseconds, interpolating linearly within the bucket that contains it
+    double percentile(const uint64_t* buckets, uint64_t count, double ratio)
+    {
+        if (count == 0) return 0.0;
+
+        double target = ratio * double(count);
+        uint64_t cumulative = 0;
+        for (uint32_t b = 0; b < TileReaderStats::numBuckets; ++b)
+        {
+            if (buckets[b] == 0) continue;
+            if (double(cumulative + buckets[b]) >= target)
+            {
+                double fraction = (target - double(cumulative)) / double(buckets[b]);
+                double lower = bucketLowerBound(b);
+                double upper = bucketLowerBound(b + 1);
+                return (lower + (upper - lower) * fraction) * 0.001;
+            }
+            cumulative += buckets[b];
+        }
+        return bucketLowerBound(TileReaderStats::numBuckets) * 0.001;
+    }
+
+    std::atomic_uint64_t s_nextStatsID{0};
+} // namespace
+
+TileReaderStats::TileReaderStats() :
+    _id(s_nextStatsID++)
+{
+}
+
+const char* TileReaderStats::phaseName(Phase phase)
+{
+    switch (phase)
+    {
+    case FETCH: return "fetch";
+    case DECODE: return "decode";
+    case MESH_BUILD: return "mesh_build";
+    case SCENEGRAPH_BUILD: return "scenegraph_build";
+    case TOTAL: return "total";
+    default: return "unknown";
+    }
+}
+
+TileReaderStats::ThreadCounters& TileReaderStats::threadCounters()
+{
+    struct CacheEntry
+    {
+        uint64_t id;
+        ThreadCounters* counters;
+    };
+
+    // cache the counters for each TileReaderStats this thread has recorded to, so the mutex is only taken on first use
+    thread_local std::vector<CacheEntry> cache;
+    for (auto& entry : cache)
+    {
+        if (entry.id == _id) return *entry.counters;
+    }
+
+    std::scoped_lock<std::mutex> lock(_threadCountersMutex);
+
+    // value initialization zeros the atomic counters
+    _threadCounters.emplace_back(new ThreadCounters());
+    cache.push_back(CacheEntry{_id, _threadCounters.back().get()});
+    return *_threadCounters.back();
+}
+
+void TileReaderStats::record(uint32_t level, Phase phase, double milliseconds)
+{
+    level = std::min(level, maxNumLevels - 1);
+
+    auto& counters = threadCounters();
+    increment(counters.histograms[level][phase][bucketForMicroseconds(milliseconds * 1000.0)], 1);
+    increment(counters.totalTime[level][phase], static_cast<uint64_t>(milliseconds * 1.0e6));
+}
+
+void TileReaderStats::recordTiles(uint32_t level, uint64_t numTiles, uint64_t numBytes)
+{
+    level = std::min(level, maxNumLevels - 1);
+
+    auto& counters = threadCounters();
+    increment(counters.numTiles[level], numTiles);
+    increment(counters.numBytes[level], numBytes);
+}
+
+void TileReaderStats::sampleQueueDepth(double time, uint32_t queueDepth)
+{
+    std::scoped_lock<std::mutex> lock(_queueDepthMutex);
+    _queueDepthSamples.push_back(QueueDepthSample{time, queueDepth});
+}
+
+std::vector<TileReaderStats::LevelSummary> TileReaderStats::summarize() const
+{
+    std::vector<LevelSummary> summaries;
+
+    std::scoped_lock<std::mutex> lock(_threadCountersMutex);
+    for (uint32_t level = 0; level < maxNumLevels; ++level)
+    {
+        LevelSummary summary;
+        summary.level = level;
+
+        uint64_t buckets[NUM_PHASES][numBuckets] = {};
+        uint64_t totalTime[NUM_PHASES] = {};
+        for (auto& counters : _threadCounters)
+        {
+            summary.numTiles += counters->numTiles[level].load(std::memory_order_relaxed);
+            summary.numBytes += counters->numBytes[level].load(std::memory_order_relaxed);
+            for (uint32_t phase = 0; phase < NUM_PHASES; ++phase)
+            {
+                totalTime[phase] += counters->totalTime[level][phase].load(std::memory_order_relaxed);
+                for (uint32_t b = 0; b < numBuckets; ++b) buckets[phase][b] += counters->histograms[level][phase][b].load(std::memory_order_relaxed);
+            }
+        }
+
+        bool hasSamples = summary.numTiles > 0;
+        for (uint32_t phase = 0; phase < NUM_PHASES; ++phase)
+        {
+            auto& phaseSummary = summary.phases[phase];
+            for (uint32_t b = 0; b < numBuckets; ++b) phaseSummary.count += buckets[phase][b];
+            phaseSummary.total = double(totalTime[phase]) * 1.0e-6;
+            phaseSummary.p50 = percentile(buckets[phase], phaseSummary.count, 0.50);
+            phaseSummary.p95 = percentile(buckets[phase], phaseSummary.count, 0.95);
+            phaseSummary.p99 = percentile(buckets[phase], phaseSummary.count, 0.99);
+            if (phaseSummary.count > 0) hasSamples = true;
+        }
+
+        if (hasSamples) summaries.push_back(summary);
+    }
+
+    return summaries;
+}
+
+void TileReaderStats::writeCSV(std::ostream& output) const
+{
+    output << "level,phase,count,total_ms,mean_ms,p50_ms,p95_ms,p99_ms,tiles,bytes\n";
+    for (auto& summary : summarize())
+    {
+        for (uint32_t phase = 0; phase < NUM_PHASES; ++phase)
+        {
+            auto& p = summary.phases[phase];
+            double mean = p.count > 0 ? p.total / double(p.count) : 0.0;
+            output << summary.level << "," << phaseName(Phase(phase)) << "," << p.count << "," << p.total << "," << mean << "," << p.p50 << "," << p.p95 << "," << p.p99 << "," << summary.numTiles << "," << summary.numBytes << "\n";
+        }
+    }
+
+    output << "\ntime_s,queue_depth\n";
+    std::scoped_lock<std::mutex> lock(_queueDepthMutex);
+    for (auto& sample : _queueDepthSamples)
+    {
+        output << sample.time << "," << sample.queueDepth << "\n";
+    }
+}
+
+void TileReaderStats::writeJSON(std::ostream& output) const
+{
+    output << "{\n  \"levels\": [";
+    auto summaries = summarize();
+    for (size_t i = 0; i < summaries.size(); ++i)
+    {
+        auto& summary = summaries[i];
+        output << (i > 0 ? ",\n" : "\n") << "    {\"level\": " << summary.level << ", \"tiles\": " << summary.numTiles << ", \"bytes\": " << summary.numBytes << ", \"phases\": {";
+        for (uint32_t phase = 0; phase < NUM_PHASES; ++phase)
+        {
+            auto& p = summary.phases[phase];
+            output << (phase > 0 ? ", " : "") << "\"" << phaseName(Phase(phase)) << "\": {\"count\": " << p.count << ", \"total_ms\": " << p.total << ", \"p50_ms\": " << p.p50 << ", \"p95_ms\": " << p.p95 << ", \"p99_ms\": " << p.p99 << "}";
+        }
+        output << "}}";
+    }
+    output << "\n  ],\n  \"queue_depth\": [";
+
+    std::scoped_lock<std::mutex> lock(_queueDepthMutex);
+    for (size_t i = 0; i < _queueDepthSamples.size(); ++i)
+    {
+        output << (i > 0 ? ", " : "") << "[" << _queueDepthSamples[i].time << ", " << _queueDepthSamples[i].queueDepth << "]";
+    }
+    output << "]\n}\n";
+}
+
+bool TileReaderStats::write(const vsg::Path& filename) const
+{
+    std::ofstream fout(filename.string());
+    if (!fout) return false;
+
+    if (vsg::lowerCaseFileExtension(filename) == ".json")
+        writeJSON(fout);
+    else
+        writeCSV(fout);
+
+    return static_cast<bool>(fout);
+}
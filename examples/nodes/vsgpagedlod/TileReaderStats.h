@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <memory>
+
+// TileReaderStats collects per level timing histograms of the phases of TileReader::read_subtile().
+// Each loading thread writes to its own set of counters so recording never contends on a lock,
+// the per thread counters are merged when a summary is requested.
+//
+// Phases:
+//     FETCH             reading the image tiles, when loading via vsg::read() this includes image decoding by the ReaderWriter
+//     DECODE            preparing the image data for upload, including optional transcoding and file cache access
+//     MESH_BUILD        creating the tile geometry and state
+//     SCENEGRAPH_BUILD  computing bounds and setting up the PagedLOD/CullGroup hierarchy
+//     TOTAL             whole read_subtile() call
+class TileReaderStats : public vsg::Inherit<vsg::Object, TileReaderStats>
+{
+public:
+    enum Phase : uint32_t
+    {
+        FETCH,
+        DECODE,
+        MESH_BUILD,
+        SCENEGRAPH_BUILD,
+        TOTAL,
+        NUM_PHASES
+    };
+
+    static constexpr uint32_t maxNumLevels = 24;
+
+    // histogram buckets are spaced at quarter powers of two of microseconds, the last bucket is ~16 seconds
+    static constexpr uint32_t numBuckets = 96;
+
+    TileReaderStats();
+
+    void record(uint32_t level, Phase phase, double milliseconds);
+    void recordTiles(uint32_t level, uint64_t numTiles, uint64_t numBytes);
+
+    // record the number of outstanding tile requests, called once per frame from the main thread
+    void sampleQueueDepth(double time, uint32_t queueDepth);
+
+    struct PhaseSummary
+    {
+        uint64_t count = 0;
+        double total = 0.0; // milliseconds
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+    };
+
+    struct LevelSummary
+    {
+        uint32_t level = 0;
+        uint64_t numTiles = 0;
+        uint64_t numBytes = 0;
+        PhaseSummary phases[NUM_PHASES];
+    };
+
+    struct QueueDepthSample
+    {
+        double time;
+        uint32_t queueDepth;
+    };
+
+    // merge the per thread counters, only levels with recorded tiles are returned
+    std::vector<LevelSummary> summarize() const;
+
+    void writeCSV(std::ostream& output) const;
+    void writeJSON(std::ostream& output) const;
+
+    // write to filename, using JSON if the extension is .json, CSV otherwise
+    bool write(const vsg::Path& filename) const;
+
+    static const char* phaseName(Phase phase);
+
+protected:
+    // counters are only ever written by their owning thread so relaxed load/store pairs are sufficient, readers may see slightly stale values
+    struct ThreadCounters
+    {
+        std::atomic_uint64_t histograms[maxNumLevels][NUM_PHASES][numBuckets];
+        std::atomic_uint64_t totalTime[maxNumLevels][NUM_PHASES]; // nanoseconds
+        std::atomic_uint64_t numTiles[maxNumLevels];
+        std::atomic_uint64_t numBytes[maxNumLevels];
+    };
+
+    ThreadCounters& threadCounters();
+
+    uint64_t _id;
+
+    mutable std::mutex _threadCountersMutex;
+    std::vector<std::unique_ptr<ThreadCounters>> _threadCounters;
+
+    mutable std::mutex _queueDepthMutex;
+    std::vector<QueueDepthSample> _queueDepthSamples;
+};
@@ -7,8 +7,33 @@
 #include <iostream>
 #include <thread>
 
+#include "TextureCompression.h"
 #include "TileReader.h"
 
+class WriteStatsHandler : public vsg::Inherit<vsg::Visitor, WriteStatsHandler>
+{
+public:
+    vsg::ref_ptr<TileReaderStats> stats;
+    vsg::Path filename;
+
+    WriteStatsHandler(vsg::ref_ptr<TileReaderStats> in_stats, const vsg::Path& in_filename) :
+        stats(in_stats),
+        filename(in_filename)
+    {
+    }
+
+    void apply(vsg::KeyPressEvent& keyPress) override
+    {
+        if (keyPress.keyBase == 's')
+        {
+            if (stats->write(filename))
+                std::cout << "Written tile reader stats to " << filename << std::endl;
+            else
+                std::cout << "Failed to write tile reader stats to " << filename << std::endl;
+        }
+    }
+};
+
 int main(int argc, char** argv)
 {
     //return 0;
@@ -51,6 +76,23 @@ int main(int argc, char** argv)
         if (arguments.read("--rgb")) options->mapRGBtoRGBAHint = false;
         arguments.read("--file-cache", options->fileCache);
         bool osgEarthStyleMouseButtons = arguments.read({"--osgearth", "-e"});
+        bool compressImages = arguments.read({"--compress", "-c"});
+        auto statsFilename = arguments.value(vsg::Path(), "--stats");
+        bool reportLowResolution = arguments.read("--low-res-stats");
+        auto maxNumBatchedTiles = arguments.value(0u, "--batch");
+        auto batchedTileImageSize = arguments.value(256u, "--batch-tile-size");
+
+        if (double lookAheadTime = 0.0; arguments.read("--prefetch", lookAheadTime))
+        {
+            // predict the tiles required over the next lookAheadTime seconds and load them ahead of the DatabasePager
+            auto prefetcher = TilePrefetcher::create(arguments.value(2u, "--prefetch-threads"));
+            prefetcher->lookAheadTime = lookAheadTime;
+            arguments.read("--prefetch-rate", prefetcher->maxTilesPerSecond);
+            arguments.read("--prefetch-in-flight", prefetcher->maxNumInFlight);
+            if (size_t cacheSizeMB = 0; arguments.read("--prefetch-cache", cacheSizeMB)) prefetcher->maxCacheSize = cacheSizeMB * 1024 * 1024;
+            tileReader->prefetcher = prefetcher;
+            reportLowResolution = true;
+        }
 
         uint32_t numOperationThreads = 0;
         if (arguments.read("--ot", numOperationThreads)) options->operationThreads = vsg::OperationThreads::create(numOperationThreads);
@@ -66,6 +108,12 @@ int main(int argc, char** argv)
             tileReader->imageLayer = "http://a.tile.openstreetmap.org/{z}/{x}/{y}.png";
         }
 
+        if (vsg::Path archiveFilename; arguments.read("--archive", archiveFilename))
+        {
+            // local tile archive built with vsgtilebuilder, the tile layout is read from the archive by TileReader::init()
+            tileReader->imageLayer = vsg::Path(std::string("archive:") + archiveFilename.string());
+        }
+
         if (arguments.read("--rm") || !tileReader->imageLayer)
         {
             // setup ready map settings
@@ -92,17 +140,19 @@ int main(int argc, char** argv)
         // initial the state that will be shared between tiles.
         tileReader->init();
 
-        // load the root tile.
-        auto vsg_scene = vsg::read_cast<vsg::Node>("root.tile", options);
-        if (!vsg_scene) return 1;
-
         if (!outputFilename.empty())
         {
+            // no device to query when writing out, so fall back to the widely supported desktop format
+            if (compressImages) tileReader->compressedImageFormat = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+
+            auto vsg_scene = vsg::read_cast<vsg::Node>("root.tile", options);
+            if (!vsg_scene) return 1;
+
             vsg::write(vsg_scene, outputFilename);
             return 0;
         }
 
-        // create the viewer and assign window(s) to it
+        // create the viewer and assign window(s) to it, the window is created before the root tile is loaded so that the compressed image format can be matched to the device.
         auto viewer = vsg::Viewer::create();
         auto window = vsg::Window::create(windowTraits);
         if (!window)
@@ -113,6 +163,41 @@ int main(int argc, char** argv)
 
         viewer->addWindow(window);
 
+        if (compressImages)
+        {
+            // the Device hasn't been created yet so we can still enable the feature required by the selected format.
+            if (!windowTraits->deviceFeatures) windowTraits->deviceFeatures = vsg::DeviceFeatures::create();
+            tileReader->compressedImageFormat = selectCompressedImageFormat(window->getOrCreatePhysicalDevice(), windowTraits->deviceFeatures);
+            if (tileReader->compressedImageFormat == VK_FORMAT_UNDEFINED)
+            {
+                std::cout << "Warning: device does not support BC1 or ETC2 compressed images, tiles will not be compressed." << std::endl;
+            }
+        }
+
+        if (maxNumBatchedTiles > 0)
+        {
+            // draw all the tiles from shared vertex/index buffers and a texture array with a single indirect draw
+            if (!windowTraits->deviceFeatures) windowTraits->deviceFeatures = vsg::DeviceFeatures::create();
+            bool multiDrawIndirect = TilePool::enableDeviceFeatures(window->getOrCreatePhysicalDevice(), windowTraits->deviceFeatures);
+            if (!multiDrawIndirect)
+            {
+                std::cout << "Warning: device does not support multiDrawIndirect, batched tiles will be drawn with a draw call per tile." << std::endl;
+            }
+
+            auto device = window->getOrCreateDevice();
+            maxNumBatchedTiles = std::min(maxNumBatchedTiles, device->getPhysicalDevice()->getProperties().limits.maxImageArrayLayers);
+
+            VkFormat imageFormat = (tileReader->compressedImageFormat != VK_FORMAT_UNDEFINED) ? tileReader->compressedImageFormat : VK_FORMAT_R8G8B8A8_UNORM;
+            // the per frame buffers are sized to the number of frames that the viewer can have in flight, one per swapchain image
+            window->getOrCreateSwapchain();
+            auto numFramesInFlight = static_cast<uint32_t>(window->numFrames());
+            tileReader->tilePool = TilePool::create(device, numFramesInFlight, maxNumBatchedTiles, batchedTileImageSize, imageFormat, multiDrawIndirect);
+        }
+
+        // load the root tile.
+        auto vsg_scene = vsg::read_cast<vsg::Node>("root.tile", options);
+        if (!vsg_scene) return 1;
+
         // compute the bounds of the scene graph to help position camera
         vsg::ComputeBounds computeBounds;
         vsg_scene->accept(computeBounds);
@@ -164,6 +249,9 @@ int main(int argc, char** argv)
         // add close handler to respond the close window button and pressing escape
         viewer->addEventHandler(vsg::CloseHandler::create(viewer));
 
+        // write the TileReader stats on pressing 's' as well as on exit
+        if (statsFilename) viewer->addEventHandler(WriteStatsHandler::create(tileReader->stats, statsFilename));
+
         if (pathFilename.empty())
         {
             if (ellipsoidModel)
@@ -202,6 +290,13 @@ int main(int argc, char** argv)
                 return 1;
             }
             viewer->addEventHandler(vsg::AnimationPathHandler::create(camera, animationPath, viewer->start_point()));
+
+            if (tileReader->prefetcher)
+            {
+                // read ahead along the same path rather than extrapolating the camera's velocity
+                tileReader->prefetcher->animationPath = animationPath;
+                tileReader->prefetcher->animationStartPoint = viewer->start_point();
+            }
         }
 
         // if required pre load specific number of PagedLOD levels.
@@ -217,8 +312,27 @@ int main(int argc, char** argv)
             std::cout << "No. of tiles loaed " << loadPagedLOD.numTiles << " in " << time << "ms." << std::endl;
         }
 
-        auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
-        viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
+        vsg::CommandGraphs commandGraphs;
+        vsg::ref_ptr<vsg::Node> scene = vsg_scene;
+        if (auto tilePool = tileReader->tilePool)
+        {
+            // tile uploads have to be recorded outside the render pass so go in their own CommandGraph ahead of the main one
+            auto uploadCommandGraph = vsg::CommandGraph::create(window);
+            uploadCommandGraph->addChild(TilePoolUpload::create(tilePool));
+            commandGraphs.push_back(uploadCommandGraph);
+
+            // the batched draw has to be recorded after the tiles have been culled and added themselves to the pool's visible list
+            auto drawGraph = tilePool->createDrawGraph(camera->viewMatrix, options);
+            if (!drawGraph) return 1;
+
+            auto group = vsg::Group::create();
+            group->addChild(vsg_scene);
+            group->addChild(drawGraph);
+            scene = group;
+        }
+
+        commandGraphs.push_back(vsg::createCommandGraphForView(window, camera, scene));
+        viewer->assignRecordAndSubmitTaskAndPresentation(commandGraphs);
 #if 0
         auto resourceHints = vsg::ResourceHints::create();
         resourceHints->numDescriptorSets = 1024;
@@ -236,6 +350,21 @@ int main(int argc, char** argv)
             }
         }
 
+        uint64_t numFramesRendered = 0;
+        uint64_t previousImageBytesUploaded = 0;
+        uint64_t maxImageBytesUploadedPerFrame = 0;
+
+        // time spent showing low resolution tiles in place of the high resolution tiles that should be visible
+        uint64_t numLowResolutionFrames = 0;
+        uint64_t totalLowResolutionTiles = 0;
+        double lowResolutionTime = 0.0;
+        double lowResolutionTileTime = 0.0;
+        auto previousFrameTime = viewer->start_point();
+
+        double totalRecordTime = 0.0;
+        uint64_t totalTilesDrawn = 0;
+        uint64_t totalDrawCalls = 0;
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
@@ -244,9 +373,73 @@ int main(int argc, char** argv)
 
             viewer->update();
 
+            auto frameStamp = viewer->getFrameStamp();
+            if (tileReader->prefetcher) tileReader->prefetcher->update(*camera, *vsg_scene, *frameStamp);
+
+            if (reportLowResolution)
+            {
+                LowResolutionTiles lowResolutionTiles(camera->projectionMatrix->transform(), camera->viewMatrix->transform());
+                vsg_scene->accept(lowResolutionTiles);
+
+                double frameDuration = std::chrono::duration<double>(frameStamp->time - previousFrameTime).count();
+                previousFrameTime = frameStamp->time;
+
+                if (lowResolutionTiles.numLowResolutionTiles > 0)
+                {
+                    ++numLowResolutionFrames;
+                    totalLowResolutionTiles += lowResolutionTiles.numLowResolutionTiles;
+                    lowResolutionTime += frameDuration;
+                    lowResolutionTileTime += frameDuration * double(lowResolutionTiles.numLowResolutionTiles);
+                }
+            }
+
+            auto startRecord = vsg::clock::now();
+
             viewer->recordAndSubmit();
 
+            totalRecordTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startRecord).count();
+            if (auto tilePool = tileReader->tilePool)
+            {
+                totalTilesDrawn += tilePool->numTilesDrawn;
+                totalDrawCalls += tilePool->numDrawCalls;
+            }
+
             viewer->present();
+
+            // track the image data that has been made available for upload during this frame
+            {
+                std::scoped_lock<std::mutex> lock(tileReader->statsMutex);
+                maxImageBytesUploadedPerFrame = std::max(maxImageBytesUploadedPerFrame, tileReader->numImageBytesUploaded - previousImageBytesUploaded);
+                previousImageBytesUploaded = tileReader->numImageBytesUploaded;
+            }
+            ++numFramesRendered;
+
+            if (statsFilename)
+            {
+                uint32_t queueDepth = 0;
+                for (auto& task : viewer->recordAndSubmitTasks)
+                {
+                    if (task->databasePager) queueDepth += task->databasePager->numActiveRequests.load();
+                }
+                tileReader->stats->sampleQueueDepth(std::chrono::duration<double>(vsg::clock::now() - viewer->start_point()).count(), queueDepth);
+            }
+        }
+
+        if (statsFilename) tileReader->stats->write(statsFilename);
+
+        if (reportLowResolution)
+        {
+            std::cout << "frames with low resolution tiles = " << numLowResolutionFrames << " of " << numFramesRendered << std::endl;
+            std::cout << "time with low resolution tiles visible = " << lowResolutionTime << "s, low resolution tile seconds = " << lowResolutionTileTime << std::endl;
+            if (numLowResolutionFrames > 0) std::cout << "average low resolution tiles when present = " << (double(totalLowResolutionTiles) / double(numLowResolutionFrames)) << std::endl;
+        }
+
+        if (auto prefetcher = tileReader->prefetcher)
+        {
+            // stop the threads and release the cached tiles, these reference the Options so would otherwise keep them alive
+            prefetcher->stop();
+            std::cout << "prefetch requested = " << prefetcher->numRequested << ", loaded = " << prefetcher->numLoaded << ", hits = " << prefetcher->numHits << ", cancelled = " << prefetcher->numCancelled << ", evicted = " << prefetcher->numEvicted << std::endl;
+            tileReader->prefetcher = {};
         }
 
         {
@@ -254,6 +447,18 @@ int main(int argc, char** argv)
             std::cout << "numOperationThreads = " << numOperationThreads << std::endl;
             std::cout << "numTilesRead = " << tileReader->numTilesRead << std::endl;
             std::cout << "average TimeReadingTiles = " << (tileReader->totalTimeReadingTiles / static_cast<double>(tileReader->numTilesRead)) << std::endl;
+            std::cout << "compressedImageFormat = " << tileReader->compressedImageFormat << std::endl;
+            std::cout << "image data read = " << tileReader->numImageBytesRead << " bytes, uploaded = " << tileReader->numImageBytesUploaded << " bytes" << std::endl;
+            if (numFramesRendered > 0)
+            {
+                std::cout << "average image bytes uploaded per frame = " << (tileReader->numImageBytesUploaded / numFramesRendered) << ", maximum = " << maxImageBytesUploadedPerFrame << std::endl;
+                std::cout << "average record and submit time = " << (totalRecordTime / double(numFramesRendered)) << "ms" << std::endl;
+                if (auto tilePool = tileReader->tilePool)
+                {
+                    std::cout << "average batched tiles drawn per frame = " << (double(totalTilesDrawn) / double(numFramesRendered)) << " using " << (double(totalDrawCalls) / double(numFramesRendered)) << " draw calls, "
+                              << tilePool->numSlotsUsed() << " of " << tilePool->maxNumTiles << " pool slots in use" << std::endl;
+                }
+            }
         }
     }
     catch (const vsg::Exception& ve)
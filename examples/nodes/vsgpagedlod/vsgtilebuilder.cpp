@@ -0,0 +1,319 @@
+#include <vsg/all.h>
+
+#include <vsgXchange/all.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+#include "TextureCompression.h"
+#include "TileArchive.h"
+
+struct TileJob
+{
+    uint32_t level;
+    uint32_t x;
+    uint32_t y;
+};
+
+// matches TileReader::computeTileExtents()
+vsg::dbox computeTileExtents(const TileArchive::Header& header, uint32_t x, uint32_t y, uint32_t level)
+{
+    double multiplier = pow(0.5, double(level));
+    double tileWidth = multiplier * (header.extents[2] - header.extents[0]) / double(header.noX);
+    double tileHeight = multiplier * (header.extents[3] - header.extents[1]) / double(header.noY);
+
+    vsg::dbox tile_extents;
+    if (header.originTopLeft)
+    {
+        vsg::dvec3 origin(header.extents[0], header.extents[3], 0.0);
+        tile_extents.min = origin + vsg::dvec3(double(x) * tileWidth, -double(y + 1) * tileHeight, 0.0);
+        tile_extents.max = origin + vsg::dvec3(double(x + 1) * tileWidth, -double(y) * tileHeight, 1.0);
+    }
+    else
+    {
+        vsg::dvec3 origin(header.extents[0], header.extents[1], 0.0);
+        tile_extents.min = origin + vsg::dvec3(double(x) * tileWidth, double(y) * tileHeight, 0.0);
+        tile_extents.max = origin + vsg::dvec3(double(x + 1) * tileWidth, double(y + 1) * tileHeight, 1.0);
+    }
+    return tile_extents;
+}
+
+vsg::Path getTilePath(const vsg::Path& src, uint32_t x, uint32_t y, uint32_t level)
+{
+    auto path = src.string();
+    auto replace = [&path](const std::string& match, uint32_t value) {
+        auto pos = path.find(match);
+        if (pos != std::string::npos) path.replace(pos, match.length(), std::to_string(value));
+    };
+
+    replace("{z}", level);
+    replace("{x}", x);
+    replace("{y}", y);
+
+    return vsg::Path(path);
+}
+
+// bilinear sample of the source raster at the (u, v) texel coordinate, returning up to 4 components
+template<typename T>
+void sampleBilinear(const vsg::Data* source, uint32_t numComponents, double u, double v, float* result)
+{
+    int width = static_cast<int>(source->width());
+    int height = static_cast<int>(source->height());
+    auto data = static_cast<const uint8_t*>(source->dataPointer());
+    auto stride = source->stride();
+
+    u = std::clamp(u, 0.0, double(width - 1));
+    v = std::clamp(v, 0.0, double(height - 1));
+    int c0 = static_cast<int>(u);
+    int r0 = static_cast<int>(v);
+    int c1 = std::min(c0 + 1, width - 1);
+    int r1 = std::min(r0 + 1, height - 1);
+    float fc = static_cast<float>(u - double(c0));
+    float fr = static_cast<float>(v - double(r0));
+
+    auto texel = [&](int c, int r) { return reinterpret_cast<const T*>(data + (size_t(r) * width + c) * stride); };
+    auto t00 = texel(c0, r0);
+    auto t01 = texel(c1, r0);
+    auto t10 = texel(c0, r1);
+    auto t11 = texel(c1, r1);
+    for (uint32_t i = 0; i < numComponents; ++i)
+    {
+        float top = float(t00[i]) * (1.0f - fc) + float(t01[i]) * fc;
+        float bottom = float(t10[i]) * (1.0f - fc) + float(t11[i]) * fc;
+        result[i] = top * (1.0f - fr) + bottom * fr;
+    }
+}
+
+// resample the region of the source raster covered by tile_extents into a tileSize x tileSize tile, the source is assumed to cover the archive extents
+vsg::ref_ptr<vsg::Data> resampleTile(const vsg::Data* source, const TileArchive::Header& header, const vsg::dbox& tile_extents, uint32_t tileSize)
+{
+    bool elevation = (source->properties.format == VK_FORMAT_R32_SFLOAT);
+    uint32_t numComponents = elevation ? 1 : source->stride();
+    if (!elevation && numComponents != 3 && numComponents != 4) return {};
+
+    double sourceWidth = header.extents[2] - header.extents[0];
+    double sourceHeight = header.extents[3] - header.extents[1];
+    bool sourceTopLeft = (source->properties.origin == vsg::TOP_LEFT);
+
+    vsg::ref_ptr<vsg::Data> tile;
+    if (elevation)
+        tile = vsg::floatArray2D::create(tileSize, tileSize, vsg::Data::Properties{VK_FORMAT_R32_SFLOAT});
+    else
+        tile = vsg::ubvec4Array2D::create(tileSize, tileSize, vsg::Data::Properties{VK_FORMAT_R8G8B8A8_UNORM});
+    tile->properties.origin = vsg::TOP_LEFT;
+
+    float sample[4] = {0.0f, 0.0f, 0.0f, 255.0f};
+    for (uint32_t r = 0; r < tileSize; ++r)
+    {
+        // row 0 is the top edge of the tile
+        double y = tile_extents.max.y - (double(r) + 0.5) / double(tileSize) * (tile_extents.max.y - tile_extents.min.y);
+        double ny = (y - header.extents[1]) / sourceHeight;
+        double v = (sourceTopLeft ? (1.0 - ny) : ny) * double(source->height()) - 0.5;
+
+        for (uint32_t c = 0; c < tileSize; ++c)
+        {
+            double x = tile_extents.min.x + (double(c) + 0.5) / double(tileSize) * (tile_extents.max.x - tile_extents.min.x);
+            double u = (x - header.extents[0]) / sourceWidth * double(source->width()) - 0.5;
+
+            if (elevation)
+            {
+                sampleBilinear<float>(source, 1, u, v, sample);
+                static_cast<vsg::floatArray2D*>(tile.get())->set(c, r, sample[0]);
+            }
+            else
+            {
+                sampleBilinear<uint8_t>(source, numComponents, u, v, sample);
+                static_cast<vsg::ubvec4Array2D*>(tile.get())->set(c, r, vsg::ubvec4(uint8_t(sample[0] + 0.5f), uint8_t(sample[1] + 0.5f), uint8_t(sample[2] + 0.5f), uint8_t(sample[3] + 0.5f)));
+            }
+        }
+    }
+
+    return tile;
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        vsg::CommandLine arguments(&argc, argv);
+
+        auto options = vsg::Options::create();
+        options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
+        options->add(vsgXchange::all::create());
+        arguments.read(options);
+
+        TileArchive::Header header;
+        header.noX = arguments.value(header.noX, "--noX");
+        header.noY = arguments.value(header.noY, "--noY");
+        header.maxLevel = arguments.value(4u, "--max-level");
+        header.originTopLeft = arguments.read("--origin-top-left") ? 1 : 0;
+        header.sphericalMercator = arguments.read("--spherical-mercator") ? 1 : 0;
+        arguments.read("--extents", header.extents[0], header.extents[1], header.extents[2], header.extents[3]);
+
+        auto outputFilename = arguments.value(vsg::Path(), "-o");
+        auto sourceImageFilename = arguments.value(vsg::Path(), "--image");
+        auto sourceTileTemplate = arguments.value(vsg::Path(), "--tiles");
+        auto tileSize = arguments.value(256u, "--tile-size");
+        auto maxNumMipmaps = arguments.value(16u, "--mipmaps");
+        auto numThreads = arguments.value(std::max(1u, std::thread::hardware_concurrency()), "-n");
+        auto compressionName = arguments.value(std::string(), "--compress");
+
+        if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+        if (!outputFilename || (!sourceImageFilename && !sourceTileTemplate))
+        {
+            std::cout << "Usage: vsgtilebuilder -o archive.vsgtiles (--image raster | --tiles path/{z}/{x}/{y}.png)" << std::endl;
+            std::cout << "    [--max-level level] [--tile-size size] [--extents minX minY maxX maxY] [--noX n] [--noY n]" << std::endl;
+            std::cout << "    [--origin-top-left] [--spherical-mercator] [--mipmaps num] [--compress bc1|etc2] [-n numThreads]" << std::endl;
+            return 1;
+        }
+
+        VkFormat compressedFormat = VK_FORMAT_UNDEFINED;
+        if (compressionName == "bc1")
+            compressedFormat = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        else if (compressionName == "etc2")
+            compressedFormat = VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+        else if (!compressionName.empty())
+        {
+            std::cout << "Unsupported compression " << compressionName << ", use bc1 or etc2." << std::endl;
+            return 1;
+        }
+
+        vsg::ref_ptr<vsg::Data> sourceImage;
+        if (sourceImageFilename)
+        {
+            sourceImage = vsg::read_cast<vsg::Data>(sourceImageFilename, options);
+            if (!sourceImage)
+            {
+                std::cout << "Unable to read source image " << sourceImageFilename << std::endl;
+                return 1;
+            }
+        }
+
+        // tiles are first written to a staging directory alongside the archive, tiles already in the staging directory
+        // from a previous interrupted run are skipped so that builds can be resumed.
+        auto stagingDirectory = vsg::Path(outputFilename.string() + ".parts");
+        vsg::makeDirectory(stagingDirectory);
+
+        auto stagingPath = [&](const TileJob& job) {
+            return stagingDirectory / vsg::Path(vsg::make_string(job.level, "_", job.x, "_", job.y, ".vsgb"));
+        };
+
+        std::vector<TileJob> jobs;
+        for (uint32_t level = 0; level <= header.maxLevel; ++level)
+        {
+            uint32_t numColumns = header.noX << level;
+            uint32_t numRows = header.noY << level;
+            for (uint32_t y = 0; y < numRows; ++y)
+            {
+                for (uint32_t x = 0; x < numColumns; ++x)
+                {
+                    jobs.push_back(TileJob{level, x, y});
+                }
+            }
+        }
+
+        std::cout << "Building " << jobs.size() << " tiles using " << numThreads << " threads." << std::endl;
+
+        auto startTime = vsg::clock::now();
+
+        std::atomic_size_t nextJob{0};
+        std::atomic_size_t numTilesBuilt{0};
+        std::atomic_size_t numTilesSkipped{0};
+        std::atomic_size_t numTilesMissing{0};
+        std::atomic_size_t numWritesFailed{0};
+        std::atomic_size_t numRenamesFailed{0};
+
+        auto buildTiles = [&]() {
+            for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+            {
+                auto& job = jobs[i];
+                auto partFilename = stagingPath(job);
+                if (vsg::fileExists(partFilename))
+                {
+                    ++numTilesSkipped;
+                    continue;
+                }
+
+                vsg::ref_ptr<vsg::Data> tile;
+                if (sourceImage)
+                    tile = resampleTile(sourceImage, header, computeTileExtents(header, job.x, job.y, job.level), tileSize);
+                else
+                    tile = vsg::read_cast<vsg::Data>(getTilePath(sourceTileTemplate, job.x, job.y, job.level), options);
+
+                if (!tile)
+                {
+                    ++numTilesMissing;
+                    continue;
+                }
+
+                // elevation tiles and other unsupported formats are stored as they are
+                vsg::ref_ptr<vsg::Data> processed;
+                if (compressedFormat != VK_FORMAT_UNDEFINED)
+                    processed = compressImage(tile, compressedFormat, maxNumMipmaps);
+                else if (maxNumMipmaps > 1)
+                    processed = createMipmappedRGBA(tile, maxNumMipmaps);
+                if (processed) tile = processed;
+
+                // write to a temporary file then rename so that only complete tiles are picked up when resuming,
+                // the temporary file keeps the .vsgb extension as vsg::write selects the writer from it.
+                auto tempFilename = vsg::Path(vsg::removeExtension(partFilename).string() + ".tmp" + vsg::fileExtension(partFilename).string());
+                if (!vsg::write(tile, tempFilename, options))
+                {
+                    if (numWritesFailed++ == 0) std::cout << "Warning: failed to write " << tempFilename << std::endl;
+                    continue;
+                }
+
+                if (std::rename(tempFilename.string().c_str(), partFilename.string().c_str()) != 0)
+                {
+                    if (numRenamesFailed++ == 0) std::cout << "Warning: failed to rename " << tempFilename << " to " << partFilename << std::endl;
+                    continue;
+                }
+
+                if ((++numTilesBuilt % 1000) == 0) std::cout << "    built " << numTilesBuilt << " tiles" << std::endl;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < numThreads; ++i) threads.emplace_back(buildTiles);
+        for (auto& thread : threads) thread.join();
+
+        auto buildTime = std::chrono::duration<double>(vsg::clock::now() - startTime).count();
+        std::cout << "Built " << numTilesBuilt << " tiles, " << numTilesSkipped << " resumed from previous run, " << numTilesMissing << " unavailable, in " << buildTime << " seconds." << std::endl;
+        if (numWritesFailed > 0 || numRenamesFailed > 0)
+        {
+            std::cout << "Failed to stage " << (numWritesFailed + numRenamesFailed) << " tiles, " << numWritesFailed << " writes and " << numRenamesFailed << " renames failed." << std::endl;
+        }
+
+        // pack all the staged tiles into the archive
+        std::vector<TileArchive::SourceTile> sourceTiles;
+        for (auto& job : jobs)
+        {
+            auto partFilename = stagingPath(job);
+            if (vsg::fileExists(partFilename)) sourceTiles.push_back(TileArchive::SourceTile{job.level, job.x, job.y, partFilename});
+        }
+
+        if (!TileArchive::write(outputFilename, header, sourceTiles))
+        {
+            std::cout << "Failed to write archive " << outputFilename << std::endl;
+            return 1;
+        }
+
+        std::cout << "Written " << sourceTiles.size() << " tiles to " << outputFilename << ", staged tiles in " << stagingDirectory << " can be removed." << std::endl;
+
+        // tiles that failed to stage are missing from the archive, rerunning will retry just those tiles
+        if (numWritesFailed > 0 || numRenamesFailed > 0) return 1;
+    }
+    catch (const vsg::Exception& ve)
+    {
+        for (int i = 0; i < argc; ++i) std::cerr << argv[i] << " ";
+        std::cerr << "\n[Exception] - " << ve.message << " result = " << ve.result << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include "CaptureSink.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    template<class A>
+    vsg::ref_ptr<vsg::Data> createLike(const vsg::Data& source)
+    {
+        if (auto array = source.cast<A>()) return A::create(array->width(), array->height(), array->properties);
+        return {};
+    }
+
+    bool compatible(const vsg::Data& lhs, const vsg::Data& rhs)
+    {
+        return std::strcmp(lhs.className(), rhs.className()) == 0 && lhs.dataSize() == rhs.dataSize() &&
+               lhs.width() == rhs.width() && lhs.height() == rhs.height() && lhs.properties.format == rhs.properties.format;
+    }
+} // namespace
+
+CaptureSink::CaptureSink(const vsg::Path& in_filename, uint32_t numThreads, uint32_t in_maxBuffers, vsg::ref_ptr<const vsg::Options> in_options) :
+    filename(in_filename),
+    maxBuffers(std::max(1u, in_maxBuffers)),
+    options(in_options),
+    _base(vsg::removeExtension(in_filename)),
+    _extension(vsg::fileExtension(in_filename))
+{
+    auto ext = vsg::lowerCaseFileExtension(filename);
+    if (ext == ".raw")
+    {
+        _format = RAW;
+    }
+    else if (ext == ".vsgseq")
+    {
+        _format = SEQUENCE;
+        _sequence.open(filename.string(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!_sequence) throw vsg::Exception{vsg::make_string("Error: CaptureSink unable to open ", filename)};
+    }
+
+    for (uint32_t i = 0; i < std::max(1u, numThreads); ++i)
+    {
+        _threads.emplace_back([this]() { run(); });
+    }
+}
+
+CaptureSink::~CaptureSink()
+{
+    flush();
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _jobAvailable.notify_all();
+
+    for (auto& thread : _threads) thread.join();
+}
+
+vsg::Path CaptureSink::frameFilename(uint64_t frameNumber) const
+{
+    if (_format == SEQUENCE) return filename;
+
+    std::ostringstream str;
+    str << _base.string() << "_" << std::setw(6) << std::setfill('0') << frameNumber << _extension.string();
+    return vsg::Path(str.str());
+}
+
+vsg::ref_ptr<vsg::Data> CaptureSink::acquire(const vsg::Data& source)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto start = vsg::clock::now();
+    bool blocked = false;
+
+    while (true)
+    {
+        // reuse a free buffer of the same type and size, discarding ones left over from before a resize
+        while (!_freeBuffers.empty())
+        {
+            auto buffer = _freeBuffers.back();
+            _freeBuffers.pop_back();
+            if (compatible(*buffer, source))
+            {
+                if (blocked) blockedTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+                return buffer;
+            }
+            --_numBuffers;
+        }
+
+        if (_numBuffers < maxBuffers)
+        {
+            ++_numBuffers;
+            break;
+        }
+
+        // all the buffers are waiting to be written so wait for one to be released
+        blocked = true;
+        _bufferAvailable.wait(lock);
+    }
+
+    if (blocked) blockedTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+    lock.unlock();
+
+    auto buffer = createLike<vsg::ubvec4Array2D>(source);
+    if (!buffer) buffer = createLike<vsg::ubvec3Array2D>(source);
+    if (!buffer) buffer = createLike<vsg::ubyteArray2D>(source);
+    if (!buffer) buffer = createLike<vsg::vec4Array2D>(source);
+    if (!buffer) buffer = createLike<vsg::floatArray2D>(source);
+    if (!buffer) buffer = createLike<vsg::uintArray2D>(source);
+
+    if (!buffer)
+    {
+        lock.lock();
+        --_numBuffers;
+        _bufferAvailable.notify_one();
+    }
+    return buffer;
+}
+
+bool CaptureSink::write(const vsg::Data& source, uint64_t frameNumber)
+{
+    return queue(source, Job{{}, frameNumber, {}});
+}
+
+bool CaptureSink::write(const vsg::Data& source, const vsg::Path& outputFilename)
+{
+    if (_format == SEQUENCE)
+    {
+        vsg::warn("CaptureSink::write() can't write ", outputFilename, " to a .vsgseq sequence");
+        return false;
+    }
+
+    return queue(source, Job{{}, 0, outputFilename});
+}
+
+bool CaptureSink::queue(const vsg::Data& source, Job job)
+{
+    auto buffer = acquire(source);
+    if (!buffer)
+    {
+        vsg::warn("CaptureSink::write() unsupported data type ", source.className());
+        std::scoped_lock<std::mutex> lock(_mutex);
+        ++numFramesFailed;
+        return false;
+    }
+
+    std::memcpy(buffer->dataPointer(), source.dataPointer(), source.dataSize());
+    job.data = buffer;
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _jobs.push_back(job);
+    }
+    _jobAvailable.notify_one();
+
+    return true;
+}
+
+void CaptureSink::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_jobs.empty() || _numActive > 0)
+    {
+        _bufferAvailable.wait(lock);
+    }
+
+    if (_sequence.is_open()) _sequence.flush();
+}
+
+bool CaptureSink::writeFrame(const Job& job)
+{
+    auto& data = *job.data;
+    auto filename = job.filename ? job.filename : frameFilename(job.frameNumber);
+
+    if (_format == NATIVE)
+    {
+        return vsg::write(job.data, filename, options);
+    }
+    else if (_format == RAW)
+    {
+        std::ofstream fout(filename.string(), std::ios::out | std::ios::binary);
+        fout.write(static_cast<const char*>(data.dataPointer()), data.dataSize());
+        return static_cast<bool>(fout);
+    }
+    else
+    {
+        FrameHeader header{};
+        std::memcpy(header.magic, "VSGSEQ\0\1", sizeof(header.magic));
+        header.frameNumber = job.frameNumber;
+        header.width = data.width();
+        header.height = data.height();
+        header.format = static_cast<uint32_t>(data.properties.format);
+        header.valueSize = data.valueSize();
+        header.dataSize = data.dataSize();
+
+        std::scoped_lock<std::mutex> lock(_sequenceMutex);
+        _sequence.write(reinterpret_cast<const char*>(&header), sizeof(FrameHeader));
+        _sequence.write(static_cast<const char*>(data.dataPointer()), data.dataSize());
+        return static_cast<bool>(_sequence);
+    }
+}
+
+void CaptureSink::run()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _jobAvailable.wait(lock, [&]() { return _stop || !_jobs.empty(); });
+            if (_jobs.empty()) return;
+
+            job = _jobs.front();
+            _jobs.pop_front();
+            ++_numActive;
+        }
+
+        bool result = writeFrame(job);
+
+        {
+            std::scoped_lock<std::mutex> lock(_mutex);
+            if (result)
+            {
+                ++numFramesWritten;
+                bytesWritten += job.data->dataSize();
+            }
+            else
+            {
+                ++numFramesFailed;
+            }
+
+            --_numActive;
+            _freeBuffers.push_back(job.data);
+        }
+
+        // wakes both write() waiting for a buffer and flush() waiting for the queue to drain
+        _bufferAvailable.notify_all();
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <thread>
+
+// CaptureSink writes captured frames as a numbered image sequence on a pool of writer threads, so the render thread only has to
+// copy the mapped image data into one of a pool of buffers rather than wait for the file to be encoded and written.
+//
+// The sequence format is chosen by the extension of the filename:
+//   .raw     one file per frame containing just the tightly packed pixel data
+//   .vsgseq  a single append-only file with a FrameHeader before each frame's pixel data, frames may be out of order when using more than one thread
+//   other    one file per frame written with vsg::write(), e.g. .vsgb, or .png when vsgXchange is available
+//
+// When all the buffers are queued waiting to be written write() blocks until one is free, throttling the renderer to the speed of the disk
+// rather than queuing frames without bound.
+class CaptureSink : public vsg::Inherit<vsg::Object, CaptureSink>
+{
+public:
+    CaptureSink(const vsg::Path& in_filename, uint32_t numThreads = 2, uint32_t in_maxBuffers = 8, vsg::ref_ptr<const vsg::Options> in_options = {});
+
+    const vsg::Path filename;
+    const uint32_t maxBuffers;
+    vsg::ref_ptr<const vsg::Options> options;
+
+    // header written before each frame in a .vsgseq file
+    struct FrameHeader
+    {
+        char magic[8]; // "VSGSEQ\0\1"
+        uint64_t frameNumber;
+        uint32_t width;
+        uint32_t height;
+        uint32_t format; // VkFormat
+        uint32_t valueSize;
+        uint64_t dataSize;
+    };
+
+    // copy source into a pooled buffer and queue it to be written as frameNumber, supports ubvec4Array2D, ubvec3Array2D, ubyteArray2D, vec4Array2D, floatArray2D and uintArray2D.
+    bool write(const vsg::Data& source, uint64_t frameNumber);
+
+    // copy source into a pooled buffer and queue it to be written to the given file rather than a numbered one, not supported for .vsgseq
+    bool write(const vsg::Data& source, const vsg::Path& outputFilename);
+
+    // wait for all the queued frames to be written
+    void flush();
+
+    // the filename the given frame is written to, for .vsgseq all frames go to filename
+    vsg::Path frameFilename(uint64_t frameNumber) const;
+
+    // stats
+    uint64_t numFramesWritten = 0;
+    uint64_t numFramesFailed = 0;
+    uint64_t bytesWritten = 0;
+    double blockedTime = 0.0; // milliseconds write() spent waiting for a free buffer
+
+protected:
+    virtual ~CaptureSink();
+
+    enum Format
+    {
+        NATIVE,
+        RAW,
+        SEQUENCE
+    };
+
+    struct Job
+    {
+        vsg::ref_ptr<vsg::Data> data;
+        uint64_t frameNumber = 0;
+        vsg::Path filename;
+    };
+
+    vsg::ref_ptr<vsg::Data> acquire(const vsg::Data& source);
+    bool queue(const vsg::Data& source, Job job);
+    bool writeFrame(const Job& job);
+    void run();
+
+    Format _format = NATIVE;
+    vsg::Path _base;
+    vsg::Path _extension;
+
+    std::mutex _mutex;
+    std::condition_variable _jobAvailable;
+    std::condition_variable _bufferAvailable;
+    std::deque<Job> _jobs;
+    std::vector<vsg::ref_ptr<vsg::Data>> _freeBuffers;
+    uint32_t _numBuffers = 0;
+    uint32_t _numActive = 0;
+    bool _stop = false;
+
+    std::mutex _sequenceMutex;
+    std::ofstream _sequence;
+
+    std::vector<std::thread> _threads;
+};
@@ -0,0 +1,410 @@
+#include "ImageConvert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__)
+#    define IMAGECONVERT_AVX2
+#    include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define IMAGECONVERT_SSE2
+#    include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    define IMAGECONVERT_NEON
+#    include <arm_neon.h>
+#endif
+
+namespace
+{
+    // images with fewer pixels than this are converted on the calling thread as the cost of starting threads outweighs the gain
+    const size_t minParallelPixels = 1 << 18;
+
+    // number of entries in the float to sRGB table, enough that every unorm8 value is reached and the error is under half a step
+    const uint32_t sRGBTableSize = 4096;
+
+    inline float clampUnit(float v)
+    {
+        // written so NaN converts to 0, matching the max then min of the SIMD paths
+        return v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+    }
+
+    inline uint8_t toUnorm8(float v)
+    {
+        return static_cast<uint8_t>(static_cast<int32_t>(clampUnit(v) * 255.0f + 0.5f));
+    }
+
+    const uint8_t* linearToSRGBTable()
+    {
+        static const std::vector<uint8_t> table = [] {
+            std::vector<uint8_t> values(sRGBTableSize + 1);
+            for (uint32_t i = 0; i <= sRGBTableSize; ++i)
+            {
+                double linear = double(i) / double(sRGBTableSize);
+                double encoded = (linear <= 0.0031308) ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+                values[i] = static_cast<uint8_t>(std::lround(encoded * 255.0));
+            }
+            return values;
+        }();
+        return table.data();
+    }
+
+    const float* sRGBToLinearTable()
+    {
+        static const std::vector<float> table = [] {
+            std::vector<float> values(256);
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                double encoded = double(i) / 255.0;
+                values[i] = static_cast<float>((encoded <= 0.04045) ? encoded / 12.92 : std::pow((encoded + 0.055) / 1.055, 2.4));
+            }
+            return values;
+        }();
+        return table.data();
+    }
+
+    // call func(firstRow, lastRow) on bands of rows, using the calling thread for the first band
+    template<typename F>
+    void forEachRowBand(uint32_t height, uint32_t width, uint32_t numThreads, F func)
+    {
+        if (numThreads == 0) numThreads = (size_t(width) * height >= minParallelPixels) ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+        numThreads = std::min(numThreads, std::max(1u, height));
+
+        if (numThreads == 1)
+        {
+            func(0, height);
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        threads.reserve(numThreads - 1);
+        auto bandStart = [&](uint32_t band) { return static_cast<uint32_t>(uint64_t(height) * band / numThreads); };
+        for (uint32_t band = 1; band < numThreads; ++band)
+        {
+            threads.emplace_back(func, bandStart(band), bandStart(band + 1));
+        }
+        func(0, bandStart(1));
+
+        for (auto& thread : threads) thread.join();
+    }
+
+    // the SIMD loops convert whole blocks and return the number of values done, the caller finishes the remainder with scalar code
+    size_t floatToUnorm8SIMD(const float* src, uint8_t* dst, size_t count)
+    {
+        size_t i = 0;
+#if defined(IMAGECONVERT_AVX2)
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 scale = _mm256_set1_ps(255.0f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        auto quantize = [&](const float* p) {
+            __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(p), zero), one);
+            return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, scale), half));
+        };
+
+        // the packs work within 128 bit lanes, so the permute restores the order of the 32 bit groups of 4 bytes
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        for (; i + 32 <= count; i += 32)
+        {
+            __m256i ab = _mm256_packs_epi32(quantize(src + i), quantize(src + i + 8));
+            __m256i cd = _mm256_packs_epi32(quantize(src + i + 16), quantize(src + i + 24));
+            __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(ab, cd), order);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), bytes);
+        }
+#elif defined(IMAGECONVERT_SSE2)
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 scale = _mm_set1_ps(255.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        auto quantize = [&](const float* p) {
+            __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(p), zero), one);
+            return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+        };
+
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i ab = _mm_packs_epi32(quantize(src + i), quantize(src + i + 4));
+            __m128i cd = _mm_packs_epi32(quantize(src + i + 8), quantize(src + i + 12));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(ab, cd));
+        }
+#elif defined(IMAGECONVERT_NEON)
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        const float32x4_t one = vdupq_n_f32(1.0f);
+        const float32x4_t half = vdupq_n_f32(0.5f);
+        auto quantize = [&](const float* p) {
+            // select rather than max so NaN converts to 0
+            float32x4_t v = vld1q_f32(p);
+            v = vminq_f32(vbslq_f32(vcgtq_f32(v, zero), v, zero), one);
+            return vmovn_u32(vcvtq_u32_f32(vmlaq_n_f32(half, v, 255.0f)));
+        };
+
+        for (; i + 16 <= count; i += 16)
+        {
+            uint16x8_t ab = vcombine_u16(quantize(src + i), quantize(src + i + 4));
+            uint16x8_t cd = vcombine_u16(quantize(src + i + 8), quantize(src + i + 12));
+            vst1q_u8(dst + i, vcombine_u8(vmovn_u16(ab), vmovn_u16(cd)));
+        }
+#else
+        (void)src;
+        (void)dst;
+        (void)count;
+#endif
+        return i;
+    }
+
+    size_t unorm8ToFloatSIMD(const uint8_t* src, float* dst, size_t count)
+    {
+        size_t i = 0;
+#if defined(IMAGECONVERT_AVX2)
+        const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i values = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale));
+        }
+#elif defined(IMAGECONVERT_SSE2)
+        const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+            __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+            _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+            _mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+            _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+        }
+#elif defined(IMAGECONVERT_NEON)
+        for (; i + 8 <= count; i += 8)
+        {
+            uint16x8_t values = vmovl_u8(vld1_u8(src + i));
+            vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(values))), 1.0f / 255.0f));
+            vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(values))), 1.0f / 255.0f));
+        }
+#else
+        (void)src;
+        (void)dst;
+        (void)count;
+#endif
+        return i;
+    }
+
+    size_t depth24ToFloatSIMD(const uint32_t* src, float* dst, size_t count)
+    {
+        size_t i = 0;
+#if defined(IMAGECONVERT_AVX2)
+        const __m256i mask = _mm256_set1_epi32(0xffffff);
+        const __m256 scale = _mm256_set1_ps(1.0f / 16777216.0f);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i values = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)), mask);
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale));
+        }
+#elif defined(IMAGECONVERT_SSE2)
+        const __m128i mask = _mm_set1_epi32(0xffffff);
+        const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i values = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), mask);
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(values), scale));
+        }
+#elif defined(IMAGECONVERT_NEON)
+        const uint32x4_t mask = vdupq_n_u32(0xffffff);
+        for (; i + 4 <= count; i += 4)
+        {
+            uint32x4_t values = vandq_u32(vld1q_u32(src + i), mask);
+            vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_u32(values), 1.0f / 16777216.0f));
+        }
+#else
+        (void)src;
+        (void)dst;
+        (void)count;
+#endif
+        return i;
+    }
+
+    size_t grayToRGBASIMD(const float* src, float* dst, size_t count)
+    {
+        size_t i = 0;
+#if defined(IMAGECONVERT_AVX2)
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256i pixels01 = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+        const __m256i pixels23 = _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3);
+        const __m256i pixels45 = _mm256_setr_epi32(4, 4, 4, 4, 5, 5, 5, 5);
+        const __m256i pixels67 = _mm256_setr_epi32(6, 6, 6, 6, 7, 7, 7, 7);
+        for (; i + 8 <= count; i += 8)
+        {
+            // each permute spreads two gray values over two pixels, the blend then sets their alpha
+            __m256 gray = _mm256_loadu_ps(src + i);
+            float* d = dst + i * 4;
+            _mm256_storeu_ps(d, _mm256_blend_ps(_mm256_permutevar8x32_ps(gray, pixels01), one, 0x88));
+            _mm256_storeu_ps(d + 8, _mm256_blend_ps(_mm256_permutevar8x32_ps(gray, pixels23), one, 0x88));
+            _mm256_storeu_ps(d + 16, _mm256_blend_ps(_mm256_permutevar8x32_ps(gray, pixels45), one, 0x88));
+            _mm256_storeu_ps(d + 24, _mm256_blend_ps(_mm256_permutevar8x32_ps(gray, pixels67), one, 0x88));
+        }
+#elif defined(IMAGECONVERT_SSE2)
+        const __m128 rgbMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+        const __m128 alpha = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 gray = _mm_loadu_ps(src + i);
+            float* d = dst + i * 4;
+            _mm_storeu_ps(d, _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(gray, gray, _MM_SHUFFLE(0, 0, 0, 0)), rgbMask), alpha));
+            _mm_storeu_ps(d + 4, _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(gray, gray, _MM_SHUFFLE(1, 1, 1, 1)), rgbMask), alpha));
+            _mm_storeu_ps(d + 8, _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(gray, gray, _MM_SHUFFLE(2, 2, 2, 2)), rgbMask), alpha));
+            _mm_storeu_ps(d + 12, _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(gray, gray, _MM_SHUFFLE(3, 3, 3, 3)), rgbMask), alpha));
+        }
+#elif defined(IMAGECONVERT_NEON)
+        for (; i + 4 <= count; i += 4)
+        {
+            float32x4_t gray = vld1q_f32(src + i);
+            float32x4x4_t rgba = {{gray, gray, gray, vdupq_n_f32(1.0f)}};
+            vst4q_f32(dst + i * 4, rgba);
+        }
+#else
+        (void)src;
+        (void)dst;
+        (void)count;
+#endif
+        return i;
+    }
+} // namespace
+
+const char* imageConvertSIMD()
+{
+#if defined(IMAGECONVERT_AVX2)
+    return "AVX2";
+#elif defined(IMAGECONVERT_SSE2)
+    return "SSE2";
+#elif defined(IMAGECONVERT_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+void convertFloatToUnorm8(const float* src, uint8_t* dst, size_t numPixels, bool sRGB, bool simd)
+{
+    if (sRGB)
+    {
+        // table lookup of the RGB channels, alpha is linear
+        const uint8_t* table = linearToSRGBTable();
+        for (size_t p = 0; p < numPixels; ++p, src += 4, dst += 4)
+        {
+            dst[0] = table[static_cast<uint32_t>(clampUnit(src[0]) * float(sRGBTableSize) + 0.5f)];
+            dst[1] = table[static_cast<uint32_t>(clampUnit(src[1]) * float(sRGBTableSize) + 0.5f)];
+            dst[2] = table[static_cast<uint32_t>(clampUnit(src[2]) * float(sRGBTableSize) + 0.5f)];
+            dst[3] = toUnorm8(src[3]);
+        }
+        return;
+    }
+
+    size_t count = numPixels * 4;
+    size_t i = simd ? floatToUnorm8SIMD(src, dst, count) : 0;
+    for (; i < count; ++i) dst[i] = toUnorm8(src[i]);
+}
+
+void convertUnorm8ToFloat(const uint8_t* src, float* dst, size_t numPixels, bool sRGB, bool simd)
+{
+    if (sRGB)
+    {
+        const float* table = sRGBToLinearTable();
+        for (size_t p = 0; p < numPixels; ++p, src += 4, dst += 4)
+        {
+            dst[0] = table[src[0]];
+            dst[1] = table[src[1]];
+            dst[2] = table[src[2]];
+            dst[3] = static_cast<float>(src[3]) * (1.0f / 255.0f);
+        }
+        return;
+    }
+
+    size_t count = numPixels * 4;
+    size_t i = simd ? unorm8ToFloatSIMD(src, dst, count) : 0;
+    for (; i < count; ++i) dst[i] = static_cast<float>(src[i]) * (1.0f / 255.0f);
+}
+
+void convertDepth24ToFloat(const uint32_t* src, float* dst, size_t count, bool simd)
+{
+    size_t i = simd ? depth24ToFloatSIMD(src, dst, count) : 0;
+    for (; i < count; ++i) dst[i] = static_cast<float>(src[i] & 0xffffff) * (1.0f / 16777216.0f);
+}
+
+void convertGrayToRGBA(const float* src, float* dst, size_t count, bool simd)
+{
+    size_t i = simd ? grayToRGBASIMD(src, dst, count) : 0;
+    for (; i < count; ++i)
+    {
+        dst[i * 4 + 0] = src[i];
+        dst[i * 4 + 1] = src[i];
+        dst[i * 4 + 2] = src[i];
+        dst[i * 4 + 3] = 1.0f;
+    }
+}
+
+void convertDepth24ToRGBA(const uint32_t* src, float* dst, size_t count, bool simd)
+{
+    // convert in blocks that stay in L1 cache between the two passes
+    const size_t blockSize = 256;
+    float depth[blockSize];
+    for (size_t i = 0; i < count; i += blockSize)
+    {
+        size_t n = std::min(blockSize, count - i);
+        convertDepth24ToFloat(src + i, depth, n, simd);
+        convertGrayToRGBA(depth, dst + i * 4, n, simd);
+    }
+}
+
+vsg::ref_ptr<vsg::ubvec4Array2D> convertToUnorm8(const vsg::vec4Array2D& image, const ImageConvertSettings& settings)
+{
+    uint32_t width = image.width();
+    auto dest = vsg::ubvec4Array2D::create(width, image.height(), vsg::Data::Properties{settings.sRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM});
+    auto src = reinterpret_cast<const float*>(image.dataPointer());
+    auto dst = reinterpret_cast<uint8_t*>(dest->dataPointer());
+    forEachRowBand(image.height(), width, settings.numThreads, [&](uint32_t firstRow, uint32_t lastRow) {
+        size_t offset = size_t(firstRow) * width * 4;
+        convertFloatToUnorm8(src + offset, dst + offset, size_t(lastRow - firstRow) * width, settings.sRGB, settings.simd);
+    });
+    return dest;
+}
+
+vsg::ref_ptr<vsg::vec4Array2D> convertToFloat(const vsg::ubvec4Array2D& image, const ImageConvertSettings& settings)
+{
+    uint32_t width = image.width();
+    auto dest = vsg::vec4Array2D::create(width, image.height(), vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT});
+    auto src = reinterpret_cast<const uint8_t*>(image.dataPointer());
+    auto dst = reinterpret_cast<float*>(dest->dataPointer());
+    forEachRowBand(image.height(), width, settings.numThreads, [&](uint32_t firstRow, uint32_t lastRow) {
+        size_t offset = size_t(firstRow) * width * 4;
+        convertUnorm8ToFloat(src + offset, dst + offset, size_t(lastRow - firstRow) * width, settings.sRGB, settings.simd);
+    });
+    return dest;
+}
+
+vsg::ref_ptr<vsg::vec4Array2D> convertDepthToRGBA(const vsg::uintArray2D& depth, const ImageConvertSettings& settings)
+{
+    uint32_t width = depth.width();
+    auto dest = vsg::vec4Array2D::create(width, depth.height(), vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT});
+    auto src = reinterpret_cast<const uint32_t*>(depth.dataPointer());
+    auto dst = reinterpret_cast<float*>(dest->dataPointer());
+    forEachRowBand(depth.height(), width, settings.numThreads, [&](uint32_t firstRow, uint32_t lastRow) {
+        size_t offset = size_t(firstRow) * width;
+        convertDepth24ToRGBA(src + offset, dst + offset * 4, size_t(lastRow - firstRow) * width, settings.simd);
+    });
+    return dest;
+}
+
+vsg::ref_ptr<vsg::vec4Array2D> convertGrayToRGBA(const vsg::floatArray2D& gray, const ImageConvertSettings& settings)
+{
+    uint32_t width = gray.width();
+    auto dest = vsg::vec4Array2D::create(width, gray.height(), vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT});
+    auto src = reinterpret_cast<const float*>(gray.dataPointer());
+    auto dst = reinterpret_cast<float*>(dest->dataPointer());
+    forEachRowBand(gray.height(), width, settings.numThreads, [&](uint32_t firstRow, uint32_t lastRow) {
+        size_t offset = size_t(firstRow) * width;
+        convertGrayToRGBA(src + offset, dst + offset * 4, size_t(lastRow - firstRow) * width, settings.simd);
+    });
+    return dest;
+}
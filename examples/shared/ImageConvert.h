@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// Vectorized conversions between the float and 8 bit image formats used when reading back and displaying images. The SIMD path is
+// chosen at compile time: AVX2 when the compiler targets it (e.g. -mavx2 or /arch:AVX2), otherwise SSE2 on x86 and NEON on ARM. The
+// scalar fallback gives exactly the same results. Large images are split into bands of rows that are converted on separate threads.
+struct ImageConvertSettings
+{
+    bool sRGB = false;       // encode/decode the RGB channels with the sRGB transfer function, alpha stays linear
+    bool simd = true;        // false forces the scalar path, used as the reference by the benchmark
+    uint32_t numThreads = 0; // 0 uses std::thread::hardware_concurrency() for images large enough to benefit
+};
+
+// name of the SIMD instruction set compiled in, "AVX2", "SSE2", "NEON" or "scalar"
+const char* imageConvertSIMD();
+
+// RGBA float pixels to RGBA unorm8, clamping to 0 to 1, NaN converts to 0
+void convertFloatToUnorm8(const float* src, uint8_t* dst, size_t numPixels, bool sRGB, bool simd = true);
+
+// RGBA unorm8 pixels to RGBA float
+void convertUnorm8ToFloat(const uint8_t* src, float* dst, size_t numPixels, bool sRGB, bool simd = true);
+
+// the low 24 bits of each value as a unorm depth, the upper 8 bits are ignored so X8_D24 and packed stencil values convert correctly
+void convertDepth24ToFloat(const uint32_t* src, float* dst, size_t count, bool simd = true);
+
+// gray values to RGBA float pixels of (gray, gray, gray, 1)
+void convertGrayToRGBA(const float* src, float* dst, size_t count, bool simd = true);
+
+// 24 bit depth values to RGBA float pixels of (depth, depth, depth, 1)
+void convertDepth24ToRGBA(const uint32_t* src, float* dst, size_t count, bool simd = true);
+
+// whole image conversions, threaded over rows
+vsg::ref_ptr<vsg::ubvec4Array2D> convertToUnorm8(const vsg::vec4Array2D& image, const ImageConvertSettings& settings = {});
+vsg::ref_ptr<vsg::vec4Array2D> convertToFloat(const vsg::ubvec4Array2D& image, const ImageConvertSettings& settings = {});
+vsg::ref_ptr<vsg::vec4Array2D> convertDepthToRGBA(const vsg::uintArray2D& depth, const ImageConvertSettings& settings = {});
+vsg::ref_ptr<vsg::vec4Array2D> convertGrayToRGBA(const vsg::floatArray2D& gray, const ImageConvertSettings& settings = {});
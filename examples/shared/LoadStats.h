@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+
+// counts of completed loads, shared between the loading threads and the main thread
+struct LoadStats : public vsg::Inherit<vsg::Object, LoadStats>
+{
+    std::atomic_uint numMerged{0};
+    std::atomic_uint numFailed{0};
+
+    uint32_t numCompleted() const { return numMerged.load() + numFailed.load(); }
+};
@@ -0,0 +1,120 @@
+#include "MergeScheduler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+MergeScheduler::MergeScheduler(vsg::observer_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<LoadStats> in_stats) :
+    _viewer(in_viewer),
+    _stats(in_stats)
+{
+}
+
+void MergeScheduler::add(Merge merge)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _pending.push_back(std::move(merge));
+}
+
+size_t MergeScheduler::numPending() const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return _pending.size();
+}
+
+double MergeScheduler::computePriority(const Merge& merge, const vsg::dmat4& projection, const vsg::dmat4& view) const
+{
+    auto centre = view * merge.bound.center;
+    double distance = -centre.z;
+
+    // subgraphs in front of the camera and inside the view frustum come before those outside it, then nearest first
+    bool visible = false;
+    if (distance + merge.bound.radius > 0.0)
+    {
+        double clampedDistance = std::max(distance, merge.bound.radius);
+        double x = projection[0][0] * centre.x / clampedDistance;
+        double y = projection[1][1] * centre.y / clampedDistance;
+        double rx = projection[0][0] * merge.bound.radius / clampedDistance;
+        double ry = projection[1][1] * merge.bound.radius / clampedDistance;
+        visible = std::abs(x) <= 1.0 + rx && std::abs(y) <= 1.0 + ry;
+    }
+
+    double range = vsg::length(centre);
+    return visible ? -range : -range - std::numeric_limits<float>::max();
+}
+
+void MergeScheduler::merge()
+{
+    vsg::ref_ptr<vsg::Viewer> ref_viewer = _viewer;
+
+    auto startTime = vsg::clock::now();
+    auto elapsed = [&startTime]() {
+        return std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+    };
+
+    merged.clear();
+
+    std::vector<Merge> merges;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        merges.swap(_pending);
+    }
+
+    if (camera && merges.size() > 1)
+    {
+        auto projection = camera->projectionMatrix->transform();
+        auto view = camera->viewMatrix->transform();
+
+        std::vector<std::pair<double, size_t>> priorities;
+        priorities.reserve(merges.size());
+        for (size_t i = 0; i < merges.size(); ++i) priorities.emplace_back(computePriority(merges[i], projection, view), i);
+        std::stable_sort(priorities.begin(), priorities.end(), [](const auto& lhs, const auto& rhs) { return lhs.first > rhs.first; });
+
+        std::vector<Merge> sorted;
+        sorted.reserve(merges.size());
+        for (auto& [priority, index] : priorities) sorted.push_back(std::move(merges[index]));
+        merges.swap(sorted);
+    }
+
+    uint32_t numMerged = 0;
+    for (auto& merge : merges)
+    {
+        if (numMerged > 0 && timeBudget > 0.0 && elapsed() >= timeBudget) break;
+
+        if (ref_viewer) updateViewer(*ref_viewer, merge.compileResult);
+
+        merge.attachmentPoint->addChild(merge.node);
+        merged.emplace_back(merge.path, merge.requestTime);
+        ++numMerged;
+    }
+
+    uint32_t numRemaining = static_cast<uint32_t>(merges.size()) - numMerged;
+    if (numRemaining > 0)
+    {
+        // return the merges that didn't fit in this frame's budget to the front of the pending list
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _pending.insert(_pending.begin(), std::make_move_iterator(merges.begin() + numMerged), std::make_move_iterator(merges.end()));
+    }
+
+    if (_stats) _stats->numMerged += numMerged;
+
+    if (numMerged > 0 || numRemaining > 0)
+    {
+        uint64_t frameCount = (ref_viewer && ref_viewer->getFrameStamp()) ? ref_viewer->getFrameStamp()->frameCount : frameStats.size();
+        frameStats.push_back(FrameStats{frameCount, numMerged, numRemaining, elapsed()});
+    }
+}
+
+bool MergeScheduler::writeStats(const vsg::Path& filename) const
+{
+    std::ofstream fout(filename.string());
+    if (!fout) return false;
+
+    fout << "frame,merged,pending,time_ms\n";
+    for (auto& stats : frameStats)
+    {
+        fout << stats.frameCount << "," << stats.numMerged << "," << stats.numPending << "," << stats.time << "\n";
+    }
+
+    return static_cast<bool>(fout);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "LoadStats.h"
+
+// MergeScheduler holds compiled subgraphs until they can be merged into the scene graph, spreading the merges over frames so that
+// no single frame exceeds its time budget. When a camera is assigned pending merges are ordered so that those in view and nearest
+// the camera are merged first, otherwise they are merged in the order they were added.
+class MergeScheduler : public vsg::Inherit<vsg::Object, MergeScheduler>
+{
+public:
+    explicit MergeScheduler(vsg::observer_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<LoadStats> in_stats = {});
+
+    struct Merge
+    {
+        vsg::Path path;
+        vsg::ref_ptr<vsg::Group> attachmentPoint;
+        vsg::ref_ptr<vsg::Node> node;
+        vsg::CompileResult compileResult;
+        vsg::dsphere bound;          // world coordinates of the merged subgraph, used to prioritize merges
+        vsg::time_point requestTime; // when the load was requested, reported back through merged
+    };
+
+    // maximum time in milliseconds to spend merging each frame, at least one merge is always done per frame so progress is guaranteed. 0.0 disables the budget.
+    double timeBudget = 2.0;
+
+    // camera used to prioritize merges, if not set merges are done in the order they were added
+    vsg::ref_ptr<vsg::Camera> camera;
+
+    // add a compiled subgraph to merge. Thread safe.
+    void add(Merge merge);
+
+    // merge pending subgraphs until the time budget is used up, call once per frame after viewer->update()
+    void merge();
+
+    size_t numPending() const;
+
+    struct FrameStats
+    {
+        uint64_t frameCount;
+        uint32_t numMerged;
+        uint32_t numPending;
+        double time; // milliseconds
+    };
+
+    std::vector<FrameStats> frameStats;
+
+    // the subgraphs merged by the last call to merge(), and when they were requested
+    std::vector<std::pair<vsg::Path, vsg::time_point>> merged;
+
+    // write the per frame stats as CSV
+    bool writeStats(const vsg::Path& filename) const;
+
+protected:
+    double computePriority(const Merge& merge, const vsg::dmat4& projection, const vsg::dmat4& view) const;
+
+    vsg::observer_ptr<vsg::Viewer> _viewer;
+    vsg::ref_ptr<LoadStats> _stats;
+
+    mutable std::mutex _mutex;
+    std::vector<Merge> _pending;
+};
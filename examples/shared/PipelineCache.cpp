@@ -0,0 +1,91 @@
+#include "PipelineCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+PipelineCache::PipelineCache(vsg::ref_ptr<vsg::Device> in_device, const vsg::Path& in_filename) :
+    device(in_device),
+    filename(in_filename)
+{
+    std::vector<char> data;
+    if (std::ifstream fin(filename.string(), std::ios::in | std::ios::binary); fin)
+    {
+        Header fileHeader;
+        auto expected = header();
+        if (fin.read(reinterpret_cast<char*>(&fileHeader), sizeof(Header)) &&
+            std::memcmp(fileHeader.magic, expected.magic, sizeof(expected.magic)) == 0 &&
+            fileHeader.vendorID == expected.vendorID &&
+            fileHeader.deviceID == expected.deviceID &&
+            fileHeader.driverVersion == expected.driverVersion &&
+            std::memcmp(fileHeader.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0)
+        {
+            data.resize(fileHeader.dataSize);
+            if (!fin.read(data.data(), data.size())) data.clear();
+        }
+
+        if (data.empty()) vsg::info("PipelineCache ignoring ", filename, " as it's from a different device or driver, or is incomplete.");
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (auto result = vkCreatePipelineCache(*device, &createInfo, device->getAllocationCallbacks(), &_pipelineCache); result != VK_SUCCESS)
+    {
+        // the driver may still reject the data, in which case start with an empty cache
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        data.clear();
+
+        if (result = vkCreatePipelineCache(*device, &createInfo, device->getAllocationCallbacks(), &_pipelineCache); result != VK_SUCCESS)
+        {
+            throw vsg::Exception{"Error: vkCreatePipelineCache(..) failed.", result};
+        }
+    }
+
+    _loadedSize = data.size();
+}
+
+PipelineCache::~PipelineCache()
+{
+    vkDestroyPipelineCache(*device, _pipelineCache, device->getAllocationCallbacks());
+}
+
+PipelineCache::Header PipelineCache::header() const
+{
+    auto& properties = device->getPhysicalDevice()->getProperties();
+
+    Header result = {};
+    std::memcpy(result.magic, "VSGPSO\0\1", sizeof(result.magic));
+    result.vendorID = properties.vendorID;
+    result.deviceID = properties.deviceID;
+    result.driverVersion = properties.driverVersion;
+    std::memcpy(result.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return result;
+}
+
+bool PipelineCache::save() const
+{
+    size_t size = 0;
+    if (vkGetPipelineCacheData(*device, _pipelineCache, &size, nullptr) != VK_SUCCESS) return false;
+
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(*device, _pipelineCache, &size, data.data()) != VK_SUCCESS) return false;
+
+    auto fileHeader = header();
+    fileHeader.dataSize = size;
+
+    auto tempFilename = filename.string() + ".tmp";
+    {
+        std::ofstream fout(tempFilename, std::ios::out | std::ios::binary);
+        fout.write(reinterpret_cast<const char*>(&fileHeader), sizeof(Header));
+        fout.write(data.data(), size);
+        if (!fout) return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempFilename, filename.string(), ec);
+    return !ec;
+}
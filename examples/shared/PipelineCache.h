@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vsg/all.h>
+
+// PipelineCache wraps a VkPipelineCache that is loaded from and saved to a file so that pipelines compiled in one run of the
+// application don't need to be recompiled by the driver in the next. The file is prefixed with the device's vendor and device IDs,
+// driver version and pipelineCacheUUID, a file written by a different device or driver is ignored rather than passed to Vulkan.
+class PipelineCache : public vsg::Inherit<vsg::Object, PipelineCache>
+{
+public:
+    PipelineCache(vsg::ref_ptr<vsg::Device> in_device, const vsg::Path& in_filename);
+
+    const vsg::ref_ptr<vsg::Device> device;
+    const vsg::Path filename;
+
+    VkPipelineCache vk() const { return _pipelineCache; }
+
+    // true if valid data was loaded from the file, i.e. the cache is warm
+    bool loaded() const { return _loadedSize > 0; }
+    size_t loadedSize() const { return _loadedSize; }
+
+    // write the cache to a temporary file then rename it over filename so an interrupted save can't leave a corrupt cache behind.
+    bool save() const;
+
+protected:
+    virtual ~PipelineCache();
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+    };
+
+    Header header() const;
+
+    VkPipelineCache _pipelineCache = VK_NULL_HANDLE;
+    size_t _loadedSize = 0;
+};
@@ -0,0 +1,283 @@
+#include "SharedPipelines.h"
+
+#include <algorithm>
+
+namespace
+{
+    struct ReplaceBindGraphicsPipelines : public vsg::Visitor
+    {
+        vsg::ref_ptr<SharedPipelines> sharedPipelines;
+        std::map<vsg::BindGraphicsPipeline*, vsg::ref_ptr<BindSharedGraphicsPipeline>> replacements;
+
+        void apply(vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(vsg::StateGroup& stateGroup) override
+        {
+            for (auto& stateCommand : stateGroup.stateCommands)
+            {
+                if (auto bindPipeline = stateCommand.cast<vsg::BindGraphicsPipeline>())
+                {
+                    // BindGraphicsPipeline may be shared between StateGroups so map it to a single replacement
+                    auto& replacement = replacements[bindPipeline.get()];
+                    if (!replacement) replacement = BindSharedGraphicsPipeline::create(sharedPipelines, bindPipeline->pipeline);
+                    stateCommand = replacement;
+                }
+            }
+            stateGroup.traverse(*this);
+        }
+    };
+
+    vsg::ref_ptr<vsg::Context> createBackgroundContext(vsg::ref_ptr<vsg::Device> device, vsg::ref_ptr<vsg::Window> window)
+    {
+        // the background compile uses the window's render pass and multisample settings, the viewport is dynamic so isn't required.
+        // Each compile has its own Context so the pipeline states can use its scratch memory without contention.
+        auto context = vsg::Context::create(device);
+        context->renderPass = window->getOrCreateRenderPass();
+        if (window->framebufferSamples() != VK_SAMPLE_COUNT_1_BIT)
+        {
+            context->overridePipelineStates.push_back(vsg::MultisampleState::create(window->framebufferSamples()));
+        }
+        return context;
+    }
+
+    struct CompilePipeline : public vsg::Inherit<vsg::Operation, CompilePipeline>
+    {
+        CompilePipeline(vsg::ref_ptr<SharedPipelines> in_sharedPipelines, vsg::ref_ptr<vsg::Window> in_window, vsg::ref_ptr<vsg::GraphicsPipeline> in_pipeline) :
+            sharedPipelines(in_sharedPipelines),
+            window(in_window),
+            pipeline(in_pipeline) {}
+
+        vsg::ref_ptr<SharedPipelines> sharedPipelines;
+        vsg::ref_ptr<vsg::Window> window;
+        vsg::ref_ptr<vsg::GraphicsPipeline> pipeline;
+
+        void run() override
+        {
+            sharedPipelines->getOrCreate(*createBackgroundContext(sharedPipelines->device, window), pipeline);
+        }
+    };
+} // namespace
+
+SharedPipelines::SharedPipelines(vsg::ref_ptr<vsg::Device> in_device, vsg::ref_ptr<PipelineCache> in_pipelineCache, vsg::ref_ptr<vsg::OperationThreads> in_compileThreads) :
+    device(in_device),
+    pipelineCache(in_pipelineCache),
+    compileThreads(in_compileThreads)
+{
+}
+
+SharedPipelines::~SharedPipelines()
+{
+    for (auto& [key, entry] : _pipelines)
+    {
+        if (entry.vkPipeline) vkDestroyPipeline(*device, entry.vkPipeline, device->getAllocationCallbacks());
+    }
+}
+
+void SharedPipelines::prepare(vsg::Node& node, vsg::ref_ptr<vsg::Window> window)
+{
+    ReplaceBindGraphicsPipelines replace;
+    replace.sharedPipelines = this;
+    node.accept(replace);
+
+    if (!window || !compileThreads) return;
+
+    auto context = createBackgroundContext(device, window);
+    for (auto& [bindPipeline, replacement] : replace.replacements)
+    {
+        // compile the layouts and shader modules on this thread, as the compile traversal of the subgraph will, so that the
+        // background threads only create the VkPipeline and don't compile objects the compile traversal may also be compiling.
+        auto& pipeline = replacement->pipeline;
+        pipeline->layout->compile(*context);
+        for (auto& shaderStage : pipeline->stages) shaderStage->compile(*context);
+
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (_pipelines.count(key(*context, pipeline.get())) == 0)
+        {
+            compileThreads->add(CompilePipeline::create(vsg::ref_ptr<SharedPipelines>(this), window, pipeline));
+        }
+    }
+}
+
+SharedPipelines::Key SharedPipelines::key(const vsg::Context& context, const vsg::GraphicsPipeline* pipeline)
+{
+    // pipelines can be used with any render pass that is compatible with the one they were created for, i.e. has the same attachment formats and sample counts.
+    std::vector<uint32_t> renderPassLayout;
+    if (context.renderPass)
+    {
+        for (auto& attachment : context.renderPass->attachments)
+        {
+            renderPassLayout.push_back(static_cast<uint32_t>(attachment.format));
+            renderPassLayout.push_back(static_cast<uint32_t>(attachment.samples));
+        }
+        renderPassLayout.push_back(static_cast<uint32_t>(context.renderPass->subpasses.size()));
+    }
+    return Key(pipeline, renderPassLayout);
+}
+
+VkPipeline SharedPipelines::getOrCreate(vsg::Context& context, vsg::ref_ptr<vsg::GraphicsPipeline> pipeline)
+{
+    auto pipelineKey = key(context, pipeline.get());
+
+    // background compiles use a Context without a View
+    bool background = !context.view;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true)
+        {
+            auto itr = _pipelines.find(pipelineKey);
+            if (itr == _pipelines.end()) break;
+
+            if (!itr->second.compiling)
+            {
+                ++numReused;
+                return itr->second.vkPipeline;
+            }
+
+            // another thread is compiling the pipeline, wait for it rather than compiling it twice
+            _compiled.wait(lock);
+        }
+
+        _pipelines[pipelineKey] = Entry{pipeline, VK_NULL_HANDLE, true};
+    }
+
+    auto start = vsg::clock::now();
+
+    VkPipeline vkPipeline = VK_NULL_HANDLE;
+    try
+    {
+        vkPipeline = create(context, *pipeline);
+    }
+    catch (...)
+    {
+        // let any waiting threads retry rather than wait forever
+        {
+            std::scoped_lock<std::mutex> lock(_mutex);
+            _pipelines.erase(pipelineKey);
+        }
+        _compiled.notify_all();
+        throw;
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        auto& entry = _pipelines[pipelineKey];
+        entry.vkPipeline = vkPipeline;
+        entry.compiling = false;
+
+        ++numCreated;
+        if (background) ++numCreatedInBackground;
+        createTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+    }
+    _compiled.notify_all();
+
+    return vkPipeline;
+}
+
+VkPipeline SharedPipelines::create(vsg::Context& context, const vsg::GraphicsPipeline& pipeline)
+{
+    auto deviceID = context.deviceID;
+
+    pipeline.layout->compile(context);
+    for (auto& shaderStage : pipeline.stages) shaderStage->compile(context);
+
+    // combine the pipeline states in the same order as GraphicsPipeline::compile(), swapping the view specific ViewportState for dynamic viewport and scissor
+    vsg::GraphicsPipelineStates pipelineStates;
+    vsg::ref_ptr<vsg::DynamicState> dynamicState;
+    auto add = [&](const vsg::GraphicsPipelineStates& states) {
+        for (auto& state : states)
+        {
+            if (state.cast<vsg::ViewportState>()) continue;
+            if (auto ds = state.cast<vsg::DynamicState>())
+            {
+                dynamicState = vsg::DynamicState::create();
+                dynamicState->dynamicStates = ds->dynamicStates;
+                continue;
+            }
+            pipelineStates.push_back(state);
+        }
+    };
+    add(context.defaultPipelineStates);
+    add(pipeline.pipelineStates);
+    add(context.overridePipelineStates);
+
+    if (!dynamicState) dynamicState = vsg::DynamicState::create();
+    for (auto state : {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR})
+    {
+        auto& states = dynamicState->dynamicStates;
+        if (std::find(states.begin(), states.end(), state) == states.end()) states.push_back(state);
+    }
+    pipelineStates.push_back(dynamicState);
+
+    // the viewport and scissor counts are still required, their values are ignored
+    pipelineStates.push_back(vsg::ViewportState::create(0, 0, 1, 1));
+
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStageCreateInfo(pipeline.stages.size());
+    for (size_t i = 0; i < pipeline.stages.size(); ++i)
+    {
+        shaderStageCreateInfo[i] = {};
+        shaderStageCreateInfo[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipeline.stages[i]->apply(context, shaderStageCreateInfo[i]);
+    }
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = pipeline.layout->vk(deviceID);
+    pipelineInfo.renderPass = *context.renderPass;
+    pipelineInfo.subpass = pipeline.subpass;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStageCreateInfo.size());
+    pipelineInfo.pStages = shaderStageCreateInfo.data();
+
+    for (auto& state : pipelineStates) state->apply(context, pipelineInfo);
+
+    VkPipeline vkPipeline = VK_NULL_HANDLE;
+    VkPipelineCache vkPipelineCache = pipelineCache ? pipelineCache->vk() : VK_NULL_HANDLE;
+    if (auto result = vkCreateGraphicsPipelines(*device, vkPipelineCache, 1, &pipelineInfo, device->getAllocationCallbacks(), &vkPipeline); result != VK_SUCCESS)
+    {
+        throw vsg::Exception{"Error: vsg::SharedPipelines failed to create VkPipeline.", result};
+    }
+
+    return vkPipeline;
+}
+
+BindSharedGraphicsPipeline::BindSharedGraphicsPipeline(vsg::ref_ptr<SharedPipelines> in_sharedPipelines, vsg::ref_ptr<vsg::GraphicsPipeline> in_pipeline) :
+    Inherit(0), // same slot as BindGraphicsPipeline
+    sharedPipelines(in_sharedPipelines),
+    pipeline(in_pipeline)
+{
+}
+
+void BindSharedGraphicsPipeline::compile(vsg::Context& context)
+{
+    if (context.viewID >= maxViews)
+    {
+        throw vsg::Exception{vsg::make_string("Error: BindSharedGraphicsPipeline supports up to ", maxViews, " views.")};
+    }
+
+    auto& perView = _views[context.viewID];
+    if (perView.vkPipeline) return;
+
+    for (auto& state : context.defaultPipelineStates)
+    {
+        if (auto viewportState = state.cast<vsg::ViewportState>()) perView.viewportState = viewportState;
+    }
+
+    perView.vkPipeline = sharedPipelines->getOrCreate(context, pipeline);
+}
+
+void BindSharedGraphicsPipeline::record(vsg::CommandBuffer& commandBuffer) const
+{
+    auto& perView = _views[commandBuffer.viewID];
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perView.vkPipeline);
+    commandBuffer.setCurrentPipelineLayout(pipeline->layout);
+
+    if (auto& viewportState = perView.viewportState)
+    {
+        vkCmdSetViewport(commandBuffer, 0, static_cast<uint32_t>(viewportState->viewports.size()), viewportState->viewports.data());
+        vkCmdSetScissor(commandBuffer, 0, static_cast<uint32_t>(viewportState->scissors.size()), viewportState->scissors.data());
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <array>
+#include <condition_variable>
+#include <map>
+
+#include "PipelineCache.h"
+
+// SharedPipelines creates one VkPipeline per GraphicsPipeline and render pass layout and shares it between all the views that
+// use it, where vsg::GraphicsPipeline compiles a separate VkPipeline for each view as the view's ViewportState is baked into it.
+// The shared pipelines replace the ViewportState with dynamic viewport and scissor state, set when the pipeline is bound.
+//
+// prepare() replaces the BindGraphicsPipeline in a loaded subgraph with BindSharedGraphicsPipeline and starts compiling the
+// pipelines on the compileThreads, so they can be ready by the time the view that uses them is compiled.
+class SharedPipelines : public vsg::Inherit<vsg::Object, SharedPipelines>
+{
+public:
+    SharedPipelines(vsg::ref_ptr<vsg::Device> in_device, vsg::ref_ptr<PipelineCache> in_pipelineCache, vsg::ref_ptr<vsg::OperationThreads> in_compileThreads);
+
+    const vsg::ref_ptr<vsg::Device> device;
+    const vsg::ref_ptr<PipelineCache> pipelineCache;
+    vsg::ref_ptr<vsg::OperationThreads> compileThreads;
+
+    // replace BindGraphicsPipeline with BindSharedGraphicsPipeline, and if window is set start compiling the pipelines in the background for its render pass.
+    void prepare(vsg::Node& node, vsg::ref_ptr<vsg::Window> window = {});
+
+    // return the VkPipeline for the context's render pass, creating it or waiting for a background compile if required. Thread safe.
+    VkPipeline getOrCreate(vsg::Context& context, vsg::ref_ptr<vsg::GraphicsPipeline> pipeline);
+
+    // stats
+    uint32_t numCreated = 0;
+    uint32_t numCreatedInBackground = 0;
+    uint32_t numReused = 0;
+    double createTime = 0.0; // milliseconds spent in vkCreateGraphicsPipelines
+
+protected:
+    virtual ~SharedPipelines();
+
+    using Key = std::pair<const vsg::GraphicsPipeline*, std::vector<uint32_t>>;
+
+    struct Entry
+    {
+        vsg::ref_ptr<vsg::GraphicsPipeline> pipeline;
+        VkPipeline vkPipeline = VK_NULL_HANDLE;
+        bool compiling = true;
+    };
+
+    static Key key(const vsg::Context& context, const vsg::GraphicsPipeline* pipeline);
+    VkPipeline create(vsg::Context& context, const vsg::GraphicsPipeline& pipeline);
+
+    std::mutex _mutex;
+    std::condition_variable _compiled;
+    std::map<Key, Entry> _pipelines;
+};
+
+// BindSharedGraphicsPipeline is used in place of BindGraphicsPipeline, binding the shared VkPipeline and setting the viewport of the view being recorded.
+class BindSharedGraphicsPipeline : public vsg::Inherit<vsg::StateCommand, BindSharedGraphicsPipeline>
+{
+public:
+    BindSharedGraphicsPipeline(vsg::ref_ptr<SharedPipelines> in_sharedPipelines, vsg::ref_ptr<vsg::GraphicsPipeline> in_pipeline);
+
+    vsg::ref_ptr<SharedPipelines> sharedPipelines;
+    vsg::ref_ptr<vsg::GraphicsPipeline> pipeline;
+
+    void compile(vsg::Context& context) override;
+    void record(vsg::CommandBuffer& commandBuffer) const override;
+
+protected:
+    static constexpr uint32_t maxViews = 32;
+
+    struct PerView
+    {
+        VkPipeline vkPipeline = VK_NULL_HANDLE;
+        vsg::ref_ptr<vsg::ViewportState> viewportState;
+    };
+
+    // indexed by viewID, fixed size so that compiling a new view doesn't move the entries of views being recorded
+    std::array<PerView, maxViews> _views;
+};
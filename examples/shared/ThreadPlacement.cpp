@@ -0,0 +1,164 @@
+#include "ThreadPlacement.h"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace
+{
+    // parse a Linux cpu list such as "0-7,16-23"
+    std::vector<uint32_t> readCpuList(const std::string& filename)
+    {
+        std::vector<uint32_t> cpus;
+
+        std::ifstream fin(filename);
+        std::string range;
+        while (std::getline(fin, range, ','))
+        {
+            uint32_t first = 0, last = 0;
+            char dash = 0;
+            std::istringstream str(range);
+            if (!(str >> first)) continue;
+            if (!(str >> dash >> last)) last = first;
+            for (uint32_t cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    // put the first hardware thread of each physical core ahead of the remaining hardware threads
+    void orderByCore(std::vector<uint32_t>& cpus)
+    {
+        std::vector<uint32_t> first, rest;
+        std::set<uint32_t> seen;
+        for (auto cpu : cpus)
+        {
+            auto siblings = readCpuList("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+            bool sibling = std::any_of(siblings.begin(), siblings.end(), [&](uint32_t s) { return seen.count(s) > 0; });
+            (sibling ? rest : first).push_back(cpu);
+            seen.insert(cpu);
+        }
+        cpus = first;
+        cpus.insert(cpus.end(), rest.begin(), rest.end());
+    }
+
+    const char* roleName(ThreadPlacement::Role role)
+    {
+        switch (role)
+        {
+        case (ThreadPlacement::MAIN): return "main";
+        case (ThreadPlacement::RECORD): return "record";
+        case (ThreadPlacement::LOAD): return "load";
+        }
+        return "unknown";
+    }
+} // namespace
+
+CpuTopology CpuTopology::read()
+{
+    CpuTopology topology;
+
+#if defined(__linux__)
+    for (auto id : readCpuList("/sys/devices/system/node/online"))
+    {
+        auto cpus = readCpuList("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+        if (cpus.empty()) continue; // memory only node
+
+        orderByCore(cpus);
+        topology.nodes.push_back(Node{id, cpus});
+    }
+#endif
+
+    if (topology.nodes.empty())
+    {
+        Node node;
+        for (uint32_t cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) node.cpus.push_back(cpu);
+        topology.nodes.push_back(node);
+    }
+
+    return topology;
+}
+
+size_t CpuTopology::numCpus() const
+{
+    size_t count = 0;
+    for (auto& node : nodes) count += node.cpus.size();
+    return count;
+}
+
+void CpuTopology::report(std::ostream& out) const
+{
+    out << "CPU topology: " << nodes.size() << " NUMA node(s), " << numCpus() << " CPUs" << std::endl;
+    for (auto& node : nodes)
+    {
+        out << "    node " << node.id << " : cpus";
+        for (auto cpu : node.cpus) out << " " << cpu;
+        out << std::endl;
+    }
+}
+
+ThreadPlacement::ThreadPlacement(Policy in_policy, const CpuTopology& in_topology) :
+    policy(in_policy),
+    topology(in_topology),
+    _nextCpu(in_topology.nodes.size(), 0)
+{
+}
+
+ThreadPlacement::Policy ThreadPlacement::policyFromString(const std::string& str)
+{
+    if (str == "compact") return COMPACT;
+    if (str == "scatter") return SCATTER;
+    return NONE;
+}
+
+vsg::Affinity ThreadPlacement::affinity(Role role, uint32_t index)
+{
+    if (policy == NONE || topology.nodes.empty()) return {};
+
+    // once every CPU has a thread start again from the first
+    if (_assignments.size() % topology.numCpus() == 0) std::fill(_nextCpu.begin(), _nextCpu.end(), 0);
+
+    uint32_t node = 0;
+    if (policy == COMPACT)
+    {
+        while (_nextCpu[node] >= topology.nodes[node].cpus.size()) ++node;
+    }
+    else
+    {
+        while (_nextCpu[_nextNode] >= topology.nodes[_nextNode].cpus.size()) _nextNode = (_nextNode + 1) % topology.nodes.size();
+        node = _nextNode;
+        _nextNode = (_nextNode + 1) % topology.nodes.size();
+    }
+
+    uint32_t cpu = topology.nodes[node].cpus[_nextCpu[node]++];
+    _assignments.push_back(Assignment{role, index, topology.nodes[node].id, cpu});
+
+    return vsg::Affinity(cpu);
+}
+
+void ThreadPlacement::place(std::thread& thread, Role role, uint32_t index)
+{
+    if (auto threadAffinity = affinity(role, index)) vsg::setAffinity(thread, threadAffinity);
+}
+
+void ThreadPlacement::placeCurrentThread(Role role, uint32_t index)
+{
+    if (auto threadAffinity = affinity(role, index)) vsg::setAffinity(threadAffinity);
+}
+
+void ThreadPlacement::report(std::ostream& out) const
+{
+    topology.report(out);
+
+    if (policy == NONE)
+    {
+        out << "Thread placement: none, threads are scheduled by the OS" << std::endl;
+        return;
+    }
+
+    out << "Thread placement: " << (policy == COMPACT ? "compact" : "scatter") << std::endl;
+    for (auto& assignment : _assignments)
+    {
+        out << "    " << roleName(assignment.role) << " thread " << assignment.index << " -> node " << assignment.node << ", cpu " << assignment.cpu << std::endl;
+    }
+}
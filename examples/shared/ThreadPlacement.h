@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <ostream>
+#include <thread>
+
+// CpuTopology lists the NUMA nodes of the system and the logical CPUs of each node, ordered so that one hardware thread of each
+// physical core comes before the second hardware thread of any core. On Linux it's read from /sys/devices/system, elsewhere
+// all the CPUs reported by std::thread::hardware_concurrency() are treated as a single node.
+struct CpuTopology
+{
+    struct Node
+    {
+        uint32_t id = 0;
+        std::vector<uint32_t> cpus;
+    };
+
+    std::vector<Node> nodes;
+
+    static CpuTopology read();
+
+    size_t numCpus() const;
+    void report(std::ostream& out) const;
+};
+
+// ThreadPlacement assigns the main, record and load threads of an application to CPUs according to a policy.
+//  Compact fills the cores of the first NUMA node before moving onto the next, keeping threads that share data on one node.
+//  Scatter deals the threads round robin across the nodes, spreading the load on memory bandwidth across the sockets.
+//
+// Each thread is pinned to a single CPU before it starts its work, so with the OS's first touch policy the pages of the memory
+// blocks it allocates, and the data it loads into them, are placed on that CPU's node.
+class ThreadPlacement : public vsg::Inherit<vsg::Object, ThreadPlacement>
+{
+public:
+    enum Policy
+    {
+        NONE,
+        COMPACT,
+        SCATTER
+    };
+
+    enum Role
+    {
+        MAIN,
+        RECORD,
+        LOAD
+    };
+
+    ThreadPlacement(Policy in_policy, const CpuTopology& in_topology = CpuTopology::read());
+
+    const Policy policy;
+    const CpuTopology topology;
+
+    // parse "none", "compact" or "scatter", returning NONE for anything else
+    static Policy policyFromString(const std::string& str);
+
+    // return the affinity for the index'th thread of the given role, empty when the policy is NONE.
+    vsg::Affinity affinity(Role role, uint32_t index);
+
+    void place(std::thread& thread, Role role, uint32_t index);
+    void placeCurrentThread(Role role, uint32_t index);
+
+    // report the CPU and node each placed thread was assigned
+    void report(std::ostream& out) const;
+
+protected:
+    struct Assignment
+    {
+        Role role;
+        uint32_t index;
+        uint32_t node;
+        uint32_t cpu;
+    };
+
+    std::vector<Assignment> _assignments;
+    std::vector<size_t> _nextCpu; // per node, next CPU to assign
+    uint32_t _nextNode = 0;
+};
@@ -5,6 +5,59 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// GPU timings of the frames collected with timestamps, the intervals the compute and graphics command buffers were executing and how
+// much they overlapped. Durations only compare timestamps written on the same queue so are always valid, the GPU frame time and overlap
+// compare timestamps from the compute and graphics queues so are only collected when the two queues share a timestamp clock.
+struct OverlapStats
+{
+    uint64_t numFrames = 0;
+    uint64_t numCorrelatedFrames = 0;
+    double computeTime = 0.0;
+    double graphicsTime = 0.0;
+    double frameTime = 0.0;
+    double overlapTime = 0.0;
+
+    void add(double computeStart, double computeEnd, double graphicsStart, double graphicsEnd, bool correlated)
+    {
+        ++numFrames;
+        computeTime += computeEnd - computeStart;
+        graphicsTime += graphicsEnd - graphicsStart;
+
+        if (correlated)
+        {
+            ++numCorrelatedFrames;
+            frameTime += std::max(computeEnd, graphicsEnd) - std::min(computeStart, graphicsStart);
+            overlapTime += std::max(0.0, std::min(computeEnd, graphicsEnd) - std::max(computeStart, graphicsStart));
+        }
+    }
+
+    void print(std::ostream& out) const
+    {
+        if (numFrames == 0)
+        {
+            out << "No GPU timings collected." << std::endl;
+            return;
+        }
+
+        double n = static_cast<double>(numFrames);
+        out << "GPU timings averaged over " << numFrames << " frames:" << std::endl;
+        out << "    compute " << computeTime / n << "ms, graphics " << graphicsTime / n << "ms" << std::endl;
+
+        if (numCorrelatedFrames == 0)
+        {
+            out << "    compute and graphics queues don't share a timestamp clock, GPU frame time and overlap not reported" << std::endl;
+            return;
+        }
+
+        double nc = static_cast<double>(numCorrelatedFrames);
+        out << "    GPU frame " << frameTime / nc << "ms, overlap " << overlapTime / nc << "ms, " << (computeTime > 0.0 ? 100.0 * overlapTime / computeTime : 0.0) << "% of the compute time" << std::endl;
+    }
+};
+
 int main(int argc, char** argv)
 {
     auto options = vsg::Options::create();
@@ -25,9 +78,14 @@ int main(int argc, char** argv)
     windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
     windowTraits->synchronizationLayer = arguments.read("--sync");
     arguments.read({"--window", "-w"}, windowTraits->width, windowTraits->height);
+    auto grid = arguments.value<uint32_t>(16, "--grid");
+    auto async = arguments.read("--async");
+    auto numFrames = arguments.value(-1, "-f");
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
+    grid = std::max(2u, grid);
+
     // load shaders
     auto computeShader = vsg::read_cast<vsg::ShaderStage>("shaders/computevertex.comp", options);
     auto vertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/computevertex.vert", options);
@@ -39,6 +97,9 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    computeShader->specializationConstants = vsg::ShaderStage::SpecializationConstants{
+        {0, vsg::uintValue::create(grid)}};
+
     auto window = vsg::Window::create(windowTraits);
     if (!window)
     {
@@ -46,15 +107,97 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    auto device = window->getOrCreateDevice();
+    // for --async find a queue for the compute that is separate from the graphics queue, preferring a dedicated compute queue family
+    // as it's most likely to run concurrently with graphics, otherwise a second queue of the graphics queue family.
+    int graphicsQueueFamily = -1;
+    int computeQueueFamily = -1;
+    uint32_t computeQueueIndex = 0;
+    bool calibratedTimestamps = false;
+    if (async)
+    {
+        // use the Window implementation to create the Instance and Surface
+        auto instance = window->getOrCreateInstance();
+        auto surface = window->getOrCreateSurface();
+
+        auto [physicalDevice, queueFamily, presentFamily] = instance->getPhysicalDeviceAndQueueFamily(windowTraits->queueFlags, surface);
+        if (!physicalDevice || queueFamily < 0 || presentFamily < 0)
+        {
+            std::cout << "Could not find a Vulkan PhysicalDevice that supports graphics and presentation." << std::endl;
+            return 1;
+        }
+
+        auto queueFamilyProperties = physicalDevice->getQueueFamilyProperties();
+        for (size_t i = 0; i < queueFamilyProperties.size(); ++i)
+        {
+            auto queueFlags = queueFamilyProperties[i].queueFlags;
+            if ((queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFlags & VK_QUEUE_GRAPHICS_BIT))
+            {
+                computeQueueFamily = static_cast<int>(i);
+                break;
+            }
+        }
+
+        std::vector<float> graphicsQueuePriorities{1.0f};
+        if (computeQueueFamily < 0 && queueFamilyProperties[queueFamily].queueCount > 1)
+        {
+            computeQueueFamily = queueFamily;
+            computeQueueIndex = 1;
+            graphicsQueuePriorities.push_back(1.0f);
+        }
+
+        if (computeQueueFamily >= 0)
+        {
+            vsg::Names requestedLayers;
+            if (windowTraits->debugLayer)
+            {
+                requestedLayers.push_back("VK_LAYER_KHRONOS_validation");
+                if (windowTraits->apiDumpLayer) requestedLayers.push_back("VK_LAYER_LUNARG_api_dump");
+            }
+
+            vsg::Names validatedNames = vsg::validateInstancelayerNames(requestedLayers);
+
+            vsg::Names deviceExtensions;
+            deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+            deviceExtensions.insert(deviceExtensions.end(), windowTraits->deviceExtensionNames.begin(), windowTraits->deviceExtensionNames.end());
+
+            // VK_EXT_calibrated_timestamps defines a single device time domain that the timestamps written on all the queues are in,
+            // without it timestamps from queues of different families can't be compared.
+            uint32_t extensionCount = 0;
+            vkEnumerateDeviceExtensionProperties(*physicalDevice, nullptr, &extensionCount, nullptr);
+            std::vector<VkExtensionProperties> extensionProperties(extensionCount);
+            vkEnumerateDeviceExtensionProperties(*physicalDevice, nullptr, &extensionCount, extensionProperties.data());
+            for (auto& extension : extensionProperties)
+            {
+                if (std::strcmp(extension.extensionName, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) == 0)
+                {
+                    deviceExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+                    calibratedTimestamps = true;
+                }
+            }
+
+            // each queue family may only be listed once
+            vsg::QueueSettings queueSettings{vsg::QueueSetting{queueFamily, graphicsQueuePriorities}};
+            if (presentFamily != queueFamily) queueSettings.push_back(vsg::QueueSetting{presentFamily, {1.0}});
+            if (computeQueueFamily != queueFamily && computeQueueFamily != presentFamily) queueSettings.push_back(vsg::QueueSetting{computeQueueFamily, {1.0}});
+
+            auto device = vsg::Device::create(physicalDevice, queueSettings, validatedNames, deviceExtensions, windowTraits->deviceFeatures, instance->getAllocationCallbacks());
+            window->setDevice(device);
+
+            graphicsQueueFamily = queueFamily;
+            std::cout << "Running compute on queue family " << computeQueueFamily << " queue " << computeQueueIndex << ", graphics on queue family " << graphicsQueueFamily << std::endl;
+        }
+        else
+        {
+            std::cout << "No separate compute queue available, compute and graphics will run on the same queue." << std::endl;
+        }
+    }
 
-    VkDeviceSize bufferSize = sizeof(vsg::vec4) * 256;
-    auto buffer = vsg::createBufferAndMemory(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    auto device = window->getOrCreateDevice();
+    auto physicalDevice = window->getOrCreatePhysicalDevice();
+    if (graphicsQueueFamily < 0) graphicsQueueFamily = physicalDevice->getQueueFamily(windowTraits->queueFlags);
 
-    auto bufferInfo = vsg::BufferInfo::create();
-    bufferInfo->buffer = buffer;
-    bufferInfo->offset = 0;
-    bufferInfo->range = bufferSize;
+    uint32_t numVertices = grid * grid;
+    VkDeviceSize bufferSize = sizeof(vsg::vec4) * numVertices;
 
     // camera related details
     auto viewport = vsg::ViewportState::create(0, 0, window->extent2D().width, window->extent2D().height);
@@ -63,88 +206,251 @@ int main(int argc, char** argv)
     auto camera = vsg::Camera::create(perspective, lookAt, viewport);
 
     // setting we pass to the compute shader each frame to provide animation of vertex data.
-    auto computeScale = vsg::vec4Array::create(1);
-    computeScale->properties.dataVariance = vsg::DYNAMIC_DATA;
-    computeScale->set(0, vsg::vec4(1.0, 1.0, 1.0, 0.0));
-
-    auto computeScaleBuffer = vsg::DescriptorBuffer::create(computeScale, 1);
-
-    // create the compute graph to compute the positions of the vertices
-    auto physicalDevice = window->getOrCreatePhysicalDevice();
-    auto computeQueueFamily = physicalDevice->getQueueFamily(VK_QUEUE_COMPUTE_BIT);
-    auto computeCommandGraph = vsg::CommandGraph::create(device, computeQueueFamily);
-    {
-        vsg::DescriptorSetLayoutBindings descriptorBindings{
-            {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
-            {1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr} // ClipSettings uniform
-        };
+    auto computeScale = vsg::vec4Value::create(vsg::vec4(1.0, 1.0, 1.0, 0.0));
+    auto pushComputeScale = vsg::PushConstants::create(VK_SHADER_STAGE_COMPUTE_BIT, 0, computeScale);
+
+    // set up the compute pipeline to compute the positions of the vertices
+    vsg::DescriptorSetLayoutBindings descriptorBindings{
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}};
+
+    auto computeDescriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+    auto computePipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{computeDescriptorSetLayout}, vsg::PushConstantRanges{{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vsg::vec4)}});
+    auto bindComputePipeline = vsg::BindComputePipeline::create(vsg::ComputePipeline::create(computePipelineLayout, computeShader));
+    auto dispatch = vsg::Dispatch::create((numVertices + 255) / 256, 1, 1);
+
+    // set up graphics pipeline to render the computed vertices
+    vsg::PushConstantRanges pushConstantRanges{
+        {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection view, and model matrices, actual push constant calls automatically provided by the VSG's DispatchTraversal
+    };
+
+    vsg::VertexInputState::Bindings vertexBindingsDescriptions{
+        VkVertexInputBindingDescription{0, sizeof(vsg::vec4), VK_VERTEX_INPUT_RATE_VERTEX}};
+
+    vsg::VertexInputState::Attributes vertexAttributeDescriptions{
+        VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0}};
+
+    auto inputAssemblyState = vsg::InputAssemblyState::create();
+    inputAssemblyState->topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+
+    vsg::GraphicsPipelineStates pipelineStates{
+        vsg::VertexInputState::create(vertexBindingsDescriptions, vertexAttributeDescriptions),
+        inputAssemblyState,
+        vsg::RasterizationState::create(),
+        vsg::MultisampleState::create(),
+        vsg::ColorBlendState::create(),
+        vsg::DepthStencilState::create()};
+
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{}, pushConstantRanges);
+    auto graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
+    auto bindGraphicsPipeline = vsg::BindGraphicsPipeline::create(graphicsPipeline);
+
+    // create StateGroup as the root of the scene/command graph to hold the GraphicsProgram, and binding of Descriptors to decorate the whole graph
+    auto scenegraph = vsg::StateGroup::create();
+    scenegraph->add(bindGraphicsPipeline);
+
+    auto createVertexBuffer = [&]() {
+        auto bufferInfo = vsg::BufferInfo::create();
+        bufferInfo->buffer = vsg::createBufferAndMemory(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        bufferInfo->offset = 0;
+        bufferInfo->range = bufferSize;
+        return bufferInfo;
+    };
+
+    auto createComputeCommands = [&](vsg::ref_ptr<vsg::BufferInfo> bufferInfo) {
+        auto stroageBuffer = vsg::DescriptorBuffer::create(vsg::BufferInfoList{bufferInfo}, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        auto descriptorSet = vsg::DescriptorSet::create(computeDescriptorSetLayout, vsg::Descriptors{stroageBuffer});
 
-        auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
-        auto pipelineLayout = vsg::PipelineLayout::create( vsg::DescriptorSetLayouts{descriptorSetLayout}, vsg::PushConstantRanges{});
-        auto pipeline = vsg::ComputePipeline::create(pipelineLayout, computeShader);
-        auto bindPipeline = vsg::BindComputePipeline::create(pipeline);
-        computeCommandGraph->addChild(bindPipeline);
+        auto commands = vsg::Commands::create();
+        commands->addChild(bindComputePipeline);
+        commands->addChild(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, descriptorSet));
+        commands->addChild(pushComputeScale);
+        commands->addChild(dispatch);
+        return commands;
+    };
 
-        auto stroageBuffer = vsg::DescriptorBuffer::create(vsg::BufferInfoList{bufferInfo}, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-        auto descriptorSet = vsg::DescriptorSet::create( descriptorSetLayout, vsg::Descriptors{stroageBuffer, computeScaleBuffer});
-        auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, descriptorSet);
+    auto createDrawCommands = [&](vsg::ref_ptr<vsg::BufferInfo> bufferInfo) {
+        auto drawCommands = vsg::Commands::create();
+        auto bind_vertex_buffer = vsg::BindVertexBuffers::create();
+        bind_vertex_buffer->arrays.push_back(bufferInfo);
+        drawCommands->addChild(bind_vertex_buffer);
+        drawCommands->addChild(vsg::Draw::create(numVertices, 1, 0, 0));
+        return drawCommands;
+    };
 
-        computeCommandGraph->addChild(bindDescriptorSet);
+    // create the viewer and assign window(s) to it
+    auto viewer = vsg::Viewer::create();
+    viewer->addWindow(window);
 
-        computeCommandGraph->addChild(vsg::Dispatch::create(1, 1, 1));
+    // with a separate compute queue the vertices are double buffered so that frame N renders the vertices computed during frame N-1
+    // while the compute queue generates the vertices for frame N+1 into the other buffer. Without one the compute and graphics
+    // command graphs are submitted together on the graphics queue and serialize, sharing a single vertex buffer.
+    bool separateQueue = computeQueueFamily >= 0;
+    if (!separateQueue) computeQueueFamily = graphicsQueueFamily;
+    bool transferOwnership = computeQueueFamily != graphicsQueueFamily;
+    uint32_t numBuffers = separateQueue ? 2 : 1;
+
+    // timestamps of each frame in flight are written to their own query pools, and read back once that frame has completed. There
+    // must be more query sets than frames in flight so a pool is never reset while a command buffer still using it is in flight,
+    // and an even number of them so that each set always pairs with the same vertex buffer.
+    window->getOrCreateSwapchain();
+    uint32_t numQuerySets = std::max(4u, static_cast<uint32_t>(window->numFrames()) + 1);
+    numQuerySets += numQuerySets % 2;
+    auto physicalDeviceProperties = physicalDevice->getProperties();
+    auto queueFamilyProperties = physicalDevice->getQueueFamilyProperties();
+    uint32_t computeTimestampBits = queueFamilyProperties[computeQueueFamily].timestampValidBits;
+    uint32_t graphicsTimestampBits = queueFamilyProperties[graphicsQueueFamily].timestampValidBits;
+    bool useTimestamps = computeTimestampBits > 0 && graphicsTimestampBits > 0;
+    double timestampScaleToMilliseconds = 1e-6 * static_cast<double>(physicalDeviceProperties.limits.timestampPeriod);
+    if (!useTimestamps) std::cout << "Timestamps not supported on the compute and graphics queues, GPU timings will not be reported." << std::endl;
+
+    // timestamps are only compared across queues when they are known to be in the same time domain, this assumes that queues of one
+    // family share a clock, queues of different families need VK_EXT_calibrated_timestamps' device time domain.
+    bool sameTimeDomain = (computeQueueFamily == graphicsQueueFamily) || calibratedTimestamps;
+
+    auto createQueryPool = []() {
+        auto queryPool = vsg::QueryPool::create();
+        queryPool->queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPool->queryCount = 2;
+        return queryPool;
+    };
+
+    std::vector<vsg::ref_ptr<vsg::QueryPool>> computeQueryPools, graphicsQueryPools;
+
+    auto computeSwitch = vsg::Switch::create();
+    auto graphicsStartSwitch = vsg::Switch::create();
+    auto graphicsEndSwitch = vsg::Switch::create();
+    auto acquireSwitch = vsg::Switch::create();
+    auto drawSwitch = vsg::Switch::create();
+
+    std::vector<vsg::ref_ptr<vsg::BufferInfo>> bufferInfos;
+    for (uint32_t i = 0; i < numBuffers; ++i) bufferInfos.push_back(createVertexBuffer());
+
+    for (uint32_t querySet = 0; querySet < numQuerySets; ++querySet)
+    {
+        // the query sets alternate between the vertex buffers along with the frames
+        auto& bufferInfo = bufferInfos[querySet % numBuffers];
+
+        auto computeCommands = vsg::Commands::create();
+        auto graphicsStartCommands = vsg::Commands::create();
+        auto graphicsEndCommands = vsg::Commands::create();
+
+        // the start timestamps are written at the first stage that does work so the intervals don't include the semaphore waits
+        vsg::ref_ptr<vsg::QueryPool> computeQueryPool;
+        if (useTimestamps)
+        {
+            computeQueryPool = createQueryPool();
+            computeQueryPools.push_back(computeQueryPool);
+            computeCommands->addChild(vsg::ResetQueryPool::create(computeQueryPool));
+
+            auto graphicsQueryPool = createQueryPool();
+            graphicsQueryPools.push_back(graphicsQueryPool);
+            graphicsStartCommands->addChild(vsg::ResetQueryPool::create(graphicsQueryPool));
+            graphicsStartCommands->addChild(vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, graphicsQueryPool, 0));
+            graphicsEndCommands->addChild(vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, graphicsQueryPool, 1));
+        }
+
+        if (!separateQueue)
+        {
+            // the previous frame's draw has to finish reading the shared vertex buffer before the dispatch overwrites it
+            computeCommands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0));
+        }
+
+        if (computeQueryPool) computeCommands->addChild(vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, computeQueryPool, 0));
+
+        computeCommands->addChild(createComputeCommands(bufferInfo));
+
+        if (!separateQueue)
+        {
+            // make the computed vertices visible to the vertex fetch of the draw that follows in the same submission
+            auto memoryBarrier = vsg::MemoryBarrier::create(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+            computeCommands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, memoryBarrier));
+        }
+        else if (transferOwnership)
+        {
+            // release the vertex buffer to the graphics queue family, the semaphore the graphics submission waits on makes the writes available
+            auto releaseBarrier = vsg::BufferMemoryBarrier::create(
+                VK_ACCESS_SHADER_WRITE_BIT,                  // srcAccessMask
+                0,                                           // dstAccessMask
+                static_cast<uint32_t>(computeQueueFamily),  // srcQueueFamilyIndex
+                static_cast<uint32_t>(graphicsQueueFamily), // dstQueueFamilyIndex
+                bufferInfo->buffer,                          // buffer
+                0,                                           // offset
+                bufferSize                                   // size
+            );
+            computeCommands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, releaseBarrier));
+        }
+
+        if (computeQueryPool) computeCommands->addChild(vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, computeQueryPool, 1));
+
+        computeSwitch->addChild(false, computeCommands);
+        graphicsStartSwitch->addChild(false, graphicsStartCommands);
+        graphicsEndSwitch->addChild(false, graphicsEndCommands);
     }
 
-    // set up graphics subgraph to render the computed vertices
-    auto graphicCommandGraph = vsg::CommandGraph::create(window);
+    for (auto& bufferInfo : bufferInfos)
     {
-        // set up graphics pipeline
-        vsg::PushConstantRanges pushConstantRanges{
-            {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection view, and model matrices, actual push constant calls automatically provided by the VSG's DispatchTraversal
-        };
-
-        vsg::VertexInputState::Bindings vertexBindingsDescriptions{
-            VkVertexInputBindingDescription{0, sizeof(vsg::vec4), VK_VERTEX_INPUT_RATE_VERTEX}};
-
-        vsg::VertexInputState::Attributes vertexAttributeDescriptions{
-            VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0}};
-
-        auto inputAssemblyState = vsg::InputAssemblyState::create();
-        inputAssemblyState->topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
-
-        vsg::GraphicsPipelineStates pipelineStates{
-            vsg::VertexInputState::create(vertexBindingsDescriptions, vertexAttributeDescriptions),
-            inputAssemblyState,
-            vsg::RasterizationState::create(),
-            vsg::MultisampleState::create(),
-            vsg::ColorBlendState::create(),
-            vsg::DepthStencilState::create()};
-
-        auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{}, pushConstantRanges);
-        auto graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, vsg::ShaderStages{vertexShader, fragmentShader}, pipelineStates);
-        auto bindGraphicsPipeline = vsg::BindGraphicsPipeline::create(graphicsPipeline);
-
-        // create StateGroup as the root of the scene/command graph to hold the GraphicsProgram, and binding of Descriptors to decorate the whole graph
-        auto scenegraph = vsg::StateGroup::create();
-        scenegraph->add(bindGraphicsPipeline);
+        auto acquireCommands = vsg::Commands::create();
+        if (transferOwnership)
+        {
+            // acquire the vertex buffer on the graphics queue family, matching the release barrier
+            auto acquireBarrier = vsg::BufferMemoryBarrier::create(
+                0,                                           // srcAccessMask
+                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,         // dstAccessMask
+                static_cast<uint32_t>(computeQueueFamily),  // srcQueueFamilyIndex
+                static_cast<uint32_t>(graphicsQueueFamily), // dstQueueFamilyIndex
+                bufferInfo->buffer,                          // buffer
+                0,                                           // offset
+                bufferSize                                   // size
+            );
+            acquireCommands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, acquireBarrier));
+        }
+
+        acquireSwitch->addChild(false, acquireCommands);
+        drawSwitch->addChild(false, createDrawCommands(bufferInfo));
+    }
 
-        auto renderGraph = vsg::createRenderGraphForView(window, camera, scenegraph);
-        graphicCommandGraph->addChild(renderGraph);
+    auto computeCommandGraph = vsg::CommandGraph::create(device, computeQueueFamily);
+    computeCommandGraph->addChild(computeSwitch);
 
-        // setup geometry
-        auto drawCommands = vsg::Commands::create();
-        auto bind_vertex_buffer = vsg::BindVertexBuffers::create();
-        bind_vertex_buffer->arrays.push_back(bufferInfo);
-        drawCommands->addChild(bind_vertex_buffer);
-        drawCommands->addChild(vsg::Draw::create(256, 1, 0, 0));
+    auto graphicCommandGraph = vsg::CommandGraph::create(window);
+    graphicCommandGraph->addChild(graphicsStartSwitch);
+    graphicCommandGraph->addChild(acquireSwitch);
+    graphicCommandGraph->addChild(vsg::createRenderGraphForView(window, camera, scenegraph));
+    graphicCommandGraph->addChild(graphicsEndSwitch);
+    scenegraph->addChild(drawSwitch);
+
+    vsg::ref_ptr<vsg::RecordAndSubmitTask> graphicsTask, computeTask;
+    if (separateQueue)
+    {
+        viewer->assignRecordAndSubmitTaskAndPresentation({graphicCommandGraph});
+
+        // the compute gets its own RecordAndSubmitTask so it's submitted to the compute queue, after the graphics so each frame's graphics
+        // submission can wait on the previous frame's compute without waiting for this frame's
+        graphicsTask = viewer->recordAndSubmitTasks.front();
+        computeTask = vsg::RecordAndSubmitTask::create(device, window->numFrames());
+        computeTask->queue = device->getQueue(computeQueueFamily, computeQueueIndex);
+        computeTask->commandGraphs.push_back(computeCommandGraph);
+        viewer->recordAndSubmitTasks.push_back(computeTask);
+    }
+    else
+    {
+        // compute and graphics recorded into command graphs that are submitted together on the graphics queue
+        viewer->assignRecordAndSubmitTaskAndPresentation({computeCommandGraph, graphicCommandGraph});
 
-        scenegraph->addChild(drawCommands);
+        acquireSwitch->setSingleChildOn(0);
+        drawSwitch->setSingleChildOn(0);
     }
 
-    // create the viewer and assign window(s) to it
-    auto viewer = vsg::Viewer::create();
-    viewer->addWindow(window);
-    // viewer->assignRecordAndSubmitTaskAndPresentation({graphicCommandGraph, computeCommandGraph});
-    viewer->assignRecordAndSubmitTaskAndPresentation({computeCommandGraph, graphicCommandGraph});
+    // RecordAndSubmitTask submits binary semaphores, so pairs of semaphores alternate between frames to chain frame N's graphics to
+    // frame N-1's compute, and frame N's compute to frame N-1's graphics that was reading the buffer it's about to overwrite.
+    std::vector<vsg::ref_ptr<vsg::Semaphore>> computeFinished{vsg::Semaphore::create(device, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT), vsg::Semaphore::create(device, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT)};
+    std::vector<vsg::ref_ptr<vsg::Semaphore>> graphicsFinished{vsg::Semaphore::create(device, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT), vsg::Semaphore::create(device, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)};
+    vsg::Semaphores graphicsWaitSemaphores, graphicsSignalSemaphores;
+    if (graphicsTask)
+    {
+        graphicsWaitSemaphores = graphicsTask->waitSemaphores;
+        graphicsSignalSemaphores = graphicsTask->signalSemaphores;
+    }
 
     // compile the Vulkan objects
     viewer->compile();
@@ -154,8 +460,12 @@ int main(int argc, char** argv)
     // assign a CloseHandler to the Viewer to respond to pressing Escape or press the window close button
     viewer->addEventHandlers({vsg::CloseHandler::create(viewer)});
 
+    OverlapStats stats;
+    uint64_t frameCount = 0;
+    auto startTime = vsg::clock::now();
+
     // main frame loop
-    while (viewer->advanceToNextFrame())
+    while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
     {
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
@@ -163,14 +473,70 @@ int main(int argc, char** argv)
         viewer->update();
 
         double frameTime = std::chrono::duration<float, std::chrono::seconds::period>(viewer->getFrameStamp()->time - viewer->start_point()).count();
-        computeScale->at(0).z = sin(frameTime);
-        computeScale->dirty();
+        computeScale->value().z = sin(frameTime);
+
+        uint32_t querySet = static_cast<uint32_t>(frameCount % numQuerySets);
+        computeSwitch->setSingleChildOn(querySet);
+        graphicsStartSwitch->setSingleChildOn(querySet);
+        graphicsEndSwitch->setSingleChildOn(querySet);
+
+        if (separateQueue)
+        {
+            uint32_t drawBuffer = 1 - static_cast<uint32_t>(frameCount % 2);
+
+            graphicsTask->waitSemaphores = graphicsWaitSemaphores;
+            graphicsTask->signalSemaphores = graphicsSignalSemaphores;
+            graphicsTask->signalSemaphores.push_back(graphicsFinished[frameCount % 2]);
+            computeTask->waitSemaphores.clear();
+            computeTask->signalSemaphores = {computeFinished[frameCount % 2]};
+
+            if (frameCount == 0)
+            {
+                // nothing has been computed for the first frame to draw
+                acquireSwitch->setAllChildren(false);
+                drawSwitch->setAllChildren(false);
+            }
+            else
+            {
+                acquireSwitch->setSingleChildOn(drawBuffer);
+                drawSwitch->setSingleChildOn(drawBuffer);
+                graphicsTask->waitSemaphores.push_back(computeFinished[(frameCount - 1) % 2]);
+                computeTask->waitSemaphores.push_back(graphicsFinished[(frameCount - 1) % 2]);
+            }
+        }
 
         viewer->recordAndSubmit();
 
         viewer->present();
+
+        // read back the timestamps of the oldest frame in flight, skipping it if it's not complete rather than waiting
+        if (useTimestamps && frameCount + 1 >= numQuerySets)
+        {
+            uint32_t completedSet = static_cast<uint32_t>((frameCount + 1) % numQuerySets);
+            std::vector<uint64_t> computeTimestamps(2), graphicsTimestamps(2);
+            if (computeQueryPools[completedSet]->getResults(computeTimestamps) == VK_SUCCESS && graphicsQueryPools[completedSet]->getResults(graphicsTimestamps) == VK_SUCCESS)
+            {
+                // times relative to the start of the compute, the graphics may have started before or after it
+                uint64_t origin = computeTimestamps[0];
+                auto relative = [&](uint64_t timestamp) { return timestampScaleToMilliseconds * static_cast<double>(static_cast<int64_t>(timestamp - origin)); };
+                double graphicsDuration = timestampScaleToMilliseconds * static_cast<double>(graphicsTimestamps[1] - graphicsTimestamps[0]);
+                double graphicsStart = sameTimeDomain ? relative(graphicsTimestamps[0]) : 0.0;
+                stats.add(0.0, relative(computeTimestamps[1]), graphicsStart, graphicsStart + graphicsDuration, sameTimeDomain);
+            }
+        }
+
+        ++frameCount;
     }
 
+    // make sure the compute queue has finished with the buffers before they are destroyed
+    device->deviceWaitIdle();
+
+    std::cout << (separateQueue ? "Compute and graphics on separate queues:" : "Compute and graphics serialized on one queue:") << std::endl;
+
+    double elapsedTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+    if (frameCount > 0) std::cout << "Average CPU frame time " << elapsedTime / double(frameCount) << "ms over " << frameCount << " frames" << std::endl;
+    stats.print(std::cout);
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -5,6 +5,8 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "ImageConvert.h"
+
 vsg::ref_ptr<vsg::Node> createQuad(const vsg::vec3& origin, const vsg::vec3& horizontal, const vsg::vec3& vertical, vsg::ref_ptr<vsg::Data> sourceData = {})
 {
     struct ConvertToRGBA : public vsg::Visitor
@@ -19,27 +21,12 @@ vsg::ref_ptr<vsg::Node> createQuad(const vsg::vec3& origin, const vsg::vec3& hor
         void apply(vsg::uintArray2D& fa) override
         {
             // treat as a 24bit depth buffer
-            float div = 1.0f / static_cast<float>(1 << 24);
-
-            auto rgba = vsg::vec4Array2D::create(fa.width(), fa.height(), vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT});
-            auto dest_itr = rgba->begin();
-            for (auto& v : fa)
-            {
-                float m = static_cast<float>(v) * div;
-                (*dest_itr++).set(m, m, m, 1.0);
-            }
-            textureData = rgba;
+            textureData = convertDepthToRGBA(fa);
         }
 
         void apply(vsg::floatArray2D& fa) override
         {
-            auto rgba = vsg::vec4Array2D::create(fa.width(), fa.height(), vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT});
-            auto dest_itr = rgba->begin();
-            for (auto& v : fa)
-            {
-                (*dest_itr++).set(v, v, v, 1.0);
-            }
-            textureData = rgba;
+            textureData = convertGrayToRGBA(fa);
         }
 
         vsg::ref_ptr<vsg::Data> convert(vsg::ref_ptr<vsg::Data> data)
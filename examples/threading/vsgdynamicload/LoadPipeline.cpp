@@ -0,0 +1,153 @@
+#include "LoadPipeline.h"
+
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    // read only std::streambuf over a block of memory so the decode stage can parse the file contents without copying them
+    struct MemoryStreamBuffer : public std::streambuf
+    {
+        MemoryStreamBuffer(const char* data, size_t size)
+        {
+            auto begin = const_cast<char*>(data);
+            setg(begin, begin, begin + size);
+        }
+    };
+} // namespace
+
+LoadPipeline::LoadPipeline(vsg::ref_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Options> in_options, vsg::ref_ptr<LoadStats> in_stats, vsg::ref_ptr<MergeScheduler> in_mergeScheduler, const Settings& settings) :
+    _viewer(in_viewer),
+    _options(in_options),
+    _stats(in_stats),
+    _mergeScheduler(in_mergeScheduler),
+    _settings(settings),
+    _decodeQueue(settings.queueSize),
+    _compileQueue(settings.queueSize)
+{
+}
+
+LoadPipeline::~LoadPipeline()
+{
+    stop();
+}
+
+void LoadPipeline::add(const vsg::Path& filename, vsg::ref_ptr<vsg::Group> attachmentPoint, const vsg::dsphere& bound)
+{
+    _requests.push_back(Request{filename, attachmentPoint, bound, {}, {}});
+}
+
+void LoadPipeline::start()
+{
+    _activeIOThreads = std::max(_settings.numIOThreads, 1u);
+    _activeDecodeThreads = std::max(_settings.numDecodeThreads, 1u);
+
+    for (uint32_t i = 0; i < _activeIOThreads; ++i) _threads.emplace_back([this]() { runIO(); });
+    for (uint32_t i = 0; i < _activeDecodeThreads; ++i) _threads.emplace_back([this]() { runDecode(); });
+    for (uint32_t i = 0; i < std::max(_settings.numCompileThreads, 1u); ++i) _threads.emplace_back([this]() { runCompile(); });
+}
+
+void LoadPipeline::stop()
+{
+    _stopped = true;
+    _decodeQueue.cancel();
+    _compileQueue.cancel();
+
+    for (auto& thread : _threads) thread.join();
+    _threads.clear();
+}
+
+void LoadPipeline::runIO()
+{
+    while (!_stopped)
+    {
+        size_t index = _nextRequest++;
+        if (index >= _requests.size()) break;
+
+        auto request = std::move(_requests[index]);
+
+        auto foundFilename = vsg::findFile(request.filename, _options);
+        std::ifstream fin(foundFilename.string(), std::ios::in | std::ios::binary | std::ios::ate);
+        if (foundFilename && fin)
+        {
+            request.contents.resize(static_cast<size_t>(fin.tellg()));
+            fin.seekg(0);
+            fin.read(request.contents.data(), request.contents.size());
+            request.filename = foundFilename;
+        }
+
+        if (request.contents.empty())
+        {
+            std::cout << "Warning: unable to read " << request.filename << std::endl;
+            ++_stats->numFailed;
+            continue;
+        }
+
+        // blocks while the decode stage is behind
+        if (!_decodeQueue.push(std::move(request))) break;
+    }
+
+    // last IO thread to finish lets the decode threads drain their queue and exit
+    if (--_activeIOThreads == 0) _decodeQueue.close();
+}
+
+void LoadPipeline::runDecode()
+{
+    Request request;
+    while (_decodeQueue.pop(request))
+    {
+        // parse from the in memory contents, with the file's directory added to the search paths so external textures can be found
+        auto local_options = vsg::Options::create(*_options);
+        local_options->extensionHint = vsg::lowerCaseFileExtension(request.filename);
+        local_options->paths.insert(local_options->paths.begin(), vsg::filePath(request.filename));
+
+        MemoryStreamBuffer buffer(request.contents.data(), request.contents.size());
+        std::istream stream(&buffer);
+        auto node = vsg::read_cast<vsg::Node>(stream, local_options);
+
+        // not all ReaderWriters support reading from a stream so fall back to reading the file directly
+        if (!node) node = vsg::read_cast<vsg::Node>(request.filename, _options);
+
+        request.contents = {};
+
+        if (!node)
+        {
+            std::cout << "Warning: unable to load " << request.filename << std::endl;
+            ++_stats->numFailed;
+            continue;
+        }
+
+        vsg::ComputeBounds computeBounds;
+        node->accept(computeBounds);
+
+        vsg::dvec3 centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
+        double radius = vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.5;
+        auto scale = vsg::MatrixTransform::create(vsg::scale(1.0 / radius, 1.0 / radius, 1.0 / radius) * vsg::translate(-centre));
+
+        scale->addChild(node);
+        request.node = scale;
+
+        if (sharedPipelines) sharedPipelines->prepare(*node);
+
+        // blocks while the compile stage is behind
+        if (!_compileQueue.push(std::move(request))) break;
+    }
+
+    if (--_activeDecodeThreads == 0) _compileQueue.close();
+}
+
+void LoadPipeline::runCompile()
+{
+    Request request;
+    while (_compileQueue.pop(request))
+    {
+        vsg::ref_ptr<vsg::Viewer> ref_viewer = _viewer;
+        if (!ref_viewer) break;
+
+        auto result = ref_viewer->compileManager->compile(request.node);
+        if (result)
+            _mergeScheduler->add(MergeScheduler::Merge{request.filename, request.attachmentPoint, request.node, result, request.bound});
+        else
+            ++_stats->numFailed;
+    }
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+#include "LoadStats.h"
+#include "MergeScheduler.h"
+#include "SharedPipelines.h"
+
+// BoundedQueue is a blocking FIFO with a fixed capacity, push() blocks while full so that a fast producer stage is held back
+// by a slower consumer stage rather than building up an unbounded backlog of loaded but uncompiled data.
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t in_capacity) :
+        capacity(in_capacity) {}
+
+    const size_t capacity;
+
+    // wait until there is space, returns false if the queue has been closed
+    bool push(T value)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notFull.wait(lock, [&]() { return _closed || _queue.size() < capacity; });
+        if (_closed) return false;
+
+        _queue.push_back(std::move(value));
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    // wait until an entry is available, returns false once the queue has been closed and drained
+    bool pop(T& value)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notEmpty.wait(lock, [&]() { return _closed || !_queue.empty(); });
+        if (_queue.empty()) return false;
+
+        value = std::move(_queue.front());
+        _queue.pop_front();
+        _notFull.notify_one();
+        return true;
+    }
+
+    // no more entries will be pushed, consumers finish once they have drained the queue
+    void close()
+    {
+        {
+            std::scoped_lock<std::mutex> lock(_mutex);
+            _closed = true;
+        }
+        _notFull.notify_all();
+        _notEmpty.notify_all();
+    }
+
+    // close the queue and discard any remaining entries
+    void cancel()
+    {
+        {
+            std::scoped_lock<std::mutex> lock(_mutex);
+            _closed = true;
+            _queue.clear();
+        }
+        _notFull.notify_all();
+        _notEmpty.notify_all();
+    }
+
+    size_t size() const
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        return _queue.size();
+    }
+
+protected:
+    mutable std::mutex _mutex;
+    std::condition_variable _notFull;
+    std::condition_variable _notEmpty;
+    std::deque<T> _queue;
+    bool _closed = false;
+};
+
+// LoadPipeline splits loading into three stages, each with its own pool of threads, connected by bounded queues:
+//     IO       reads the file contents into memory
+//     decode   parses the in memory file into a scene graph, computes its bounds and places it in a normalizing transform
+//     compile  compiles the Vulkan objects using the viewer's CompileManager
+// The compiled subgraphs are passed to a MergeScheduler for merging into the scene graph on the main thread.
+class LoadPipeline : public vsg::Inherit<vsg::Object, LoadPipeline>
+{
+public:
+    struct Settings
+    {
+        uint32_t numIOThreads = 2;
+        uint32_t numDecodeThreads = 4;
+        uint32_t numCompileThreads = 1;
+        size_t queueSize = 8;
+    };
+
+    LoadPipeline(vsg::ref_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Options> in_options, vsg::ref_ptr<LoadStats> in_stats, vsg::ref_ptr<MergeScheduler> in_mergeScheduler, const Settings& settings);
+
+    // add a file to load, the group to attach it to and its expected world bound, must be called before start()
+    void add(const vsg::Path& filename, vsg::ref_ptr<vsg::Group> attachmentPoint, const vsg::dsphere& bound);
+
+    // optional, when set the loaded subgraphs use its shared pipelines and pipeline cache. Must be assigned before start()
+    vsg::ref_ptr<SharedPipelines> sharedPipelines;
+
+    void start();
+    void stop();
+
+    // current occupancy of the queues between stages
+    size_t decodeQueueSize() const { return _decodeQueue.size(); }
+    size_t compileQueueSize() const { return _compileQueue.size(); }
+
+protected:
+    virtual ~LoadPipeline();
+
+    struct Request
+    {
+        vsg::Path filename;
+        vsg::ref_ptr<vsg::Group> attachmentPoint;
+        vsg::dsphere bound;
+        std::vector<char> contents;
+        vsg::ref_ptr<vsg::Node> node;
+    };
+
+    void runIO();
+    void runDecode();
+    void runCompile();
+
+    vsg::observer_ptr<vsg::Viewer> _viewer;
+    vsg::ref_ptr<vsg::Options> _options;
+    vsg::ref_ptr<LoadStats> _stats;
+    vsg::ref_ptr<MergeScheduler> _mergeScheduler;
+    Settings _settings;
+
+    std::vector<Request> _requests;
+    std::atomic_size_t _nextRequest{0};
+
+    BoundedQueue<Request> _decodeQueue;
+    BoundedQueue<Request> _compileQueue;
+
+    std::atomic_uint _activeIOThreads{0};
+    std::atomic_uint _activeDecodeThreads{0};
+    std::atomic_bool _stopped{false};
+
+    std::vector<std::thread> _threads;
+};
@@ -9,47 +9,28 @@
 #include <iostream>
 #include <thread>
 
-struct Merge : public vsg::Inherit<vsg::Operation, Merge>
-{
-    Merge(const vsg::Path& in_path, vsg::observer_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Group> in_attachmentPoint, vsg::ref_ptr<vsg::Node> in_node, const vsg::CompileResult& in_compileResult):
-        path(in_path),
-        viewer(in_viewer),
-        attachmentPoint(in_attachmentPoint),
-        node(in_node),
-        compileResult(in_compileResult) {}
-
-    vsg::Path path;
-    vsg::observer_ptr<vsg::Viewer> viewer;
-    vsg::ref_ptr<vsg::Group> attachmentPoint;
-    vsg::ref_ptr<vsg::Node> node;
-    vsg::CompileResult compileResult;
-
-    void run() override
-    {
-        std::cout<<"Merge::run() path = "<<path<<", "<<attachmentPoint<<", "<<node<<std::endl;
-
-        vsg::ref_ptr<vsg::Viewer> ref_viewer = viewer;
-        if (ref_viewer)
-        {
-            updateViewer(*ref_viewer, compileResult);
-        }
-
-        attachmentPoint->addChild(node);
-    }
-};
+#include "LoadPipeline.h"
 
 struct LoadOperation : public vsg::Inherit<vsg::Operation, LoadOperation>
 {
-    LoadOperation(vsg::ref_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Group> in_attachmentPoint, const vsg::Path& in_filename, vsg::ref_ptr<vsg::Options> in_options) :
+    LoadOperation(vsg::ref_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Group> in_attachmentPoint, const vsg::dsphere& in_bound, const vsg::Path& in_filename, vsg::ref_ptr<vsg::Options> in_options, vsg::ref_ptr<MergeScheduler> in_mergeScheduler, vsg::ref_ptr<LoadStats> in_stats, vsg::ref_ptr<SharedPipelines> in_sharedPipelines) :
         viewer(in_viewer),
         attachmentPoint(in_attachmentPoint),
+        bound(in_bound),
         filename(in_filename),
-        options(in_options) {}
+        options(in_options),
+        mergeScheduler(in_mergeScheduler),
+        stats(in_stats),
+        sharedPipelines(in_sharedPipelines) {}
 
     vsg::observer_ptr<vsg::Viewer> viewer;
     vsg::ref_ptr<vsg::Group> attachmentPoint;
+    vsg::dsphere bound;
     vsg::Path filename;
     vsg::ref_ptr<vsg::Options> options;
+    vsg::ref_ptr<MergeScheduler> mergeScheduler;
+    vsg::ref_ptr<LoadStats> stats;
+    vsg::ref_ptr<SharedPipelines> sharedPipelines;
 
     void run() override
     {
@@ -69,9 +50,17 @@ struct LoadOperation : public vsg::Inherit<vsg::Operation, LoadOperation>
 
             scale->addChild(node);
 
+            if (sharedPipelines) sharedPipelines->prepare(*node);
+
             auto result = ref_viewer->compileManager->compile(node);
-            if (result) ref_viewer->addUpdateOperation(Merge::create(filename, viewer, attachmentPoint, scale, result));
+            if (result)
+            {
+                mergeScheduler->add(MergeScheduler::Merge{filename, attachmentPoint, scale, result, bound});
+                return;
+            }
         }
+
+        ++stats->numFailed;
     }
 };
 
@@ -105,6 +94,22 @@ int main(int argc, char** argv)
         arguments.read("--display", windowTraits->display);
         auto numFrames = arguments.value(-1, "-f");
         auto numThreads = arguments.value(16, "-n");
+        auto numRepeats = arguments.value(1, "--repeat");
+
+        // the default pipelined loader, --serial uses a single pool of -n threads each doing the read, bounds and compile for a model
+        bool serialLoad = arguments.read("--serial");
+        LoadPipeline::Settings pipelineSettings;
+        arguments.read("--io-threads", pipelineSettings.numIOThreads);
+        arguments.read("--decode-threads", pipelineSettings.numDecodeThreads);
+        arguments.read("--compile-threads", pipelineSettings.numCompileThreads);
+        arguments.read("--queue-size", pipelineSettings.queueSize);
+
+        // time in milliseconds that merging loaded models may take each frame, 0 merges everything as soon as it's compiled
+        auto mergeBudget = arguments.value(2.0, "--merge-budget");
+        auto mergeStatsFilename = arguments.value(vsg::Path(), "--merge-stats");
+
+        // VkPipelineCache to load before compiling and save on exit so later runs don't need to recompile the pipelines
+        auto pipelineCacheFilename = arguments.value(vsg::Path(), "--pipeline-cache");
 
         // provide setting of the resource hints on the command line
         vsg::ref_ptr<vsg::ResourceHints> resourceHints;
@@ -134,12 +139,28 @@ int main(int argc, char** argv)
 
         viewer->addWindow(window);
 
+        vsg::ref_ptr<PipelineCache> pipelineCache;
+        vsg::ref_ptr<SharedPipelines> sharedPipelines;
+        if (pipelineCacheFilename)
+        {
+            auto device = window->getOrCreateDevice();
+            pipelineCache = PipelineCache::create(device, pipelineCacheFilename);
+            sharedPipelines = SharedPipelines::create(device, pipelineCache, vsg::ref_ptr<vsg::OperationThreads>());
+        }
+
         // set up the grid dimensions to place the loaded models on.
         vsg::dvec3 origin(0.0, 0.0, 0.0);
         vsg::dvec3 primary(2.0, 0.0, 0.0);
         vsg::dvec3 secondary(0.0, 2.0, 0.0);
 
-        int numModels = static_cast<float>(argc - 1);
+        // load each model numRepeats times to make it easier to test with large numbers of models
+        vsg::Paths filenames;
+        for (int r = 0; r < numRepeats; ++r)
+        {
+            for (int i = 1; i < argc; ++i) filenames.push_back(argv[i]);
+        }
+
+        int numModels = static_cast<int>(filenames.size());
         int numColumns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(numModels))));
         int numRows = static_cast<int>(std::ceil(static_cast<float>(numModels) / static_cast<float>(numColumns)));
 
@@ -171,38 +192,135 @@ int main(int argc, char** argv)
         }
 
         // configure the viewers rendering backend, initialize and compile Vulkan objects, passing in ResourceHints to guide the resources allocated.
+        auto startCompile = vsg::clock::now();
         viewer->compile(resourceHints);
+        auto compileTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startCompile).count();
+
+        auto loadStats = LoadStats::create();
+        auto startLoad = vsg::clock::now();
 
-        auto loadThreads = vsg::OperationThreads::create(numThreads, viewer->status);
+        auto mergeScheduler = MergeScheduler::create(viewer, loadStats);
+        mergeScheduler->timeBudget = mergeBudget;
+        mergeScheduler->camera = camera;
 
-        // assign the LoadOperation that will do the load in the background and once loaded and compiled merged then via Merge operation that is assigned to updateOperations and called from viewer.update()
+        vsg::ref_ptr<vsg::OperationThreads> loadThreads;
+        vsg::ref_ptr<LoadPipeline> loadPipeline;
+        if (serialLoad)
+        {
+            loadThreads = vsg::OperationThreads::create(numThreads, viewer->status);
+        }
+        else
+        {
+            loadPipeline = LoadPipeline::create(viewer, options, loadStats, mergeScheduler, pipelineSettings);
+            loadPipeline->sharedPipelines = sharedPipelines;
+        }
+
+        // assign the loads that will be done in the background, once loaded and compiled they are passed to the MergeScheduler which merges them from the main loop
         vsg::observer_ptr<vsg::Viewer> observer_viewer(viewer);
-        for (int i = 1; i < argc; ++i)
+        for (int index = 0; index < numModels; ++index)
         {
-            int index = i - 1;
             vsg::dvec3 position = origin + primary * static_cast<double>(index % numColumns) + secondary * static_cast<double>(index / numColumns);
             auto transform = vsg::MatrixTransform::create(vsg::translate(position));
 
             vsg_scene->addChild(transform);
 
-            loadThreads->add(LoadOperation::create(observer_viewer, transform, argv[i], options));
+            // models are normalized to a unit radius so their world bound is a unit sphere at the grid position
+            vsg::dsphere bound(position, 1.0);
+
+            if (loadThreads)
+                loadThreads->add(LoadOperation::create(observer_viewer, transform, bound, filenames[index], options, mergeScheduler, loadStats, sharedPipelines));
+            else
+                loadPipeline->add(filenames[index], transform, bound);
         }
 
+        if (loadPipeline) loadPipeline->start();
+
+        // main thread frame times while models are being loaded and merged
+        std::vector<double> frameTimes;
+        double timeToAllLoaded = 0.0;
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
+            auto startFrame = vsg::clock::now();
+
             // std::cout<<"new Frame"<<std::endl;
             // pass any events into EventHandlers assigned to the Viewer
             viewer->handleEvents();
 
             viewer->update();
 
+            // merge the compiled models within this frame's merge budget
+            mergeScheduler->merge();
+
             viewer->recordAndSubmit();
 
             viewer->present();
 
+            if (timeToAllLoaded == 0.0)
+            {
+                auto endFrame = vsg::clock::now();
+                frameTimes.push_back(std::chrono::duration<double, std::chrono::milliseconds::period>(endFrame - startFrame).count());
+
+                if (loadStats->numCompleted() >= static_cast<uint32_t>(numModels))
+                {
+                    timeToAllLoaded = std::chrono::duration<double, std::chrono::milliseconds::period>(endFrame - startLoad).count();
+                }
+            }
+
             // if (loadThreads->queue->empty()) break;
         }
+
+        if (loadPipeline) loadPipeline->stop();
+
+        std::cout << "viewer->compile() time = " << compileTime << "ms" << std::endl;
+        if (pipelineCache)
+        {
+            viewer->deviceWaitIdle();
+
+            std::cout << "pipeline cache " << pipelineCacheFilename << " was " << (pipelineCache->loaded() ? "warm" : "cold") << ", pipelines created = " << sharedPipelines->numCreated
+                      << ", vkCreateGraphicsPipelines time = " << sharedPipelines->createTime << "ms" << std::endl;
+
+            if (!pipelineCache->save()) std::cout << "Failed to write pipeline cache to " << pipelineCacheFilename << std::endl;
+        }
+
+        if (mergeStatsFilename)
+        {
+            if (mergeScheduler->writeStats(mergeStatsFilename))
+                std::cout << "Written per frame merge stats to " << mergeStatsFilename << std::endl;
+            else
+                std::cout << "Failed to write per frame merge stats to " << mergeStatsFilename << std::endl;
+        }
+
+        std::cout << "loader = " << (serialLoad ? "serial" : "pipelined") << ", models = " << numModels << ", merged = " << loadStats->numMerged << ", failed = " << loadStats->numFailed << std::endl;
+        if (timeToAllLoaded > 0.0)
+            std::cout << "time to all loaded = " << timeToAllLoaded << "ms" << std::endl;
+        else
+            std::cout << "time to all loaded = not completed" << std::endl;
+
+        if (!frameTimes.empty())
+        {
+            // a spike is a frame taking more than twice the median frame time
+            auto sortedFrameTimes = frameTimes;
+            std::sort(sortedFrameTimes.begin(), sortedFrameTimes.end());
+            double median = sortedFrameTimes[sortedFrameTimes.size() / 2];
+            double p99 = sortedFrameTimes[std::min(sortedFrameTimes.size() - 1, (sortedFrameTimes.size() * 99) / 100)];
+            auto numSpikes = std::count_if(frameTimes.begin(), frameTimes.end(), [&](double frameTime) { return frameTime > median * 2.0; });
+
+            std::cout << "frames during loading = " << frameTimes.size() << ", median = " << median << "ms, p99 = " << p99 << "ms, max = " << sortedFrameTimes.back() << "ms, spikes (> 2x median) = " << numSpikes << std::endl;
+        }
+
+        if (!mergeScheduler->frameStats.empty())
+        {
+            uint32_t maxMerged = 0;
+            double maxMergeTime = 0.0;
+            for (auto& stats : mergeScheduler->frameStats)
+            {
+                maxMerged = std::max(maxMerged, stats.numMerged);
+                maxMergeTime = std::max(maxMergeTime, stats.time);
+            }
+            std::cout << "merge budget = " << mergeBudget << "ms, frames merging = " << mergeScheduler->frameStats.size() << ", max merged in a frame = " << maxMerged << ", max merge time = " << maxMergeTime << "ms" << std::endl;
+        }
     }
     catch (const vsg::Exception& ve)
     {
@@ -9,39 +9,16 @@
 #include <iostream>
 #include <thread>
 
-struct Merge : public vsg::Inherit<vsg::Operation, Merge>
-{
-    Merge(const vsg::Path& in_path, vsg::observer_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Group> in_attachmentPoint, vsg::ref_ptr<vsg::Node> in_node, const vsg::CompileResult& in_compileResult):
-        path(in_path),
-        viewer(in_viewer),
-        attachmentPoint(in_attachmentPoint),
-        node(in_node),
-        compileResult(in_compileResult) {}
-
-    vsg::Path path;
-    vsg::observer_ptr<vsg::Viewer> viewer;
-    vsg::ref_ptr<vsg::Group> attachmentPoint;
-    vsg::ref_ptr<vsg::Node> node;
-    vsg::CompileResult compileResult;
-
-    void run() override
-    {
-        std::cout<<"Merge::run() path = "<<path<<", "<<attachmentPoint<<", "<<node<<std::endl;
-
-        vsg::ref_ptr<vsg::Viewer> ref_viewer = viewer;
-        if (ref_viewer)
-        {
-            updateViewer(*ref_viewer, compileResult);
-        }
-
-        attachmentPoint->addChild(node);
-    }
-};
+#include "MergeScheduler.h"
+#include "PipelineCache.h"
+#include "SharedPipelines.h"
 
 struct LoadViewOperation : public vsg::Inherit<vsg::Operation, LoadViewOperation>
 {
-    LoadViewOperation(vsg::ref_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Window> in_window, int32_t in_x, int32_t in_y, uint32_t in_width, uint32_t in_height, vsg::ref_ptr<vsg::Group> in_attachmentPoint, const vsg::Path& in_filename, vsg::ref_ptr<vsg::Options> in_options) :
+    LoadViewOperation(vsg::ref_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<MergeScheduler> in_mergeScheduler, vsg::ref_ptr<SharedPipelines> in_sharedPipelines, vsg::ref_ptr<vsg::Window> in_window, int32_t in_x, int32_t in_y, uint32_t in_width, uint32_t in_height, vsg::ref_ptr<vsg::Group> in_attachmentPoint, const vsg::Path& in_filename, vsg::ref_ptr<vsg::Options> in_options) :
         viewer(in_viewer),
+        mergeScheduler(in_mergeScheduler),
+        sharedPipelines(in_sharedPipelines),
         window(in_window),
         x(in_x),
         y(in_y),
@@ -49,17 +26,21 @@ struct LoadViewOperation : public vsg::Inherit<vsg::Operation, LoadViewOperation
         height(in_height),
         attachmentPoint(in_attachmentPoint),
         filename(in_filename),
-        options(in_options)
+        options(in_options),
+        requestTime(vsg::clock::now())
     {
     }
 
     vsg::observer_ptr<vsg::Viewer> viewer;
+    vsg::ref_ptr<MergeScheduler> mergeScheduler;
+    vsg::ref_ptr<SharedPipelines> sharedPipelines;
     vsg::observer_ptr<vsg::Window> window;
     int32_t x, y;
     uint32_t width, height;
     vsg::ref_ptr<vsg::Group> attachmentPoint;
     vsg::Path filename;
     vsg::ref_ptr<vsg::Options> options;
+    vsg::time_point requestTime;
 
     void run() override
     {
@@ -71,6 +52,9 @@ struct LoadViewOperation : public vsg::Inherit<vsg::Operation, LoadViewOperation
         {
             // std::cout << "Loaded " << filename << std::endl;
 
+            // start compiling the pipelines in the background while the view is set up
+            if (sharedPipelines) sharedPipelines->prepare(*node, ref_window);
+
             vsg::ComputeBounds computeBounds;
             node->accept(computeBounds);
 
@@ -110,7 +94,7 @@ struct LoadViewOperation : public vsg::Inherit<vsg::Operation, LoadViewOperation
                 }
             });
 
-            if (result) ref_viewer->addUpdateOperation(Merge::create(filename, viewer, attachmentPoint, renderGraph, result));
+            if (result) mergeScheduler->add(MergeScheduler::Merge{filename, attachmentPoint, renderGraph, result, {}, requestTime});
         }
     }
 };
@@ -146,6 +130,11 @@ int main(int argc, char** argv)
         arguments.read("--display", windowTraits->display);
         auto numFrames = arguments.value(-1, "-f");
         auto numThreads = arguments.value(16, "-n");
+        auto mergeBudget = arguments.value(2.0, "--merge-budget");
+        auto mergeStatsFilename = arguments.value(vsg::Path(), "--merge-stats");
+        auto pipelineCacheFilename = arguments.value(vsg::Path(), "--pipeline-cache");
+        auto sharePipelines = !arguments.read("--no-shared-pipelines");
+        auto numCompileThreads = arguments.value(4, "--compile-threads");
 
         // provide setting of the resource hints on the command line
         vsg::ref_ptr<vsg::ResourceHints> resourceHints;
@@ -169,6 +158,24 @@ int main(int argc, char** argv)
 
         viewer->addWindow(window);
 
+        // share pipelines between views, compiling them in the background and optionally using a VkPipelineCache that persists between runs
+        vsg::ref_ptr<PipelineCache> pipelineCache;
+        vsg::ref_ptr<vsg::OperationThreads> compileThreads;
+        vsg::ref_ptr<SharedPipelines> sharedPipelines;
+        if (sharePipelines)
+        {
+            auto device = window->getOrCreateDevice();
+            if (pipelineCacheFilename)
+            {
+                pipelineCache = PipelineCache::create(device, pipelineCacheFilename);
+                std::cout << "Pipeline cache " << pipelineCacheFilename << (pipelineCache->loaded() ? " warm, loaded " : " cold, loaded ") << pipelineCache->loadedSize() << " bytes" << std::endl;
+            }
+
+            compileThreads = vsg::OperationThreads::create(numCompileThreads, viewer->status);
+            sharedPipelines = SharedPipelines::create(device, pipelineCache, compileThreads);
+            sharedPipelines->prepare(*vsg_scene);
+        }
+
         // set up the grid dimensions to place the loaded models on.
         vsg::dvec3 origin(0.0, 0.0, 0.0);
         vsg::dvec3 primary(2.0, 0.0, 0.0);
@@ -223,10 +230,13 @@ int main(int argc, char** argv)
         // create threads to load models and views in background
         auto loadThreads = vsg::OperationThreads::create(numThreads, viewer->status);
 
-        // assign the LoadViewOperation that will do the load in the background and once loaded and compiled merged then via Merge operation that is assigned to updateOperations and called from viewer.update()
         vsg::observer_ptr<vsg::Viewer> observer_viewer(viewer);
-        loadThreads->add(LoadViewOperation::create(observer_viewer, window, 50, 50, 512, 480, commandGraph, "models/openstreetmap.vsgt", options));
-        loadThreads->add(LoadViewOperation::create(observer_viewer, window, 600, 50, 512, 480, commandGraph, "models/lz.vsgt", options));
+        auto mergeScheduler = MergeScheduler::create(observer_viewer);
+        mergeScheduler->timeBudget = mergeBudget;
+
+        // assign the LoadViewOperation that will do the load in the background and once loaded and compiled pass the view to the MergeScheduler that merges it from the main loop
+        loadThreads->add(LoadViewOperation::create(observer_viewer, mergeScheduler, sharedPipelines, window, 50, 50, 512, 480, commandGraph, "models/openstreetmap.vsgt", options));
+        loadThreads->add(LoadViewOperation::create(observer_viewer, mergeScheduler, sharedPipelines, window, 600, 50, 512, 480, commandGraph, "models/lz.vsgt", options));
 
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
@@ -237,12 +247,43 @@ int main(int argc, char** argv)
 
             viewer->update();
 
+            mergeScheduler->merge();
+
             viewer->recordAndSubmit();
 
             viewer->present();
 
+            for (auto& [path, requestTime] : mergeScheduler->merged)
+            {
+                std::cout << "View " << path << " first frame " << std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - requestTime).count() << "ms after request" << std::endl;
+            }
+
             // if (loadThreads->queue->empty()) break;
         }
+
+        if (sharedPipelines)
+        {
+            viewer->deviceWaitIdle();
+
+            std::cout << "Shared pipelines created = " << sharedPipelines->numCreated << " (" << sharedPipelines->numCreatedInBackground << " in background), reused = " << sharedPipelines->numReused
+                      << ", vkCreateGraphicsPipelines time = " << sharedPipelines->createTime << "ms" << std::endl;
+
+            if (pipelineCache)
+            {
+                if (pipelineCache->save())
+                    std::cout << "Written pipeline cache to " << pipelineCacheFilename << std::endl;
+                else
+                    std::cout << "Failed to write pipeline cache to " << pipelineCacheFilename << std::endl;
+            }
+        }
+
+        if (mergeStatsFilename)
+        {
+            if (mergeScheduler->writeStats(mergeStatsFilename))
+                std::cout << "Written per frame merge stats to " << mergeStatsFilename << std::endl;
+            else
+                std::cout << "Failed to write per frame merge stats to " << mergeStatsFilename << std::endl;
+        }
     }
     catch (const vsg::Exception& ve)
     {
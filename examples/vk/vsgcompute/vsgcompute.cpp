@@ -1,7 +1,195 @@
 #include <vsg/all.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+#include "ImageConvert.h"
+
+// a single benchmark configuration, the problem size and workgroup size along with the timings collected for it
+struct BenchmarkResult
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t workgroupSize = 0;
+    uint32_t numDispatches = 0;
+    uint32_t numIterations = 0;
+
+    double gpuTime = 0.0;    // average milliseconds per dispatch, measured with timestamps
+    double minGpuTime = 0.0; // fastest single dispatch
+    double maxGpuTime = 0.0; // slowest single dispatch
+    double cpuTime = 0.0;    // average milliseconds from vkQueueSubmit to the fence being signalled
+    double overhead = 0.0;   // average milliseconds per submission not accounted for by GPU execution
+    double bandwidth = 0.0;  // GB/s written to the output buffer
+
+    vsg::ref_ptr<vsg::Buffer> buffer;
+};
+
+namespace
+{
+    // the values from minValue to maxValue doubling each step, used for the --sweep-w and --sweep-size ranges
+    std::vector<uint32_t> powersOfTwo(uint32_t minValue, uint32_t maxValue)
+    {
+        std::vector<uint32_t> values;
+        for (uint32_t value = std::max(1u, minValue); value <= maxValue; value *= 2)
+        {
+            values.push_back(value);
+
+            // stop before doubling would wrap around for ranges reaching 2^31 and above
+            if (value > maxValue / 2) break;
+        }
+        return values;
+    }
+
+    // hash of the converted image, so outputs can be compared without holding several multi GB images at once
+    uint64_t hashData(const vsg::Data& data)
+    {
+        auto bytes = static_cast<const uint8_t*>(data.dataPointer());
+        size_t size = data.dataSize();
+        uint64_t hash = 14695981039346656037ull;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+        for (; i < size; ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    // time the ImageConvert functions on square images from minSize to maxSize, comparing the scalar path with SIMD on one thread and SIMD threaded over rows
+    int runConvertBenchmark(uint32_t minSize, uint32_t maxSize, uint32_t numWarmup, uint32_t numIterations, const vsg::Path& jsonFilename)
+    {
+        uint32_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::cout << "Image conversion benchmark, SIMD = " << imageConvertSIMD() << ", threads = " << numThreads << std::endl;
+
+        // deterministic pseudo random values, the float values go outside 0 to 1 to exercise the clamping
+        uint32_t seed = 1;
+        auto random = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return seed;
+        };
+        auto randomFloat = [&random]() { return static_cast<float>(random() >> 8) / 16777216.0f * 1.2f - 0.1f; };
+
+        using Conversion = std::function<vsg::ref_ptr<vsg::Data>(const ImageConvertSettings&)>;
+        struct Variant
+        {
+            const char* name;
+            ImageConvertSettings settings;
+        };
+        std::vector<Variant> variants{
+            {"scalar", {false, false, 1}},
+            {"simd", {false, true, 1}},
+            {"simd_threaded", {false, true, numThreads}}};
+
+        // every conversion reads and writes 20 bytes per pixel, 16 of float RGBA and 4 of unorm8 RGBA, gray or depth
+        const size_t bytesPerPixel = 20;
+
+        std::stringstream json;
+        size_t numResults = 0;
+        bool allMatched = true;
+
+        for (auto size : powersOfTwo(minSize, maxSize))
+        {
+            // only allocate the source image for the conversion being timed, at 8k the float RGBA image alone is 1GB
+            std::vector<std::pair<std::string, std::function<Conversion()>>> conversions{
+                {"float_to_unorm8", [&]() {
+                     auto image = vsg::vec4Array2D::create(size, size);
+                     for (auto& v : *image) v.set(randomFloat(), randomFloat(), randomFloat(), randomFloat());
+                     return Conversion([image](const ImageConvertSettings& settings) -> vsg::ref_ptr<vsg::Data> { return convertToUnorm8(*image, settings); });
+                 }},
+                {"float_to_srgb8", [&]() {
+                     auto image = vsg::vec4Array2D::create(size, size);
+                     for (auto& v : *image) v.set(randomFloat(), randomFloat(), randomFloat(), randomFloat());
+                     return Conversion([image](ImageConvertSettings settings) -> vsg::ref_ptr<vsg::Data> {
+                         settings.sRGB = true;
+                         return convertToUnorm8(*image, settings);
+                     });
+                 }},
+                {"unorm8_to_float", [&]() {
+                     auto image = vsg::ubvec4Array2D::create(size, size);
+                     for (auto& v : *image) v.set(uint8_t(random()), uint8_t(random() >> 8), uint8_t(random() >> 16), uint8_t(random() >> 24));
+                     return Conversion([image](const ImageConvertSettings& settings) -> vsg::ref_ptr<vsg::Data> { return convertToFloat(*image, settings); });
+                 }},
+                {"depth24_to_rgba", [&]() {
+                     auto image = vsg::uintArray2D::create(size, size);
+                     for (auto& v : *image) v = random();
+                     return Conversion([image](const ImageConvertSettings& settings) -> vsg::ref_ptr<vsg::Data> { return convertDepthToRGBA(*image, settings); });
+                 }},
+                {"gray_to_rgba", [&]() {
+                     auto image = vsg::floatArray2D::create(size, size);
+                     for (auto& v : *image) v = randomFloat();
+                     return Conversion([image](const ImageConvertSettings& settings) -> vsg::ref_ptr<vsg::Data> { return convertGrayToRGBA(*image, settings); });
+                 }}};
+
+            for (auto& [name, createConversion] : conversions)
+            {
+                auto conversion = createConversion();
+                double numPixels = double(size) * double(size);
+
+                std::cout << size << "x" << size << " " << name << " :";
+
+                uint64_t referenceHash = 0;
+                double referenceTime = 0.0;
+                for (auto& variant : variants)
+                {
+                    for (uint32_t i = 0; i < numWarmup; ++i) conversion(variant.settings);
+
+                    double totalTime = 0.0;
+                    uint64_t hash = 0;
+                    for (uint32_t i = 0; i < numIterations; ++i)
+                    {
+                        auto startTime = std::chrono::steady_clock::now();
+                        auto result = conversion(variant.settings);
+                        totalTime += std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - startTime).count();
+                        if (i == 0) hash = hashData(*result);
+                    }
+
+                    double time = totalTime / double(numIterations);
+                    bool matched = true;
+                    if (variant.settings.simd)
+                    {
+                        matched = (hash == referenceHash);
+                        allMatched = allMatched && matched;
+                    }
+                    else
+                    {
+                        referenceHash = hash;
+                        referenceTime = time;
+                    }
+
+                    double megapixelsPerSecond = numPixels / (time * 1e3);
+                    double gigabytesPerSecond = numPixels * double(bytesPerPixel) / (time * 1e6);
+                    std::cout << " " << variant.name << " " << time << "ms (" << referenceTime / time << "x)" << (matched ? "" : " MISMATCH");
+
+                    json << (numResults++ > 0 ? ",\n" : "\n") << "    {\"size\": " << size << ", \"conversion\": \"" << name << "\", \"variant\": \"" << variant.name << "\", \"ms\": " << time
+                         << ", \"mpixels_per_s\": " << megapixelsPerSecond << ", \"gb_per_s\": " << gigabytesPerSecond << ", \"matches_scalar\": " << (matched ? "true" : "false") << "}";
+                }
+                std::cout << std::endl;
+            }
+        }
+
+        if (jsonFilename)
+        {
+            std::ofstream fout(jsonFilename.string());
+            fout << "{\n  \"simd\": \"" << imageConvertSIMD() << "\",\n  \"threads\": " << numThreads << ",\n  \"iterations\": " << numIterations << ",\n  \"results\": [" << json.str() << "\n  ]\n}\n";
+            if (fout)
+                std::cout << "Written results to " << jsonFilename << std::endl;
+            else
+                std::cout << "Failed to write results to " << jsonFilename << std::endl;
+        }
+
+        if (!allMatched) std::cout << "Error: SIMD results differ from the scalar reference." << std::endl;
+        return allMatched ? 0 : 1;
+    }
+} // namespace
 
 int main(int argc, char** argv)
 {
@@ -13,8 +201,27 @@ int main(int argc, char** argv)
     auto workgroupSize = arguments.value(32, "-w");
     auto outputFilename = arguments.value<std::string>("", "-o");
     auto outputAsFloat = arguments.read("-f");
+
+    // benchmark settings, the defaults run the single configuration above once as vsgcompute always has
+    auto numWarmup = arguments.value(0u, "--warmup");
+    auto numIterations = arguments.value(1u, "--iterations");
+    auto numDispatches = arguments.value(1u, "--dispatches");
+    auto jsonFilename = arguments.value<vsg::Path>("", "--json");
+    uint32_t minWorkgroupSize = 0, maxWorkgroupSize = 0;
+    bool sweepWorkgroupSize = arguments.read("--sweep-w", minWorkgroupSize, maxWorkgroupSize);
+    uint32_t minSize = 0, maxSize = 0;
+    bool sweepSize = arguments.read("--sweep-size", minSize, maxSize);
+    auto convertBenchmark = arguments.read("--convert-benchmark");
+    uint32_t minConvertSize = 1024, maxConvertSize = 8192;
+    arguments.read("--convert-sizes", minConvertSize, maxConvertSize);
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
+    numIterations = std::max(1u, numIterations);
+    numDispatches = std::max(1u, numDispatches);
+
+    // the image conversion benchmark runs on the CPU so doesn't need a Vulkan device
+    if (convertBenchmark) return runConvertBenchmark(minConvertSize, maxConvertSize, numWarmup, numIterations, jsonFilename);
+
     vsg::Names instanceExtensions;
     vsg::Names requestedLayers;
     vsg::Names deviceExtensions;
@@ -25,19 +232,15 @@ int main(int argc, char** argv)
         if (apiDumpLayer) requestedLayers.push_back("VK_LAYER_LUNARG_api_dump");
     }
 
+    // use the precompiled SPIR-V so the benchmark doesn't require glslang at runtime, e.g. when running under lavapipe in CI
     vsg::Paths searchPaths = vsg::getEnvPaths("VSG_FILE_PATH");
-    auto computeStage = vsg::ShaderStage::read(VK_SHADER_STAGE_COMPUTE_BIT, "main", vsg::findFile("shaders/comp.spv", searchPaths));
-    if (!computeStage)
+    auto computeShader = vsg::ShaderStage::read(VK_SHADER_STAGE_COMPUTE_BIT, "main", vsg::findFile("shaders/comp.spv", searchPaths));
+    if (!computeShader)
     {
         std::cout << "Error : No shader loaded." << std::endl;
         return 1;
     }
 
-    computeStage->specializationConstants = vsg::ShaderStage::SpecializationConstants{
-        {0, vsg::intValue::create(width)},
-        {1, vsg::intValue::create(height)},
-        {2, vsg::intValue::create(workgroupSize)}};
-
     vsg::Names validatedNames = vsg::validateInstancelayerNames(requestedLayers);
 
     // get the physical device that supports the required compute queue
@@ -56,57 +259,211 @@ int main(int argc, char** argv)
     // get the queue for the compute commands
     auto computeQueue = device->getQueue(computeQueueFamily);
 
-    // allocate output storage buffer
-    VkDeviceSize bufferSize = sizeof(vsg::vec4) * width * height;
+    const auto& properties = physicalDevice->getProperties();
+    const auto& limits = properties.limits;
 
-    auto buffer = vsg::createBufferAndMemory(device, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    auto bufferMemory = buffer->getDeviceMemory(device->deviceID);
+    // timestamps are only valid on queues that report valid bits, otherwise fall back to timing on the CPU
+    uint32_t timestampValidBits = physicalDevice->getQueueFamilyProperties()[computeQueueFamily].timestampValidBits;
+    bool useTimestamps = timestampValidBits > 0;
+    uint64_t timestampMask = (timestampValidBits >= 64) ? ~uint64_t(0) : ((uint64_t(1) << timestampValidBits) - 1);
+    double timestampScaleToMilliseconds = 1e-6 * static_cast<double>(limits.timestampPeriod);
+    if (!useTimestamps) std::cout << "Warning: compute queue doesn't support timestamps, GPU times will be measured on the CPU." << std::endl;
 
-    // set up DescriptorSetLayout, DecriptorSet and BindDescriptorSets
+    // set up DescriptorSetLayout and PipelineLayout, these are shared by all the configurations
     vsg::DescriptorSetLayoutBindings descriptorBindings{{0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}};
     auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, vsg::PushConstantRanges{});
 
-    vsg::Descriptors descriptors{vsg::DescriptorBuffer::create(vsg::BufferInfoList{vsg::BufferInfo::create(buffer, 0, bufferSize)}, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)};
-    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, descriptors);
+    auto commandPool = vsg::CommandPool::create(device, computeQueueFamily);
+    auto fence = vsg::Fence::create(device);
 
-    auto pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, vsg::PushConstantRanges{});
-    auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, descriptorSet);
+    // the configurations to run, the shader uses a square workgroup of workgroupSize x workgroupSize
+    std::vector<uint32_t> workgroupSizes = sweepWorkgroupSize ? powersOfTwo(minWorkgroupSize, maxWorkgroupSize) : std::vector<uint32_t>{static_cast<uint32_t>(workgroupSize)};
+    std::vector<std::pair<uint32_t, uint32_t>> sizes;
+    if (sweepSize)
+    {
+        for (auto size : powersOfTwo(minSize, maxSize)) sizes.emplace_back(size, size);
+    }
+    else
+    {
+        sizes.emplace_back(width, height);
+    }
 
-    // set up the compute pipeline
-    auto pipeline = vsg::ComputePipeline::create(pipelineLayout, computeStage);
-    auto bindPipeline = vsg::BindComputePipeline::create(pipeline);
+    std::vector<BenchmarkResult> results;
+    for (auto& [problemWidth, problemHeight] : sizes)
+    {
+        // allocate output storage buffer, shared by all the workgroup sizes of this problem size
+        VkDeviceSize bufferSize = sizeof(vsg::vec4) * problemWidth * problemHeight;
+        auto buffer = vsg::createBufferAndMemory(device, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        for (auto wgSize : workgroupSizes)
+        {
+            uint32_t groupCountX = (problemWidth + wgSize - 1) / wgSize;
+            uint32_t groupCountY = (problemHeight + wgSize - 1) / wgSize;
+            if (wgSize * wgSize > limits.maxComputeWorkGroupInvocations || wgSize > limits.maxComputeWorkGroupSize[0] || wgSize > limits.maxComputeWorkGroupSize[1] ||
+                groupCountX > limits.maxComputeWorkGroupCount[0] || groupCountY > limits.maxComputeWorkGroupCount[1])
+            {
+                std::cout << "Skipping " << problemWidth << "x" << problemHeight << " with workgroup size " << wgSize << ", exceeds device limits." << std::endl;
+                continue;
+            }
 
-    // assign to a CommandGraph that binds the Pipeline and DescritorSets and calls Dispatch
-    auto commandGraph = vsg::Commands::create();
-    commandGraph->addChild(bindPipeline);
-    commandGraph->addChild(bindDescriptorSet);
-    commandGraph->addChild(vsg::Dispatch::create(uint32_t(ceil(float(width) / float(workgroupSize))), uint32_t(ceil(float(height) / float(workgroupSize))), 1));
+            // share the shader module but give each configuration its own specialization constants
+            auto computeStage = vsg::ShaderStage::create(VK_SHADER_STAGE_COMPUTE_BIT, "main", computeShader->module);
+            computeStage->specializationConstants = vsg::ShaderStage::SpecializationConstants{
+                {0, vsg::intValue::create(static_cast<int>(problemWidth))},
+                {1, vsg::intValue::create(static_cast<int>(problemHeight))},
+                {2, vsg::intValue::create(static_cast<int>(wgSize))}};
 
-    // compile the Vulkan objects
-    auto compileTraversal = vsg::CompileTraversal::create(device);
-    auto context = compileTraversal->contexts.front();
-    context->commandPool = vsg::CommandPool::create(device, computeQueueFamily);
-    // context->descriptorPool = vsg::DescriptorPool::create(device, 1, vsg::DescriptorPoolSizes{{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1}});
+            vsg::Descriptors descriptors{vsg::DescriptorBuffer::create(vsg::BufferInfoList{vsg::BufferInfo::create(buffer, 0, bufferSize)}, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)};
+            auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, vsg::DescriptorSet::create(descriptorSetLayout, descriptors));
+            auto bindPipeline = vsg::BindComputePipeline::create(vsg::ComputePipeline::create(pipelineLayout, computeStage));
 
-    commandGraph->accept(*compileTraversal);
+            // one timestamp before the first dispatch and one after each dispatch
+            auto queryPool = vsg::QueryPool::create();
+            queryPool->queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPool->queryCount = numDispatches + 1;
 
-    // setup fence
-    auto fence = vsg::Fence::create(device);
+            // assign to a Commands that binds the Pipeline and DescritorSets and calls Dispatch numDispatches times
+            auto commands = vsg::Commands::create();
+            if (useTimestamps)
+            {
+                commands->addChild(vsg::ResetQueryPool::create(queryPool));
+                commands->addChild(vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0));
+            }
+            commands->addChild(bindPipeline);
+            commands->addChild(bindDescriptorSet);
+            for (uint32_t d = 0; d < numDispatches; ++d)
+            {
+                if (d > 0)
+                {
+                    // each dispatch writes the whole buffer so they have to run one after the other
+                    auto bufferBarrier = vsg::BufferMemoryBarrier::create(
+                        VK_ACCESS_SHADER_WRITE_BIT, // srcAccessMask
+                        VK_ACCESS_SHADER_WRITE_BIT, // dstAccessMask
+                        VK_QUEUE_FAMILY_IGNORED,    // srcQueueFamilyIndex
+                        VK_QUEUE_FAMILY_IGNORED,    // dstQueueFamilyIndex
+                        buffer,                     // buffer
+                        0,                          // offset
+                        bufferSize                  // size
+                    );
+                    commands->addChild(vsg::PipelineBarrier::create(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, bufferBarrier));
+                }
+                commands->addChild(vsg::Dispatch::create(groupCountX, groupCountY, 1));
+                if (useTimestamps) commands->addChild(vsg::WriteTimestamp::create(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, d + 1));
+            }
+
+            // compile the Vulkan objects
+            auto compileTraversal = vsg::CompileTraversal::create(device);
+            auto context = compileTraversal->contexts.front();
+            context->commandPool = commandPool;
+            commands->accept(*compileTraversal);
+
+            // record the command buffer once and resubmit it for every iteration so the timings only include submission and execution
+            auto commandBuffer = commandPool->allocate();
+
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            vkBeginCommandBuffer(*commandBuffer, &beginInfo);
+            commands->record(*commandBuffer);
+            vkEndCommandBuffer(*commandBuffer);
+
+            VkCommandBuffer vk_commandBuffer = *commandBuffer;
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &vk_commandBuffer;
+
+            BenchmarkResult result;
+            result.width = problemWidth;
+            result.height = problemHeight;
+            result.workgroupSize = wgSize;
+            result.numDispatches = numDispatches;
+            result.numIterations = numIterations;
+            result.minGpuTime = std::numeric_limits<double>::max();
+            result.buffer = buffer;
+
+            std::vector<uint64_t> timestamps(numDispatches + 1);
+            for (uint32_t i = 0; i < numWarmup + numIterations; ++i)
+            {
+                auto startTime = std::chrono::steady_clock::now();
 
-    auto startTime = std::chrono::steady_clock::now();
+                computeQueue->submit(submitInfo, fence);
+                fence->wait(100000000000);
 
-    // submit commands
-    vsg::submitCommandsToQueue(context->commandPool, fence, 100000000000, computeQueue, [&](vsg::CommandBuffer& commandBuffer) {
-        commandGraph->record(commandBuffer);
-    });
+                double cpuTime = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - startTime).count();
+                fence->reset();
 
-    auto time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - startTime).count();
-    std::cout << "Time to run commands " << time << "ms" << std::endl;
+                // the warm up iterations let the driver finish any lazy pipeline creation and the GPU clocks ramp up
+                if (i < numWarmup) continue;
+
+                double gpuTime = cpuTime;
+                if (useTimestamps && queryPool->getResults(timestamps) == VK_SUCCESS)
+                {
+                    gpuTime = timestampScaleToMilliseconds * static_cast<double>((timestamps[numDispatches] - timestamps[0]) & timestampMask);
+                    for (uint32_t d = 0; d < numDispatches; ++d)
+                    {
+                        double dispatchTime = timestampScaleToMilliseconds * static_cast<double>((timestamps[d + 1] - timestamps[d]) & timestampMask);
+                        result.minGpuTime = std::min(result.minGpuTime, dispatchTime);
+                        result.maxGpuTime = std::max(result.maxGpuTime, dispatchTime);
+                    }
+                }
+                else
+                {
+                    result.minGpuTime = std::min(result.minGpuTime, gpuTime / numDispatches);
+                    result.maxGpuTime = std::max(result.maxGpuTime, gpuTime / numDispatches);
+                }
+
+                result.gpuTime += gpuTime;
+                result.cpuTime += cpuTime;
+                result.overhead += cpuTime - gpuTime;
+            }
+
+            result.gpuTime /= double(numIterations) * double(numDispatches);
+            result.cpuTime /= double(numIterations);
+            result.overhead /= double(numIterations);
+            if (result.gpuTime > 0.0) result.bandwidth = double(bufferSize) / (result.gpuTime * 1e6);
+
+            std::cout << problemWidth << "x" << problemHeight << " workgroup " << wgSize << "x" << wgSize << " : GPU " << result.gpuTime << "ms per dispatch (min " << result.minGpuTime << ", max " << result.maxGpuTime << "), "
+                      << "submit to complete " << result.cpuTime << "ms, overhead " << result.overhead << "ms, " << result.bandwidth << " GB/s" << std::endl;
+
+            results.push_back(result);
+        }
+    }
+
+    if (results.empty())
+    {
+        std::cout << "No configurations could be run." << std::endl;
+        return 1;
+    }
+
+    if (jsonFilename)
+    {
+        std::ofstream fout(jsonFilename.string());
+        fout << "{\n  \"device\": \"" << properties.deviceName << "\",\n  \"timer\": \"" << (useTimestamps ? "timestamp" : "cpu") << "\",\n  \"timestamp_period_ns\": " << limits.timestampPeriod
+             << ",\n  \"warmup\": " << numWarmup << ",\n  \"iterations\": " << numIterations << ",\n  \"dispatches\": " << numDispatches << ",\n  \"results\": [";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            auto& result = results[i];
+            fout << (i > 0 ? ",\n" : "\n") << "    {\"width\": " << result.width << ", \"height\": " << result.height << ", \"workgroup_size\": " << result.workgroupSize
+                 << ", \"gpu_ms\": " << result.gpuTime << ", \"gpu_min_ms\": " << result.minGpuTime << ", \"gpu_max_ms\": " << result.maxGpuTime
+                 << ", \"submit_ms\": " << result.cpuTime << ", \"overhead_ms\": " << result.overhead << ", \"gb_per_s\": " << result.bandwidth << "}";
+        }
+        fout << "\n  ]\n}\n";
+
+        if (fout)
+            std::cout << "Written results to " << jsonFilename << std::endl;
+        else
+            std::cout << "Failed to write results to " << jsonFilename << std::endl;
+    }
 
     if (!outputFilename.empty())
     {
+        // write the output of the last configuration run
+        auto& result = results.back();
+        auto bufferMemory = result.buffer->getDeviceMemory(device->deviceID);
+
         // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
-        auto image = vsg::MappedData<vsg::vec4Array2D>::create(bufferMemory, 0, 0, vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT}, width, height); // deviceMemory, offset, flags an d dimensions
+        auto image = vsg::MappedData<vsg::vec4Array2D>::create(bufferMemory, 0, 0, vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT}, result.width, result.height); // deviceMemory, offset, flags an d dimensions
 
         if (outputAsFloat)
         {
@@ -114,15 +471,8 @@ int main(int argc, char** argv)
         }
         else
         {
-            // create a unsigned byte version of the image and then copy the texels across converting colours from float to unsigned byte.
-            auto dest = vsg::ubvec4Array2D::create(width, height, vsg::Data::Properties{VK_FORMAT_R8G8B8A8_UNORM});
-
-            using component_type = uint8_t;
-            auto c_itr = dest->begin();
-            for (auto& colour : *image)
-            {
-                (c_itr++)->set(static_cast<component_type>(colour.r * 255.0), static_cast<component_type>(colour.g * 255.0), static_cast<component_type>(colour.b * 255.0), static_cast<component_type>(colour.a * 255.0));
-            }
+            // create a unsigned byte version of the image, converting colours from float to unsigned byte with SIMD and threads over rows.
+            auto dest = convertToUnorm8(*image);
 
             vsg::write(dest, outputFilename);
         }